@@ -0,0 +1,122 @@
+#ifndef AABBTREE_H
+#define AABBTREE_H
+
+#include <cstdint>
+#include <vector>
+
+// An axis aligned bounding box in world units.
+struct Aabb {
+    float min[2] = { 0.0f, 0.0f };
+    float max[2] = { 0.0f, 0.0f };
+
+    bool overlaps(const Aabb& other) const {
+        return min[0] <= other.max[0] && other.min[0] <= max[0] &&
+               min[1] <= other.max[1] && other.min[1] <= max[1];
+    }
+
+    bool contains(const Aabb& other) const {
+        return min[0] <= other.min[0] && min[1] <= other.min[1] &&
+               other.max[0] <= max[0] && other.max[1] <= max[1];
+    }
+
+    float perimeter() const { return 2.0f * ((max[0] - min[0]) + (max[1] - min[1])); }
+
+    // Written without std::min and std::max, since this header is included after Windows.h, which defines macros with those names.
+    static Aabb combine(const Aabb& a, const Aabb& b) {
+        Aabb result {};
+        result.min[0] = a.min[0] < b.min[0] ? a.min[0] : b.min[0];
+        result.min[1] = a.min[1] < b.min[1] ? a.min[1] : b.min[1];
+        result.max[0] = a.max[0] > b.max[0] ? a.max[0] : b.max[0];
+        result.max[1] = a.max[1] > b.max[1] ? a.max[1] : b.max[1];
+        return result;
+    }
+};
+
+// A bounding volume hierarchy that is updated incrementally, as objects are added, moved and removed.
+//
+// Every object is a leaf with an enlarged ("fat") box. Moving an object only touches the tree when it leaves its fat box,
+// so objects that move a little every frame, or not at all, cost nothing. Leaves are inserted next to the sibling that
+// grows the tree's total perimeter the least, and rotations on the way back up keep the boxes tight as objects come and go.
+//
+// Queries only read the tree, so any number of them may run at the same time, as long as nothing modifies the tree meanwhile.
+class AabbTree {
+public:
+    static constexpr uint32_t nullNode = UINT32_MAX;
+
+    // Adds an object with the given box, and returns its proxy. "userData" is handed back by queries.
+    uint32_t createProxy(const Aabb& box, float margin, uint32_t userData);
+    void destroyProxy(uint32_t proxy);
+    // Returns whether the proxy was reinserted, because "box" is no longer inside its fat box.
+    bool moveProxy(uint32_t proxy, const Aabb& box, float margin);
+
+    const Aabb& fatBox(uint32_t proxy) const { return nodes[proxy].box; }
+    uint32_t userData(uint32_t proxy) const { return nodes[proxy].userData; }
+
+    // Calls "callback(userData)" for every proxy whose fat box overlaps "box".
+    template<typename Callback>
+    void query(const Aabb& box, Callback&& callback) const;
+
+    void clear();
+
+    uint32_t height() const { return root == nullNode ? 0 : static_cast<uint32_t>(nodes[root].height); }
+    uint32_t proxyCount() const { return leafCount; }
+
+private:
+    // Queries walk the tree with a fixed size stack. Rotations keep the tree shallow, so its height stays far below this.
+    static constexpr uint32_t queryStackSize = 256;
+
+    struct Node {
+        Aabb box {};
+        // The parent of nodes in the tree, or the next free node of nodes on the free list.
+        uint32_t parent = nullNode;
+        uint32_t child1 = nullNode;
+        uint32_t child2 = nullNode;
+        // Leaves have height 0, free nodes -1.
+        int32_t height = -1;
+        uint32_t userData = 0;
+
+        bool isLeaf() const { return child1 == nullNode; }
+    };
+
+    uint32_t allocateNode();
+    void freeNode(uint32_t node);
+
+    void insertLeaf(uint32_t leaf);
+    void removeLeaf(uint32_t leaf);
+    // Swaps a child of "node" with a grandchild, if that makes the boxes below "node" smaller.
+    void rotate(uint32_t node);
+    // Walks from "node" up to the root, refitting and rotating every node on the way.
+    void refitAncestors(uint32_t node);
+
+    std::vector<Node> nodes;
+    uint32_t root = nullNode;
+    uint32_t freeList = nullNode;
+    uint32_t leafCount = 0;
+};
+
+template<typename Callback>
+void AabbTree::query(const Aabb& box, Callback&& callback) const {
+    if (root == nullNode) {
+        return;
+    }
+
+    uint32_t stack[queryStackSize];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = root;
+
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        if (!node.box.overlaps(box)) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            callback(node.userData);
+        } else {
+            stack[stackSize++] = node.child1;
+            stack[stackSize++] = node.child2;
+        }
+    }
+}
+
+#endif // AABBTREE_H
@@ -0,0 +1,93 @@
+#ifndef ASSETARCHIVE_H
+#define ASSETARCHIVE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mappedfile.h"
+
+// On-disk layout of an asset archive (.bpak):
+//
+//   ArchiveHeader
+//   ArchiveEntry[entryCount]    sorted by (nameHash, name)
+//   string table                entry names, not null terminated
+//   entry data                  every entry starts at a multiple of "alignment"
+//
+// All offsets are relative to the start of the file, and all values are little endian.
+constexpr uint32_t archiveMagic = 0x4B415042; // "BPAK"
+constexpr uint32_t archiveVersion = 1;
+
+// The entry data is stored LZ4 block compressed.
+constexpr uint32_t archiveEntryCompressed = 1 << 0;
+
+struct ArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;
+    uint64_t indexOffset;
+    uint64_t stringTableOffset;
+};
+
+struct ArchiveEntry {
+    uint64_t nameHash;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint64_t dataOffset;
+    // Size of the data in the archive, which is smaller than "size" for compressed entries.
+    uint64_t storedSize;
+    uint64_t size;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+// 64 bit FNV-1a hash of an entry name. Used to sort the index, so lookups are a binary search over integers.
+uint64_t hashAssetName(std::string_view name);
+
+// A read-only archive of packed assets, memory mapped once when opened.
+// Lookups return spans pointing straight into the mapping, so reading an uncompressed asset never copies it.
+// Compressed entries are decompressed once on first lookup and kept for the lifetime of the archive.
+// Lookups are safe to do from multiple threads.
+class AssetArchive {
+public:
+    AssetArchive() = default;
+    AssetArchive(const AssetArchive&) = delete;
+    AssetArchive& operator=(const AssetArchive&) = delete;
+    ~AssetArchive();
+
+    // Throws std::runtime_error if the file cannot be mapped or is not a valid archive.
+    void open(const std::string& filename);
+    void close();
+
+    bool isOpen() const { return mappedData != nullptr; }
+
+    std::optional<std::span<const char>> find(std::string_view name);
+
+    // Like "find", but throws std::runtime_error if the asset is not in the archive.
+    std::span<const char> get(std::string_view name);
+
+    uint32_t entryCount() const { return header != nullptr ? header->entryCount : 0; }
+
+private:
+    const ArchiveEntry* findEntry(std::string_view name) const;
+
+    MappedFile file;
+    const char* mappedData = nullptr;
+    size_t mappedSize = 0;
+
+    const ArchiveHeader* header = nullptr;
+    const ArchiveEntry* entries = nullptr;
+    const char* stringTable = nullptr;
+
+    std::mutex decompressedMutex;
+    std::unordered_map<const ArchiveEntry*, std::unique_ptr<char[]>> decompressedEntries;
+};
+
+#endif // ASSETARCHIVE_H
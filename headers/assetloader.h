@@ -0,0 +1,158 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include <atomic>
+#include <coroutine>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "assetarchive.h"
+#include "task.h"
+#include "threadpool.h"
+#include "uploadmanager.h"
+
+// Everything an asset needs to create and upload its GPU resources.
+struct AssetUploadContext {
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    UploadManager* uploadManager = nullptr;
+};
+
+// Describes how to turn raw file data into an asset of type T.
+// Specializations must provide:
+//   static T decode(std::span<const char> data);                   Runs on an I/O thread.
+// and may provide:
+//   static void upload(T& asset, const AssetUploadContext& context);  Runs on the main thread.
+template<typename T>
+struct AssetTraits;
+
+// Loads assets with coroutines, for example:
+//
+//   Task<void> loadLevel(AssetLoader& loader) {
+//       Texture background = co_await loader.load<Texture>("textures/background.tga");
+//       std::vector<Texture> sprites = co_await loader.loadAll<Texture>({ "textures/a.tga", "textures/b.tga" });
+//   }
+//
+// Reading and decoding happen on a pool of I/O threads. The coroutine then hops back to the main thread, where the GPU resources
+// are created and handed to the upload manager, and resumes there once the asset is ready.
+// "loadAll" starts all loads at once, so dozens of reads overlap with decoding and uploading instead of running one after another.
+// Loads that haven't finished by "shutdown" fail with an error, which the awaiting coroutines see like any other failed load.
+class AssetLoader {
+public:
+    void init(uint32_t ioThreadCount, AssetArchive* archive, const AssetUploadContext& uploadContext);
+    void shutdown();
+
+    // Resumes coroutines that are waiting to continue on the main thread. Call this once per frame from the main thread.
+    void pump();
+
+    // "co_await loader.resumeOnIoThread()" continues the current coroutine on an I/O thread.
+    // After "shutdown", it throws instead of suspending.
+    auto resumeOnIoThread() {
+        struct Awaiter {
+            AssetLoader& loader;
+            bool await_ready() const noexcept { return loader.cancelled; }
+            void await_suspend(std::coroutine_handle<> handle) { loader.ioPool->enqueue([handle] { handle.resume(); }); }
+            void await_resume() const { loader.throwIfCancelled(); }
+        };
+        return Awaiter { *this };
+    }
+
+    // "co_await loader.resumeOnMainThread()" continues the current coroutine during the next call to "pump".
+    // After "shutdown", it throws instead of suspending.
+    auto resumeOnMainThread() {
+        struct Awaiter {
+            AssetLoader& loader;
+            bool await_ready() const noexcept { return loader.cancelled; }
+            void await_suspend(std::coroutine_handle<> handle) {
+                std::lock_guard<std::mutex> lock(loader.mainThreadMutex);
+                loader.mainThreadQueue.push_back(handle);
+            }
+            void await_resume() const { loader.throwIfCancelled(); }
+        };
+        return Awaiter { *this };
+    }
+
+    template<typename T>
+    Task<T> load(std::string path);
+
+    template<typename T>
+    Task<std::vector<T>> loadAll(std::vector<std::string> paths);
+
+    // Number of loads that have been started but not finished yet.
+    uint32_t loadsInFlight() const { return inFlight.load(); }
+
+private:
+    // Reads an asset from the archive when it's packed there, or from a loose file otherwise.
+    // The returned span stays valid as long as "storage" and the archive do.
+    std::span<const char> readAsset(const std::string& path, std::vector<char>& storage);
+
+    void throwIfCancelled() const {
+        if (cancelled) {
+            throw std::runtime_error("asset loading was cancelled!");
+        }
+    }
+
+    std::unique_ptr<ThreadPool> ioPool;
+    AssetArchive* assetArchive = nullptr;
+    AssetUploadContext context {};
+
+    std::mutex mainThreadMutex;
+    std::vector<std::coroutine_handle<>> mainThreadQueue;
+    std::vector<std::coroutine_handle<>> resumingHandles;
+
+    std::atomic<uint32_t> inFlight = 0;
+    std::atomic<bool> cancelled = false;
+};
+
+template<typename T>
+Task<T> AssetLoader::load(std::string path) {
+    inFlight++;
+    struct InFlightGuard {
+        std::atomic<uint32_t>& counter;
+        ~InFlightGuard() { counter--; }
+    } inFlightGuard { inFlight };
+
+    co_await resumeOnIoThread();
+
+    // Errors are carried over to the main thread, so that a load always finishes on the main thread, even if it fails.
+    std::optional<T> asset;
+    std::exception_ptr error;
+    try {
+        std::vector<char> storage;
+        asset = AssetTraits<T>::decode(readAsset(path, storage));
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    co_await resumeOnMainThread();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    if constexpr (requires { AssetTraits<T>::upload(asset.value(), context); }) {
+        AssetTraits<T>::upload(asset.value(), context);
+    }
+
+    co_return std::move(asset.value());
+}
+
+template<typename T>
+Task<std::vector<T>> AssetLoader::loadAll(std::vector<std::string> paths) {
+    std::vector<Task<T>> tasks;
+    tasks.reserve(paths.size());
+    for (auto& path : paths) {
+        tasks.push_back(load<T>(std::move(path)));
+    }
+
+    co_return co_await whenAll(std::move(tasks));
+}
+
+#endif // ASSETLOADER_H
@@ -0,0 +1,131 @@
+#ifndef ASYNCCOMPUTE_H
+#define ASYNCCOMPUTE_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "hostallocator.h"
+#include "timeline.h"
+
+// Records a compute pass into "commandBuffer". "slot" selects which copy of the pass's per-frame resources to use, see AsyncCompute.
+using ComputePassRecorder = std::function<void(VkCommandBuffer commandBuffer, uint32_t slot)>;
+
+struct AsyncComputeStats {
+    // GPU time of the most recently measured compute submission, and of the graphics frame it ran alongside.
+    double computeMilliseconds = 0.0;
+    double graphicsMilliseconds = 0.0;
+    // How long both were executing at the same time.
+    double overlapMilliseconds = 0.0;
+    // Fraction of the compute work that was hidden behind graphics work. 0 means the queues serialized completely.
+    double overlapRatio = 0.0;
+};
+
+// Runs compute passes (particles, culling, lighting) on a separate compute queue, so they can overlap with rasterization.
+//
+// The compute work of frame N is submitted before the CPU waits for frame N-1, so on a device with a dedicated compute family
+// it can execute while the graphics queue is still busy with the previous frame. Frame N's graphics submission then waits on
+// it with a semaphore, at the stage that consumes the results.
+//
+// Because two frames of compute work can be alive at once, passes keep two copies ("slots") of anything they write,
+// and must use the slot they are given. Buffers shared between compute and graphics should be created with
+// VK_SHARING_MODE_CONCURRENT for both queue families, so that no ownership transfers are needed.
+//
+// Timestamps are written at the start and end of every compute submission and every graphics frame, and used to measure
+// how much of the compute work actually overlapped with the previous frame's graphics work.
+class AsyncCompute {
+public:
+    static constexpr uint32_t slotCount = 2;
+
+    // "graphicsTimeline" is null when timeline semaphores are not in use. "hostAllocations" must outlive the object.
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t computeFamily, VkQueue computeQueue,
+              uint32_t graphicsFamily, const QueueTimeline* graphicsTimeline, HostAllocationTracker& hostAllocations);
+    void destroy();
+
+    // Passes are recorded in the order they were added, into a single command buffer per frame.
+    void addPass(std::string name, ComputePassRecorder recorder);
+
+    // Records and submits the compute passes of the frame that will be submitted with "frameValue".
+    // Nothing is submitted if there are no passes.
+    void submit(uint64_t frameValue);
+
+    // Makes the graphics submission of the current frame wait for its compute work at "stage".
+    void waitInGraphicsSubmit(SubmitSemaphores& submitSemaphores, VkPipelineStageFlags stage);
+
+    // Command buffers that bracket the graphics work of the current frame with timestamps. "begin" goes before the frame's
+    // command buffers in its submission, and "end" after them. Both are null when timestamps aren't supported.
+    struct GraphicsTimestamps {
+        VkCommandBuffer begin = VK_NULL_HANDLE;
+        VkCommandBuffer end = VK_NULL_HANDLE;
+    };
+    // The queries change every frame, so they are recorded into command buffers of their own, once per frame.
+    // That keeps the frame's own command buffers reusable.
+    GraphicsTimestamps recordGraphicsTimestamps();
+
+    uint32_t currentSlot() const { return slot; }
+    uint32_t queueFamily() const { return computeFamilyIndex; }
+    bool usesDedicatedComputeQueue() const { return computeFamilyIndex != graphicsFamilyIndex; }
+
+    const AsyncComputeStats& stats() const { return computeStats; }
+
+private:
+    struct Slot {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkSemaphore computeFinishedSemaphore = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t frameValue = 0;
+        bool inFlight = false;
+    };
+
+    // Each frame gets four queries: compute begin and end, then graphics begin and end.
+    // Results are read two frames later, so the ring has room for the frames that may still be running.
+    static constexpr uint32_t timestampFrameCount = 4;
+    static constexpr uint32_t queriesPerFrame = 4;
+
+    struct TimestampFrame {
+        bool computeWritten = false;
+        bool graphicsWritten = false;
+    };
+
+    void waitForSlot(Slot& slot);
+    VkCommandBuffer recordTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t query, bool reset);
+    void readTimestamps(uint64_t frameValue);
+
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    HostAllocationTracker* hostAllocations = nullptr;
+    uint32_t computeFamilyIndex = 0;
+    uint32_t graphicsFamilyIndex = 0;
+    VkQueue computeQueue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+
+    std::array<Slot, slotCount> slots {};
+    uint32_t slot = 0;
+    // Set when the current frame submitted compute work that its graphics submission has to wait for.
+    bool graphicsWaitPending = false;
+    uint64_t currentFrameValue = 0;
+
+    const QueueTimeline* graphicsTimeline = nullptr;
+    QueueTimeline computeTimeline {};
+
+    struct Pass {
+        std::string name;
+        ComputePassRecorder recorder;
+    };
+    std::vector<Pass> passes;
+
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    // Allocated from the graphics family, one begin and end pair per timestamp frame.
+    VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+    std::array<GraphicsTimestamps, timestampFrameCount> graphicsTimestampBuffers {};
+    std::array<TimestampFrame, timestampFrameCount> timestampFrames {};
+    uint64_t timestampMask = 0;
+    double timestampPeriod = 0.0;
+
+    AsyncComputeStats computeStats {};
+};
+
+#endif // ASYNCCOMPUTE_H
@@ -0,0 +1,23 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include <cstdint>
+#include <span>
+
+#include <vulkan/vulkan.h>
+
+// Software decoders for the block-compressed texture formats, for devices that can't sample a format a texture was shipped in.
+// Desktop GPUs support the BC formats and usually not ETC2, mobile GPUs the other way around, so either may need decoding.
+//
+// All of these formats split the image into 4x4 texel blocks of 8 or 16 bytes. Every block holds a few endpoint colors
+// and a small index per texel, which picks a color interpolated between the endpoints.
+// Supported are BC1 (RGB and RGBA), BC3, BC7, and ETC2 (RGB, RGB with 1 bit alpha, and RGBA with EAC alpha).
+
+// The size of one 4x4 block in bytes, or 0 if the format is not one of the supported block-compressed formats.
+uint32_t compressedBlockSize(VkFormat format);
+
+// Decodes an image of "width" x "height" texels into tightly packed RGBA8 texels.
+// "blocks" holds the blocks row by row, and must contain all of them. Returns false if the format isn't supported.
+bool decodeCompressedImage(VkFormat format, std::span<const uint8_t> blocks, uint32_t width, uint32_t height, std::span<uint8_t> rgba);
+
+#endif // BLOCKCOMPRESSION_H
@@ -0,0 +1,129 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "aabbtree.h"
+
+class ThreadPool;
+
+using BodyId = uint32_t;
+
+// Static bodies never move, and are never tested against each other.
+enum class BodyType {
+    Static,
+    Dynamic,
+};
+
+// Two bodies whose boxes overlap. "a" is always the smaller id.
+struct BodyPair {
+    BodyId a = 0;
+    BodyId b = 0;
+};
+
+enum class BroadphaseMode {
+    // Boxes are kept sorted along the X axis. Since bodies move little between frames, the order from the last frame is almost
+    // right, and an insertion sort fixes it in close to linear time. Best when most bodies move.
+    SweepAndPrune,
+    // Boxes are kept in a dynamic AABB tree, which only dynamic bodies query. Static bodies cost nothing after being inserted,
+    // so this is best for scenes with a lot of static geometry.
+    DynamicTree,
+};
+
+struct BroadphaseStats {
+    uint32_t bodyCount = 0;
+    uint32_t pairCount = 0;
+    // Swaps done by the insertion sort in the last update. Stays low as long as bodies move coherently.
+    uint64_t sortSwaps = 0;
+    // Tree proxies that left their fat box in the last update, and had to be reinserted.
+    uint32_t treeReinserts = 0;
+    double milliseconds = 0.0;
+};
+
+// Finds all pairs of bodies whose boxes overlap, as the first step of collision detection.
+// Overlapping boxes don't mean the bodies touch, so the pairs are meant to be tested exactly by the narrow phase afterwards.
+//
+// Pairs are generated in chunks, which are spread over the workers of a thread pool when one is given.
+// Every chunk writes into its own pair list, so workers don't share anything they write to.
+class Broadphase {
+public:
+    explicit Broadphase(BroadphaseMode mode = BroadphaseMode::SweepAndPrune);
+
+    BodyId addBody(const Aabb& box, BodyType type);
+    void removeBody(BodyId body);
+    void updateBody(BodyId body, const Aabb& box);
+
+    const Aabb& bounds(BodyId body) const { return bodies[body].box; }
+
+    // Switching rebuilds the acceleration structures from scratch.
+    void setMode(BroadphaseMode newMode);
+    BroadphaseMode currentMode() const { return mode; }
+
+    // Fat boxes in the tree are this much larger than the bodies on every side, in world units.
+    // Larger margins mean fewer reinserts for moving bodies, but more pairs to reject.
+    void setTreeMargin(float margin) { treeMargin = margin; }
+
+    // Recomputes the overlapping pairs, if any body was added, moved or removed since the last call.
+    // Returns whether the pairs were recomputed.
+    bool findPairs(ThreadPool* pool);
+
+    // Only valid until the next call to "findPairs". Pairs are in no particular order.
+    std::span<const BodyPair> pairs() const { return pairList; }
+
+    const BroadphaseStats& stats() const { return lastStats; }
+
+private:
+    // Below this many bodies, handing chunks to workers costs more than it saves.
+    static constexpr uint32_t parallelBodyCount = 2048;
+    // Chunks per thread. More chunks than threads, so that a worker that got a crowded chunk doesn't hold up the rest.
+    static constexpr uint32_t chunksPerThread = 4;
+
+    struct Body {
+        Aabb box {};
+        BodyType type = BodyType::Dynamic;
+        bool alive = false;
+        uint32_t treeProxy = AabbTree::nullNode;
+        // Position in "dynamicBodies".
+        uint32_t dynamicIndex = UINT32_MAX;
+    };
+
+    // A body in the sweep list. The box is copied in, so that the sweep reads the list front to back and nothing else.
+    struct SweepEntry {
+        Aabb box {};
+        BodyId body = 0;
+        bool isStatic = false;
+    };
+
+    void sortSweepList();
+    void sweepRange(uint32_t begin, uint32_t end, std::vector<BodyPair>& output) const;
+    void queryTreeRange(uint32_t begin, uint32_t end, std::vector<BodyPair>& output) const;
+    void rebuildStructures();
+
+    BroadphaseMode mode;
+    float treeMargin = 8.0f;
+
+    std::vector<Body> bodies;
+    std::vector<BodyId> freeBodies;
+    // Removed bodies whose ids are still in the sweep list.
+    std::vector<BodyId> removedBodies;
+    std::vector<BodyId> dynamicBodies;
+    uint32_t bodyCount = 0;
+
+    std::vector<SweepEntry> sweepList;
+    bool sweepListHasRemovedBodies = false;
+    uint32_t addedSinceSort = 0;
+
+    AabbTree tree;
+    uint32_t treeReinserts = 0;
+
+    // One pair list per chunk, kept between updates so their memory is reused.
+    std::vector<std::vector<BodyPair>> chunkPairs;
+    std::vector<BodyPair> pairList;
+
+    bool changed = false;
+    BroadphaseStats lastStats {};
+};
+
+#endif // BROADPHASE_H
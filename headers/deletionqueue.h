@@ -0,0 +1,54 @@
+#ifndef DELETIONQUEUE_H
+#define DELETIONQUEUE_H
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+// Defers destruction of Vulkan objects until the GPU is done with them.
+//
+// It is an application's responsibility not to destroy objects while they are still in use by the GPU.
+// Instead of waiting for the device to go idle, objects are retired together with the value of the last frame (or timeline value)
+// that used them, and destroyed by "collect" once the GPU has completed that value.
+// This allows resources to be replaced at any time (hot reloads, resizes, streaming) without stalling.
+// Objects are destroyed without allocation callbacks, so only objects created without them can be retired.
+class DeletionQueue {
+public:
+    void init(VkDevice device);
+
+    void retire(VkBuffer buffer, uint64_t lastUsedValue);
+    void retire(VkImage image, uint64_t lastUsedValue);
+    void retire(VkImageView imageView, uint64_t lastUsedValue);
+    void retire(VkSampler sampler, uint64_t lastUsedValue);
+    void retire(VkDeviceMemory memory, uint64_t lastUsedValue);
+    void retire(VkPipeline pipeline, uint64_t lastUsedValue);
+    void retire(VkPipelineLayout pipelineLayout, uint64_t lastUsedValue);
+    void retire(VkFramebuffer framebuffer, uint64_t lastUsedValue);
+    void retire(VkRenderPass renderPass, uint64_t lastUsedValue);
+    void retire(VkDescriptorPool descriptorPool, uint64_t lastUsedValue);
+    void retire(VkShaderModule shaderModule, uint64_t lastUsedValue);
+
+    // Destroys every retired object whose value is less than or equal to "completedValue".
+    void collect(uint64_t completedValue);
+
+    // Destroys everything, regardless of its value. Only call this once the device is idle.
+    void flush();
+
+    size_t pendingCount() const { return pending.size(); }
+
+private:
+    struct PendingDestruction {
+        VkObjectType type;
+        uint64_t handle;
+        uint64_t lastUsedValue;
+    };
+
+    void push(VkObjectType type, uint64_t handle, uint64_t lastUsedValue);
+    void destroy(const PendingDestruction& destruction);
+
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    std::vector<PendingDestruction> pending;
+};
+
+#endif // DELETIONQUEUE_H
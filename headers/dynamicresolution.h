@@ -0,0 +1,117 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <vulkan/vulkan.h>
+
+#include "hostallocator.h"
+#include "perfcounters.h"
+
+struct DynamicResolutionSettings {
+    // Bounds of the scene resolution, as a fraction of the output resolution in each dimension.
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    // The GPU time a frame should take. Leaves some headroom below a 60 Hz refresh.
+    double targetMilliseconds = 14.0;
+};
+
+// Renders the scene at a resolution that follows the GPU frame time, and upscales it to the output resolution.
+//
+// The scene is rendered into an offscreen image that is large enough for the maximum scale, but only its top left
+// "renderExtent()" pixels are used. A final pass samples that part of the image with bilinear filtering to fill the swapchain image.
+// Anything drawn after the upscale, like UI, is drawn at the native resolution.
+//
+// Every frame's command buffer is bracketed by timestamps. Their smoothed difference is compared with the target,
+// and the scale is lowered when the GPU is over budget, and slowly raised again when there is room to spare.
+// Changing the scale changes the render area and viewport, so the scene has to be recorded again when it does.
+class DynamicResolution {
+public:
+    // "frameSlotCount" is the number of command buffers that record timestamps, each of which gets its own queries.
+    // "hostAllocations" must outlive the object.
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t graphicsFamily, VkExtent2D outputExtent, VkFormat sceneFormat,
+              uint32_t frameSlotCount, const DynamicResolutionSettings& settings, HostAllocationTracker& hostAllocations);
+    // Creates the pipeline of the upscale pass.
+    void createPipeline(VkRenderPass renderPass, uint32_t subpass, std::span<const char> vertexShaderCode, std::span<const char> fragmentShaderCode);
+    void destroy();
+
+    // Brackets the GPU work of a command buffer. Must be recorded outside of render passes, the beginning right before the scene pass.
+    // The queries are reset inside the command buffer, so it may be submitted again without recording it again.
+    void beginFrameTimestamps(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+    void endFrameTimestamps(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+
+    // Remembers which command buffer was submitted, so its timestamps can be read once it completes.
+    void frameSubmitted(uint32_t frameSlot);
+    // Reads the timestamps of the last submitted frame. Must only be called once that frame has completed.
+    void collectFrameTime();
+    // Picks a new scale from the measured frame times. Returns true if the render extent changed.
+    bool updateScale();
+    // Sets the scale directly, clamped to the bounds of the settings, e.g. to replay the scale a frame was captured at.
+    // Returns true if the render extent changed.
+    bool setScale(float newScale);
+
+    // Records the upscale of the scene image into the current subpass, which must cover the output extent.
+    void recordUpscale(VkCommandBuffer commandBuffer, CommandCounters& counters);
+
+    VkImageView sceneView() const { return scene.imageView; }
+    // The size of the scene image, and of any attachment rendered together with it.
+    VkExtent2D maxExtent() const { return sceneExtent; }
+    // The part of the scene image that is rendered to at the current scale.
+    VkExtent2D renderExtent() const { return currentExtent; }
+    float scale() const { return currentScale; }
+    double gpuMilliseconds() const { return smoothedMilliseconds; }
+
+private:
+    // Matches the push constant block of upscale.frag.
+    struct PushConstants {
+        float outputSize[2];
+        float sceneScale[2];
+        float maxTexCoord[2];
+    };
+
+    // Scale changes are rounded to this step, so that tiny changes don't cause command buffers to be recorded again.
+    static constexpr float scaleStep = 0.05f;
+    // Number of measured frames after a scale change before the next one, so that the smoothed time can catch up.
+    static constexpr uint32_t settleFrames = 30;
+
+    VkExtent2D extentForScale(float scale) const;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    HostAllocationTracker* hostAllocations = nullptr;
+    DynamicResolutionSettings settings {};
+
+    VkExtent2D outputExtent {};
+    VkExtent2D sceneExtent {};
+    VkExtent2D currentExtent {};
+    float currentScale = 1.0f;
+
+    struct {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+    } scene;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    // Two queries per frame slot, written at the start and end of its command buffer.
+    // Without timestamp support on the graphics queue, the scale stays at its maximum.
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    bool timestampsSupported = false;
+    uint64_t timestampMask = 0;
+    double timestampPeriod = 0.0;
+
+    std::optional<uint32_t> pendingFrameSlot;
+    double smoothedMilliseconds = 0.0;
+    uint64_t measuredFrames = 0;
+    uint32_t framesSinceChange = 0;
+};
+
+#endif // DYNAMICRESOLUTION_H
@@ -0,0 +1,114 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// A linear allocator for data that only lives for a frame, like draw lists, sort keys, culling results and text layouts.
+//
+// Allocating is a pointer bump, freeing individual allocations does nothing, and everything is released at once when the frame
+// starts again, by resetting the pointer. There's one region per frame that can be alive at the same time (the frame being built,
+// and the one before it), so data built for a frame stays valid while the next one is built.
+//
+// When a frame needs more than its region holds, the rest is allocated from the heap, and the region grows to the frame's
+// high-water mark the next time it's reset. After a few frames of warm-up, frames don't touch the heap at all.
+//
+// With "poisonFreedMemory" set, memory is filled with a recognizable pattern when it's released, so that anything still reading it
+// after its frame is over reads garbage instead of data that happens to look valid. It's on by default in debug builds.
+class FrameArena {
+public:
+    static constexpr uint32_t slotCount = 2;
+    // Byte patterns written over memory released by reset, and by deallocate.
+    static constexpr unsigned char resetPoison = 0xCD;
+    static constexpr unsigned char deallocatePoison = 0xDD;
+
+    FrameArena() = default;
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+    ~FrameArena();
+
+    void init(size_t initialCapacity);
+    void destroy();
+
+    // Starts building the frame with "frameValue", releasing everything allocated by the frame that last used the same region.
+    void beginFrame(uint64_t frameValue);
+
+    void* allocate(size_t size, size_t alignment);
+    // Only poisons the memory when "poisonFreedMemory" is set. It's reclaimed when the frame is reset either way.
+    void deallocate(void* memory, size_t size);
+
+    template<typename T>
+    T* allocate(size_t count) { return static_cast<T*>(allocate(count * sizeof(T), alignof(T))); }
+
+    void setPoisonFreedMemory(bool poison) { poisonFreedMemory = poison; }
+
+    // Bytes allocated by the current frame so far.
+    size_t bytesUsed() const { return slots[currentSlot].used; }
+    // The most any single frame has allocated.
+    size_t highWaterMark() const { return peakUsed; }
+    // Number of times a frame ran out of space and went to the heap, including growing regions. Stops increasing once warmed up.
+    uint64_t heapAllocations() const { return heapAllocationCount; }
+
+private:
+    struct Block {
+        unsigned char* memory = nullptr;
+        size_t capacity = 0;
+        size_t offset = 0;
+    };
+
+    struct Slot {
+        Block block;
+        // Heap blocks for whatever didn't fit into "block". Freed when the slot is reset.
+        std::vector<Block> overflow;
+        // Bytes allocated in this slot since its last reset, including overflow.
+        size_t used = 0;
+    };
+
+    static void* bump(Block& block, size_t size, size_t alignment);
+    Block allocateBlock(size_t capacity);
+
+    std::array<Slot, slotCount> slots {};
+    uint32_t currentSlot = 0;
+
+    size_t peakUsed = 0;
+    uint64_t heapAllocationCount = 0;
+
+#ifdef NDEBUG
+    bool poisonFreedMemory = false;
+#else
+    bool poisonFreedMemory = true;
+#endif
+};
+
+// Adapts a FrameArena to the allocator interface of the standard containers.
+// Containers using it must not outlive the frame they were created in.
+template<typename T>
+class FrameAllocator {
+public:
+    using value_type = T;
+
+    explicit FrameAllocator(FrameArena& arena) : arena(&arena) {}
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->template allocate<T>(count); }
+    void deallocate(T* memory, size_t count) { arena->deallocate(memory, count * sizeof(T)); }
+
+    template<typename U>
+    bool operator==(const FrameAllocator<U>& other) const { return arena == other.arena; }
+
+private:
+    template<typename U>
+    friend class FrameAllocator;
+
+    FrameArena* arena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif // FRAMEARENA_H
@@ -0,0 +1,111 @@
+#ifndef FRAMEBUFFERREADBACK_H
+#define FRAMEBUFFERREADBACK_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "hostallocator.h"
+#include "threadpool.h"
+
+struct ReadbackStats {
+    // Frames copied out of the swapchain, and frames that were wanted but skipped, because every buffer was still busy.
+    uint64_t capturedFrames = 0;
+    uint64_t droppedFrames = 0;
+    uint64_t writtenFrames = 0;
+    uint64_t bytesWritten = 0;
+    // Time the main thread spent on readback per captured frame, and the writer thread per written frame.
+    double mainThreadMilliseconds = 0.0;
+    double writeMilliseconds = 0.0;
+};
+
+// Copies presented frames back to the CPU and writes them to disk as TGA files, for screenshots and recording video.
+//
+// Reading an image back right after rendering it would stall the CPU until the GPU caught up, every frame.
+// Instead, each captured frame is copied into one of a ring of host visible buffers, by a small command buffer submitted
+// together with the frame. Only when a later frame finds that the copy has completed is the buffer handed to a background thread,
+// which converts and writes it, and then gives the buffer back. The main thread never waits: if all buffers are still busy,
+// because the disk can't keep up, the frame is dropped.
+//
+// The swapchain images must have been created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT.
+class FramebufferReadback {
+public:
+    static constexpr uint32_t slotCount = 4;
+
+    // "supported" tells whether the swapchain images can be copied from. Without it, or with a format other than 8 bit BGRA or RGBA,
+    // every capture is ignored.
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t graphicsFamily, VkExtent2D extent, VkFormat format, bool supported,
+              HostAllocationTracker& hostAllocations);
+    // Writes every frame that has completed, and waits for the writes to finish. The device must be idle.
+    void destroy();
+
+    // Saves the next presented frame to "filename".
+    void requestScreenshot(const std::string& filename);
+    // Saves every presented frame to "<prefix>_<frame number>.tga", until "stopRecording" is called.
+    void startRecording(const std::string& prefix);
+    void stopRecording();
+    bool isRecording() const { return recording; }
+    // Whether the next frame should be rendered, even if nothing in it changed, so that it can be captured.
+    bool wantsFrame() const { return enabled && (recording || !screenshotFilename.empty()); }
+
+    // Hands the buffers of frames up to "completedFrameValue" to the writer thread.
+    void collect(uint64_t completedFrameValue);
+    // Records the copy of "image", once rendered, if the frame is to be captured. The command buffer must be submitted after
+    // the frame's own, with the frame's value as "frameValue". Returns VK_NULL_HANDLE if there is nothing to capture.
+    VkCommandBuffer recordCopy(VkImage image, uint64_t frameValue);
+
+    ReadbackStats stats() const;
+
+private:
+    enum class SlotState : uint8_t {
+        Free,
+        // The copy was submitted, and hasn't completed yet.
+        Copying,
+        // The writer thread owns the buffer.
+        Writing,
+    };
+
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        const uint8_t* mapped = nullptr;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t frameValue = 0;
+        std::string filename;
+        std::atomic<SlotState> state { SlotState::Free };
+    };
+
+    void write(Slot& slot);
+
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    HostAllocationTracker* hostAllocations = nullptr;
+    VkExtent2D imageExtent {};
+    VkDeviceSize imageSize = 0;
+    bool enabled = false;
+    // Swapchains in RGBA order are swizzled to the BGRA order of TGA files.
+    bool swizzle = false;
+    bool coherent = false;
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    std::array<Slot, slotCount> slots {};
+    // A single thread, so frames are written in order.
+    std::unique_ptr<ThreadPool> writer;
+
+    std::string screenshotFilename;
+    bool recording = false;
+    std::string recordingPrefix;
+    uint64_t recordedFrames = 0;
+
+    uint64_t capturedFrames = 0;
+    uint64_t droppedFrames = 0;
+    double mainThreadSeconds = 0.0;
+    std::atomic<uint64_t> writtenFrames { 0 };
+    std::atomic<uint64_t> bytesWritten { 0 };
+    std::atomic<uint64_t> writeMicroseconds { 0 };
+};
+
+#endif // FRAMEBUFFERREADBACK_H
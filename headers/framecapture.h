@@ -0,0 +1,107 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "lighting.h"
+#include "spritebatch.h"
+
+// On-disk layout of a frame capture (.bcap):
+//
+//   CaptureHeader
+//   for every frame:
+//     CaptureFrameHeader
+//     frame data, LZ4 block compressed
+//
+// The frame data is the difference to the previous frame:
+//
+//   double time, float renderScale, uint32_t instanceCount, uint32_t runCount
+//   for every run of changed instances: uint32_t first, uint32_t count, SpriteInstance[count]
+//   uint32_t lightCount, Light[lightCount]      lightCount is capturedLightsUnchanged if the lights didn't change
+//
+// Instances and lights are stored as they are in memory, so a capture can only be replayed by a build with the same layouts,
+// which the header records the sizes of.
+constexpr uint32_t captureMagic = 0x50414342; // "BCAP"
+constexpr uint32_t captureVersion = 1;
+constexpr uint32_t capturedLightsUnchanged = UINT32_MAX;
+
+struct CaptureHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t instanceSize;
+    uint32_t lightSize;
+};
+
+struct CaptureFrameHeader {
+    uint32_t storedSize;
+    uint32_t size;
+};
+
+// Everything a frame was rendered from, as far as the renderer is concerned. Rendering the same packets again
+// renders the same images, independent of input, game logic, or how long anything took.
+//
+// Uploads are not part of a packet: textures, and anything else that goes through the upload manager or the texture cache,
+// are loaded by the replay the same way the game loaded them. Their contents match, but a texture that was streamed in
+// during the capture may become resident in a different frame of the replay.
+struct RenderPacket {
+    // Seconds since the captured game started, which is the time GPU animations were evaluated at. The replay evaluates them
+    // at the same time, so the first packet of a capture that started late in the game has a time well above zero.
+    double time = 0.0;
+    float renderScale = 1.0f;
+    std::vector<SpriteInstance> instances;
+    std::vector<Light> lights;
+    // Whether the instances or lights changed since the previous packet.
+    bool instancesChanged = false;
+    bool lightsChanged = false;
+};
+
+// Writes the render packet of every rendered frame to a capture file.
+// Only the instances that changed since the previous frame are stored, and every frame is compressed, so the file grows
+// with how much the scene changes, not with how many sprites there are.
+class FrameCaptureWriter {
+public:
+    // Throws std::runtime_error if the file can't be created.
+    void open(const std::string& filename);
+    void close();
+    bool isOpen() const { return file.is_open(); }
+
+    void write(double time, float renderScale, std::span<const SpriteInstance> instances, std::span<const Light> lights);
+
+    uint64_t frameCount() const { return frames; }
+    uint64_t bytesWritten() const { return storedBytes; }
+
+private:
+    std::ofstream file;
+    std::vector<SpriteInstance> previousInstances;
+    std::vector<Light> previousLights;
+    std::vector<char> frameData;
+    uint64_t frames = 0;
+    uint64_t storedBytes = 0;
+};
+
+// Reads the render packets of a capture file back, one frame at a time.
+class FrameCaptureReader {
+public:
+    // Throws std::runtime_error if the file can't be opened, or was written by a build with different layouts.
+    void open(const std::string& filename);
+    void close();
+    bool isOpen() const { return file.is_open(); }
+
+    // Applies the next frame to "packet", which must hold the previous frame read, or be empty for the first.
+    // Returns false at the end of the capture, or if the frame is malformed.
+    bool read(RenderPacket& packet);
+
+    uint64_t frameCount() const { return frames; }
+
+private:
+    std::ifstream file;
+    std::vector<char> storedData;
+    std::vector<char> frameData;
+    uint64_t frames = 0;
+};
+
+#endif // FRAMECAPTURE_H
@@ -0,0 +1,112 @@
+#ifndef HOSTALLOCATOR_H
+#define HOSTALLOCATOR_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+struct HostAllocationCounters {
+    uint64_t liveBytes = 0;
+    uint64_t liveAllocations = 0;
+    uint64_t peakBytes = 0;
+    // Every allocation and reallocation ever made. Growing quickly while the live counters stay flat means churn.
+    uint64_t totalAllocations = 0;
+};
+
+struct HostAllocationStats {
+    HostAllocationCounters total;
+    // Indexed by VkSystemAllocationScope.
+    std::array<HostAllocationCounters, 5> byScope;
+    std::vector<std::pair<VkObjectType, HostAllocationCounters>> byObjectType;
+    // Memory the driver allocated itself and only reported to us, like executable code for shaders.
+    uint64_t internalBytes = 0;
+};
+
+// Routes the host memory allocations of the Vulkan driver through our own allocator, and keeps count of them.
+//
+// Vulkan allocates host memory for almost every object it creates. Passing nullptr as "pAllocator" leaves that to the
+// driver, and makes it invisible to us. Passing the callbacks of this tracker instead lets us see how much memory the driver
+// holds, for which kind of object, and for how long (the VkSystemAllocationScope of each allocation).
+//
+// The callbacks don't tell which object an allocation belongs to, so every object type gets its own callbacks, which
+// know the type they were handed out for. The callbacks passed to vkDestroy* must match the ones passed to vkCreate*.
+//
+// The driver may call the callbacks from any thread that calls into Vulkan, so all counters are atomic.
+//
+// Not everything is tracked. The objects created in main.cpp, by the sprite pipelines, async compute, dynamic resolution,
+// lighting and framebuffer readback, and the timeline semaphores are. Left out are:
+// - buffers, images, image views, memory and shader modules made by the helpers in vulkanhelper.h, which the tools share
+//   without a tracker
+// - everything the sprite batch, upload manager, overdraw meter, perf overlay and texture code create
+// - whatever goes through the deletion queue, which destroys objects without callbacks
+class HostAllocationTracker {
+public:
+    HostAllocationTracker() = default;
+    HostAllocationTracker(const HostAllocationTracker&) = delete;
+    HostAllocationTracker& operator=(const HostAllocationTracker&) = delete;
+
+    // Callbacks for objects of "objectType". Returns nullptr while tracking is disabled, which makes Vulkan use its own allocator.
+    // Must not be disabled while objects created with tracking enabled are alive.
+    const VkAllocationCallbacks* callbacks(VkObjectType objectType);
+
+    void setEnabled(bool enabled) { trackingEnabled = enabled; }
+    bool enabled() const { return trackingEnabled; }
+
+    HostAllocationStats stats() const;
+
+private:
+    struct AtomicCounters {
+        std::atomic<uint64_t> liveBytes = 0;
+        std::atomic<uint64_t> liveAllocations = 0;
+        std::atomic<uint64_t> peakBytes = 0;
+        std::atomic<uint64_t> totalAllocations = 0;
+
+        void add(uint64_t size);
+        void remove(uint64_t size);
+        HostAllocationCounters load() const;
+    };
+
+    struct ObjectTypeRecord {
+        HostAllocationTracker* tracker = nullptr;
+        VkObjectType objectType = VK_OBJECT_TYPE_UNKNOWN;
+        VkAllocationCallbacks callbacks {};
+        AtomicCounters counters;
+    };
+
+    // Stored right in front of every allocation, since vkFree callbacks only get the pointer.
+    struct AllocationHeader {
+        void* block;
+        size_t size;
+        ObjectTypeRecord* record;
+        VkSystemAllocationScope scope;
+    };
+
+    static void* VKAPI_PTR allocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void* VKAPI_PTR reallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    static void VKAPI_PTR free(void* userData, void* memory);
+    static void VKAPI_PTR internalAllocation(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+    static void VKAPI_PTR internalFree(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+    void* allocateTracked(ObjectTypeRecord& record, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void freeTracked(void* memory);
+
+    bool trackingEnabled = true;
+
+    // Records are never removed, and unordered_map never moves its elements, so the callbacks can point into them.
+    mutable std::mutex recordsMutex;
+    std::unordered_map<VkObjectType, ObjectTypeRecord> records;
+
+    AtomicCounters totalCounters;
+    std::array<AtomicCounters, 5> scopeCounters;
+    std::atomic<uint64_t> internalBytes = 0;
+};
+
+// A readable name for the object types we create, for reports.
+const char* objectTypeName(VkObjectType objectType);
+
+#endif // HOSTALLOCATOR_H
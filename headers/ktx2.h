@@ -0,0 +1,47 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "texture.h"
+
+struct Ktx2Stats {
+    uint64_t textures = 0;
+    // Textures whose format the device can't sample, which were decoded to RGBA8 on the CPU.
+    uint64_t transcodedTextures = 0;
+    // The size of the texels of all mip levels as uploaded, and what they would have taken as RGBA8.
+    uint64_t uploadedBytes = 0;
+    uint64_t uncompressedBytes = 0;
+};
+
+// KTX2 (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html) is a container for GPU texture data.
+// It stores a VkFormat and every mip level exactly as the GPU wants it, so block-compressed textures are copied straight
+// into the image, without decoding them on the CPU. BC1 takes 4 bits per texel, BC3 and BC7 take 8, compared to 32 for RGBA8,
+// which saves as much video memory and upload bandwidth, and makes sampling faster as well.
+//
+// Supported are 2D textures in BC1, BC3, BC7, ETC2 and RGBA8, with any number of mip levels, and without supercompression.
+// A block-compressed format the device can't sample is decoded to RGBA8 instead, on the thread that decodes the file.
+
+// Returns true if "data" starts with the KTX2 file identifier.
+bool isKtx2(std::span<const char> data);
+
+// Finds out which block-compressed formats the device can sample. "enabledFeatures" are the features the device was created with,
+// as the BC and ETC2 formats each need a feature enabled. Also reads the largest 2D image the device supports, and textures beyond
+// it are rejected. Must be called before any KTX2 file is decoded.
+void queryKtx2FormatSupport(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures& enabledFeatures);
+
+// Parses a KTX2 file into a texture with all of its mip levels.
+// Throws std::runtime_error if the file is malformed, or uses something that isn't supported.
+Texture decodeKtx2(std::span<const char> data);
+
+// Reads and decodes a KTX2 file from disk.
+Texture loadKtx2(const std::string& filename);
+
+// Totals over every KTX2 file decoded so far, from any thread.
+Ktx2Stats ktx2Stats();
+
+#endif // KTX2_H
@@ -0,0 +1,227 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "aabbtree.h"
+#include "mappedfile.h"
+#include "scenehierarchy.h"
+#include "textureatlas.h"
+
+// On-disk layout of a level (.blvl):
+//
+//   LevelHeader
+//   sections    one array per LevelSectionId, each starting at a multiple of "levelAlignment"
+//
+// Nothing in a level is a pointer. Entities, sprites and tilemaps refer to each other by index, and to names by offset into
+// the string section, so a level is used exactly as it lies in memory, straight out of a file mapping, without being parsed.
+// Opening one only checks the header, so its cost doesn't grow with the level, and loading is bounded by the pages touched.
+//
+// All offsets are relative to the start of the level, and all values are little endian.
+constexpr uint32_t levelMagic = 0x4C564C42; // "BLVL"
+constexpr uint32_t levelVersion = 1;
+constexpr uint32_t levelAlignment = 16;
+
+// An entity without a parent, or a tile without an image.
+constexpr uint32_t levelNone = UINT32_MAX;
+constexpr uint16_t levelEmptyTile = UINT16_MAX;
+
+enum LevelSectionId : uint32_t {
+    // LevelEntity[], parents before their children.
+    levelEntities,
+    // LevelSprite[], the sprites of every entity next to each other.
+    levelSprites,
+    // LevelTilemap[]
+    levelTilemaps,
+    // uint16_t[], the tiles of every tilemap, row by row.
+    levelTiles,
+    // LevelSpatialNode[], a bounding volume hierarchy over the entities, with the root first.
+    levelSpatialNodes,
+    // uint32_t[], entity indices, referenced by the leaves of the hierarchy.
+    levelSpatialItems,
+    // char[], names, not null terminated.
+    levelStrings,
+    levelSectionCount,
+};
+
+struct LevelSection {
+    uint64_t offset;
+    // Number of elements, not bytes.
+    uint64_t count;
+};
+
+struct LevelHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    LevelSection sections[levelSectionCount];
+    // Bounds of every entity, in world space.
+    Aabb bounds;
+};
+
+struct LevelString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct LevelEntity {
+    // Relative to the parent.
+    Transform2D transform;
+    uint32_t parent;
+    uint32_t firstSprite;
+    uint32_t spriteCount;
+    LevelString name;
+    // World space bounds of the sprites, or the world position of an entity without any.
+    Aabb bounds;
+};
+
+// A sprite drawn centered on its entity.
+struct LevelSprite {
+    // The name of the image, which "uv" was taken from when the level was built.
+    LevelString image;
+    AtlasUvRect uv;
+    float size[2];
+    float color[4];
+    float layer;
+};
+
+// A grid of tiles, cut from a tileset image of "tilesetColumns" by "tilesetRows" tiles.
+struct LevelTilemap {
+    // World position of the top left corner of the grid.
+    float origin[2];
+    float tileSize[2];
+    uint32_t width;
+    uint32_t height;
+    uint64_t firstTile;
+    LevelString tileset;
+    AtlasUvRect tilesetUv;
+    uint32_t tilesetColumns;
+    uint32_t tilesetRows;
+    float layer;
+    uint32_t reserved;
+};
+
+struct LevelSpatialNode {
+    Aabb bounds;
+    // Leaves have items, which are "spatialItems[first, first + itemCount)". Inner nodes have none, and their children are
+    // the nodes at "first" and "first + 1".
+    uint32_t first;
+    uint32_t itemCount;
+};
+
+// A level, used in place. The data is either a file this level mapped itself, or memory owned by someone else,
+// like an uncompressed entry of the asset archive, which is mapped as well.
+class Level {
+public:
+    // Throws std::runtime_error if the file can't be mapped, or isn't a level this version can use.
+    void open(const std::string& filename);
+    // Uses "data", which must stay valid and unchanged until the level is closed, and be 8 byte aligned.
+    void open(std::span<const char> data);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    std::span<const LevelEntity> entities() const { return section<LevelEntity>(levelEntities); }
+    std::span<const LevelTilemap> tilemaps() const { return section<LevelTilemap>(levelTilemaps); }
+    std::span<const LevelSprite> sprites(const LevelEntity& entity) const;
+    // Row by row, "tilemap.width" tiles per row.
+    std::span<const uint16_t> tiles(const LevelTilemap& tilemap) const;
+    std::string_view string(const LevelString& string) const;
+    const Aabb& bounds() const { return header->bounds; }
+    uint64_t spriteCount() const { return header->sections[levelSprites].count; }
+    uint64_t tileCount() const { return header->sections[levelTiles].count; }
+
+    // Calls "visit(entityIndex)" for every entity whose bounds overlap "region".
+    // Only the nodes of the hierarchy that overlap it are touched, so only their pages are faulted in.
+    // Nodes and items that point outside the level are skipped.
+    template<typename Visitor>
+    void query(const Aabb& region, Visitor&& visit) const;
+
+private:
+    void useData(std::span<const char> levelData);
+
+    template<typename T>
+    std::span<const T> section(LevelSectionId id) const {
+        const LevelSection& section = header->sections[id];
+        return { reinterpret_cast<const T*>(data.data() + section.offset), static_cast<size_t>(section.count) };
+    }
+
+    MappedFile file;
+    std::span<const char> data;
+    const LevelHeader* header = nullptr;
+};
+
+template<typename Visitor>
+void Level::query(const Aabb& region, Visitor&& visit) const {
+    std::span<const LevelSpatialNode> nodes = section<LevelSpatialNode>(levelSpatialNodes);
+    std::span<const uint32_t> items = section<uint32_t>(levelSpatialItems);
+    std::span<const LevelEntity> entityList = entities();
+    if (nodes.empty()) {
+        return;
+    }
+
+    // The hierarchy is balanced, so its depth stays far below this even for millions of entities.
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0) {
+        const LevelSpatialNode& node = nodes[stack[--stackSize]];
+        if (!node.bounds.overlaps(region)) {
+            continue;
+        }
+
+        if (node.itemCount > 0) {
+            if (node.first > items.size() || node.itemCount > items.size() - node.first) {
+                continue;
+            }
+            // A leaf's bounds cover all of its entities, so each of them is tested on its own as well.
+            for (uint32_t item : items.subspan(node.first, node.itemCount)) {
+                if (item < entityList.size() && entityList[item].bounds.overlaps(region)) {
+                    visit(item);
+                }
+            }
+        } else if (node.first + 1 < nodes.size() && stackSize + 2 <= 64) {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+}
+
+// Builds levels, for tools that convert levels from other formats, and for tests.
+class LevelBuilder {
+public:
+    // Returns the index of the entity. "parent" is the index of an entity added before, or levelNone.
+    uint32_t addEntity(std::string_view name, uint32_t parent, const Transform2D& transform);
+    void addSprite(uint32_t entity, std::string_view image, const AtlasUvRect& uv, float width, float height,
+                   const float color[4], float layer);
+    // "tiles" holds "width" times "height" tile indices, row by row. Tiles are numbered row by row across the tileset.
+    void addTilemap(std::string_view tileset, const AtlasUvRect& tilesetUv, uint32_t tilesetColumns, uint32_t tilesetRows,
+                    float originX, float originY, float tileWidth, float tileHeight, uint32_t width, uint32_t height,
+                    std::span<const uint16_t> tiles, float layer);
+
+    // Lays the level out, and builds the spatial index over the world bounds of the entities.
+    std::vector<char> build() const;
+
+private:
+    struct Entity {
+        LevelEntity entity;
+        std::string name;
+        std::vector<LevelSprite> sprites;
+        std::vector<std::string> images;
+    };
+
+    struct Tilemap {
+        LevelTilemap tilemap;
+        std::string tileset;
+        std::vector<uint16_t> tiles;
+    };
+
+    std::vector<Entity> builtEntities;
+    std::vector<Tilemap> builtTilemaps;
+};
+
+#endif // LEVEL_H
@@ -0,0 +1,173 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "asynccompute.h"
+#include "assetloader.h"
+#include "hostallocator.h"
+#include "perfcounters.h"
+#include "texture.h"
+
+enum class LightType : uint32_t {
+    Point = 0,
+    // A point light limited to a cone around "direction".
+    Spot = 1
+};
+
+// Matches the std430 layout of "Light" in lightcull.comp and lighting.frag.
+// Positions and radii are in output pixels. They are scaled to the render resolution when they are uploaded.
+struct Light {
+    float position[2] = { 0.0f, 0.0f };
+    float radius = 0.0f;
+    float intensity = 1.0f;
+    float color[3] = { 1.0f, 1.0f, 1.0f };
+    LightType type = LightType::Point;
+    // Spot lights only. The direction must be normalized, and the angles are given as cosines of the half angles.
+    float direction[2] = { 1.0f, 0.0f };
+    float cosInnerAngle = 1.0f;
+    float cosOuterAngle = 0.0f;
+};
+static_assert(sizeof(Light) == 48, "Light must match the std430 layout used by the shaders.");
+
+// Normal maps hold directions rather than colors, so unlike regular textures they must not be decoded as sRGB.
+struct NormalMap {
+    Texture texture;
+};
+
+template<>
+struct AssetTraits<NormalMap> {
+    static NormalMap decode(std::span<const char> data) {
+        NormalMap normalMap { decodeTga(data) };
+        normalMap.texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+        return normalMap;
+    }
+    static void upload(NormalMap& normalMap, const AssetUploadContext& context) { uploadTexture(normalMap.texture, context); }
+};
+
+// Deferred 2D lighting with tiled light culling.
+//
+// Sprites are drawn in the first subpass, writing their albedo and normal into two extra color attachments.
+// A compute pass on the async compute queue bins all lights into 16x16 pixel tiles, by testing each light's radius against the tile bounds.
+// The lighting subpass then reads albedo and normal as input attachments, and shades each pixel with only the lights of its tile.
+// The per-pixel cost depends on the number of lights overlapping a tile, not on the total number of lights,
+// so hundreds of small lights cost about as much as a few large ones.
+//
+// Both extra attachments live only for the duration of the render pass, so on tiled GPUs they may never leave on-chip memory.
+class LightingSystem {
+public:
+    static constexpr uint32_t tileSize = 16;
+    // Lights beyond this many in a single tile are dropped. Must match the shaders.
+    static constexpr uint32_t maxLightsPerTile = 63;
+    static constexpr uint32_t maxLights = 1024;
+    static constexpr uint32_t maxMaterialSets = 64;
+
+    static constexpr VkFormat albedoFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    static constexpr VkFormat normalFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+    // Creates the attachments, light buffers and culling pipeline for a framebuffer of up to "extent", and registers the culling pass.
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, uint32_t graphicsFamily,
+              AsyncCompute& asyncCompute, UploadManager& uploadManager, std::span<const char> cullShaderCode,
+              HostAllocationTracker& hostAllocations);
+    // Creates the pipeline of the lighting subpass.
+    void createPipeline(VkRenderPass renderPass, uint32_t subpass, std::span<const char> vertexShaderCode, std::span<const char> fragmentShaderCode);
+    void destroy();
+
+    // Replaces the lights of the scene. Takes effect with the next compute submission. At most "maxLights" are used.
+    void setLights(std::span<const Light> lights);
+    std::span<const Light> currentLights() const { return lights; }
+
+    // Sets the part of the framebuffer that is rendered to, and the ratio of render pixels to output pixels.
+    // Takes effect with the next compute submission, and in lighting subpasses recorded after it.
+    void setRenderExtent(VkExtent2D extent, float scale);
+
+    // Sprite materials. Set 0 of sprite pipelines must use this layout. Binding 0 is the normal map, and binding 1 the albedo map.
+    VkDescriptorSetLayout materialSetLayout() const { return materialLayout; }
+    // Without an albedo map, the material gets a white one, so only the sprite's color shows.
+    VkDescriptorSet createMaterialSet(VkImageView normalMapView, VkImageView albedoMapView = VK_NULL_HANDLE);
+    // Points a material at other maps, like a streamed texture that just became resident. A null view picks the flat normal map
+    // or the white albedo map. The set must not be in use by a frame that is still executing, and command buffers that bound it
+    // are invalidated, so they have to be recorded again.
+    void updateMaterialSet(VkDescriptorSet materialSet, VkImageView normalMapView, VkImageView albedoMapView);
+    // A material with a flat normal map and a white albedo map, for sprites without their own.
+    VkDescriptorSet defaultMaterialSet() const { return defaultMaterial; }
+
+    // Records the lighting subpass. Must be called right after vkCmdNextSubpass.
+    void recordLighting(VkCommandBuffer commandBuffer, uint32_t slot, CommandCounters& counters);
+
+    VkImageView albedoView() const { return albedo.imageView; }
+    VkImageView normalView() const { return normal.imageView; }
+
+    void setAmbient(float red, float green, float blue) { ambient = { red, green, blue, 1.0f }; }
+
+private:
+    // Matches the push constant blocks of lightcull.comp and lighting.frag.
+    struct PushConstants {
+        float framebufferSize[2];
+        uint32_t tileCountX;
+        uint32_t lightCount;
+        float ambient[4];
+        // Height of the lights above the sprite plane, in pixels. Without it, lights would only hit surfaces facing sideways.
+        float lightHeight;
+    };
+
+    struct Attachment {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+    };
+
+    struct Slot {
+        VkBuffer lightBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory lightMemory = VK_NULL_HANDLE;
+        Light* mappedLights = nullptr;
+        VkBuffer tileBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory tileMemory = VK_NULL_HANDLE;
+        VkDescriptorSet cullSet = VK_NULL_HANDLE;
+        VkDescriptorSet lightingSet = VK_NULL_HANDLE;
+        uint32_t lightCount = 0;
+    };
+
+    void createAttachment(VkFormat format, Attachment& attachment);
+    void createDescriptors();
+    void recordCulling(VkCommandBuffer commandBuffer, uint32_t slot);
+    PushConstants pushConstants(uint32_t lightCount) const;
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    HostAllocationTracker* hostAllocations = nullptr;
+    VkExtent2D framebufferExtent {};
+    VkExtent2D renderExtent {};
+    float renderScale = 1.0f;
+    // Tiles covering the render extent.
+    uint32_t tileCountX = 0;
+    uint32_t tileCountY = 0;
+
+    Attachment albedo {};
+    Attachment normal {};
+    std::array<Slot, AsyncCompute::slotCount> slots {};
+
+    std::vector<Light> lights;
+    std::array<float, 4> ambient = { 0.1f, 0.1f, 0.1f, 1.0f };
+
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout cullLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout lightingLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout materialLayout = VK_NULL_HANDLE;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipelineLayout lightingPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline cullPipeline = VK_NULL_HANDLE;
+    VkPipeline lightingPipeline = VK_NULL_HANDLE;
+
+    VkSampler materialSampler = VK_NULL_HANDLE;
+    NormalMap flatNormalMap {};
+    Texture whiteAlbedoMap {};
+    VkDescriptorSet defaultMaterial = VK_NULL_HANDLE;
+};
+
+#endif // LIGHTING_H
@@ -0,0 +1,16 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <span>
+#include <vector>
+
+// A small implementation of the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md).
+// The compressor is a simple greedy one, which is plenty for packing assets offline.
+// Decompression is what matters at runtime, and it's a straight copy loop.
+std::vector<char> lz4CompressBlock(std::span<const char> input);
+
+// Decompresses a block into "output", which must be exactly the size of the uncompressed data.
+// Returns false if the block is malformed.
+bool lz4DecompressBlock(std::span<const char> input, std::span<char> output);
+
+#endif // LZ4_H
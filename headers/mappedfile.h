@@ -0,0 +1,41 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+// How a mapped file is going to be read, which decides how aggressively the OS reads ahead of the pages we touch.
+enum class MappedFileAccess {
+    // Lookups jump around the file, so reading ahead would mostly read pages we never use.
+    Random,
+    // The file is read mostly from front to back, so reading ahead turns many small page faults into a few large reads.
+    Sequential,
+};
+
+// A whole file, memory mapped read-only.
+// Mapping a file doesn't read anything yet. Pages are faulted in from the file cache when they are first touched,
+// so only the parts of the file that are actually used are ever read, and they are shared with every other process mapping it.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    // Throws std::runtime_error if the file cannot be opened or mapped.
+    void open(const std::string& filename, MappedFileAccess access);
+    void close();
+
+    bool isOpen() const { return mappedData != nullptr; }
+    std::span<const char> data() const { return { mappedData, mappedSize }; }
+
+private:
+    const char* mappedData = nullptr;
+    size_t mappedSize = 0;
+    // Platform handles of the open file and its mapping.
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+};
+
+#endif // MAPPEDFILE_H
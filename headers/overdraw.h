@@ -0,0 +1,63 @@
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <vulkan/vulkan.h>
+
+#include "spritebatch.h"
+
+struct OverdrawStats {
+    uint64_t measuredFrames = 0;
+    // Fragments shaded per pixel if every sprite was drawn back to front, without depth testing. Estimated from the sprite areas.
+    double paintedFragmentsPerPixel = 0.0;
+    // Fragments the sprites actually shaded per pixel, counted by the GPU. Stays 0 when pipeline statistics aren't supported.
+    double shadedFragmentsPerPixel = 0.0;
+    bool measured = false;
+};
+
+// Measures how often every pixel of the scene is shaded while drawing the sprites, averaged over all frames.
+//
+// With a fill rate bound renderer, that number is what the frame time follows. The GPU counts the fragment shader invocations
+// of the sprite subpass with a pipeline statistics query, one per frame slot, which doesn't include fragments the early depth test rejected.
+// For comparison, the fragments that drawing every sprite back to front would shade are estimated from the area the sprites cover.
+class OverdrawMeter {
+public:
+    // "pipelineStatistics" tells whether the pipelineStatisticsQuery feature was enabled on the device. Without it, only the estimate is made.
+    void init(VkDevice device, bool pipelineStatistics, uint32_t frameSlotCount);
+    void destroy();
+
+    // Must be recorded outside of render passes, before "beginQuery". Like the frame timestamps, the query is reset
+    // inside the command buffer, so it may be submitted again without recording it again.
+    void resetQuery(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+    // Brackets the sprite draws. Both must be recorded in the same subpass.
+    void beginQuery(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+    void endQuery(VkCommandBuffer commandBuffer, uint32_t frameSlot);
+
+    // Remembers which command buffer was submitted, and what it drew. The estimate is only computed again when "sceneVersion" changed.
+    void frameSubmitted(uint32_t frameSlot, std::span<const SpriteInstance> instances, uint64_t sceneVersion,
+                        VkExtent2D outputExtent, VkExtent2D renderExtent);
+    // Reads the query of the last submitted frame. Must only be called once that frame has completed.
+    void collect();
+
+    OverdrawStats stats() const;
+
+private:
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+
+    uint64_t estimatedSceneVersion = 0;
+    double paintedFragmentsPerPixel = 0.0;
+
+    std::optional<uint32_t> pendingFrameSlot;
+    double pendingPaintedFragmentsPerPixel = 0.0;
+    double pendingRenderPixels = 0.0;
+
+    uint64_t measuredFrames = 0;
+    double paintedSum = 0.0;
+    double shadedSum = 0.0;
+};
+
+#endif // OVERDRAW_H
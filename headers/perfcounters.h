@@ -0,0 +1,100 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// What one frame cost. Draw calls, instances and pipeline binds are those of the graphics command buffers the frame submitted,
+// whether they were recorded for this frame or reused from an earlier one.
+struct FrameCounters {
+    uint32_t drawCalls = 0;
+    uint64_t instances = 0;
+    uint32_t pipelineBinds = 0;
+    // Bytes the CPU wrote for the GPU: staged uploads, and instance data written straight into host visible buffers.
+    uint64_t bytesUploaded = 0;
+    uint32_t descriptorAllocations = 0;
+    // Times the frame arena ran out of space and went to the heap. Zero in a steady scene, once the arena has warmed up.
+    uint32_t arenaHeapAllocations = 0;
+    // Time the CPU spent blocked, waiting for the previous frame to complete, and for a swapchain image.
+    double fenceWaitMilliseconds = 0.0;
+    double acquireWaitMilliseconds = 0.0;
+    // Time since the previous frame was drawn.
+    double frameMilliseconds = 0.0;
+};
+
+// Counts the commands recorded into a command buffer. The recording functions of the renderer add to it as they go, and
+// the counts are kept with the command buffer, so a command buffer that is submitted again without being recorded counts the same.
+struct CommandCounters {
+    uint32_t drawCalls = 0;
+    uint64_t instances = 0;
+    uint32_t pipelineBinds = 0;
+
+    void draw(uint64_t instanceCount) {
+        drawCalls++;
+        instances += instanceCount;
+    }
+
+    void bindPipeline() { pipelineBinds++; }
+};
+
+// Descriptor sets are allocated by many systems, at any time. They report it here, and "PerfCounters" takes the difference per frame.
+void countDescriptorAllocations(uint32_t count);
+uint64_t descriptorAllocationCount();
+
+// Always-on counters of the cost of every frame, cheap enough to never turn off: each is a plain addition, and the only clock
+// reads are the ones around the waits that are measured anyway.
+//
+// Frames are bracketed by "beginFrame" and "endFrame". The last "historySize" frames are kept for queries and for the overlay.
+// With a dump file open, one line of JSON is appended every "intervalSeconds", with the averages and the worst frame time
+// of the frames since the previous line, so regressions in frame time can be found by tools without a profiler attached.
+class PerfCounters {
+public:
+    static constexpr uint32_t historySize = 240;
+
+    // Throws std::runtime_error if the file can't be created.
+    void openDump(const std::string& filename, double intervalSeconds);
+    void closeDump();
+    bool isDumping() const { return dump.is_open(); }
+
+    void beginFrame();
+    void addCommands(const CommandCounters& counters);
+    void addUploadedBytes(uint64_t bytes) { current.bytesUploaded += bytes; }
+    void addFenceWait(double milliseconds) { current.fenceWaitMilliseconds += milliseconds; }
+    void addAcquireWait(double milliseconds) { current.acquireWaitMilliseconds += milliseconds; }
+    void addArenaHeapAllocations(uint32_t count) { current.arenaHeapAllocations += count; }
+    void endFrame();
+
+    // The newest completed frame, or the one "framesAgo" before it. Only the last "frameCount()" frames, up to "historySize", exist.
+    const FrameCounters& lastFrame(uint32_t framesAgo = 0) const;
+    uint32_t frameCount() const { return historyCount; }
+    uint64_t totalFrames() const { return frameNumber; }
+    // The average of every counter over the frames in the history.
+    FrameCounters average() const;
+
+private:
+    void writeDumpLine(double seconds);
+
+    std::array<FrameCounters, historySize> history {};
+    uint32_t historyNext = 0;
+    uint32_t historyCount = 0;
+    uint64_t frameNumber = 0;
+
+    FrameCounters current {};
+    uint64_t descriptorAllocationsAtBegin = 0;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point lastFrameEnd {};
+    bool haveLastFrameEnd = false;
+
+    std::ofstream dump;
+    double dumpInterval = 1.0;
+    std::chrono::steady_clock::time_point dumpStart {};
+    // Sums over the frames since the last line of the dump.
+    FrameCounters dumpSums {};
+    double dumpMaxFrameMilliseconds = 0.0;
+    uint32_t dumpFrames = 0;
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,72 @@
+#ifndef PERFOVERLAY_H
+#define PERFOVERLAY_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include <vulkan/vulkan.h>
+
+#include "perfcounters.h"
+
+// Draws the performance counters over the finished frame: a few lines of text, and a graph of the recent frame times.
+//
+// Everything is made of rectangles, drawn as instances with a single indirect draw call. Text uses a built-in 3 by 5 pixel font,
+// where each glyph is a 15 bit mask that the fragment shader tests, so the overlay needs no font texture and no descriptors.
+// The rectangles and the instance count of the draw are written into a host visible buffer every frame, so the command buffer
+// that draws them doesn't have to be recorded again when the numbers change.
+class PerfOverlay {
+public:
+    static constexpr uint32_t maxRectangles = 2048;
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device);
+    // Creates the pipeline, which draws into the swapchain image after the upscale, at the native resolution.
+    void createPipeline(VkRenderPass renderPass, uint32_t subpass, std::span<const char> vertexShaderCode, std::span<const char> fragmentShaderCode);
+    void destroy();
+
+    // Command buffers record the overlay only while it's enabled, so they must be recorded again when this changes.
+    void setEnabled(bool enabled) { overlayEnabled = enabled; }
+    bool enabled() const { return overlayEnabled; }
+
+    // Lays out the overlay for the next frame. The GPU must be done with the previous frame.
+    void update(const PerfCounters& counters);
+
+    // Records the overlay into the current subpass, if it's enabled.
+    void record(VkCommandBuffer commandBuffer, VkExtent2D outputExtent, CommandCounters& counters) const;
+
+    static VkVertexInputBindingDescription bindingDescription();
+    static std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions();
+
+private:
+    // Matches the vertex inputs of overlay.vert.
+    struct Rectangle {
+        float position[2];
+        float size[2];
+        float color[4];
+        // Bit "row * 3 + column" is set for the pixels of the 3 by 5 grid that are filled. "solid" fills all of them.
+        uint32_t mask;
+        uint32_t reserved[3];
+    };
+
+    static constexpr uint32_t solid = 0x7FFF;
+    // The indirect draw command comes first in the buffer, and the rectangles follow at this offset.
+    static constexpr VkDeviceSize rectangleOffset = 64;
+
+    void addRectangle(float x, float y, float width, float height, const float color[4], uint32_t mask = solid);
+    void addText(float x, float y, std::string_view text, const float color[4]);
+
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDrawIndirectCommand* drawCommand = nullptr;
+    Rectangle* rectangles = nullptr;
+    uint32_t rectangleCount = 0;
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    bool overlayEnabled = false;
+};
+
+#endif // PERFOVERLAY_H
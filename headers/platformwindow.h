@@ -0,0 +1,142 @@
+#ifndef PLATFORMWINDOW_H
+#define PLATFORMWINDOW_H
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "spscqueue.h"
+
+enum class InputEventType : uint8_t {
+    // "code" is the virtual key code.
+    KeyDown,
+    KeyUp,
+    // "x" and "y" are the cursor position in client pixels.
+    MouseMove,
+    // "x" and "y" are the raw motion of the mouse since the last event, in mouse units. Arrives at the mouse's own polling rate,
+    // which is usually much higher than the frame rate, and keeps going when the cursor hits the edge of the screen.
+    MouseDelta,
+    // "code" is the button, 0 = left, 1 = right, 2 = middle. "x" and "y" are the cursor position in client pixels.
+    MouseButtonDown,
+    MouseButtonUp,
+    // "y" is the wheel rotation, in multiples of WHEEL_DELTA (120) per notch.
+    MouseWheel,
+    // "x" and "y" are the new client size in pixels.
+    WindowResized,
+    // The user asked to close the window. The window stays open until "PlatformWindow::destroy".
+    WindowClosed,
+};
+
+struct InputEvent {
+    // When the platform thread received the event, in ticks of the performance counter. See PlatformWindow::now.
+    int64_t timestamp = 0;
+    InputEventType type = InputEventType::KeyDown;
+    uint32_t code = 0;
+    int32_t x = 0;
+    int32_t y = 0;
+};
+
+// The state of keyboard and mouse, built up from events as the game consumes them.
+struct InputState {
+    std::bitset<256> keysDown;
+    uint32_t mouseButtonsDown = 0;
+    int32_t mouseX = 0;
+    int32_t mouseY = 0;
+    // Raw mouse motion and wheel rotation since "beginStep" was last called.
+    int32_t mouseDeltaX = 0;
+    int32_t mouseDeltaY = 0;
+    int32_t wheelDelta = 0;
+
+    // Clears the per-step accumulators.
+    void beginStep();
+    void apply(const InputEvent& event);
+};
+
+struct InputLatencyStats {
+    uint64_t eventCount = 0;
+    // Time from the platform thread receiving an event, to the game consuming it.
+    double averageMilliseconds = 0.0;
+    double maxMilliseconds = 0.0;
+    // Events lost because the game didn't drain the queue for so long that it filled up.
+    uint64_t droppedEvents = 0;
+};
+
+// The game window, with its message loop running on a dedicated platform thread.
+//
+// Windows delivers input as window messages, to the thread that created the window, and only while that thread pumps messages.
+// When the game thread pumps them between frames, a long frame delays all input by that long, and mouse motion that arrives
+// in the meantime is merged or lost. Here, the platform thread does nothing but pump messages, so every event is picked up
+// as it arrives, stamped with the time it arrived, and pushed into a lock-free queue. The game thread drains the queue whenever
+// it's ready, and knows exactly when each event happened.
+class PlatformWindow {
+public:
+    static constexpr uint32_t queueCapacity = 8192;
+
+    PlatformWindow() = default;
+    PlatformWindow(const PlatformWindow&) = delete;
+    PlatformWindow& operator=(const PlatformWindow&) = delete;
+    ~PlatformWindow();
+
+    // Starts the platform thread, and returns once it created the window. Returns the window's HWND.
+    void* create(void* instance, int showCommand, const std::string& title, int width, int height);
+    // Destroys the window and joins the platform thread. Anything presenting to the window must be destroyed first.
+    void destroy();
+
+    // Consumes every event received up to "untilTimestamp", oldest first, calling "handler(event)" for each.
+    template<typename Handler>
+    void drainEvents(int64_t untilTimestamp, Handler&& handler);
+
+    // Blocks until an event arrives, or "milliseconds" pass.
+    void waitForEvents(uint32_t milliseconds);
+
+    void* handle() const { return windowHandle; }
+    InputLatencyStats latencyStats() const;
+
+    // The current time in ticks of the performance counter, the clock that event timestamps use.
+    static int64_t now();
+    static int64_t secondsToTicks(double seconds);
+    static double ticksToMilliseconds(int64_t ticks);
+
+    // Called by the window procedure, on the platform thread. Returns whether the message was handled.
+    bool handleMessage(uint32_t message, uintptr_t wParam, intptr_t lParam);
+
+private:
+    void threadMain(void* instance, int showCommand, std::string title, int width, int height);
+    void pushEvent(InputEventType type, uint32_t code, int32_t x, int32_t y);
+    void recordLatency(int64_t latencyTicks);
+
+    std::thread platformThread;
+    void* windowHandle = nullptr;
+    // Signaled when the window was created, and whenever an event is pushed.
+    void* createdSignal = nullptr;
+    void* eventSignal = nullptr;
+
+    SpscQueue<InputEvent, queueCapacity> events;
+    std::atomic<uint64_t> droppedEvents { 0 };
+
+    // Only touched by the consumer.
+    uint64_t consumedEvents = 0;
+    double totalLatencyMilliseconds = 0.0;
+    double maxLatencyMilliseconds = 0.0;
+};
+
+template<typename Handler>
+void PlatformWindow::drainEvents(int64_t untilTimestamp, Handler&& handler) {
+    int64_t consumeTime = now();
+
+    while (const InputEvent* event = events.front()) {
+        if (event->timestamp > untilTimestamp) {
+            break;
+        }
+
+        InputEvent copy = *event;
+        events.popFront();
+
+        recordLatency(consumeTime - copy.timestamp);
+        handler(copy);
+    }
+}
+
+#endif // PLATFORMWINDOW_H
@@ -0,0 +1,119 @@
+#ifndef SCENEHIERARCHY_H
+#define SCENEHIERARCHY_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+class SpriteBatch;
+class ThreadPool;
+
+// Position, rotation in radians, and scale of a node, relative to its parent.
+struct Transform2D {
+    float position[2] = { 0.0f, 0.0f };
+    float rotation = 0.0f;
+    float scale[2] = { 1.0f, 1.0f };
+};
+
+// A 2D affine transform, mapping (x, y) to (a * x + c * y + tx, b * x + d * y + ty).
+// (a, b) and (c, d) are where the X and Y axes end up.
+struct Affine2D {
+    float a = 1.0f;
+    float b = 0.0f;
+    float c = 0.0f;
+    float d = 1.0f;
+    float tx = 0.0f;
+    float ty = 0.0f;
+
+    // Scale first, then rotate, then translate.
+    static Affine2D fromTransform(const Transform2D& transform) {
+        float cosine = std::cos(transform.rotation);
+        float sine = std::sin(transform.rotation);
+
+        Affine2D affine {};
+        affine.a = cosine * transform.scale[0];
+        affine.b = sine * transform.scale[0];
+        affine.c = -sine * transform.scale[1];
+        affine.d = cosine * transform.scale[1];
+        affine.tx = transform.position[0];
+        affine.ty = transform.position[1];
+        return affine;
+    }
+
+    // Applies "child" first, then this transform.
+    Affine2D operator*(const Affine2D& child) const {
+        Affine2D result {};
+        result.a = a * child.a + c * child.b;
+        result.b = b * child.a + d * child.b;
+        result.c = a * child.c + c * child.d;
+        result.d = b * child.c + d * child.d;
+        result.tx = a * child.tx + c * child.ty + tx;
+        result.ty = b * child.tx + d * child.ty + ty;
+        return result;
+    }
+};
+
+using NodeId = uint32_t;
+
+// A tree of transforms, like a character made of a body with arms that hold a weapon.
+// Every node's world transform is its parent's world transform combined with its own local transform.
+//
+// Nodes are stored in flat arrays in breadth-first order, so a parent always comes before its children, and all nodes
+// at the same depth are next to each other. Propagating transforms is then a single pass over the arrays, level by level,
+// and every level can be split across threads, because nodes at the same depth never depend on each other.
+//
+// Changing a local transform only sets a dirty flag. Nothing is computed until "propagate", which only recomputes dirty
+// nodes and their descendants, and writes the results straight into the instances of the sprites attached to them.
+class SceneHierarchy {
+public:
+    static constexpr NodeId invalidNode = UINT32_MAX;
+
+    // Creates a node below "parent", or a root node when "parent" is invalidNode.
+    NodeId createNode(NodeId parent = invalidNode, const Transform2D& localTransform = {});
+
+    void setLocalTransform(NodeId node, const Transform2D& localTransform);
+    const Transform2D& localTransform(NodeId node) const { return locals[indexOf[node]]; }
+    // Only up to date after "propagate".
+    const Affine2D& worldTransform(NodeId node) const { return worlds[indexOf[node]]; }
+
+    // The node's world transform is written into the sprite instance at "instanceIndex" of the batch passed to "propagate",
+    // as a quad of "width" by "height" pixels centered on the node.
+    void attachSprite(NodeId node, uint32_t instanceIndex, float width, float height);
+
+    // Recomputes the world transforms of dirty nodes and their descendants, and updates their sprites.
+    // Uses the workers of "pool" for large levels, when given. Returns whether any sprite instance was written.
+    bool propagate(SpriteBatch& spriteBatch, ThreadPool* pool);
+
+    uint32_t nodeCount() const { return static_cast<uint32_t>(parentOf.size()); }
+
+private:
+    static constexpr uint32_t noSprite = UINT32_MAX;
+    // Levels with fewer nodes than this are propagated on the calling thread, since handing them out costs more than it saves.
+    static constexpr uint32_t parallelBatchSize = 4096;
+
+    // Restores the breadth-first order after nodes were created.
+    void rebuildOrder();
+    void propagateRange(uint32_t begin, uint32_t end, SpriteBatch& spriteBatch);
+
+    // Indexed by NodeId. Node ids never change, while their position in the arrays below does whenever the order is rebuilt.
+    std::vector<NodeId> parentOf;
+    std::vector<uint32_t> indexOf;
+
+    // Indexed by position in breadth-first order.
+    std::vector<NodeId> nodeAt;
+    std::vector<uint32_t> parentIndex;
+    std::vector<Transform2D> locals;
+    std::vector<Affine2D> worlds;
+    // Not std::vector<bool>, since neighbouring flags are written from different threads.
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> spriteInstance;
+    std::vector<float> spriteSize;
+
+    // Start of every depth level in the arrays above, with the end of the last level at the back.
+    std::vector<uint32_t> levelStarts;
+
+    bool orderChanged = false;
+    bool anyDirty = false;
+};
+
+#endif // SCENEHIERARCHY_H
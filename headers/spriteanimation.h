@@ -0,0 +1,82 @@
+#ifndef SPRITEANIMATION_H
+#define SPRITEANIMATION_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "textureatlas.h"
+
+class SpriteBatch;
+
+using ClipId = uint32_t;
+using AnimatorId = uint32_t;
+
+// A sequence of frames from a sprite sheet, played back at a fixed rate.
+struct SpriteClip {
+    // The clip's frames are [firstFrame, firstFrame + frameCount) in the shared frame table.
+    uint32_t firstFrame = 0;
+    uint32_t frameCount = 0;
+    float framesPerSecond = 0.0f;
+    bool loop = true;
+    // Set when the frames are equally sized and spaced in a row of the atlas, which is what GPU animation needs.
+    bool isStrip = false;
+    float stripStride = 0.0f;
+};
+
+// Plays sprite-sheet animations on the sprites of a SpriteBatch, by writing the current frame's UV rect into their instances.
+//
+// Animators don't have an update function of their own. Their state lives in one array per field, and "update" advances all of them
+// in a single pass that only touches the fields it needs. An instance is only written when its frame actually changed.
+//
+// Looping clips laid out as a strip can be played on the GPU instead: the vertex shader picks the frame from the frame time,
+// so those sprites cost no CPU time at all after they're started, and don't change the instance stream.
+class SpriteAnimationSystem {
+public:
+    // Adds a clip with the given frames, in playback order.
+    ClipId addClip(std::span<const AtlasUvRect> frames, float framesPerSecond, bool loop);
+    const SpriteClip& clip(ClipId id) const { return clips[id]; }
+
+    // Starts playing "clip" on the sprite at "instanceIndex", from its first frame. "speed" scales the clip's frame rate.
+    AnimatorId play(uint32_t instanceIndex, ClipId clip, float speed = 1.0f);
+    void stop(AnimatorId animator);
+
+    // Switches to another clip, starting from its first frame.
+    void setClip(AnimatorId animator, ClipId clip);
+    void setSpeed(AnimatorId animator, float speed);
+
+    // Advances every animator by "deltaSeconds", and writes the UVs of sprites whose frame changed.
+    // Returns whether any instance was written.
+    bool update(float deltaSeconds, SpriteBatch& spriteBatch);
+
+    // Sets the sprite up to loop "clip" on the GPU from "startTime", in the time of SpriteBatch::setTime.
+    // Returns false, and changes nothing, when the clip isn't a looping strip. Like any change to the instances, the scene must be
+    // invalidated afterwards, so the new instance data is drawn.
+    bool playOnGpu(uint32_t instanceIndex, ClipId clip, float speed, float startTime, SpriteBatch& spriteBatch);
+    void stopOnGpu(uint32_t instanceIndex, SpriteBatch& spriteBatch);
+
+    // While any sprite is animated on the GPU, the image changes every frame, even when nothing else does.
+    bool hasGpuAnimations() const { return gpuAnimationCount > 0; }
+
+    uint32_t animatorCount() const { return static_cast<uint32_t>(times.size()); }
+
+private:
+    std::vector<SpriteClip> clips;
+    std::vector<AtlasUvRect> frameTable;
+
+    // Indexed by animator position. Stopping an animator moves the last one into its place, so the arrays stay dense.
+    std::vector<float> times;
+    std::vector<float> speeds;
+    std::vector<ClipId> clipIds;
+    std::vector<uint32_t> instanceIndices;
+    std::vector<uint32_t> currentFrames;
+    std::vector<AnimatorId> animatorAt;
+
+    // Indexed by AnimatorId.
+    std::vector<uint32_t> indexOf;
+    std::vector<AnimatorId> freeAnimators;
+
+    uint32_t gpuAnimationCount = 0;
+};
+
+#endif // SPRITEANIMATION_H
@@ -0,0 +1,131 @@
+#ifndef SPRITEBATCH_H
+#define SPRITEBATCH_H
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "framearena.h"
+#include "perfcounters.h"
+#include "textureatlas.h"
+
+// Per-instance vertex data of a sprite. Matches the instance attributes of shader.vert.
+// Positions and axes are in output pixels, with the origin in the top left corner of the window.
+struct SpriteInstance {
+    // The sprite's local X and Y axes, scaled by its width and height. A sprite without rotation or scaling has
+    // axes (width, 0) and (0, height). Sprites with zero axes cover no pixels, which is how hidden sprites are drawn.
+    float xAxis[2] = { 0.0f, 0.0f };
+    float yAxis[2] = { 0.0f, 0.0f };
+    // The center of the sprite.
+    float position[2] = { 0.0f, 0.0f };
+    AtlasUvRect uv { 0.0f, 0.0f, 1.0f, 1.0f };
+    // Sprites with an alpha of 1 are opaque, and hide whatever is behind them. Anything less is blended.
+    float color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    // Looping animations evaluated by the vertex shader: frame count, frames per second, start time in seconds, and the distance
+    // between two frames in U. "uv" is the first frame. Sprites with fewer than 2 frames aren't animated on the GPU.
+    float gpuAnimation[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    // Sprites on higher layers are drawn in front of sprites on lower ones. Within a layer, later sprites are drawn in front.
+    float layer = 0.0f;
+    // The depth the sprite is drawn at, from its place in the drawing order. Written by SpriteBatch::upload, only into the uploaded copy.
+    float depth = 0.0f;
+};
+
+// The instance stream of all sprites, drawn with a single instanced draw call.
+//
+// Systems like the scene hierarchy write straight into "instances()", and call "markChanged" when they did.
+// The stream is copied into a host visible vertex buffer when it changed, with one buffer per frame slot,
+// so that the CPU never writes to a buffer that a frame still executing on the GPU is reading.
+//
+// Every slot also has a small uniform buffer with the time, which GPU animated sprites are evaluated at. It's written every frame,
+// without touching the instance stream, so recorded command buffers stay valid while those sprites animate.
+//
+// The uploaded copy is in drawing order, not in the order of "instances()". With "opaqueFirst", the opaque sprites come first,
+// front to back, followed by the translucent ones, back to front. Drawn like that with depth testing, every pixel that's covered
+// by an opaque sprite is shaded once, by the front most one, and early depth tests reject all fragments behind it before shading.
+// Translucent sprites still have to be blended in order, but fragments of them that are hidden by opaque sprites are rejected as well.
+// Without "opaqueFirst", every sprite is drawn back to front, and every fragment of every sprite is shaded.
+class SpriteBatch {
+public:
+    static constexpr uint32_t slotCount = 2;
+
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t capacity, bool opaqueFirst);
+    void destroy();
+
+    // Appends a sprite and returns its index in the instance stream. Indices stay valid for the lifetime of the batch.
+    uint32_t add(const SpriteInstance& instance);
+    // Removes every sprite. Indices handed out before are no longer valid.
+    void clear() { spriteInstances.clear(); markChanged(); }
+
+    std::span<SpriteInstance> instances() { return spriteInstances; }
+    uint32_t count() const { return static_cast<uint32_t>(spriteInstances.size()); }
+    uint32_t capacity() const { return instanceCapacity; }
+
+    // Must be called after writing to "instances()", so the change gets uploaded.
+    void markChanged() { version++; }
+    // Whether anything changed since the last call to "upload" for the given slot.
+    bool changedSince(uint32_t slot) const { return slots[slot].uploadedVersion != version; }
+
+    // The time in seconds that GPU animations are evaluated at, for frames uploaded from now on.
+    void setTime(float seconds) { currentTime = seconds; }
+
+    // Copies the instance stream into the buffer of "slot" in drawing order, if it changed since that buffer was last written,
+    // and writes the time. The GPU must be done with the last frame that used the slot. Returns the number of bytes written.
+    // Sorting takes its scratch memory from "frameArena", so uploads don't allocate from the heap.
+    uint64_t upload(uint32_t slot, FrameArena& frameArena);
+
+    // Binds the buffers of "slot" and draws every sprite, the opaque ones with "opaquePipeline" and the rest with "translucentPipeline".
+    // Both pipelines must use "pipelineLayout". Without "opaqueFirst", every sprite is drawn with "translucentPipeline".
+    void record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t slot,
+                VkPipeline opaquePipeline, VkPipeline translucentPipeline, CommandCounters& counters) const;
+
+    // Set 1 of sprite pipelines, with the frame uniforms.
+    VkDescriptorSetLayout frameSetLayout() const { return frameLayout; }
+
+    // Vertex input state of sprite pipelines.
+    static VkVertexInputBindingDescription bindingDescription();
+    static std::array<VkVertexInputAttributeDescription, 7> attributeDescriptions();
+
+private:
+    // Matches the uniform block of shader.vert.
+    struct FrameUniforms {
+        float time = 0.0f;
+    };
+
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        SpriteInstance* mapped = nullptr;
+        uint64_t uploadedVersion = 0;
+        uint32_t uploadedCount = 0;
+        // The opaque sprites are the first ones in the buffer.
+        uint32_t opaqueCount = 0;
+
+        VkBuffer uniformBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory uniformMemory = VK_NULL_HANDLE;
+        FrameUniforms* uniforms = nullptr;
+        VkDescriptorSet frameSet = VK_NULL_HANDLE;
+    };
+
+    void createDescriptors();
+    void sortDrawOrder(FrameArena& frameArena);
+
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    uint32_t instanceCapacity = 0;
+    bool opaqueFirst = false;
+
+    std::vector<SpriteInstance> spriteInstances;
+    // Indices of the instances from back to front, kept between uploads so its memory is reused.
+    std::vector<uint32_t> drawOrder;
+    uint64_t version = 1;
+    float currentTime = 0.0f;
+
+    VkDescriptorSetLayout frameLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+
+    std::array<Slot, slotCount> slots {};
+};
+
+#endif // SPRITEBATCH_H
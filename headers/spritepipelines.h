@@ -0,0 +1,119 @@
+#ifndef SPRITEPIPELINES_H
+#define SPRITEPIPELINES_H
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <vulkan/vulkan.h>
+
+// Features of the sprite shaders, combined into a mask. Must match the feature constants of shader.vert and shader.frag.
+using SpriteFeatures = uint32_t;
+// Multiplies the sprite's color with its albedo map. Translucent sprites blend by the texels' alpha. Opaque sprites aren't blended,
+// so they keep the alpha of their color, and cut out the texels with an alpha below one half instead.
+constexpr SpriteFeatures spriteTextured = 1u << 0;
+// Takes the color of the sprite from its instance color. Without it, sprites are white, with the alpha of their instance color.
+constexpr SpriteFeatures spriteTinted = 1u << 1;
+// Lights the sprite with its normal map. Without it, the sprite is lit as a flat surface facing the viewer.
+constexpr SpriteFeatures spriteLit = 1u << 2;
+// Discards fragments with an alpha below one half.
+constexpr SpriteFeatures spriteAlphaTest = 1u << 3;
+constexpr SpriteFeatures spriteAllFeatures = spriteTextured | spriteTinted | spriteLit | spriteAlphaTest;
+
+// Feature names joined with "+", like "textured+lit", or "none" for an empty mask.
+std::string spriteFeatureNames(SpriteFeatures features);
+// Parses a list of feature names separated by "+" or ",", or "none" or "all". Returns nothing for unknown names.
+std::optional<SpriteFeatures> parseSpriteFeatures(std::string_view names);
+
+enum class SpriteBlend {
+    // Writes depth and overwrites what's behind it.
+    Opaque,
+    // Tests depth without writing it, and blends with what's behind it by its alpha.
+    Translucent
+};
+
+// Matches the push constant blocks of shader.vert and shader.frag.
+struct SpritePushConstants {
+    // Size of the output in pixels. Sprite positions are in output pixels.
+    float screenSize[2] = { 0.0f, 0.0f };
+    // The features of runtime branching variants. Specialized variants ignore it.
+    SpriteFeatures features = 0;
+};
+
+struct SpritePipelineSettings {
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+    // Set 0 is the sprite's material, and set 1 the frame uniforms of the sprite batch.
+    VkDescriptorSetLayout materialLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout frameLayout = VK_NULL_HANDLE;
+    // Whether the subpass has a depth attachment. Without one, variants don't test or write depth.
+    bool depthAttachment = false;
+    // Host allocation callbacks for the objects the pipelines own. May be null.
+    const VkAllocationCallbacks* pipelineCallbacks = nullptr;
+    const VkAllocationCallbacks* layoutCallbacks = nullptr;
+    const VkAllocationCallbacks* cacheCallbacks = nullptr;
+    // Builds every variant so the driver keeps its shader statistics. The device must have been created with
+    // VK_KHR_pipeline_executable_properties and its pipelineExecutableInfo feature enabled.
+    bool captureStatistics = false;
+};
+
+// Instruction counts of the shaders of a variant, as reported by the driver. Not every driver reports them,
+// and the counts of different drivers aren't comparable, but variants on the same driver are.
+struct SpriteShaderStatistics {
+    bool available = false;
+    uint64_t vertexInstructions = 0;
+    uint64_t fragmentInstructions = 0;
+};
+
+// The graphics pipelines that draw sprites, one variant per feature mask and blend mode.
+//
+// All variants are built from a single uber-shader, shader.vert and shader.frag, which branches on the features.
+// Every variant specializes the shaders with its feature mask, through specialization constants. The branches are then constant,
+// and the driver removes the ones that are off, along with the texture reads and the discard they guard, while it builds the pipeline.
+// That gives each variant the code it would have had as a separate shader, without a separate SPIR-V file for every combination.
+//
+// Variants are built the first time they're asked for, and kept until "destroy". A pipeline cache is shared between them,
+// so the parts the driver compiled for one variant can be reused by the next.
+//
+// "runtimeBranching" asks for the variant that keeps every branch, and reads the features from the push constants instead.
+// It's what a shader without specialization would look like, and is the baseline the specialized variants are measured against.
+class SpritePipelines {
+public:
+    // Not a feature. Combined with a mask, asks "get" for the runtime branching variant.
+    static constexpr SpriteFeatures runtimeBranching = 1u << 31;
+
+    // Creates the shader modules, the pipeline layout and the pipeline cache. No variant is built yet.
+    void init(VkDevice device, const SpritePipelineSettings& settings, std::span<const char> vertexShaderCode,
+              std::span<const char> fragmentShaderCode);
+    void destroy();
+
+    // The variant for a feature mask and blend mode, built on first use. Building a variant can take a while, so the ones that
+    // are used every frame should be asked for before the first frame.
+    VkPipeline get(SpriteFeatures features, SpriteBlend blend);
+
+    // The layout of all variants. Its push constant range covers SpritePushConstants, for both shader stages.
+    VkPipelineLayout layout() const { return pipelineLayout; }
+    uint32_t variantCount() const { return static_cast<uint32_t>(variants.size()); }
+
+    // Builds the variant if needed, and asks the driver for its instruction counts. Only available with "captureStatistics".
+    SpriteShaderStatistics statistics(SpriteFeatures features, SpriteBlend blend);
+
+private:
+    VkPipeline build(SpriteFeatures features, SpriteBlend blend);
+
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    SpritePipelineSettings pipelineSettings {};
+
+    VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+    std::map<std::pair<SpriteFeatures, SpriteBlend>, VkPipeline> variants;
+};
+
+#endif // SPRITEPIPELINES_H
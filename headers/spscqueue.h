@@ -0,0 +1,76 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+
+// A fixed size ring buffer for passing items from exactly one producer thread to exactly one consumer thread, without locks.
+//
+// The producer only writes "tail", and the consumer only writes "head". Each side publishes its index with a release store
+// after touching the slot, and reads the other side's index with an acquire load, which is all the synchronization needed.
+// Both indices grow forever, and are masked into the ring, so a full ring and an empty ring can be told apart.
+//
+// Each side also keeps a copy of the other side's last index it saw, and only loads the shared one when the copy says the ring
+// is full (or empty). That keeps the two threads from pulling the same cache line back and forth on every item.
+template<typename T, uint32_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+public:
+    // Producer only. Returns false when the ring is full.
+    bool push(const T& item) {
+        uint32_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - cachedHead == Capacity) {
+            cachedHead = headIndex.load(std::memory_order_acquire);
+            if (tail - cachedHead == Capacity) {
+                return false;
+            }
+        }
+
+        items[tail & (Capacity - 1)] = item;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Returns the oldest item without removing it, or nullptr when the ring is empty.
+    const T* front() {
+        uint32_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == cachedTail) {
+            cachedTail = tailIndex.load(std::memory_order_acquire);
+            if (head == cachedTail) {
+                return nullptr;
+            }
+        }
+
+        return &items[head & (Capacity - 1)];
+    }
+
+    // Consumer only. Removes the item returned by "front".
+    void popFront() {
+        headIndex.store(headIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer only. Returns false when the ring is empty.
+    bool pop(T& item) {
+        const T* oldest = front();
+        if (oldest == nullptr) {
+            return false;
+        }
+
+        item = *oldest;
+        popFront();
+        return true;
+    }
+
+private:
+    // Each index sits on its own cache line, together with the copy its owner keeps of the other index.
+    alignas(64) std::atomic<uint32_t> headIndex { 0 };
+    uint32_t cachedTail = 0;
+
+    alignas(64) std::atomic<uint32_t> tailIndex { 0 };
+    uint32_t cachedHead = 0;
+
+    alignas(64) T items[Capacity];
+};
+
+#endif // SPSCQUEUE_H
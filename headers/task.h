@@ -0,0 +1,206 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+template<typename T>
+class Task;
+
+namespace detail {
+    // When a task finishes, whoever awaited it is resumed right away on the same thread (symmetric transfer).
+    struct TaskFinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    struct TaskPromiseBase {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        // Tasks are lazy. Nothing runs until the task is awaited.
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        TaskFinalAwaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() noexcept { exception = std::current_exception(); }
+    };
+
+    template<typename T>
+    struct TaskPromise : TaskPromiseBase {
+        std::optional<T> value;
+
+        Task<T> get_return_object() noexcept;
+        void return_value(T result) { value = std::move(result); }
+    };
+
+    template<>
+    struct TaskPromise<void> : TaskPromiseBase {
+        Task<void> get_return_object() noexcept;
+        void return_void() const noexcept {}
+    };
+}
+
+// A lazily started coroutine producing a T.
+// Awaiting a task starts it, and resumes the awaiting coroutine once it finishes, on whichever thread it finished on.
+// Exceptions thrown inside the task are rethrown at the co_await.
+template<typename T = void>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    Task() = default;
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return !handle || handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        if (handle.promise().exception) {
+            std::rethrow_exception(handle.promise().exception);
+        }
+
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(handle.promise().value.value());
+        }
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail {
+    template<typename T>
+    Task<T> TaskPromise<T>::get_return_object() noexcept {
+        return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+        return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+
+    // A coroutine that starts immediately and cleans up after itself. Used to run tasks nobody awaits.
+    struct DetachedTask {
+        struct promise_type {
+            DetachedTask get_return_object() const noexcept { return {}; }
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() const noexcept {}
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+    };
+
+    template<typename T>
+    struct WhenAllState {
+        std::atomic<size_t> remaining = 0;
+        std::coroutine_handle<> waiter;
+        std::vector<std::optional<T>> results;
+        std::mutex exceptionMutex;
+        std::exception_ptr exception;
+    };
+
+    template<typename T>
+    DetachedTask runWhenAllItem(WhenAllState<T>& state, Task<T>& task, size_t index) {
+        try {
+            state.results[index] = co_await task;
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(state.exceptionMutex);
+            if (!state.exception) {
+                state.exception = std::current_exception();
+            }
+        }
+
+        // The last task to finish resumes the coroutine waiting on all of them.
+        if (--state.remaining == 0) {
+            state.waiter.resume();
+        }
+    }
+
+    template<typename T>
+    struct WhenAllAwaiter {
+        WhenAllState<T>& state;
+        std::vector<Task<T>>& tasks;
+
+        bool await_ready() const noexcept { return tasks.empty(); }
+
+        bool await_suspend(std::coroutine_handle<> awaiting) {
+            state.waiter = awaiting;
+            // One extra count keeps tasks that finish synchronously from resuming us while we're still starting the others.
+            state.remaining = tasks.size() + 1;
+
+            for (size_t i = 0; i < tasks.size(); i++) {
+                runWhenAllItem(state, tasks[i], i);
+            }
+
+            // If everything already finished, don't suspend at all.
+            return --state.remaining != 0;
+        }
+
+        void await_resume() const noexcept {}
+    };
+}
+
+// Starts a task without waiting for it. Errors are reported to the console instead of being propagated.
+inline detail::DetachedTask spawn(Task<void> task) {
+    try {
+        co_await task;
+    } catch (const std::exception& exception) {
+        std::cout << "Task failed: " << exception.what() << std::endl;
+    }
+}
+
+// Runs all tasks concurrently, and finishes once every one of them has finished.
+// Results are returned in the same order as the tasks. If any task threw, the first exception is rethrown.
+template<typename T>
+Task<std::vector<T>> whenAll(std::vector<Task<T>> tasks) {
+    detail::WhenAllState<T> state;
+    state.results.resize(tasks.size());
+
+    co_await detail::WhenAllAwaiter<T> { state, tasks };
+
+    if (state.exception) {
+        std::rethrow_exception(state.exception);
+    }
+
+    std::vector<T> results;
+    results.reserve(state.results.size());
+    for (auto& result : state.results) {
+        results.push_back(std::move(result.value()));
+    }
+    co_return results;
+}
+
+#endif // TASK_H
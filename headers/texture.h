@@ -0,0 +1,53 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "assetloader.h"
+#include "deletionqueue.h"
+#include "uploadmanager.h"
+
+// A sampled 2D texture.
+// Until it's uploaded, only the decoded texels in "pixels" are valid. After uploading, the texels are released
+// and the GPU resources are valid instead.
+struct Texture {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t mipLevels = 1;
+    // Where each mip level is in "pixels", largest first. Empty for a single level of tightly packed texels.
+    std::vector<VkBufferImageCopy> levels;
+    std::vector<uint8_t> pixels;
+
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    UploadTicket uploadTicket = 0;
+};
+
+// Decodes an uncompressed 24 or 32 bit TGA file into RGBA8 texels.
+// Throws std::runtime_error for anything else.
+Texture decodeTga(std::span<const char> data);
+
+// Decodes a KTX2 or TGA file, depending on what the data starts with.
+Texture decodeTexture(std::span<const char> data);
+
+// Creates the image and image view for a decoded texture, and queues its texels for upload.
+void uploadTexture(Texture& texture, const AssetUploadContext& context);
+
+void destroyTexture(VkDevice device, Texture& texture);
+
+// Hands the GPU resources of a texture to the deletion queue, so that it can be dropped while frames using it are still in flight.
+void retireTexture(DeletionQueue& deletionQueue, Texture& texture, uint64_t lastUsedValue);
+
+template<>
+struct AssetTraits<Texture> {
+    static Texture decode(std::span<const char> data) { return decodeTexture(data); }
+    static void upload(Texture& texture, const AssetUploadContext& context) { uploadTexture(texture, context); }
+};
+
+#endif // TEXTURE_H
@@ -0,0 +1,114 @@
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A rectangle in texel coordinates on an atlas page.
+struct AtlasRect {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// Normalized texture coordinates of an image inside an atlas page.
+// (u0, v0) is the top left corner, (u1, v1) the bottom right corner.
+struct AtlasUvRect {
+    float u0 = 0.0f;
+    float v0 = 0.0f;
+    float u1 = 0.0f;
+    float v1 = 0.0f;
+};
+
+// Where an image ended up in the atlas.
+// "rect" is the area of the image itself, "allocation" additionally includes the gutter and padding around it.
+struct AtlasEntry {
+    uint32_t page = 0;
+    AtlasRect rect {};
+    AtlasRect allocation {};
+    AtlasUvRect uv {};
+};
+
+struct TextureAtlasConfig {
+    // Width and height of every page in texels.
+    uint32_t pageSize = 2048;
+    // Empty texels between the gutters of two neighbouring images.
+    uint32_t padding = 1;
+    // Amount of texels the border of every image is extruded by.
+    // Bilinear filtering and lower mip levels sample outside of the image rect, and the gutter makes sure they sample
+    // the image's own border instead of whatever was packed next to it.
+    uint32_t gutter = 2;
+    // Allocations are placed and sized in multiples of this, and the image inside is placed on the first multiple after the gutter.
+    // Using 2^(mipLevels - 1) keeps every image aligned to texel boundaries on all mip levels, and a multiple of 4
+    // keeps images aligned to blocks of block-compressed formats.
+    uint32_t alignment = 4;
+    // Insertion fails once this many pages are full.
+    uint32_t maxPages = 8;
+};
+
+// A single RGBA8 page of the atlas.
+struct AtlasPage {
+    std::vector<uint8_t> pixels;
+    // Free space of the page in the form of (possibly overlapping) maximal rectangles.
+    std::vector<AtlasRect> freeRects;
+    // Union of everything written since the last call to "clearDirty", so the renderer only has to upload that region.
+    AtlasRect dirtyRect {};
+    bool dirty = false;
+    // Amount of images currently placed on the page.
+    uint32_t entryCount = 0;
+};
+
+// Packs images into large pages at runtime, so that sprites can share textures and descriptors.
+// Packing uses the MaxRects algorithm with the "best short side fit" heuristic.
+// Images can be inserted and removed incrementally. Removing an image gives its space back to the free list
+// of the page without moving any of the other images, so UV rects handed out earlier stay valid.
+class TextureAtlas {
+public:
+    explicit TextureAtlas(const TextureAtlasConfig& config = {});
+
+    // Packs an RGBA8 image with tightly packed rows.
+    // Returns std::nullopt if the image does not fit on any page and no more pages can be created.
+    // Inserting a name that is already in the atlas replaces the old image. If the new image doesn't fit, the old one is kept.
+    std::optional<AtlasEntry> insert(const std::string& name, uint32_t width, uint32_t height, const uint8_t* rgbaPixels);
+
+    // Evicts an image, making its space available to future insertions.
+    // Returns false if no image with that name is in the atlas.
+    bool remove(const std::string& name);
+
+    const AtlasEntry* find(const std::string& name) const;
+
+    const TextureAtlasConfig& config() const { return atlasConfig; }
+    const std::vector<AtlasPage>& pages() const { return atlasPages; }
+    size_t entryCount() const { return entries.size(); }
+
+    // Ratio of texels covered by allocations to the total amount of texels on all pages.
+    float occupancy() const;
+
+    void clearDirty(uint32_t page);
+
+    // Offline mode.
+    // Writes all pages, entries and free lists to a single binary file, which can be loaded again without repacking.
+    // A loaded atlas can keep receiving insertions and evictions.
+    void writeToFile(const std::string& filename) const;
+    static TextureAtlas readFromFile(const std::string& filename);
+
+private:
+    std::optional<AtlasRect> findPosition(const AtlasPage& page, uint32_t width, uint32_t height) const;
+    void placeRect(AtlasPage& page, const AtlasRect& usedRect);
+    void pruneFreeRects(AtlasPage& page);
+    void mergeFreeRects(AtlasPage& page);
+    void blitWithGutter(AtlasPage& page, const AtlasRect& imageRect, const uint8_t* rgbaPixels);
+    void markDirty(AtlasPage& page, const AtlasRect& rect);
+    AtlasPage& addPage();
+
+    TextureAtlasConfig atlasConfig;
+    std::vector<AtlasPage> atlasPages;
+    std::unordered_map<std::string, AtlasEntry> entries;
+    uint64_t usedTexels = 0;
+};
+
+#endif // TEXTUREATLAS_H
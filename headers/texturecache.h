@@ -0,0 +1,128 @@
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "assetloader.h"
+#include "deletionqueue.h"
+#include "task.h"
+#include "texture.h"
+
+// Identifies a texture registered with the cache. Stays valid whether or not the texture is resident.
+using TextureHandle = uint32_t;
+
+struct TextureCacheSettings {
+    // A fixed budget for resident textures, in bytes. 0 derives it from the device-local heap instead.
+    VkDeviceSize budgetBytes = 0;
+    // The share of the device-local heap textures may take, when the budget is derived from it.
+    // With VK_EXT_memory_budget, that's a share of what the heap has left for this process, not counting the textures themselves.
+    float heapFraction = 0.5f;
+    // How many frames to wait between queries of the heap budget, which changes as other processes allocate memory.
+    uint32_t budgetQueryInterval = 60;
+};
+
+struct TextureCacheStats {
+    // "acquire" found the texture resident.
+    uint64_t hits = 0;
+    // "acquire" had to show the placeholder, because the texture wasn't loaded yet.
+    uint64_t misses = 0;
+    uint64_t loads = 0;
+    uint64_t evictions = 0;
+    uint32_t residentCount = 0;
+    VkDeviceSize residentBytes = 0;
+    VkDeviceSize peakResidentBytes = 0;
+    VkDeviceSize budgetBytes = 0;
+};
+
+// Returns true if the device supports VK_EXT_memory_budget, and the instance and device are new enough to query it.
+bool supportsMemoryBudget(VkPhysicalDevice physicalDevice, uint32_t instanceApiVersion);
+
+// Keeps as many textures resident as fit in a memory budget, and streams the rest in on demand.
+//
+// Every texture is registered once by path, and asked for with "acquire" in every frame that uses it. The cache remembers the frame
+// each texture was last used in, and keeps the resident ones in a list ordered by that, most recently used first.
+// When the resident textures take more than the budget, the ones at the end of the list, the least recently used, are evicted.
+// A texture that isn't resident is loaded asynchronously the first time it's asked for, and a placeholder is handed out until it arrives.
+//
+// The budget is either fixed, or a share of the device-local heap. With VK_EXT_memory_budget, the driver reports how much of the heap
+// this process can use right now, which shrinks when other applications need memory, and the budget follows it.
+class TextureCache {
+public:
+    // "memoryBudget" tells whether VK_EXT_memory_budget was enabled on the device. See supportsMemoryBudget.
+    void init(const AssetUploadContext& uploadContext, AssetLoader& assetLoader, DeletionQueue& deletionQueue,
+              bool memoryBudget, const TextureCacheSettings& settings);
+    // Destroys every resident texture and the placeholder. Only call this once the device is idle.
+    void destroy();
+
+    // Registers a texture without loading it.
+    TextureHandle add(std::string path);
+
+    // Returns the view to sample for the texture in the frame with value "frameValue", and marks it as used by that frame.
+    // Until the texture is resident, that's the placeholder's view, and a load is started if none is running.
+    // The returned view is valid until "frameValue" completes, so this has to be called again for each frame that uses it.
+    VkImageView acquire(TextureHandle handle, uint64_t frameValue);
+    bool isResident(TextureHandle handle) const;
+
+    // Evicts the least recently used textures while over budget. Textures used by "frameValue" or later are never evicted.
+    // Call this once per frame, before recording the frame with value "frameValue".
+    void update(uint64_t frameValue);
+
+    // Changes the budget. 0 derives it from the device-local heap again.
+    void setBudget(VkDeviceSize budgetBytes);
+
+    TextureCacheStats stats() const;
+
+private:
+    static constexpr uint32_t invalidIndex = UINT32_MAX;
+
+    enum class Residency : uint8_t {
+        Unloaded,
+        Loading,
+        Resident,
+        // The last load threw. It's not tried again, so a missing file doesn't reload every frame.
+        Failed,
+    };
+
+    struct Entry {
+        std::string path;
+        Residency residency = Residency::Unloaded;
+        Texture texture {};
+        VkDeviceSize bytes = 0;
+        uint64_t lastUsedFrame = 0;
+        // Neighbours in the list of resident textures.
+        uint32_t newer = invalidIndex;
+        uint32_t older = invalidIndex;
+    };
+
+    Task<void> load(TextureHandle handle);
+
+    void linkNewest(TextureHandle handle);
+    void unlink(TextureHandle handle);
+    void evict(TextureHandle handle);
+
+    VkDeviceSize queryBudget() const;
+
+    AssetUploadContext context {};
+    AssetLoader* loader = nullptr;
+    DeletionQueue* retired = nullptr;
+    bool memoryBudgetSupported = false;
+    TextureCacheSettings settings {};
+
+    std::vector<Entry> entries;
+    Texture placeholder {};
+
+    // Resident textures, from most to least recently used.
+    uint32_t newestResident = invalidIndex;
+    uint32_t oldestResident = invalidIndex;
+
+    VkDeviceSize budgetBytes = 0;
+    uint64_t budgetQueriedFrame = 0;
+
+    TextureCacheStats counters {};
+};
+
+#endif // TEXTURECACHE_H
@@ -0,0 +1,40 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads pulling jobs from a shared FIFO queue.
+// The destructor finishes all queued jobs before joining the workers.
+class ThreadPool {
+public:
+    explicit ThreadPool(uint32_t threadCount);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    void enqueue(std::function<void()> job);
+
+    // Splits [0, count) into batches of at least "minBatchSize" and runs "job(begin, end)" on each, using the workers and
+    // the calling thread. Returns once every batch has finished.
+    // Must not be called from a job running on the same pool, since the calling thread waits for the workers.
+    void parallelFor(uint32_t count, uint32_t minBatchSize, const std::function<void(uint32_t begin, uint32_t end)>& job);
+
+    uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<std::function<void()>> jobs;
+    bool stopping = false;
+};
+
+#endif // THREADPOOL_H
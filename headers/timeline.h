@@ -0,0 +1,63 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <array>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+// Timeline semaphores (core in Vulkan 1.2) hold a 64 bit counter instead of a signaled/unsignaled state.
+// Every submission to a queue signals the next value of that queue's counter, and anything that depends on the submission,
+// be it other queues or the host, waits for that value. A single semaphore per queue replaces the pile of binary semaphores
+// and fences otherwise needed, and checking progress is a cheap counter read instead of polling fences one by one.
+struct QueueTimeline {
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    // The value signaled by the most recent submission.
+    uint64_t lastSubmittedValue = 0;
+};
+
+// Returns true if the device reports Vulkan 1.2 and the timelineSemaphore feature.
+bool supportsTimelineSemaphores(VkPhysicalDevice physicalDevice);
+
+// "allocator" is passed on to vkCreateSemaphore and vkDestroySemaphore, and must be the same for both.
+QueueTimeline createQueueTimeline(VkDevice device, const VkAllocationCallbacks* allocator);
+void destroyQueueTimeline(VkDevice device, QueueTimeline& timeline, const VkAllocationCallbacks* allocator);
+
+// The value the next submission to the queue should signal.
+inline uint64_t nextTimelineValue(QueueTimeline& timeline) {
+    return ++timeline.lastSubmittedValue;
+}
+
+// The highest value the GPU has signaled so far. Never blocks.
+uint64_t completedTimelineValue(VkDevice device, const QueueTimeline& timeline);
+
+// Blocks the calling thread until the timeline has reached "value".
+void waitForTimelineValue(VkDevice device, const QueueTimeline& timeline, uint64_t value, uint64_t timeout = UINT64_MAX);
+
+// Collects the semaphores a queue submission waits on and signals, mixing binary semaphores (like the ones used with the swapchain)
+// and timeline values. Fixed capacity, so building a submission never allocates. Adding more than that terminates.
+struct SubmitSemaphores {
+    static constexpr uint32_t maxSemaphores = 8;
+
+    std::array<VkSemaphore, maxSemaphores> waitSemaphores {};
+    std::array<uint64_t, maxSemaphores> waitValues {};
+    std::array<VkPipelineStageFlags, maxSemaphores> waitStages {};
+    uint32_t waitCount = 0;
+
+    std::array<VkSemaphore, maxSemaphores> signalSemaphores {};
+    std::array<uint64_t, maxSemaphores> signalValues {};
+    uint32_t signalCount = 0;
+
+    bool usesTimeline = false;
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo {};
+
+    void waitBinary(VkSemaphore semaphore, VkPipelineStageFlags stage);
+    void waitTimeline(const QueueTimeline& timeline, uint64_t value, VkPipelineStageFlags stage);
+    void signalBinary(VkSemaphore semaphore);
+    void signalTimeline(const QueueTimeline& timeline, uint64_t value);
+
+    // Points the submit info at the collected semaphores. The SubmitSemaphores object must outlive the vkQueueSubmit call.
+    void apply(VkSubmitInfo& submitInfo);
+};
+
+#endif // TIMELINE_H
@@ -0,0 +1,137 @@
+#ifndef UPLOADMANAGER_H
+#define UPLOADMANAGER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "timeline.h"
+
+// Identifies the batch an upload was recorded into.
+// An upload is complete once "UploadManager::isComplete" returns true for its ticket.
+using UploadTicket = uint64_t;
+
+struct UploadStats {
+    // Bytes copied into the staging arena since startup.
+    uint64_t bytesUploaded = 0;
+    // Bytes of batches the GPU has finished.
+    uint64_t bytesCompleted = 0;
+    uint64_t batchesSubmitted = 0;
+    // Throughput of completed batches, measured from submission until the batch was seen as completed.
+    double megabytesPerSecond = 0.0;
+    // Time the CPU spent blocked, waiting for staging space or free batches.
+    double secondsWaiting = 0.0;
+};
+
+// Batches buffer and image uploads through a shared, persistently mapped staging arena.
+//
+// If the device exposes a transfer-only queue family (usually backed by dedicated DMA engines), copies are submitted there,
+// so they run alongside rendering instead of competing with it on the graphics queue.
+// Resources created with VK_SHARING_MODE_EXCLUSIVE belong to one queue family at a time, so ownership is handed to
+// the graphics family with a release barrier on the transfer queue, and a matching acquire barrier on the graphics queue.
+// The acquire barrier is submitted on the graphics queue before any frame recorded after "flush", and pipeline barriers
+// apply to everything later in submission order, so frames can use uploaded resources without waiting on the CPU.
+//
+// With timeline semaphores, each batch signals its ticket on the upload timeline instead of a fence. Other queues can then
+// wait for an upload by value, and completion is polled with a single counter read.
+class UploadManager {
+public:
+    void init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t transferFamily, VkQueue transferQueue,
+              uint32_t graphicsFamily, VkQueue graphicsQueue, VkDeviceSize stagingSize, bool useTimelineSemaphores = false);
+    void destroy();
+
+    // Copies "data" into "dstBuffer" at "dstOffset".
+    // "dstStageMask" and "dstAccessMask" describe how the graphics queue will use the buffer.
+    UploadTicket uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+                              VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                              VkAccessFlags dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT);
+
+    // Copies "data" into the mip levels of "dstImage" described by "regions". The buffer offsets of the regions are relative to "data".
+    // The image is transitioned from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+    UploadTicket uploadImage(VkImage dstImage, uint32_t mipLevels, std::span<const VkBufferImageCopy> regions, const void* data, VkDeviceSize size);
+
+    // Convenience overload for a single mip level with tightly packed texels.
+    UploadTicket uploadImage(VkImage dstImage, uint32_t width, uint32_t height, const void* data, VkDeviceSize size);
+
+    // Submits everything recorded since the last flush. Should be called once per frame before the frame is submitted.
+    void flush();
+
+    // Retires batches the GPU has finished, without blocking.
+    void collect();
+
+    bool isComplete(UploadTicket ticket) const { return ticket <= completedTicket; }
+
+    // Blocks until the upload is complete.
+    void waitFor(UploadTicket ticket);
+
+    bool usesDedicatedTransferQueue() const { return transferFamilyIndex != graphicsFamilyIndex; }
+
+    // The timeline every batch signals with its ticket once its uploads are usable by the graphics queue.
+    // Null if timeline semaphores are not in use.
+    const QueueTimeline* timeline() const { return useTimeline ? &uploadTimeline : nullptr; }
+
+    const UploadStats& stats() const { return uploadStats; }
+
+private:
+    struct Batch {
+        VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;
+        VkSemaphore transferCompleteSemaphore = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        UploadTicket ticket = 0;
+        VkDeviceSize stagingEnd = 0;
+        uint64_t bytes = 0;
+        std::chrono::steady_clock::time_point submitTime {};
+        bool recording = false;
+        bool inFlight = false;
+
+        std::vector<VkBufferMemoryBarrier> bufferReleaseBarriers;
+        std::vector<VkImageMemoryBarrier> imageReleaseBarriers;
+        VkPipelineStageFlags acquireStageMask = 0;
+    };
+
+    static constexpr uint32_t batchCount = 4;
+
+    Batch& beginRecording();
+    VkDeviceSize allocateStaging(VkDeviceSize size, VkDeviceSize alignment);
+    void waitForOldestBatch();
+    bool isBatchComplete(const Batch& batch) const;
+    void waitForBatch(const Batch& batch);
+    void retire(Batch& batch);
+
+    VkDevice logicalDevice = VK_NULL_HANDLE;
+    uint32_t transferFamilyIndex = 0;
+    uint32_t graphicsFamilyIndex = 0;
+    VkQueue transferQueue = VK_NULL_HANDLE;
+    VkQueue graphicsQueue = VK_NULL_HANDLE;
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+    VkCommandPool acquireCommandPool = VK_NULL_HANDLE;
+
+    // The staging arena is used as a ring buffer.
+    // "stagingHead" is where the next allocation goes, "stagingTail" is the start of the oldest range the GPU may still read.
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+    uint8_t* stagingMapped = nullptr;
+    VkDeviceSize stagingCapacity = 0;
+    VkDeviceSize stagingHead = 0;
+    VkDeviceSize stagingTail = 0;
+    VkDeviceSize stagingUsed = 0;
+
+    std::array<Batch, batchCount> batches {};
+    uint32_t currentBatch = 0;
+    UploadTicket nextTicket = 1;
+    UploadTicket completedTicket = 0;
+
+    // When set, batch completion is tracked with "uploadTimeline" and the batch fences are not used.
+    bool useTimeline = false;
+    QueueTimeline uploadTimeline {};
+
+    UploadStats uploadStats {};
+    double secondsInFlight = 0.0;
+};
+
+#endif // UPLOADMANAGER_H
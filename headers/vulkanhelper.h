@@ -0,0 +1,28 @@
+#ifndef VULKANHELPER_H
+#define VULKANHELPER_H
+
+#include <span>
+
+#include <vulkan/vulkan.h>
+
+// Finds a memory type on the physical device that is allowed by "typeFilter" (a bitmask as reported in VkMemoryRequirements::memoryTypeBits)
+// and that has all of the requested property flags.
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+// Creates a buffer and allocates and binds dedicated memory for it.
+// If more than one queue family is given in "sharedQueueFamilies", the buffer can be used by all of them without ownership transfers.
+void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage,
+                  VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+                  std::span<const uint32_t> sharedQueueFamilies = {});
+
+// Creates a 2D image with optimal tiling and allocates and binds dedicated memory for it.
+void createImage(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t width, uint32_t height, uint32_t mipLevels,
+                 VkFormat format, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+
+// Creates a 2D image view covering all mip levels of an image.
+VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
+
+// Wraps SPIR-V code in a shader module. The code must be 4 byte aligned.
+VkShaderModule createShaderModule(VkDevice device, std::span<const char> code);
+
+#endif // VULKANHELPER_H
@@ -0,0 +1,79 @@
+#version 450
+
+// Must match LightingSystem in lighting.h.
+const uint tileSize = 16;
+const uint maxLightsPerTile = 63;
+const uint lightTypeSpot = 1;
+
+struct Light {
+    vec2 position;
+    float radius;
+    float intensity;
+    vec3 color;
+    uint type;
+    vec2 direction;
+    float cosInnerAngle;
+    float cosOuterAngle;
+};
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput albedoInput;
+layout(input_attachment_index = 1, set = 0, binding = 1) uniform subpassInput normalInput;
+
+layout(std430, set = 0, binding = 2) readonly buffer Lights {
+    Light lights[];
+};
+
+// For every tile, a light count followed by "maxLightsPerTile" light indices.
+layout(std430, set = 0, binding = 3) readonly buffer TileLights {
+    uint tileLights[];
+};
+
+layout(push_constant) uniform PushConstants {
+    vec2 framebufferSize;
+    uint tileCountX;
+    uint lightCount;
+    vec4 ambient;
+    float lightHeight;
+} params;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 albedo = subpassLoad(albedoInput);
+    vec3 normal = normalize(subpassLoad(normalInput).xyz * 2.0 - 1.0);
+    // Normal maps point +Y up, but framebuffer coordinates point +Y down.
+    normal.y = -normal.y;
+
+    uvec2 tile = uvec2(gl_FragCoord.xy) / tileSize;
+    uint tileOffset = (tile.y * params.tileCountX + tile.x) * (maxLightsPerTile + 1);
+    uint count = tileLights[tileOffset];
+
+    vec3 color = albedo.rgb * params.ambient.rgb;
+
+    for (uint i = 0; i < count; i++) {
+        Light light = lights[tileLights[tileOffset + 1 + i]];
+
+        vec2 toLight = light.position - gl_FragCoord.xy;
+        float distance = length(toLight);
+        if (distance >= light.radius) {
+            continue;
+        }
+
+        // Quadratic falloff that reaches exactly zero at the radius, so culling by radius never cuts off visible light.
+        float attenuation = 1.0 - distance / light.radius;
+        attenuation *= attenuation;
+
+        if (light.type == lightTypeSpot && distance > 0.0) {
+            float cosAngle = dot(-toLight / distance, light.direction);
+            attenuation *= smoothstep(light.cosOuterAngle, light.cosInnerAngle, cosAngle);
+        }
+
+        // Lights hover above the sprite plane, so surfaces facing the viewer are lit as well.
+        vec3 lightDirection = normalize(vec3(toLight, params.lightHeight));
+        float diffuse = max(dot(normal, lightDirection), 0.0);
+
+        color += albedo.rgb * light.color * light.intensity * diffuse * attenuation;
+    }
+
+    outColor = vec4(color, albedo.a);
+}
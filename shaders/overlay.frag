@@ -0,0 +1,17 @@
+#version 450
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragCell;
+layout(location = 2) flat in uint fragMask;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // Glyphs are 3 by 5 pixel masks, with bit "row * 3 + column" set for filled pixels. Solid rectangles have every bit set.
+    uvec2 cell = uvec2(clamp(fragCell, vec2(0.0), vec2(2.0, 4.0)));
+    if ((fragMask & (1u << (cell.y * 3u + cell.x))) == 0u) {
+        discard;
+    }
+
+    outColor = fragColor;
+}
@@ -0,0 +1,29 @@
+#version 450
+
+// Per-instance rectangle data, see PerfOverlay::Rectangle in perfoverlay.h.
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inSize;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in uint inMask;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragCell;
+layout(location = 2) flat out uint fragMask;
+
+layout(push_constant) uniform PushConstants {
+    // Size of the output in pixels. Rectangles are positioned in output pixels, from the top left corner.
+    vec2 screenSize;
+} pushConstants;
+
+void main() {
+    // The 4 vertices of the triangle strip are the corners (0, 0), (1, 0), (0, 1) and (1, 1) of the rectangle.
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+
+    vec2 position = inPosition + inSize * corner;
+    gl_Position = vec4(position / pushConstants.screenSize * 2.0 - 1.0, 0.0, 1.0);
+
+    fragColor = inColor;
+    // Position in the 3 by 5 grid of the font.
+    fragCell = corner * vec2(3.0, 5.0);
+    fragMask = inMask;
+}
@@ -1,8 +1,69 @@
 #version 450
 
-layout(location = 0) in vec3 fragColor;
-layout(location = 0) out vec4 outColor;
+// Features of the sprite uber-shader. Must match SpriteFeatures in spritepipelines.h.
+const uint featureTextured = 1;
+const uint featureTinted = 2;
+const uint featureLit = 4;
+const uint featureAlphaTest = 8;
+
+// Every sprite pipeline specializes these when it's built. The branches of features that are off are then constant, and the
+// driver removes them along with the texture reads they guard, so each variant only pays for what it uses.
+// With "runtimeBranching", the features are read from the push constants instead, and every branch stays in the shader.
+layout(constant_id = 0) const bool runtimeBranching = false;
+layout(constant_id = 1) const uint specializedFeatures = featureTinted | featureLit;
+// Set for the variants that draw opaque sprites. Those don't blend and do write depth, so nothing they draw may be see-through.
+layout(constant_id = 2) const bool opaquePass = false;
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+// The lighting subpass shades the scene using these two attachments.
+layout(location = 0) out vec4 outAlbedo;
+layout(location = 1) out vec4 outNormal;
+
+// Tangent space normal map of the sprite. Sprites without one use a flat 1x1 map.
+layout(set = 0, binding = 0) uniform sampler2D normalMap;
+// Albedo map of the sprite. Sprites without one use a white 1x1 map.
+layout(set = 0, binding = 1) uniform sampler2D albedoMap;
+
+// The screen size in front of the features is only used by the vertex shader.
+layout(push_constant) uniform PushConstants {
+    layout(offset = 8) uint features;
+} pushConstants;
+
+bool hasFeature(uint feature) {
+    uint features = runtimeBranching ? pushConstants.features : specializedFeatures;
+    return (features & feature) != 0u;
+}
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
-}
\ No newline at end of file
+    // The sprite's color decides whether it's drawn as opaque or translucent, so its alpha is where the written alpha starts.
+    vec4 albedo = vec4(1.0, 1.0, 1.0, fragColor.a);
+    if (hasFeature(featureTinted)) {
+        albedo.rgb = fragColor.rgb;
+    }
+
+    // How much of the sprite covers the fragment. Translucent variants blend by it. Opaque variants can't, so they keep the alpha
+    // of the sprite's color, and cut out the texels that are mostly transparent instead, as if the alpha test was on.
+    float coverage = albedo.a;
+    if (hasFeature(featureTextured)) {
+        vec4 texel = texture(albedoMap, fragTexCoord);
+        albedo.rgb *= texel.rgb;
+        coverage *= texel.a;
+        if (!opaquePass) {
+            albedo.a = coverage;
+        }
+    }
+    // Discarding keeps the depth test from running before the fragment shader, so only variants that need it do it.
+    bool cutOut = hasFeature(featureAlphaTest) || (opaquePass && hasFeature(featureTextured));
+    if (cutOut && coverage < 0.5) {
+        discard;
+    }
+    outAlbedo = albedo;
+
+    // Sprites face the viewer, so tangent space and screen space line up, and the encoded normal can be stored as is.
+    // Sprites that aren't lit by their normal map are lit as flat surfaces facing the viewer.
+    // The alpha is the sprite's, so translucent sprites blend their normals with the ones behind them, like their colors.
+    vec3 normal = hasFeature(featureLit) ? texture(normalMap, fragTexCoord).xyz : vec3(0.5, 0.5, 1.0);
+    outNormal = vec4(normal, albedo.a);
+}
@@ -1,20 +1,62 @@
 #version 450
 
-layout(location = 0) out vec3 fragColor;
+// See shader.frag. Texture coordinates are only needed by the features that read textures.
+const uint featureTextured = 1;
+const uint featureTinted = 2;
+const uint featureLit = 4;
+layout(constant_id = 0) const bool runtimeBranching = false;
+layout(constant_id = 1) const uint specializedFeatures = featureTinted | featureLit;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+// Per-instance sprite data, see SpriteInstance in spritebatch.h.
+layout(location = 0) in vec2 inXAxis;
+layout(location = 1) in vec2 inYAxis;
+layout(location = 2) in vec2 inPosition;
+layout(location = 3) in vec4 inUvRect;
+layout(location = 4) in vec4 inColor;
+// Frame count, frames per second, start time and frame stride in U of looping animations. See SpriteInstance::gpuAnimation.
+layout(location = 5) in vec4 inAnimation;
+// Depth from the sprite's place in the back to front order, see SpriteInstance::depth.
+layout(location = 6) in float inDepth;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+layout(push_constant) uniform PushConstants {
+    // Size of the output in pixels. Sprite positions are in output pixels, whatever resolution the scene is rendered at.
+    vec2 screenSize;
+    // The features of pipelines that branch at runtime.
+    uint features;
+} pushConstants;
+
+layout(set = 1, binding = 0) uniform FrameUniforms {
+    // Seconds since startup, written every frame. Animations evaluated here don't need the instance data to change.
+    float time;
+} frame;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
-}
\ No newline at end of file
+    // The 4 vertices of the triangle strip are the corners (0, 0), (1, 0), (0, 1) and (1, 1) of the quad.
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec2 local = corner - 0.5;
+
+    vec2 world = inPosition + inXAxis * local.x + inYAxis * local.y;
+    gl_Position = vec4(world / pushConstants.screenSize * 2.0 - 1.0, inDepth, 1.0);
+
+    fragColor = inColor;
+
+    // Without textures, GPU animations don't change anything that's visible, so they aren't evaluated.
+    uint features = runtimeBranching ? pushConstants.features : specializedFeatures;
+    if ((features & (featureTextured | featureLit)) == 0u) {
+        fragTexCoord = vec2(0.0);
+        return;
+    }
+
+    // The frames of GPU animations are laid out next to each other in the atlas, so the current frame is the first one,
+    // moved to the right by a whole number of frames.
+    vec4 uvRect = inUvRect;
+    if (inAnimation.x >= 2.0) {
+        float frameIndex = mod(floor((frame.time - inAnimation.z) * inAnimation.y), inAnimation.x);
+        uvRect.xz += frameIndex * inAnimation.w;
+    }
+
+    fragTexCoord = mix(uvRect.xy, uvRect.zw, corner);
+}
@@ -0,0 +1,19 @@
+#version 450
+
+// The scene, rendered at a reduced resolution into the top left corner of the scene image.
+layout(set = 0, binding = 0) uniform sampler2D sceneImage;
+
+layout(push_constant) uniform PushConstants {
+    vec2 outputSize;
+    // The part of the scene image that was rendered to, in texture coordinates.
+    vec2 sceneScale;
+    // Bilinear filtering must not reach into texels outside of the rendered area, which hold stale contents.
+    vec2 maxTexCoord;
+} params;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec2 texCoord = gl_FragCoord.xy / params.outputSize * params.sceneScale;
+    outColor = texture(sceneImage, min(texCoord, params.maxTexCoord));
+}
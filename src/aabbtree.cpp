@@ -0,0 +1,239 @@
+#include "aabbtree.h"
+
+#include <algorithm>
+
+namespace {
+    Aabb inflate(const Aabb& box, float margin) {
+        Aabb fat = box;
+        fat.min[0] -= margin;
+        fat.min[1] -= margin;
+        fat.max[0] += margin;
+        fat.max[1] += margin;
+        return fat;
+    }
+}
+
+uint32_t AabbTree::createProxy(const Aabb& box, float margin, uint32_t userData) {
+    uint32_t proxy = allocateNode();
+    nodes[proxy].box = inflate(box, margin);
+    nodes[proxy].userData = userData;
+    nodes[proxy].height = 0;
+
+    insertLeaf(proxy);
+    leafCount++;
+    return proxy;
+}
+
+void AabbTree::destroyProxy(uint32_t proxy) {
+    removeLeaf(proxy);
+    freeNode(proxy);
+    leafCount--;
+}
+
+bool AabbTree::moveProxy(uint32_t proxy, const Aabb& box, float margin) {
+    if (nodes[proxy].box.contains(box)) {
+        return false;
+    }
+
+    removeLeaf(proxy);
+    nodes[proxy].box = inflate(box, margin);
+    insertLeaf(proxy);
+    return true;
+}
+
+void AabbTree::clear() {
+    nodes.clear();
+    root = nullNode;
+    freeList = nullNode;
+    leafCount = 0;
+}
+
+uint32_t AabbTree::allocateNode() {
+    uint32_t node;
+    if (freeList != nullNode) {
+        node = freeList;
+        freeList = nodes[node].parent;
+    } else {
+        node = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    nodes[node] = Node {};
+    return node;
+}
+
+void AabbTree::freeNode(uint32_t node) {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+void AabbTree::insertLeaf(uint32_t leaf) {
+    if (root == nullNode) {
+        root = leaf;
+        nodes[root].parent = nullNode;
+        return;
+    }
+
+    // Walk down to the best sibling for the new leaf. At every node, we either pair the leaf with the node itself, or descend into
+    // the child whose box grows the least. Every ancestor of the new leaf grows to include it, which is the "inheritance" cost.
+    const Aabb leafBox = nodes[leaf].box;
+    uint32_t index = root;
+    while (!nodes[index].isLeaf()) {
+        const Node& node = nodes[index];
+
+        float area = node.box.perimeter();
+        float combinedArea = Aabb::combine(node.box, leafBox).perimeter();
+
+        // Cost of creating a new parent for this node and the leaf.
+        float cost = 2.0f * combinedArea;
+        // Minimum cost of pushing the leaf further down the tree.
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](uint32_t child) {
+            float childCost = Aabb::combine(leafBox, nodes[child].box).perimeter();
+            if (!nodes[child].isLeaf()) {
+                childCost -= nodes[child].box.perimeter();
+            }
+            return childCost + inheritanceCost;
+        };
+
+        float cost1 = descendCost(node.child1);
+        float cost2 = descendCost(node.child2);
+
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    // Create a new parent for the sibling and the leaf.
+    uint32_t sibling = index;
+    uint32_t oldParent = nodes[sibling].parent;
+    uint32_t newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].box = Aabb::combine(leafBox, nodes[sibling].box);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != nullNode) {
+        if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        } else {
+            nodes[oldParent].child2 = newParent;
+        }
+    } else {
+        root = newParent;
+    }
+
+    refitAncestors(nodes[leaf].parent);
+}
+
+void AabbTree::removeLeaf(uint32_t leaf) {
+    if (leaf == root) {
+        root = nullNode;
+        return;
+    }
+
+    // The leaf's parent is removed as well, and the leaf's sibling takes its place.
+    uint32_t parent = nodes[leaf].parent;
+    uint32_t grandParent = nodes[parent].parent;
+    uint32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent != nullNode) {
+        if (nodes[grandParent].child1 == parent) {
+            nodes[grandParent].child1 = sibling;
+        } else {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+
+        refitAncestors(grandParent);
+    } else {
+        root = sibling;
+        nodes[sibling].parent = nullNode;
+        freeNode(parent);
+    }
+}
+
+void AabbTree::refitAncestors(uint32_t node) {
+    while (node != nullNode) {
+        Node& current = nodes[node];
+        const Node& child1 = nodes[current.child1];
+        const Node& child2 = nodes[current.child2];
+        current.height = 1 + std::max(child1.height, child2.height);
+        current.box = Aabb::combine(child1.box, child2.box);
+
+        rotate(node);
+
+        node = current.parent;
+    }
+}
+
+void AabbTree::rotate(uint32_t a) {
+    Node& nodeA = nodes[a];
+    uint32_t b = nodeA.child1;
+    uint32_t c = nodeA.child2;
+
+    // Swapping a child of A with a grandchild below its sibling doesn't change A's box, but changes the box of the sibling.
+    // The swap that shrinks the sibling the most is taken. Smaller boxes are overlapped by fewer queries.
+    struct Swap {
+        uint32_t child = nullNode;
+        uint32_t grandChild = nullNode;
+        float gain = 0.0f;
+    };
+    Swap best {};
+
+    auto consider = [&](uint32_t child, uint32_t sibling) {
+        const Node& siblingNode = nodes[sibling];
+        if (siblingNode.isLeaf()) {
+            return;
+        }
+
+        float siblingArea = siblingNode.box.perimeter();
+        uint32_t grandChildren[2] = { siblingNode.child1, siblingNode.child2 };
+        for (int i = 0; i < 2; i++) {
+            // The grandchild moves up next to the sibling, and the child takes its place next to the other grandchild.
+            uint32_t stays = grandChildren[1 - i];
+            float gain = siblingArea - Aabb::combine(nodes[child].box, nodes[stays].box).perimeter();
+            if (gain > best.gain) {
+                best = { child, grandChildren[i], gain };
+            }
+        }
+    };
+
+    consider(b, c);
+    consider(c, b);
+
+    if (best.child == nullNode) {
+        return;
+    }
+
+    uint32_t child = best.child;
+    uint32_t grandChild = best.grandChild;
+    uint32_t sibling = child == b ? c : b;
+    Node& siblingNode = nodes[sibling];
+
+    if (nodeA.child1 == child) {
+        nodeA.child1 = grandChild;
+    } else {
+        nodeA.child2 = grandChild;
+    }
+    nodes[grandChild].parent = a;
+
+    if (siblingNode.child1 == grandChild) {
+        siblingNode.child1 = child;
+    } else {
+        siblingNode.child2 = child;
+    }
+    nodes[child].parent = sibling;
+
+    siblingNode.box = Aabb::combine(nodes[siblingNode.child1].box, nodes[siblingNode.child2].box);
+    siblingNode.height = 1 + std::max(nodes[siblingNode.child1].height, nodes[siblingNode.child2].height);
+    nodeA.height = 1 + std::max(nodes[nodeA.child1].height, nodes[nodeA.child2].height);
+}
@@ -0,0 +1,148 @@
+#include "assetarchive.h"
+#include "lz4.h"
+
+#include <stdexcept>
+
+uint64_t hashAssetName(std::string_view name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+AssetArchive::~AssetArchive() {
+    close();
+}
+
+void AssetArchive::open(const std::string& filename) {
+    close();
+
+    // We jump between entries, so the OS shouldn't read ahead aggressively.
+    file.open(filename, MappedFileAccess::Random);
+    mappedData = file.data().data();
+    mappedSize = file.data().size();
+
+    if (mappedSize < sizeof(ArchiveHeader)) {
+        close();
+        throw std::runtime_error("asset archive is truncated!");
+    }
+
+    header = reinterpret_cast<const ArchiveHeader*>(mappedData);
+    if (header->magic != archiveMagic || header->version != archiveVersion) {
+        close();
+        throw std::runtime_error("asset archive has an unknown format!");
+    }
+
+    // Offsets are compared against what's left of the mapping after them, so that huge values can't wrap around.
+    if (header->indexOffset > mappedSize || header->entryCount > (mappedSize - header->indexOffset) / sizeof(ArchiveEntry) ||
+        header->stringTableOffset > mappedSize) {
+        close();
+        throw std::runtime_error("asset archive is truncated!");
+    }
+
+    entries = reinterpret_cast<const ArchiveEntry*>(mappedData + header->indexOffset);
+    stringTable = mappedData + header->stringTableOffset;
+
+    // Lookups read the names of the entries they pass, so every name has to be inside the mapping before the first lookup.
+    uint64_t stringTableSize = mappedSize - header->stringTableOffset;
+    for (uint32_t i = 0; i < header->entryCount; i++) {
+        if (entries[i].nameOffset > stringTableSize || entries[i].nameLength > stringTableSize - entries[i].nameOffset) {
+            close();
+            throw std::runtime_error("asset archive entry name is out of bounds!");
+        }
+    }
+}
+
+void AssetArchive::close() {
+    if (mappedData == nullptr) {
+        return;
+    }
+
+    decompressedEntries.clear();
+    file.close();
+
+    mappedData = nullptr;
+    mappedSize = 0;
+    header = nullptr;
+    entries = nullptr;
+    stringTable = nullptr;
+}
+
+std::optional<std::span<const char>> AssetArchive::find(std::string_view name) {
+    const ArchiveEntry* entry = findEntry(name);
+    if (entry == nullptr) {
+        return std::nullopt;
+    }
+
+    if (entry->dataOffset > mappedSize || entry->storedSize > mappedSize - entry->dataOffset) {
+        throw std::runtime_error("asset archive entry is out of bounds!");
+    }
+
+    std::span<const char> storedData(mappedData + entry->dataOffset, entry->storedSize);
+
+    if (!(entry->flags & archiveEntryCompressed)) {
+        return storedData;
+    }
+
+    // Every byte of an LZ4 block decompresses to at most 255 bytes, so the stored data, which lies within the mapped file,
+    // bounds the size. Checking it before allocating keeps a corrupt size from allocating more than the data can ever fill.
+    if (entry->size / 255 > entry->storedSize) {
+        throw std::runtime_error("asset archive entry is larger than its data can decompress to!");
+    }
+
+    std::lock_guard<std::mutex> lock(decompressedMutex);
+
+    auto it = decompressedEntries.find(entry);
+    if (it == decompressedEntries.end()) {
+        // new[] returns memory aligned for any fundamental type, which covers the 4 byte alignment SPIR-V needs.
+        std::unique_ptr<char[]> decompressed(new char[entry->size]);
+        if (!lz4DecompressBlock(storedData, std::span<char>(decompressed.get(), entry->size))) {
+            throw std::runtime_error("failed to decompress asset archive entry!");
+        }
+        it = decompressedEntries.emplace(entry, std::move(decompressed)).first;
+    }
+
+    return std::span<const char>(it->second.get(), entry->size);
+}
+
+std::span<const char> AssetArchive::get(std::string_view name) {
+    auto data = find(name);
+    if (!data.has_value()) {
+        throw std::runtime_error("asset not found in archive: " + std::string(name));
+    }
+    return data.value();
+}
+
+// Binary search over the sorted index. Hash collisions are resolved by comparing names, which are sorted within equal hashes.
+const ArchiveEntry* AssetArchive::findEntry(std::string_view name) const {
+    if (entries == nullptr) {
+        return nullptr;
+    }
+
+    uint64_t hash = hashAssetName(name);
+
+    uint32_t low = 0;
+    uint32_t high = header->entryCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        const ArchiveEntry& entry = entries[middle];
+
+        std::string_view entryName(stringTable + entry.nameOffset, entry.nameLength);
+        if (entry.nameHash < hash || (entry.nameHash == hash && entryName < name)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low < header->entryCount) {
+        const ArchiveEntry& entry = entries[low];
+        if (entry.nameHash == hash && std::string_view(stringTable + entry.nameOffset, entry.nameLength) == name) {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
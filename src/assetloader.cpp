@@ -0,0 +1,44 @@
+#include "assetloader.h"
+#include "filehelper.h"
+
+void AssetLoader::init(uint32_t ioThreadCount, AssetArchive* archive, const AssetUploadContext& uploadContext) {
+    ioPool = std::make_unique<ThreadPool>(ioThreadCount);
+    assetArchive = archive;
+    context = uploadContext;
+}
+
+void AssetLoader::shutdown() {
+    // Finishes every read and decode that is already queued.
+    ioPool.reset();
+
+    // Coroutines still waiting for the main thread must not upload into a device that is being torn down, but dropping their handles
+    // would leak their frames, and those of every coroutine awaiting them. They are resumed with an error instead, which unwinds them
+    // the same way a failed load does. Anything they await from now on throws right away, so nothing is queued again.
+    cancelled = true;
+    pump();
+}
+
+void AssetLoader::pump() {
+    // Swap the queue out before resuming anything, as resumed coroutines may queue themselves again.
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMutex);
+        std::swap(resumingHandles, mainThreadQueue);
+    }
+
+    for (auto handle : resumingHandles) {
+        handle.resume();
+    }
+
+    resumingHandles.clear();
+}
+
+std::span<const char> AssetLoader::readAsset(const std::string& path, std::vector<char>& storage) {
+    if (assetArchive != nullptr && assetArchive->isOpen()) {
+        if (auto data = assetArchive->find(path)) {
+            return data.value();
+        }
+    }
+
+    storage = readFile(path);
+    return storage;
+}
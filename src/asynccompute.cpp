@@ -0,0 +1,324 @@
+#include "asynccompute.h"
+
+#include <algorithm>
+#include <iostream>
+
+void AsyncCompute::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t computeFamily, VkQueue computeQueue,
+                        uint32_t graphicsFamily, const QueueTimeline* graphicsTimeline, HostAllocationTracker& hostAllocations) {
+    logicalDevice = device;
+    this->hostAllocations = &hostAllocations;
+    computeFamilyIndex = computeFamily;
+    graphicsFamilyIndex = graphicsFamily;
+    this->computeQueue = computeQueue;
+    this->graphicsTimeline = graphicsTimeline;
+
+    VkCommandPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = computeFamilyIndex;
+
+    if (vkCreateCommandPool(logicalDevice, &poolInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &commandPool) != VK_SUCCESS) {
+        std::cout << "Failed to create compute command pool." << std::endl;
+        std::terminate();
+    }
+
+    if (graphicsTimeline != nullptr) {
+        computeTimeline = createQueueTimeline(logicalDevice, hostAllocations.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+    }
+
+    VkSemaphoreCreateInfo semaphoreInfo {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (auto& computeSlot : slots) {
+        VkCommandBufferAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &computeSlot.commandBuffer) != VK_SUCCESS) {
+            std::cout << "Failed to allocate compute command buffer." << std::endl;
+            std::terminate();
+        }
+
+        // With timeline semaphores, the compute timeline replaces both the binary semaphore and the fence.
+        if (graphicsTimeline == nullptr &&
+            (vkCreateSemaphore(logicalDevice, &semaphoreInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &computeSlot.computeFinishedSemaphore) != VK_SUCCESS ||
+             vkCreateFence(logicalDevice, &fenceInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_FENCE), &computeSlot.fence) != VK_SUCCESS)) {
+            std::cout << "Failed to create compute synchronization objects." << std::endl;
+            std::terminate();
+        }
+    }
+
+    // Timestamps are only useful if both queue families support them.
+    // timestampValidBits tells how many bits of a timestamp are meaningful, and 0 means timestamps aren't supported at all.
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    uint32_t validBits = std::min(queueFamilies[computeFamilyIndex].timestampValidBits, queueFamilies[graphicsFamilyIndex].timestampValidBits);
+    if (validBits == 0) {
+        std::cout << "Timestamps are not supported, async compute overlap will not be measured." << std::endl;
+        return;
+    }
+
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    // timestampPeriod is the number of nanoseconds it takes for a timestamp to increase by 1.
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolInfo {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = timestampFrameCount * queriesPerFrame;
+
+    if (vkCreateQueryPool(logicalDevice, &queryPoolInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_QUERY_POOL), &timestampPool) != VK_SUCCESS) {
+        std::cout << "Failed to create timestamp query pool." << std::endl;
+        std::terminate();
+    }
+
+    VkCommandPoolCreateInfo graphicsPoolInfo {};
+    graphicsPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    graphicsPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    graphicsPoolInfo.queueFamilyIndex = graphicsFamilyIndex;
+
+    if (vkCreateCommandPool(logicalDevice, &graphicsPoolInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &graphicsCommandPool) != VK_SUCCESS) {
+        std::cout << "Failed to create graphics timestamp command pool." << std::endl;
+        std::terminate();
+    }
+
+    for (auto& buffers : graphicsTimestampBuffers) {
+        std::array<VkCommandBuffer, 2> commandBuffers {};
+
+        VkCommandBufferAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = graphicsCommandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+        if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+            std::cout << "Failed to allocate graphics timestamp command buffers." << std::endl;
+            std::terminate();
+        }
+        buffers = { commandBuffers[0], commandBuffers[1] };
+    }
+}
+
+void AsyncCompute::destroy() {
+    for (auto& computeSlot : slots) {
+        vkDestroySemaphore(logicalDevice, computeSlot.computeFinishedSemaphore, hostAllocations->callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+        vkDestroyFence(logicalDevice, computeSlot.fence, hostAllocations->callbacks(VK_OBJECT_TYPE_FENCE));
+    }
+
+    if (graphicsTimeline != nullptr) {
+        destroyQueueTimeline(logicalDevice, computeTimeline, hostAllocations->callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+    }
+
+    vkDestroyQueryPool(logicalDevice, timestampPool, hostAllocations->callbacks(VK_OBJECT_TYPE_QUERY_POOL));
+    vkDestroyCommandPool(logicalDevice, graphicsCommandPool, hostAllocations->callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+    vkDestroyCommandPool(logicalDevice, commandPool, hostAllocations->callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+}
+
+void AsyncCompute::addPass(std::string name, ComputePassRecorder recorder) {
+    passes.push_back({ std::move(name), std::move(recorder) });
+}
+
+void AsyncCompute::submit(uint64_t frameValue) {
+    currentFrameValue = frameValue;
+    slot = static_cast<uint32_t>(frameValue % slotCount);
+    graphicsWaitPending = false;
+
+    if (timestampPool != VK_NULL_HANDLE) {
+        readTimestamps(frameValue);
+    }
+
+    uint32_t timestampFrame = static_cast<uint32_t>(frameValue % timestampFrameCount);
+    timestampFrames[timestampFrame] = {};
+
+    if (passes.empty()) {
+        return;
+    }
+
+    Slot& computeSlot = slots[slot];
+    waitForSlot(computeSlot);
+
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkResetCommandBuffer(computeSlot.commandBuffer, 0);
+    if (vkBeginCommandBuffer(computeSlot.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        std::cout << "Failed to begin recording compute command buffer." << std::endl;
+        std::terminate();
+    }
+
+    uint32_t firstQuery = timestampFrame * queriesPerFrame;
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(computeSlot.commandBuffer, timestampPool, firstQuery, 2);
+        vkCmdWriteTimestamp(computeSlot.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, firstQuery);
+    }
+
+    for (const auto& pass : passes) {
+        pass.recorder(computeSlot.commandBuffer, slot);
+    }
+
+    if (timestampPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(computeSlot.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, firstQuery + 1);
+        timestampFrames[timestampFrame].computeWritten = true;
+    }
+
+    if (vkEndCommandBuffer(computeSlot.commandBuffer) != VK_SUCCESS) {
+        std::cout << "Failed to record compute command buffer." << std::endl;
+        std::terminate();
+    }
+
+    // The slot was last used by frame "frameValue - slotCount", and its outputs may only be overwritten once that frame's
+    // graphics work is done reading them. Without timeline semaphores, the CPU has already waited for that frame before we get here.
+    SubmitSemaphores submitSemaphores;
+    if (graphicsTimeline != nullptr) {
+        if (frameValue > slotCount) {
+            submitSemaphores.waitTimeline(*graphicsTimeline, frameValue - slotCount, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        }
+        submitSemaphores.signalTimeline(computeTimeline, frameValue);
+    } else {
+        submitSemaphores.signalBinary(computeSlot.computeFinishedSemaphore);
+        vkResetFences(logicalDevice, 1, &computeSlot.fence);
+    }
+
+    VkSubmitInfo submitInfo {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &computeSlot.commandBuffer;
+    submitSemaphores.apply(submitInfo);
+
+    if (vkQueueSubmit(computeQueue, 1, &submitInfo, computeSlot.fence) != VK_SUCCESS) {
+        std::cout << "Failed to submit compute command buffer." << std::endl;
+        std::terminate();
+    }
+
+    computeTimeline.lastSubmittedValue = frameValue;
+    computeSlot.frameValue = frameValue;
+    computeSlot.inFlight = true;
+    graphicsWaitPending = true;
+}
+
+void AsyncCompute::waitInGraphicsSubmit(SubmitSemaphores& submitSemaphores, VkPipelineStageFlags stage) {
+    if (!graphicsWaitPending) {
+        return;
+    }
+
+    // A binary semaphore must be waited on exactly once per signal, so the wait is only added once per frame.
+    if (graphicsTimeline != nullptr) {
+        submitSemaphores.waitTimeline(computeTimeline, currentFrameValue, stage);
+    } else {
+        submitSemaphores.waitBinary(slots[slot].computeFinishedSemaphore, stage);
+    }
+
+    graphicsWaitPending = false;
+}
+
+AsyncCompute::GraphicsTimestamps AsyncCompute::recordGraphicsTimestamps() {
+    if (timestampPool == VK_NULL_HANDLE) {
+        return {};
+    }
+
+    // The frame that last used these command buffers is "timestampFrameCount" frames old, and the CPU has waited for it since.
+    uint32_t timestampFrame = static_cast<uint32_t>(currentFrameValue % timestampFrameCount);
+    uint32_t firstQuery = timestampFrame * queriesPerFrame + 2;
+    const GraphicsTimestamps& buffers = graphicsTimestampBuffers[timestampFrame];
+
+    GraphicsTimestamps timestamps {};
+    timestamps.begin = recordTimestamp(buffers.begin, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, firstQuery, true);
+    timestamps.end = recordTimestamp(buffers.end, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, firstQuery + 1, false);
+    timestampFrames[timestampFrame].graphicsWritten = true;
+    return timestamps;
+}
+
+VkCommandBuffer AsyncCompute::recordTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t query, bool reset) {
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkResetCommandBuffer(commandBuffer, 0);
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        std::cout << "Failed to begin recording timestamp command buffer." << std::endl;
+        std::terminate();
+    }
+
+    // Both queries of the frame are reset by the command buffer that runs first.
+    if (reset) {
+        vkCmdResetQueryPool(commandBuffer, timestampPool, query, 2);
+    }
+    vkCmdWriteTimestamp(commandBuffer, stage, timestampPool, query);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        std::cout << "Failed to record timestamp command buffer." << std::endl;
+        std::terminate();
+    }
+    return commandBuffer;
+}
+
+void AsyncCompute::waitForSlot(Slot& computeSlot) {
+    if (!computeSlot.inFlight) {
+        return;
+    }
+
+    if (graphicsTimeline != nullptr) {
+        waitForTimelineValue(logicalDevice, computeTimeline, computeSlot.frameValue);
+    } else {
+        vkWaitForFences(logicalDevice, 1, &computeSlot.fence, VK_TRUE, UINT64_MAX);
+    }
+
+    computeSlot.inFlight = false;
+}
+
+void AsyncCompute::readTimestamps(uint64_t frameValue) {
+    // The compute work of frame N was submitted to overlap with the graphics work of frame N-1.
+    // By the time frame N+2 starts, the CPU has waited for frame N, and with it, for both of them.
+    if (frameValue < 3) {
+        return;
+    }
+
+    const TimestampFrame& computeFrame = timestampFrames[(frameValue - 2) % timestampFrameCount];
+    const TimestampFrame& graphicsFrame = timestampFrames[(frameValue - 3) % timestampFrameCount];
+    if (!computeFrame.computeWritten || !graphicsFrame.graphicsWritten) {
+        return;
+    }
+
+    uint32_t computeQuery = static_cast<uint32_t>((frameValue - 2) % timestampFrameCount) * queriesPerFrame;
+    uint32_t graphicsQuery = static_cast<uint32_t>((frameValue - 3) % timestampFrameCount) * queriesPerFrame + 2;
+
+    // Without VK_QUERY_RESULT_WAIT_BIT this never blocks, and returns VK_NOT_READY if a result isn't available yet.
+    std::array<uint64_t, 2> computeTimes {};
+    std::array<uint64_t, 2> graphicsTimes {};
+    if (vkGetQueryPoolResults(logicalDevice, timestampPool, computeQuery, 2, sizeof(computeTimes), computeTimes.data(),
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS ||
+        vkGetQueryPoolResults(logicalDevice, timestampPool, graphicsQuery, 2, sizeof(graphicsTimes), graphicsTimes.data(),
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+
+    for (auto& time : computeTimes) {
+        time &= timestampMask;
+    }
+    for (auto& time : graphicsTimes) {
+        time &= timestampMask;
+    }
+
+    const double millisecondsPerTick = timestampPeriod / 1000000.0;
+    uint64_t overlapBegin = std::max(computeTimes[0], graphicsTimes[0]);
+    uint64_t overlapEnd = std::min(computeTimes[1], graphicsTimes[1]);
+
+    computeStats.computeMilliseconds = (computeTimes[1] - computeTimes[0]) * millisecondsPerTick;
+    computeStats.graphicsMilliseconds = (graphicsTimes[1] - graphicsTimes[0]) * millisecondsPerTick;
+    computeStats.overlapMilliseconds = overlapEnd > overlapBegin ? (overlapEnd - overlapBegin) * millisecondsPerTick : 0.0;
+    computeStats.overlapRatio = computeStats.computeMilliseconds > 0.0
+        ? computeStats.overlapMilliseconds / computeStats.computeMilliseconds
+        : 0.0;
+}
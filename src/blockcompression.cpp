@@ -0,0 +1,646 @@
+#include "blockcompression.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    // Decoded blocks are 4x4 RGBA8 texels, row by row.
+    constexpr uint32_t blockTexelBytes = 4 * 4 * 4;
+
+    uint8_t clampToByte(int value) {
+        return static_cast<uint8_t>(std::clamp(value, 0, 255));
+    }
+
+    void setTexel(uint8_t* texels, uint32_t x, uint32_t y, int r, int g, int b, int a) {
+        uint8_t* texel = texels + (y * 4 + x) * 4;
+        texel[0] = clampToByte(r);
+        texel[1] = clampToByte(g);
+        texel[2] = clampToByte(b);
+        texel[3] = clampToByte(a);
+    }
+
+    // BC1 to BC3 ------------------------------------------------------------------------------------------------------------------
+
+    // Two RGB565 endpoints, and 2 bit indices that pick one of four colors between them.
+    // When the first endpoint is not greater than the second, the block only has three colors, and the fourth is black,
+    // which the RGBA variant makes transparent. BC3 always uses four colors.
+    void decodeBc1Block(const uint8_t* block, uint8_t* texels, bool alwaysFourColors, bool transparentBlack) {
+        uint32_t color0 = block[0] | (block[1] << 8);
+        uint32_t color1 = block[2] | (block[3] << 8);
+
+        int palette[4][4];
+        for (int i = 0; i < 2; i++) {
+            uint32_t color = i == 0 ? color0 : color1;
+            uint32_t r = (color >> 11) & 0x1F;
+            uint32_t g = (color >> 5) & 0x3F;
+            uint32_t b = color & 0x1F;
+            palette[i][0] = (r << 3) | (r >> 2);
+            palette[i][1] = (g << 2) | (g >> 4);
+            palette[i][2] = (b << 3) | (b >> 2);
+            palette[i][3] = 255;
+        }
+
+        for (int c = 0; c < 3; c++) {
+            if (alwaysFourColors || color0 > color1) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            } else {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        palette[2][3] = 255;
+        palette[3][3] = !alwaysFourColors && color0 <= color1 && transparentBlack ? 0 : 255;
+
+        uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+        for (uint32_t i = 0; i < 16; i++) {
+            const int* color = palette[(indices >> (2 * i)) & 3];
+            setTexel(texels, i % 4, i / 4, color[0], color[1], color[2], color[3]);
+        }
+    }
+
+    // Two 8 bit alpha endpoints, and 3 bit indices. Like BC1, the order of the endpoints selects between
+    // eight interpolated values, or six plus fully transparent and fully opaque.
+    void decodeBc3AlphaBlock(const uint8_t* block, uint8_t* texels) {
+        int alpha[8];
+        alpha[0] = block[0];
+        alpha[1] = block[1];
+        if (alpha[0] > alpha[1]) {
+            for (int i = 1; i < 7; i++) {
+                alpha[i + 1] = ((7 - i) * alpha[0] + i * alpha[1]) / 7;
+            }
+        } else {
+            for (int i = 1; i < 5; i++) {
+                alpha[i + 1] = ((5 - i) * alpha[0] + i * alpha[1]) / 5;
+            }
+            alpha[6] = 0;
+            alpha[7] = 255;
+        }
+
+        uint64_t indices = 0;
+        for (int i = 0; i < 6; i++) {
+            indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+        }
+        for (uint32_t i = 0; i < 16; i++) {
+            texels[i * 4 + 3] = static_cast<uint8_t>(alpha[(indices >> (3 * i)) & 7]);
+        }
+    }
+
+    // BC7 -------------------------------------------------------------------------------------------------------------------------
+
+    // BC7 has eight modes, which trade the number of subsets (each with its own pair of endpoints),
+    // endpoint precision, and index precision. The mode is stored in unary in the lowest bits of the block.
+    struct Bc7Mode {
+        uint8_t subsets;
+        uint8_t partitionBits;
+        uint8_t rotationBits;
+        uint8_t indexSelectionBits;
+        uint8_t colorBits;
+        uint8_t alphaBits;
+        // One extra low bit per endpoint, or one shared by both endpoints of a subset.
+        uint8_t endpointPBits;
+        uint8_t sharedPBits;
+        uint8_t indexBits;
+        // Modes 4 and 5 have a second set of indices, so color and alpha are interpolated separately.
+        uint8_t secondaryIndexBits;
+    };
+
+    constexpr Bc7Mode bc7Modes[8] = {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+    };
+
+    // Which texels belong to the second subset, one bit per texel, for each of the 64 two-subset partitions.
+    constexpr uint16_t bc7Partitions2[64] = {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+    };
+
+    // The subset of each texel, for each of the 64 three-subset partitions.
+    constexpr uint8_t bc7Partitions3[64][16] = {
+        { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 }, { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 }, { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+        { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 }, { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+        { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+        { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 }, { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+        { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 }, { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+        { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 }, { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 }, { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+        { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 }, { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+        { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 }, { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+        { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 }, { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+        { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 }, { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+        { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 }, { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 }, { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+        { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 }, { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+        { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 }, { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+        { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 }, { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 }, { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+        { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 }, { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+        { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 }, { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+        { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 }, { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+        { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 }, { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+        { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 }, { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+        { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+        { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 }, { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+        { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 }, { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+        { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 }, { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 },
+    };
+
+    // The index of the first texel of each subset (other than the first) is stored with one bit less,
+    // since the encoder orders the endpoints so that its top bit is 0.
+    constexpr uint8_t bc7Anchors2[64] = {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+    };
+
+    constexpr uint8_t bc7Anchors3Second[64] = {
+         3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+         3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+         8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+         3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+    };
+
+    constexpr uint8_t bc7Anchors3Third[64] = {
+        15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+        15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+        15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+        15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+    };
+
+    // Interpolation weights out of 64, for 2, 3 and 4 bit indices.
+    constexpr uint8_t bc7Weights2[4] = { 0, 21, 43, 64 };
+    constexpr uint8_t bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    constexpr uint8_t bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Reads the fields of a BC7 block, which are packed starting at its lowest bit.
+    class BitReader {
+    public:
+        explicit BitReader(const uint8_t* data) : bytes(data) {}
+
+        uint32_t read(uint32_t count) {
+            uint32_t value = 0;
+            for (uint32_t i = 0; i < count; i++, position++) {
+                value |= ((bytes[position >> 3] >> (position & 7)) & 1u) << i;
+            }
+            return value;
+        }
+
+    private:
+        const uint8_t* bytes;
+        uint32_t position = 0;
+    };
+
+    int bc7Interpolate(int endpoint0, int endpoint1, uint32_t index, uint32_t indexBits) {
+        const uint8_t* weights = indexBits == 2 ? bc7Weights2 : indexBits == 3 ? bc7Weights3 : bc7Weights4;
+        return ((64 - weights[index]) * endpoint0 + weights[index] * endpoint1 + 32) >> 6;
+    }
+
+    void decodeBc7Block(const uint8_t* block, uint8_t* texels) {
+        BitReader bits(block);
+
+        uint32_t modeIndex = 0;
+        while (modeIndex < 8 && bits.read(1) == 0) {
+            modeIndex++;
+        }
+        // There's no ninth mode. Such blocks are reserved, and decode to transparent black.
+        if (modeIndex == 8) {
+            std::memset(texels, 0, blockTexelBytes);
+            return;
+        }
+
+        const Bc7Mode& mode = bc7Modes[modeIndex];
+        uint32_t partition = bits.read(mode.partitionBits);
+        uint32_t rotation = bits.read(mode.rotationBits);
+        uint32_t indexSelection = bits.read(mode.indexSelectionBits);
+
+        // Endpoints are stored channel by channel: all reds, then all greens, and so on.
+        const uint32_t endpointCount = mode.subsets * 2u;
+        int endpoints[6][4] = {};
+        for (uint32_t c = 0; c < 3; c++) {
+            for (uint32_t e = 0; e < endpointCount; e++) {
+                endpoints[e][c] = bits.read(mode.colorBits);
+            }
+        }
+        for (uint32_t e = 0; e < endpointCount && mode.alphaBits > 0; e++) {
+            endpoints[e][3] = bits.read(mode.alphaBits);
+        }
+
+        uint32_t pBits[6] = {};
+        if (mode.endpointPBits) {
+            for (uint32_t e = 0; e < endpointCount; e++) {
+                pBits[e] = bits.read(1);
+            }
+        }
+        if (mode.sharedPBits) {
+            for (uint32_t s = 0; s < mode.subsets; s++) {
+                pBits[s * 2] = pBits[s * 2 + 1] = bits.read(1);
+            }
+        }
+
+        // Append the p-bit below each channel, and expand to 8 bits by repeating the top bits below the bottom ones.
+        const bool hasPBits = mode.endpointPBits || mode.sharedPBits;
+        for (uint32_t e = 0; e < endpointCount; e++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t channelBits = c < 3 ? mode.colorBits : mode.alphaBits;
+                if (channelBits == 0) {
+                    endpoints[e][c] = 255;
+                    continue;
+                }
+                int value = endpoints[e][c];
+                if (hasPBits) {
+                    value = (value << 1) | pBits[e];
+                    channelBits++;
+                }
+                value <<= 8 - channelBits;
+                endpoints[e][c] = value | (value >> channelBits);
+            }
+        }
+
+        uint32_t subsetOf[16] = {};
+        for (uint32_t i = 0; i < 16; i++) {
+            if (mode.subsets == 2) {
+                subsetOf[i] = (bc7Partitions2[partition] >> i) & 1;
+            } else if (mode.subsets == 3) {
+                subsetOf[i] = bc7Partitions3[partition][i];
+            }
+        }
+
+        auto isAnchor = [&](uint32_t texel) {
+            if (texel == 0) {
+                return true;
+            }
+            if (mode.subsets == 2) {
+                return texel == bc7Anchors2[partition];
+            }
+            if (mode.subsets == 3) {
+                return texel == bc7Anchors3Second[partition] || texel == bc7Anchors3Third[partition];
+            }
+            return false;
+        };
+
+        uint32_t primaryIndices[16];
+        for (uint32_t i = 0; i < 16; i++) {
+            primaryIndices[i] = bits.read(mode.indexBits - (isAnchor(i) ? 1 : 0));
+        }
+        uint32_t secondaryIndices[16] = {};
+        if (mode.secondaryIndexBits > 0) {
+            for (uint32_t i = 0; i < 16; i++) {
+                secondaryIndices[i] = bits.read(mode.secondaryIndexBits - (i == 0 ? 1 : 0));
+            }
+        }
+
+        for (uint32_t i = 0; i < 16; i++) {
+            const int* endpoint0 = endpoints[subsetOf[i] * 2];
+            const int* endpoint1 = endpoints[subsetOf[i] * 2 + 1];
+
+            // With two sets of indices, the index selection bit picks which one interpolates color, and which one alpha.
+            uint32_t colorIndex = primaryIndices[i];
+            uint32_t colorIndexBits = mode.indexBits;
+            uint32_t alphaIndex = primaryIndices[i];
+            uint32_t alphaIndexBits = mode.indexBits;
+            if (mode.secondaryIndexBits > 0) {
+                if (indexSelection) {
+                    colorIndex = secondaryIndices[i];
+                    colorIndexBits = mode.secondaryIndexBits;
+                } else {
+                    alphaIndex = secondaryIndices[i];
+                    alphaIndexBits = mode.secondaryIndexBits;
+                }
+            }
+
+            int color[4];
+            for (uint32_t c = 0; c < 3; c++) {
+                color[c] = bc7Interpolate(endpoint0[c], endpoint1[c], colorIndex, colorIndexBits);
+            }
+            color[3] = bc7Interpolate(endpoint0[3], endpoint1[3], alphaIndex, alphaIndexBits);
+
+            // Rotation swaps alpha with one of the color channels, so that channel gets the separate, more precise index.
+            if (rotation > 0) {
+                std::swap(color[3], color[rotation - 1]);
+            }
+
+            setTexel(texels, i % 4, i / 4, color[0], color[1], color[2], color[3]);
+        }
+    }
+
+    // ETC2 ------------------------------------------------------------------------------------------------------------------------
+
+    // Each half of an ETC block has a base color and one of eight tables of intensity modifiers, which the 2 bit texel indices pick from.
+    constexpr int etcModifiers[8][4] = {
+        { 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+        { 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 },
+    };
+
+    // The distance between paint colors in the T and H modes.
+    constexpr int etcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+    // EAC alpha modifiers, scaled by the multiplier of the block.
+    constexpr int eacModifiers[16][8] = {
+        { -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 }, { -2, -5, -8, -13, 1, 4, 7, 12 },
+        { -2, -4, -6, -13, 1, 3, 5, 12 }, { -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+        { -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 }, { -2, -6, -8, -10, 1, 5, 7, 9 },
+        { -2, -5, -8, -10, 1, 4, 7, 9 }, { -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+        { -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 }, { -4, -6, -8, -9, 3, 5, 7, 8 },
+        { -3, -5, -7, -9, 2, 4, 6, 8 },
+    };
+
+    int extend4(int value) {
+        return value * 17;
+    }
+
+    int extend5(int value) {
+        return (value << 3) | (value >> 2);
+    }
+
+    int extend6(int value) {
+        return (value << 2) | (value >> 4);
+    }
+
+    int extend7(int value) {
+        return (value << 1) | (value >> 6);
+    }
+
+    int signExtend3(int value) {
+        return value >= 4 ? value - 8 : value;
+    }
+
+    // ETC blocks are big-endian, and number their texels column by column. Texel (x, y) has its index split
+    // over bit x * 4 + y of the low 16 bits, and the same bit of the next 16 bits for the high half of the index.
+    uint32_t etcTexelIndex(uint32_t indexBits, uint32_t x, uint32_t y) {
+        uint32_t bit = x * 4 + y;
+        return (((indexBits >> (bit + 16)) & 1) << 1) | ((indexBits >> bit) & 1);
+    }
+
+    // Decodes the RGB part of an ETC2 block, which is a superset of ETC1. ETC1 has two modes, with each half of the block
+    // getting a 4 bit color, or a 5 bit color and the other one as a 3 bit difference to it. ETC2 adds three modes for
+    // blocks that don't suit that, signaled by differences that overflow the 5 bit range, which ETC1 encoders never produce.
+    //
+    // With punch-through alpha, the bit that selected the first mode marks the block as opaque instead. Non-opaque blocks
+    // use index 2 for transparent black.
+    void decodeEtc2Block(const uint8_t* block, uint8_t* texels, bool punchThroughAlpha) {
+        const bool differential = (block[3] & 2) != 0;
+        const bool transparentIndex = punchThroughAlpha && !differential;
+        const uint32_t indexBits = (block[4] << 24) | (block[5] << 16) | (block[6] << 8) | block[7];
+
+        int r = block[0] >> 3;
+        int g = block[1] >> 3;
+        int b = block[2] >> 3;
+        int r2 = r + signExtend3(block[0] & 7);
+        int g2 = g + signExtend3(block[1] & 7);
+        int b2 = b + signExtend3(block[2] & 7);
+
+        if ((differential || punchThroughAlpha) && (r2 < 0 || r2 > 31)) {
+            // T mode: one color, and three colors spread around a second one.
+            int color1[3] = {
+                extend4(((block[0] >> 1) & 0xC) | (block[0] & 3)), extend4(block[1] >> 4), extend4(block[1] & 0xF) };
+            int color2[3] = { extend4(block[2] >> 4), extend4(block[2] & 0xF), extend4(block[3] >> 4) };
+            int distance = etcDistances[((block[3] >> 1) & 6) | (block[3] & 1)];
+
+            int paint[4][3];
+            for (int c = 0; c < 3; c++) {
+                paint[0][c] = color1[c];
+                paint[1][c] = color2[c] + distance;
+                paint[2][c] = color2[c];
+                paint[3][c] = color2[c] - distance;
+            }
+
+            for (uint32_t x = 0; x < 4; x++) {
+                for (uint32_t y = 0; y < 4; y++) {
+                    uint32_t index = etcTexelIndex(indexBits, x, y);
+                    if (transparentIndex && index == 2) {
+                        setTexel(texels, x, y, 0, 0, 0, 0);
+                    } else {
+                        setTexel(texels, x, y, paint[index][0], paint[index][1], paint[index][2], 255);
+                    }
+                }
+            }
+            return;
+        }
+
+        if ((differential || punchThroughAlpha) && (g2 < 0 || g2 > 31)) {
+            // H mode: two pairs of colors, each spread around a base color.
+            int base1 = (block[0] >> 3) & 0xF;
+            int base1Green = ((block[0] & 7) << 1) | ((block[1] >> 4) & 1);
+            int base1Blue = (block[1] & 8) | ((block[1] & 3) << 1) | (block[2] >> 7);
+            int base2 = (block[2] >> 3) & 0xF;
+            int base2Green = ((block[2] & 7) << 1) | (block[3] >> 7);
+            int base2Blue = (block[3] >> 3) & 0xF;
+
+            // The lowest bit of the distance is implied by the order of the two base colors.
+            int order = ((base1 << 8) | (base1Green << 4) | base1Blue) >= ((base2 << 8) | (base2Green << 4) | base2Blue) ? 1 : 0;
+            int distance = etcDistances[(block[3] & 4) | ((block[3] & 1) << 1) | order];
+
+            int color1[3] = { extend4(base1), extend4(base1Green), extend4(base1Blue) };
+            int color2[3] = { extend4(base2), extend4(base2Green), extend4(base2Blue) };
+            int paint[4][3];
+            for (int c = 0; c < 3; c++) {
+                paint[0][c] = color1[c] + distance;
+                paint[1][c] = color1[c] - distance;
+                paint[2][c] = color2[c] + distance;
+                paint[3][c] = color2[c] - distance;
+            }
+
+            for (uint32_t x = 0; x < 4; x++) {
+                for (uint32_t y = 0; y < 4; y++) {
+                    uint32_t index = etcTexelIndex(indexBits, x, y);
+                    if (transparentIndex && index == 2) {
+                        setTexel(texels, x, y, 0, 0, 0, 0);
+                    } else {
+                        setTexel(texels, x, y, paint[index][0], paint[index][1], paint[index][2], 255);
+                    }
+                }
+            }
+            return;
+        }
+
+        if ((differential || punchThroughAlpha) && (b2 < 0 || b2 > 31)) {
+            // Planar mode: a smooth gradient, given by the colors at the origin, and one texel past the right and bottom edges.
+            int origin[3] = {
+                extend6((block[0] >> 1) & 0x3F),
+                extend7(((block[0] & 1) << 6) | ((block[1] >> 1) & 0x3F)),
+                extend6(((block[1] & 1) << 5) | (block[2] & 0x18) | ((block[2] & 3) << 1) | (block[3] >> 7)) };
+            int horizontal[3] = {
+                extend6((((block[3] >> 2) & 0x1F) << 1) | (block[3] & 1)),
+                extend7(block[4] >> 1),
+                extend6(((block[4] & 1) << 5) | (block[5] >> 3)) };
+            int vertical[3] = {
+                extend6(((block[5] & 7) << 3) | (block[6] >> 5)),
+                extend7(((block[6] & 0x1F) << 2) | (block[7] >> 6)),
+                extend6(block[7] & 0x3F) };
+
+            for (uint32_t x = 0; x < 4; x++) {
+                for (uint32_t y = 0; y < 4; y++) {
+                    int color[3];
+                    for (int c = 0; c < 3; c++) {
+                        color[c] = (static_cast<int>(x) * (horizontal[c] - origin[c]) + static_cast<int>(y) * (vertical[c] - origin[c])
+                                    + 4 * origin[c] + 2) >> 2;
+                    }
+                    setTexel(texels, x, y, color[0], color[1], color[2], 255);
+                }
+            }
+            return;
+        }
+
+        int baseColors[2][3];
+        if (differential || punchThroughAlpha) {
+            baseColors[0][0] = extend5(r);
+            baseColors[0][1] = extend5(g);
+            baseColors[0][2] = extend5(b);
+            baseColors[1][0] = extend5(r2);
+            baseColors[1][1] = extend5(g2);
+            baseColors[1][2] = extend5(b2);
+        } else {
+            baseColors[0][0] = extend4(block[0] >> 4);
+            baseColors[0][1] = extend4(block[1] >> 4);
+            baseColors[0][2] = extend4(block[2] >> 4);
+            baseColors[1][0] = extend4(block[0] & 0xF);
+            baseColors[1][1] = extend4(block[1] & 0xF);
+            baseColors[1][2] = extend4(block[2] & 0xF);
+        }
+
+        const uint32_t tables[2] = { static_cast<uint32_t>(block[3] >> 5), static_cast<uint32_t>((block[3] >> 2) & 7) };
+        // The halves are side by side, or on top of each other when the flip bit is set.
+        const bool flipped = (block[3] & 1) != 0;
+
+        for (uint32_t x = 0; x < 4; x++) {
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t half = flipped ? y / 2 : x / 2;
+                uint32_t index = etcTexelIndex(indexBits, x, y);
+                if (transparentIndex && index == 2) {
+                    setTexel(texels, x, y, 0, 0, 0, 0);
+                    continue;
+                }
+
+                // Non-opaque punch-through blocks trade the small modifiers for transparency, leaving 0 in their place.
+                int modifier = transparentIndex && (index & 1) == 0 ? 0 : etcModifiers[tables[half]][index];
+                const int* base = baseColors[half];
+                setTexel(texels, x, y, base[0] + modifier, base[1] + modifier, base[2] + modifier, 255);
+            }
+        }
+    }
+
+    // An 8 bit base alpha, a multiplier and a table of modifiers, and a 3 bit index per texel, column by column from the top bits.
+    void decodeEacAlphaBlock(const uint8_t* block, uint8_t* texels) {
+        int base = block[0];
+        int multiplier = block[1] >> 4;
+        const int* modifiers = eacModifiers[block[1] & 0xF];
+
+        uint64_t indices = 0;
+        for (int i = 2; i < 8; i++) {
+            indices = (indices << 8) | block[i];
+        }
+
+        for (uint32_t i = 0; i < 16; i++) {
+            uint32_t index = (indices >> (45 - 3 * i)) & 7;
+            uint32_t x = i / 4;
+            uint32_t y = i % 4;
+            texels[(y * 4 + x) * 4 + 3] = clampToByte(base + modifiers[index] * multiplier);
+        }
+    }
+
+    bool decodeBlock(VkFormat format, const uint8_t* block, uint8_t* texels) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                decodeBc1Block(block, texels, false, false);
+                return true;
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                decodeBc1Block(block, texels, false, true);
+                return true;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+                decodeBc1Block(block + 8, texels, true, false);
+                decodeBc3AlphaBlock(block, texels);
+                return true;
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                decodeBc7Block(block, texels);
+                return true;
+            case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+                decodeEtc2Block(block, texels, false);
+                return true;
+            case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+                decodeEtc2Block(block, texels, true);
+                return true;
+            case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+                decodeEtc2Block(block + 8, texels, false);
+                decodeEacAlphaBlock(block, texels);
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+uint32_t compressedBlockSize(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+            return 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+        case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+bool decodeCompressedImage(VkFormat format, std::span<const uint8_t> blocks, uint32_t width, uint32_t height, std::span<uint8_t> rgba) {
+    const uint32_t blockSize = compressedBlockSize(format);
+    const uint32_t blocksWide = (width + 3) / 4;
+    const uint32_t blocksHigh = (height + 3) / 4;
+    if (blockSize == 0 || blocks.size() < static_cast<size_t>(blocksWide) * blocksHigh * blockSize ||
+        rgba.size() < static_cast<size_t>(width) * height * 4) {
+        return false;
+    }
+
+    uint8_t texels[blockTexelBytes];
+    for (uint32_t blockY = 0; blockY < blocksHigh; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+            decodeBlock(format, blocks.data() + (static_cast<size_t>(blockY) * blocksWide + blockX) * blockSize, texels);
+
+            // Blocks on the right and bottom edges may stick out of images whose size isn't a multiple of 4.
+            uint32_t columns = std::min(4u, width - blockX * 4);
+            uint32_t rows = std::min(4u, height - blockY * 4);
+            for (uint32_t y = 0; y < rows; y++) {
+                uint8_t* destination = rgba.data() + ((static_cast<size_t>(blockY) * 4 + y) * width + blockX * 4) * 4;
+                std::memcpy(destination, texels + y * 16, columns * 4);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,270 @@
+#include "broadphase.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+
+Broadphase::Broadphase(BroadphaseMode mode) : mode(mode) {
+}
+
+BodyId Broadphase::addBody(const Aabb& box, BodyType type) {
+    BodyId id;
+    if (!freeBodies.empty()) {
+        id = freeBodies.back();
+        freeBodies.pop_back();
+    } else {
+        id = static_cast<BodyId>(bodies.size());
+        bodies.emplace_back();
+    }
+
+    Body& body = bodies[id];
+    body = Body {};
+    body.box = box;
+    body.type = type;
+    body.alive = true;
+
+    if (type == BodyType::Dynamic) {
+        body.dynamicIndex = static_cast<uint32_t>(dynamicBodies.size());
+        dynamicBodies.push_back(id);
+    }
+
+    // New bodies are appended to the end of the sweep list, and moved to their place by the next sort.
+    if (mode == BroadphaseMode::SweepAndPrune) {
+        sweepList.push_back({ box, id, type == BodyType::Static });
+        addedSinceSort++;
+    } else {
+        body.treeProxy = tree.createProxy(box, type == BodyType::Static ? 0.0f : treeMargin, id);
+    }
+
+    bodyCount++;
+    changed = true;
+    return id;
+}
+
+void Broadphase::removeBody(BodyId id) {
+    Body& body = bodies[id];
+
+    if (body.type == BodyType::Dynamic) {
+        // Swap with the last dynamic body, so the list stays dense.
+        BodyId last = dynamicBodies.back();
+        dynamicBodies[body.dynamicIndex] = last;
+        bodies[last].dynamicIndex = body.dynamicIndex;
+        dynamicBodies.pop_back();
+    }
+
+    if (body.treeProxy != AabbTree::nullNode) {
+        tree.destroyProxy(body.treeProxy);
+    }
+
+    body = Body {};
+
+    // Dead entries are dropped from the sweep list by the next sort, which walks the whole list anyway.
+    // Until then, the id can't be reused, or the dead entry would come back to life with the new body.
+    if (mode == BroadphaseMode::SweepAndPrune) {
+        sweepListHasRemovedBodies = true;
+        removedBodies.push_back(id);
+    } else {
+        freeBodies.push_back(id);
+    }
+    bodyCount--;
+    changed = true;
+}
+
+void Broadphase::updateBody(BodyId id, const Aabb& box) {
+    Body& body = bodies[id];
+    body.box = box;
+
+    if (body.treeProxy != AabbTree::nullNode && tree.moveProxy(body.treeProxy, box, treeMargin)) {
+        treeReinserts++;
+    }
+
+    changed = true;
+}
+
+void Broadphase::setMode(BroadphaseMode newMode) {
+    if (newMode == mode) {
+        return;
+    }
+
+    mode = newMode;
+    rebuildStructures();
+}
+
+void Broadphase::rebuildStructures() {
+    sweepList.clear();
+    sweepListHasRemovedBodies = false;
+    freeBodies.insert(freeBodies.end(), removedBodies.begin(), removedBodies.end());
+    removedBodies.clear();
+    tree.clear();
+
+    for (BodyId id = 0; id < bodies.size(); id++) {
+        Body& body = bodies[id];
+        body.treeProxy = AabbTree::nullNode;
+        if (!body.alive) {
+            continue;
+        }
+
+        if (mode == BroadphaseMode::SweepAndPrune) {
+            sweepList.push_back({ body.box, id, body.type == BodyType::Static });
+            addedSinceSort++;
+        } else {
+            body.treeProxy = tree.createProxy(body.box, body.type == BodyType::Static ? 0.0f : treeMargin, id);
+        }
+    }
+
+    changed = true;
+}
+
+bool Broadphase::findPairs(ThreadPool* pool) {
+    if (!changed) {
+        return false;
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    lastStats = {};
+    lastStats.bodyCount = bodyCount;
+    lastStats.treeReinserts = treeReinserts;
+    treeReinserts = 0;
+
+    // Only dynamic bodies query the tree, so that's what the work is split by in tree mode.
+    uint32_t workCount;
+    if (mode == BroadphaseMode::SweepAndPrune) {
+        sortSweepList();
+        workCount = static_cast<uint32_t>(sweepList.size());
+    } else {
+        workCount = static_cast<uint32_t>(dynamicBodies.size());
+    }
+
+    uint32_t chunkCount = 1;
+    if (pool != nullptr && workCount >= parallelBodyCount) {
+        chunkCount = (pool->threadCount() + 1) * chunksPerThread;
+    }
+    if (chunkPairs.size() < chunkCount) {
+        chunkPairs.resize(chunkCount);
+    }
+
+    uint32_t chunkSize = (workCount + chunkCount - 1) / chunkCount;
+    auto runChunks = [&](uint32_t firstChunk, uint32_t lastChunk) {
+        for (uint32_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+            uint32_t begin = std::min(chunk * chunkSize, workCount);
+            uint32_t end = std::min(begin + chunkSize, workCount);
+
+            std::vector<BodyPair>& output = chunkPairs[chunk];
+            output.clear();
+
+            if (mode == BroadphaseMode::SweepAndPrune) {
+                sweepRange(begin, end, output);
+            } else {
+                queryTreeRange(begin, end, output);
+            }
+        }
+    };
+
+    if (chunkCount > 1) {
+        pool->parallelFor(chunkCount, 1, runChunks);
+    } else {
+        runChunks(0, 1);
+    }
+
+    pairList.clear();
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+        pairList.insert(pairList.end(), chunkPairs[chunk].begin(), chunkPairs[chunk].end());
+    }
+
+    changed = false;
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    lastStats.pairCount = static_cast<uint32_t>(pairList.size());
+    lastStats.milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    return true;
+}
+
+void Broadphase::sortSweepList() {
+    if (sweepListHasRemovedBodies) {
+        std::erase_if(sweepList, [&](const SweepEntry& entry) {
+            return !bodies[entry.body].alive;
+        });
+        sweepListHasRemovedBodies = false;
+
+        freeBodies.insert(freeBodies.end(), removedBodies.begin(), removedBodies.end());
+        removedBodies.clear();
+    }
+
+    // Pick up the boxes of bodies that moved. Bodies are visited in roughly the same order every frame, so this stays cache friendly.
+    for (SweepEntry& entry : sweepList) {
+        entry.box = bodies[entry.body].box;
+    }
+
+    auto leftEdgeLess = [](const SweepEntry& a, const SweepEntry& b) {
+        return a.box.min[0] < b.box.min[0];
+    };
+
+    // Bodies added since the last sort can be anywhere, and moving each of them into place costs up to the whole list.
+    // When a lot of them were added at once, like when a level is loaded, sorting from scratch is faster.
+    bool manyAdded = addedSinceSort > 64 && addedSinceSort > sweepList.size() / 16;
+    addedSinceSort = 0;
+    if (manyAdded) {
+        std::sort(sweepList.begin(), sweepList.end(), leftEdgeLess);
+        lastStats.sortSwaps = 0;
+        return;
+    }
+
+    // Insertion sort by the left edge. Elements only move as far as they're out of place, which is not far between two frames.
+    uint64_t swaps = 0;
+    for (size_t i = 1; i < sweepList.size(); i++) {
+        SweepEntry entry = sweepList[i];
+        size_t j = i;
+        while (j > 0 && leftEdgeLess(entry, sweepList[j - 1])) {
+            sweepList[j] = sweepList[j - 1];
+            j--;
+        }
+        sweepList[j] = entry;
+        swaps += i - j;
+    }
+
+    lastStats.sortSwaps = swaps;
+}
+
+void Broadphase::sweepRange(uint32_t begin, uint32_t end, std::vector<BodyPair>& output) const {
+    size_t count = sweepList.size();
+
+    // Every entry is tested against the entries to its right, until one starts past its right edge.
+    // Everything after that starts even further right, since the list is sorted, so it can't overlap either.
+    for (uint32_t i = begin; i < end; i++) {
+        const SweepEntry& entry = sweepList[i];
+
+        for (size_t j = i + 1; j < count && sweepList[j].box.min[0] <= entry.box.max[0]; j++) {
+            const SweepEntry& other = sweepList[j];
+            if (entry.isStatic && other.isStatic) {
+                continue;
+            }
+
+            // The X axis overlaps already, so only Y is left to test.
+            if (entry.box.min[1] <= other.box.max[1] && other.box.min[1] <= entry.box.max[1]) {
+                output.push_back({ std::min(entry.body, other.body), std::max(entry.body, other.body) });
+            }
+        }
+    }
+}
+
+void Broadphase::queryTreeRange(uint32_t begin, uint32_t end, std::vector<BodyPair>& output) const {
+    for (uint32_t i = begin; i < end; i++) {
+        BodyId id = dynamicBodies[i];
+        const Aabb& box = bodies[id].box;
+
+        tree.query(box, [&](uint32_t otherId) {
+            const Body& other = bodies[otherId];
+
+            // Two dynamic bodies find each other, so only the one with the smaller id reports the pair.
+            if (otherId == id || (other.type == BodyType::Dynamic && otherId < id)) {
+                return;
+            }
+
+            // The tree only knows the fat boxes.
+            if (box.overlaps(other.box)) {
+                output.push_back({ std::min(id, otherId), std::max(id, otherId) });
+            }
+        });
+    }
+}
@@ -0,0 +1,124 @@
+#include "deletionqueue.h"
+
+// Non-dispatchable handles (everything except instances, devices, queues and command buffers) are 64 bit values.
+// On 64 bit platforms they are defined as pointers, and on 32 bit platforms as uint64_t, so we use C-style casts to convert
+// between a handle and its value in a way that compiles on both.
+
+void DeletionQueue::init(VkDevice device) {
+    logicalDevice = device;
+}
+
+void DeletionQueue::retire(VkBuffer buffer, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_BUFFER, (uint64_t) buffer, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkImage image, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_IMAGE, (uint64_t) image, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkImageView imageView, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_IMAGE_VIEW, (uint64_t) imageView, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkSampler sampler, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_SAMPLER, (uint64_t) sampler, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkDeviceMemory memory, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t) memory, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkPipeline pipeline, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_PIPELINE, (uint64_t) pipeline, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkPipelineLayout pipelineLayout, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t) pipelineLayout, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkFramebuffer framebuffer, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_FRAMEBUFFER, (uint64_t) framebuffer, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkRenderPass renderPass, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_RENDER_PASS, (uint64_t) renderPass, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkDescriptorPool descriptorPool, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_DESCRIPTOR_POOL, (uint64_t) descriptorPool, lastUsedValue);
+}
+
+void DeletionQueue::retire(VkShaderModule shaderModule, uint64_t lastUsedValue) {
+    push(VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t) shaderModule, lastUsedValue);
+}
+
+void DeletionQueue::collect(uint64_t completedValue) {
+    // Objects are destroyed in the order they were retired, so an image view retired before its image is also destroyed before it.
+    size_t kept = 0;
+    for (size_t i = 0; i < pending.size(); i++) {
+        if (pending[i].lastUsedValue <= completedValue) {
+            destroy(pending[i]);
+        } else {
+            pending[kept++] = pending[i];
+        }
+    }
+
+    pending.resize(kept);
+}
+
+void DeletionQueue::flush() {
+    for (const auto& destruction : pending) {
+        destroy(destruction);
+    }
+
+    pending.clear();
+}
+
+void DeletionQueue::push(VkObjectType type, uint64_t handle, uint64_t lastUsedValue) {
+    // Destroying a VK_NULL_HANDLE is a no-op in Vulkan anyway, so there's no reason to keep track of it.
+    if (handle == 0) {
+        return;
+    }
+
+    pending.push_back({ type, handle, lastUsedValue });
+}
+
+void DeletionQueue::destroy(const PendingDestruction& destruction) {
+    switch (destruction.type) {
+        case VK_OBJECT_TYPE_BUFFER:
+            vkDestroyBuffer(logicalDevice, (VkBuffer) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_IMAGE:
+            vkDestroyImage(logicalDevice, (VkImage) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_IMAGE_VIEW:
+            vkDestroyImageView(logicalDevice, (VkImageView) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_SAMPLER:
+            vkDestroySampler(logicalDevice, (VkSampler) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_DEVICE_MEMORY:
+            vkFreeMemory(logicalDevice, (VkDeviceMemory) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_PIPELINE:
+            vkDestroyPipeline(logicalDevice, (VkPipeline) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+            vkDestroyPipelineLayout(logicalDevice, (VkPipelineLayout) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_FRAMEBUFFER:
+            vkDestroyFramebuffer(logicalDevice, (VkFramebuffer) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_RENDER_PASS:
+            vkDestroyRenderPass(logicalDevice, (VkRenderPass) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+            vkDestroyDescriptorPool(logicalDevice, (VkDescriptorPool) destruction.handle, nullptr);
+            break;
+        case VK_OBJECT_TYPE_SHADER_MODULE:
+            vkDestroyShaderModule(logicalDevice, (VkShaderModule) destruction.handle, nullptr);
+            break;
+        default:
+            break;
+    }
+}
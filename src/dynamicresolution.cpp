@@ -0,0 +1,364 @@
+#include "dynamicresolution.h"
+#include "vulkanhelper.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+void DynamicResolution::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t graphicsFamily, VkExtent2D outputExtent, VkFormat sceneFormat,
+                             uint32_t frameSlotCount, const DynamicResolutionSettings& settings, HostAllocationTracker& hostAllocations) {
+    this->physicalDevice = physicalDevice;
+    logicalDevice = device;
+    this->hostAllocations = &hostAllocations;
+    this->settings = settings;
+    this->outputExtent = outputExtent;
+
+    // The scene image is allocated once at the largest size we may render at. Lowering the scale only shrinks the render area,
+    // so no images or framebuffers have to be created again when it changes.
+    sceneExtent = extentForScale(settings.maxScale);
+    currentScale = settings.maxScale;
+    currentExtent = sceneExtent;
+
+    createImage(physicalDevice, logicalDevice, sceneExtent.width, sceneExtent.height, 1, sceneFormat,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scene.image, scene.memory);
+    scene.imageView = createImageView(logicalDevice, scene.image, sceneFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+    // Linear filtering is what makes this an upscale rather than a blocky pixel enlargement.
+    // The scene image is rendered to and has a single level, so there are no mips to sample.
+    VkSamplerCreateInfo samplerInfo {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = 0.0f;
+
+    if (vkCreateSampler(logicalDevice, &samplerInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_SAMPLER), &sampler) != VK_SUCCESS) {
+        std::cout << "Failed to create upscale sampler." << std::endl;
+        std::terminate();
+    }
+
+    VkDescriptorSetLayoutBinding sceneBinding {};
+    sceneBinding.binding = 0;
+    sceneBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    sceneBinding.descriptorCount = 1;
+    sceneBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &sceneBinding;
+
+    if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &descriptorSetLayout) != VK_SUCCESS) {
+        std::cout << "Failed to create upscale descriptor set layout." << std::endl;
+        std::terminate();
+    }
+
+    VkDescriptorPoolSize poolSize {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    if (vkCreateDescriptorPool(logicalDevice, &poolInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &descriptorPool) != VK_SUCCESS) {
+        std::cout << "Failed to create upscale descriptor pool." << std::endl;
+        std::terminate();
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        std::cout << "Failed to allocate upscale descriptor set." << std::endl;
+        std::terminate();
+    }
+    countDescriptorAllocations(1);
+
+    VkDescriptorImageInfo imageInfo {};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = scene.imageView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+
+    // timestampValidBits tells how many bits of a timestamp are meaningful, and 0 means the queue doesn't support timestamps.
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    uint32_t validBits = queueFamilies[graphicsFamily].timestampValidBits;
+    if (validBits == 0) {
+        std::cout << "Timestamps are not supported, the scene will be rendered at a fixed resolution." << std::endl;
+        return;
+    }
+
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    // timestampPeriod is the number of nanoseconds it takes for a timestamp to increase by 1.
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    timestampPeriod = properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolInfo {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = frameSlotCount * 2;
+
+    if (vkCreateQueryPool(logicalDevice, &queryPoolInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_QUERY_POOL), &timestampPool) != VK_SUCCESS) {
+        std::cout << "Failed to create frame timestamp query pool." << std::endl;
+        std::terminate();
+    }
+
+    timestampsSupported = true;
+}
+
+void DynamicResolution::createPipeline(VkRenderPass renderPass, uint32_t subpass, std::span<const char> vertexShaderCode, std::span<const char> fragmentShaderCode) {
+    VkShaderModule vertexShaderModule = createShaderModule(logicalDevice, vertexShaderCode);
+    VkShaderModule fragmentShaderModule = createShaderModule(logicalDevice, fragmentShaderCode);
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertexShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragmentShaderModule;
+    shaderStages[1].pName = "main";
+
+    // The upscale draws a single triangle covering the whole output, generated in the vertex shader.
+    VkPipelineVertexInputStateCreateInfo vertexInputState {};
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState {};
+    inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationState {};
+    rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationState.cullMode = VK_CULL_MODE_NONE;
+    rasterizationState.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizationState.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleState {};
+    multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendState {};
+    colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendState.attachmentCount = 1;
+    colorBlendState.pAttachments = &colorBlendAttachment;
+
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &pipelineLayout) != VK_SUCCESS) {
+        std::cout << "Failed to create upscale pipeline layout." << std::endl;
+        std::terminate();
+    }
+
+    VkGraphicsPipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputState;
+    pipelineInfo.pInputAssemblyState = &inputAssemblyState;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizationState;
+    pipelineInfo.pMultisampleState = &multisampleState;
+    pipelineInfo.pColorBlendState = &colorBlendState;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = subpass;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE), &pipeline) != VK_SUCCESS) {
+        std::cout << "Failed to create upscale pipeline." << std::endl;
+        std::terminate();
+    }
+
+    vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+    vkDestroyShaderModule(logicalDevice, fragmentShaderModule, nullptr);
+}
+
+void DynamicResolution::destroy() {
+    vkDestroyPipeline(logicalDevice, pipeline, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE));
+    vkDestroyPipelineLayout(logicalDevice, pipelineLayout, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+    vkDestroyDescriptorPool(logicalDevice, descriptorPool, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+    vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+    vkDestroySampler(logicalDevice, sampler, hostAllocations->callbacks(VK_OBJECT_TYPE_SAMPLER));
+    vkDestroyQueryPool(logicalDevice, timestampPool, hostAllocations->callbacks(VK_OBJECT_TYPE_QUERY_POOL));
+
+    vkDestroyImageView(logicalDevice, scene.imageView, nullptr);
+    vkDestroyImage(logicalDevice, scene.image, nullptr);
+    vkFreeMemory(logicalDevice, scene.memory, nullptr);
+}
+
+void DynamicResolution::beginFrameTimestamps(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+    if (!timestampsSupported) {
+        return;
+    }
+
+    // Queries have to be reset before they are written again. Doing it in the command buffer itself keeps it reusable.
+    vkCmdResetQueryPool(commandBuffer, timestampPool, frameSlot * 2, 2);
+    // At the top of the pipe, the timestamp would be written as soon as the submission starts, while the scene is still waiting
+    // for the async compute results, and the frame time would include that wait. The vertex shader stage is the first one the
+    // submission waits at, so the timestamp is written once the scene can actually start.
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, timestampPool, frameSlot * 2);
+}
+
+void DynamicResolution::endFrameTimestamps(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+    if (!timestampsSupported) {
+        return;
+    }
+
+    // The timestamp is written once all previous commands have completed every stage.
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, frameSlot * 2 + 1);
+}
+
+void DynamicResolution::frameSubmitted(uint32_t frameSlot) {
+    if (timestampsSupported) {
+        pendingFrameSlot = frameSlot;
+    }
+}
+
+void DynamicResolution::collectFrameTime() {
+    if (!pendingFrameSlot.has_value()) {
+        return;
+    }
+
+    uint32_t firstQuery = *pendingFrameSlot * 2;
+    pendingFrameSlot.reset();
+
+    // The frame has completed, so its results are available and we don't need to ask the driver to wait for them.
+    std::array<uint64_t, 2> timestamps {};
+    if (vkGetQueryPoolResults(logicalDevice, timestampPool, firstQuery, 2, sizeof(timestamps), timestamps.data(),
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return;
+    }
+
+    double milliseconds = ((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod / 1000000.0;
+
+    // Single frames can take much longer than usual, for example when the OS or another application uses the GPU.
+    // An exponential moving average keeps those spikes from changing the resolution on their own.
+    smoothedMilliseconds = measuredFrames == 0 ? milliseconds : smoothedMilliseconds * 0.9 + milliseconds * 0.1;
+    measuredFrames++;
+    framesSinceChange++;
+}
+
+bool DynamicResolution::updateScale() {
+    if (!timestampsSupported || framesSinceChange < settleFrames || smoothedMilliseconds <= 0.0) {
+        return false;
+    }
+
+    // GPU time is roughly proportional to the number of pixels, which is the square of the scale.
+    float idealScale = currentScale * static_cast<float>(std::sqrt(settings.targetMilliseconds / smoothedMilliseconds));
+
+    float newScale = currentScale;
+    if (smoothedMilliseconds > settings.targetMilliseconds) {
+        // Over budget: go straight to the scale that should fit, so that frame drops stop quickly.
+        // The small bias keeps a scale that is exactly on a step from being rounded down to the step below.
+        newScale = std::floor(idealScale / scaleStep + 0.001f) * scaleStep;
+    } else if (smoothedMilliseconds < settings.targetMilliseconds * 0.8 && idealScale >= currentScale + scaleStep) {
+        // Well under budget: raise the scale a single step at a time. Raising it too far would immediately push us over budget again.
+        newScale = currentScale + scaleStep;
+    }
+
+    return setScale(newScale);
+}
+
+bool DynamicResolution::setScale(float newScale) {
+    newScale = std::clamp(newScale, settings.minScale, settings.maxScale);
+    VkExtent2D newExtent = extentForScale(newScale);
+    if (newExtent.width == currentExtent.width && newExtent.height == currentExtent.height) {
+        return false;
+    }
+
+    currentScale = newScale;
+    currentExtent = newExtent;
+    framesSinceChange = 0;
+    return true;
+}
+
+void DynamicResolution::recordUpscale(VkCommandBuffer commandBuffer, CommandCounters& counters) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+    VkViewport viewport {};
+    viewport.width = static_cast<float>(outputExtent.width);
+    viewport.height = static_cast<float>(outputExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor {};
+    scissor.extent = outputExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    PushConstants constants {};
+    constants.outputSize[0] = static_cast<float>(outputExtent.width);
+    constants.outputSize[1] = static_cast<float>(outputExtent.height);
+    constants.sceneScale[0] = static_cast<float>(currentExtent.width) / sceneExtent.width;
+    constants.sceneScale[1] = static_cast<float>(currentExtent.height) / sceneExtent.height;
+    // Half a texel in from the edge of the rendered area, where bilinear filtering stops reading neighbouring texels.
+    constants.maxTexCoord[0] = (currentExtent.width - 0.5f) / sceneExtent.width;
+    constants.maxTexCoord[1] = (currentExtent.height - 0.5f) / sceneExtent.height;
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    counters.bindPipeline();
+    counters.draw(1);
+}
+
+VkExtent2D DynamicResolution::extentForScale(float scale) const {
+    VkExtent2D extent {};
+    extent.width = std::max(1u, static_cast<uint32_t>(std::lround(outputExtent.width * scale)));
+    extent.height = std::max(1u, static_cast<uint32_t>(std::lround(outputExtent.height * scale)));
+    return extent;
+}
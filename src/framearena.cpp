@@ -0,0 +1,101 @@
+#include "framearena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+FrameArena::~FrameArena() {
+    destroy();
+}
+
+void FrameArena::init(size_t initialCapacity) {
+    for (auto& slot : slots) {
+        slot.block = allocateBlock(initialCapacity);
+    }
+}
+
+void FrameArena::destroy() {
+    for (auto& slot : slots) {
+        for (auto& block : slot.overflow) {
+            std::free(block.memory);
+        }
+        slot.overflow.clear();
+
+        std::free(slot.block.memory);
+        slot.block = {};
+        slot.used = 0;
+    }
+}
+
+void FrameArena::beginFrame(uint64_t frameValue) {
+    currentSlot = static_cast<uint32_t>(frameValue % slotCount);
+    Slot& slot = slots[currentSlot];
+
+    if (poisonFreedMemory) {
+        std::memset(slot.block.memory, resetPoison, slot.block.offset);
+    }
+
+    // The frame didn't fit, so the region is replaced by one that would have fit it, leaving some room for growth.
+    if (!slot.overflow.empty()) {
+        for (auto& block : slot.overflow) {
+            std::free(block.memory);
+        }
+        slot.overflow.clear();
+
+        std::free(slot.block.memory);
+        slot.block = allocateBlock(slot.used + slot.used / 2);
+        heapAllocationCount++;
+    }
+
+    slot.block.offset = 0;
+    slot.used = 0;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+    Slot& slot = slots[currentSlot];
+
+    void* memory = bump(slot.block, size, alignment);
+    if (memory == nullptr) {
+        // Overflow blocks are at least as large as the region, so a frame that overflows a little doesn't need many of them.
+        if (slot.overflow.empty() || (memory = bump(slot.overflow.back(), size, alignment)) == nullptr) {
+            slot.overflow.push_back(allocateBlock(std::max(slot.block.capacity, size + alignment)));
+            heapAllocationCount++;
+            memory = bump(slot.overflow.back(), size, alignment);
+        }
+    }
+
+    slot.used += size;
+    peakUsed = std::max(peakUsed, slot.used);
+    return memory;
+}
+
+void FrameArena::deallocate(void* memory, size_t size) {
+    if (poisonFreedMemory && memory != nullptr) {
+        std::memset(memory, deallocatePoison, size);
+    }
+}
+
+void* FrameArena::bump(Block& block, size_t size, size_t alignment) {
+    // Alignment is applied to the address rather than the offset, so blocks don't need to be aligned to more than malloc gives us.
+    uintptr_t base = reinterpret_cast<uintptr_t>(block.memory);
+    uintptr_t address = (base + block.offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    size_t end = static_cast<size_t>(address - base) + size;
+
+    if (block.memory == nullptr || end > block.capacity) {
+        return nullptr;
+    }
+
+    block.offset = end;
+    return reinterpret_cast<void*>(address);
+}
+
+FrameArena::Block FrameArena::allocateBlock(size_t capacity) {
+    Block block {};
+    block.memory = static_cast<unsigned char*>(std::malloc(capacity));
+    if (block.memory == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    block.capacity = capacity;
+    return block;
+}
@@ -0,0 +1,316 @@
+#include "framebufferreadback.h"
+#include "vulkanhelper.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+    // Whether any memory type has all of "properties". Buffers can generally use every host visible memory type.
+    bool hasMemoryType(VkPhysicalDevice physicalDevice, VkMemoryPropertyFlags properties) {
+        VkPhysicalDeviceMemoryProperties memoryProperties {};
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+void FramebufferReadback::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t graphicsFamily, VkExtent2D extent,
+                               VkFormat format, bool supported, HostAllocationTracker& hostAllocations) {
+    logicalDevice = device;
+    this->hostAllocations = &hostAllocations;
+    imageExtent = extent;
+    imageSize = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+    switch (format) {
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            swizzle = false;
+            break;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            swizzle = true;
+            break;
+        default:
+            supported = false;
+            break;
+    }
+
+    if (!supported) {
+        std::cout << "The swapchain can't be read back, screenshots and recording are disabled." << std::endl;
+        return;
+    }
+    enabled = true;
+
+    VkCommandPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // The copy command buffers are recorded again for every capture.
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = graphicsFamily;
+
+    if (vkCreateCommandPool(logicalDevice, &poolInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &commandPool) != VK_SUCCESS) {
+        std::cout << "Failed to create readback command pool." << std::endl;
+        std::terminate();
+    }
+
+    // The CPU reads every byte of these buffers, which is very slow from uncached memory. Cached memory isn't always coherent,
+    // in which case the range is invalidated before it's read.
+    coherent = !hasMemoryType(physicalDevice, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    VkMemoryPropertyFlags memoryProperties = coherent
+        ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    for (Slot& slot : slots) {
+        createBuffer(physicalDevice, logicalDevice, imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties, slot.buffer, slot.memory);
+
+        void* mapped = nullptr;
+        if (vkMapMemory(logicalDevice, slot.memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+            std::cout << "Failed to map readback buffer." << std::endl;
+            std::terminate();
+        }
+        slot.mapped = static_cast<const uint8_t*>(mapped);
+
+        VkCommandBufferAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &slot.commandBuffer) != VK_SUCCESS) {
+            std::cout << "Failed to allocate readback command buffer." << std::endl;
+            std::terminate();
+        }
+    }
+
+    writer = std::make_unique<ThreadPool>(1);
+}
+
+void FramebufferReadback::destroy() {
+    if (!enabled) {
+        return;
+    }
+
+    // The device is idle, so every submitted copy has completed. Destroying the pool finishes the queued writes.
+    collect(UINT64_MAX);
+    writer.reset();
+
+    for (Slot& slot : slots) {
+        vkUnmapMemory(logicalDevice, slot.memory);
+        vkDestroyBuffer(logicalDevice, slot.buffer, nullptr);
+        vkFreeMemory(logicalDevice, slot.memory, nullptr);
+    }
+    vkDestroyCommandPool(logicalDevice, commandPool, hostAllocations->callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+}
+
+void FramebufferReadback::requestScreenshot(const std::string& filename) {
+    screenshotFilename = filename;
+}
+
+void FramebufferReadback::startRecording(const std::string& prefix) {
+    recording = true;
+    recordingPrefix = prefix;
+    recordedFrames = 0;
+}
+
+void FramebufferReadback::stopRecording() {
+    recording = false;
+}
+
+void FramebufferReadback::collect(uint64_t completedFrameValue) {
+    if (!enabled) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Slots are handed over in the order their frames were submitted, so the writer thread writes them in order as well.
+    while (true) {
+        Slot* oldest = nullptr;
+        for (Slot& slot : slots) {
+            if (slot.state.load() == SlotState::Copying && slot.frameValue <= completedFrameValue &&
+                (oldest == nullptr || slot.frameValue < oldest->frameValue)) {
+                oldest = &slot;
+            }
+        }
+        if (oldest == nullptr) {
+            break;
+        }
+
+        oldest->state.store(SlotState::Writing);
+        writer->enqueue([this, oldest] { write(*oldest); });
+    }
+
+    mainThreadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+VkCommandBuffer FramebufferReadback::recordCopy(VkImage image, uint64_t frameValue) {
+    if (!enabled || !wantsFrame()) {
+        return VK_NULL_HANDLE;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    Slot* free = nullptr;
+    for (Slot& slot : slots) {
+        if (slot.state.load() == SlotState::Free) {
+            free = &slot;
+            break;
+        }
+    }
+
+    // Every buffer is waiting for the GPU or the disk. Rather than wait for one, we skip this frame.
+    // A screenshot stays requested, and is taken from the next frame instead.
+    if (free == nullptr) {
+        droppedFrames++;
+        return VK_NULL_HANDLE;
+    }
+
+    if (!screenshotFilename.empty()) {
+        free->filename = screenshotFilename;
+        screenshotFilename.clear();
+    } else {
+        char frameNumber[16];
+        std::snprintf(frameNumber, sizeof(frameNumber), "_%06llu.tga", static_cast<unsigned long long>(recordedFrames++));
+        free->filename = recordingPrefix + frameNumber;
+    }
+
+    VkCommandBuffer commandBuffer = free->commandBuffer;
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        std::cout << "Failed to begin recording readback command buffer." << std::endl;
+        std::terminate();
+    }
+
+    // The frame's render pass left the image ready for presentation. It's moved to a layout we can copy from, once the frame
+    // has finished writing it, and moved back afterwards, so the presentation engine finds it as it expects.
+    VkImageMemoryBarrier toTransfer {};
+    toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toTransfer.oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image = image;
+    toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    VkBufferImageCopy region {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { imageExtent.width, imageExtent.height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, free->buffer, 1, &region);
+
+    // Nothing after the copy writes the image, so going back to the present layout only has to wait for the copy's reads.
+    VkImageMemoryBarrier toPresent = toTransfer;
+    toPresent.srcAccessMask = 0;
+    toPresent.dstAccessMask = 0;
+    toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    // The copy's writes have to be made visible to the host, which waiting for the frame alone doesn't do.
+    VkBufferMemoryBarrier toHost {};
+    toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer = free->buffer;
+    toHost.offset = 0;
+    toHost.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         0, nullptr, 1, &toHost, 1, &toPresent);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        std::cout << "Failed to record readback command buffer." << std::endl;
+        std::terminate();
+    }
+
+    free->frameValue = frameValue;
+    free->state.store(SlotState::Copying);
+    capturedFrames++;
+
+    mainThreadSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return commandBuffer;
+}
+
+// Runs on the writer thread.
+void FramebufferReadback::write(Slot& slot) {
+    auto start = std::chrono::steady_clock::now();
+
+    if (!coherent) {
+        VkMappedMemoryRange range {};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot.memory;
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        vkInvalidateMappedMemoryRanges(logicalDevice, 1, &range);
+    }
+
+    // An uncompressed 32 bit true color TGA, stored top to bottom. The pixels are in BGRA order, like the swapchain's usually are.
+    uint8_t header[18] {};
+    header[2] = 2;
+    header[12] = static_cast<uint8_t>(imageExtent.width & 0xFF);
+    header[13] = static_cast<uint8_t>(imageExtent.width >> 8);
+    header[14] = static_cast<uint8_t>(imageExtent.height & 0xFF);
+    header[15] = static_cast<uint8_t>(imageExtent.height >> 8);
+    header[16] = 32;
+    // 8 bits of alpha, and the first row is the top one.
+    header[17] = 0x28;
+
+    std::ofstream file(slot.filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "Failed to create " << slot.filename << "." << std::endl;
+        slot.state.store(SlotState::Free);
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    // The swapchain's alpha isn't meaningful, since the window is composited as opaque, so every pixel is written as opaque.
+    const size_t rowSize = static_cast<size_t>(imageExtent.width) * 4;
+    std::vector<uint8_t> row(rowSize);
+    for (uint32_t y = 0; y < imageExtent.height; y++) {
+        const uint8_t* source = slot.mapped + y * rowSize;
+        for (size_t x = 0; x < rowSize; x += 4) {
+            row[x + 0] = source[x + (swizzle ? 2 : 0)];
+            row[x + 1] = source[x + 1];
+            row[x + 2] = source[x + (swizzle ? 0 : 2)];
+            row[x + 3] = 0xFF;
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    file.close();
+
+    // The buffer can be reused as soon as its pixels are written, so it's released before the stats are updated.
+    slot.state.store(SlotState::Free);
+
+    writtenFrames++;
+    bytesWritten += sizeof(header) + imageSize;
+    writeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+ReadbackStats FramebufferReadback::stats() const {
+    ReadbackStats stats {};
+    stats.capturedFrames = capturedFrames;
+    stats.droppedFrames = droppedFrames;
+    stats.writtenFrames = writtenFrames.load();
+    stats.bytesWritten = bytesWritten.load();
+    stats.mainThreadMilliseconds = capturedFrames > 0 ? mainThreadSeconds * 1000.0 / capturedFrames : 0.0;
+    stats.writeMilliseconds = stats.writtenFrames > 0 ? writeMicroseconds.load() / 1000.0 / stats.writtenFrames : 0.0;
+    return stats;
+}
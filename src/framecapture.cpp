@@ -0,0 +1,209 @@
+#include "framecapture.h"
+#include "lz4.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+    template<typename T>
+    void append(std::vector<char>& data, const T& value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    template<typename T>
+    void appendArray(std::vector<char>& data, const T* values, size_t count) {
+        const char* bytes = reinterpret_cast<const char*>(values);
+        data.insert(data.end(), bytes, bytes + sizeof(T) * count);
+    }
+
+    // Reads from the decompressed frame data, failing instead of reading past its end.
+    class FrameDataReader {
+    public:
+        explicit FrameDataReader(std::span<const char> data) : remaining(data) {}
+
+        template<typename T>
+        bool read(T& value) {
+            return readArray(&value, 1);
+        }
+
+        template<typename T>
+        bool readArray(T* values, size_t count) {
+            if (remaining.size() / sizeof(T) < count) {
+                return false;
+            }
+            std::memcpy(values, remaining.data(), sizeof(T) * count);
+            remaining = remaining.subspan(sizeof(T) * count);
+            return true;
+        }
+
+        // How many values of type T are left to read.
+        template<typename T>
+        size_t remainingCount() const {
+            return remaining.size() / sizeof(T);
+        }
+
+    private:
+        std::span<const char> remaining;
+    };
+}
+
+void FrameCaptureWriter::open(const std::string& filename) {
+    file.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to create capture file " + filename + "!");
+    }
+
+    CaptureHeader header {};
+    header.magic = captureMagic;
+    header.version = captureVersion;
+    header.instanceSize = sizeof(SpriteInstance);
+    header.lightSize = sizeof(Light);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    previousInstances.clear();
+    previousLights.clear();
+    frames = 0;
+    storedBytes = sizeof(header);
+}
+
+void FrameCaptureWriter::close() {
+    file.close();
+}
+
+void FrameCaptureWriter::write(double time, float renderScale, std::span<const SpriteInstance> instances, std::span<const Light> lights) {
+    frameData.clear();
+    append(frameData, time);
+    append(frameData, renderScale);
+    append(frameData, static_cast<uint32_t>(instances.size()));
+
+    // The run count is only known once the runs are written, so its place is kept and filled in afterwards.
+    size_t runCountOffset = frameData.size();
+    uint32_t runCount = 0;
+    append(frameData, runCount);
+
+    // Instances are plain floats, so comparing their bytes finds exactly the ones that changed.
+    auto changed = [&](size_t i) {
+        return i >= previousInstances.size() || std::memcmp(&instances[i], &previousInstances[i], sizeof(SpriteInstance)) != 0;
+    };
+    for (size_t i = 0; i < instances.size();) {
+        if (!changed(i)) {
+            i++;
+            continue;
+        }
+
+        size_t first = i;
+        while (i < instances.size() && changed(i)) {
+            i++;
+        }
+        append(frameData, static_cast<uint32_t>(first));
+        append(frameData, static_cast<uint32_t>(i - first));
+        appendArray(frameData, instances.data() + first, i - first);
+        runCount++;
+    }
+    std::memcpy(frameData.data() + runCountOffset, &runCount, sizeof(runCount));
+
+    bool lightsChanged = frames == 0 || lights.size() != previousLights.size() ||
+                         std::memcmp(lights.data(), previousLights.data(), lights.size_bytes()) != 0;
+    if (lightsChanged) {
+        append(frameData, static_cast<uint32_t>(lights.size()));
+        appendArray(frameData, lights.data(), lights.size());
+        previousLights.assign(lights.begin(), lights.end());
+    } else {
+        append(frameData, capturedLightsUnchanged);
+    }
+
+    previousInstances.assign(instances.begin(), instances.end());
+
+    std::vector<char> compressed = lz4CompressBlock(frameData);
+    CaptureFrameHeader frameHeader {};
+    frameHeader.storedSize = static_cast<uint32_t>(compressed.size());
+    frameHeader.size = static_cast<uint32_t>(frameData.size());
+    file.write(reinterpret_cast<const char*>(&frameHeader), sizeof(frameHeader));
+    file.write(compressed.data(), compressed.size());
+
+    frames++;
+    storedBytes += sizeof(frameHeader) + compressed.size();
+}
+
+void FrameCaptureReader::open(const std::string& filename) {
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open capture file " + filename + "!");
+    }
+
+    CaptureHeader header {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != captureMagic || header.version != captureVersion) {
+        file.close();
+        throw std::runtime_error(filename + " is not a valid capture file!");
+    }
+    if (header.instanceSize != sizeof(SpriteInstance) || header.lightSize != sizeof(Light)) {
+        file.close();
+        throw std::runtime_error(filename + " was captured by a build with a different sprite or light layout!");
+    }
+
+    frames = 0;
+}
+
+void FrameCaptureReader::close() {
+    file.close();
+}
+
+bool FrameCaptureReader::read(RenderPacket& packet) {
+    CaptureFrameHeader frameHeader {};
+    if (!file.read(reinterpret_cast<char*>(&frameHeader), sizeof(frameHeader))) {
+        return false;
+    }
+
+    storedData.resize(frameHeader.storedSize);
+    frameData.resize(frameHeader.size);
+    if (!file.read(storedData.data(), storedData.size()) || !lz4DecompressBlock(storedData, frameData)) {
+        std::cout << "Failed to read frame " << frames << " of the capture." << std::endl;
+        return false;
+    }
+
+    FrameDataReader reader(frameData);
+    uint32_t instanceCount = 0;
+    uint32_t runCount = 0;
+    bool valid = reader.read(packet.time) && reader.read(packet.renderScale) && reader.read(instanceCount) && reader.read(runCount);
+
+    // Instances beyond the previous frame's are always part of a run, so the frame data must hold at least that many.
+    // Checking before resizing keeps a malformed count from allocating gigabytes.
+    valid = valid && (instanceCount <= packet.instances.size() ||
+                      instanceCount - packet.instances.size() <= reader.remainingCount<SpriteInstance>());
+    if (!valid) {
+        std::cout << "Failed to read frame " << frames << " of the capture." << std::endl;
+        return false;
+    }
+
+    // Sprites that were removed leave no run behind, so a smaller count is a change of its own.
+    packet.instancesChanged = runCount > 0 || frames == 0 || instanceCount != packet.instances.size();
+    packet.instances.resize(instanceCount);
+    for (uint32_t run = 0; valid && run < runCount; run++) {
+        uint32_t first = 0;
+        uint32_t count = 0;
+        valid = reader.read(first) && reader.read(count) && first <= instanceCount && count <= instanceCount - first &&
+                reader.readArray(packet.instances.data() + first, count);
+    }
+
+    uint32_t lightCount = 0;
+    valid = valid && reader.read(lightCount);
+    packet.lightsChanged = valid && lightCount != capturedLightsUnchanged;
+    if (packet.lightsChanged) {
+        valid = lightCount <= reader.remainingCount<Light>();
+        if (valid) {
+            packet.lights.resize(lightCount);
+            valid = reader.readArray(packet.lights.data(), lightCount);
+        }
+    }
+
+    if (!valid) {
+        std::cout << "Failed to read frame " << frames << " of the capture." << std::endl;
+        return false;
+    }
+
+    frames++;
+    return true;
+}
@@ -0,0 +1,195 @@
+#include "hostallocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+void HostAllocationTracker::AtomicCounters::add(uint64_t size) {
+    uint64_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    liveAllocations.fetch_add(1, std::memory_order_relaxed);
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    // Raise the peak if we're above it. Another thread may raise it at the same time, so retry until one of us wins.
+    uint64_t peak = peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+void HostAllocationTracker::AtomicCounters::remove(uint64_t size) {
+    liveBytes.fetch_sub(size, std::memory_order_relaxed);
+    liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+}
+
+HostAllocationCounters HostAllocationTracker::AtomicCounters::load() const {
+    HostAllocationCounters counters {};
+    counters.liveBytes = liveBytes.load(std::memory_order_relaxed);
+    counters.liveAllocations = liveAllocations.load(std::memory_order_relaxed);
+    counters.peakBytes = peakBytes.load(std::memory_order_relaxed);
+    counters.totalAllocations = totalAllocations.load(std::memory_order_relaxed);
+    return counters;
+}
+
+const VkAllocationCallbacks* HostAllocationTracker::callbacks(VkObjectType objectType) {
+    if (!trackingEnabled) {
+        return nullptr;
+    }
+
+    std::lock_guard lock(recordsMutex);
+
+    auto [iterator, inserted] = records.try_emplace(objectType);
+    ObjectTypeRecord& record = iterator->second;
+
+    if (inserted) {
+        record.tracker = this;
+        record.objectType = objectType;
+        record.callbacks.pUserData = &record;
+        record.callbacks.pfnAllocation = allocate;
+        record.callbacks.pfnReallocation = reallocate;
+        record.callbacks.pfnFree = free;
+        record.callbacks.pfnInternalAllocation = internalAllocation;
+        record.callbacks.pfnInternalFree = internalFree;
+    }
+
+    return &record.callbacks;
+}
+
+HostAllocationStats HostAllocationTracker::stats() const {
+    HostAllocationStats stats {};
+    stats.total = totalCounters.load();
+
+    for (size_t i = 0; i < scopeCounters.size(); i++) {
+        stats.byScope[i] = scopeCounters[i].load();
+    }
+
+    {
+        std::lock_guard lock(recordsMutex);
+        for (const auto& [objectType, record] : records) {
+            stats.byObjectType.emplace_back(objectType, record.counters.load());
+        }
+    }
+
+    // Largest consumers first.
+    std::sort(stats.byObjectType.begin(), stats.byObjectType.end(), [](const auto& a, const auto& b) {
+        return a.second.peakBytes > b.second.peakBytes;
+    });
+
+    stats.internalBytes = internalBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void* VKAPI_PTR HostAllocationTracker::allocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    auto& record = *static_cast<ObjectTypeRecord*>(userData);
+    return record.tracker->allocateTracked(record, size, alignment, scope);
+}
+
+void* VKAPI_PTR HostAllocationTracker::reallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    auto& record = *static_cast<ObjectTypeRecord*>(userData);
+
+    // Reallocating nothing is an allocation, and reallocating to size 0 is a free.
+    if (original == nullptr) {
+        return record.tracker->allocateTracked(record, size, alignment, scope);
+    }
+    if (size == 0) {
+        record.tracker->freeTracked(original);
+        return nullptr;
+    }
+
+    // The spec requires the alignment to stay the same, so the new block has to be allocated and copied into,
+    // rather than grown in place with realloc, which doesn't know about our alignment.
+    void* memory = record.tracker->allocateTracked(record, size, alignment, scope);
+    if (memory == nullptr) {
+        // On failure, the original allocation must be left untouched.
+        return nullptr;
+    }
+
+    const AllocationHeader* originalHeader = static_cast<const AllocationHeader*>(original) - 1;
+    std::memcpy(memory, original, std::min(size, originalHeader->size));
+    record.tracker->freeTracked(original);
+    return memory;
+}
+
+void VKAPI_PTR HostAllocationTracker::free(void* userData, void* memory) {
+    // Freeing nullptr must be a no-op.
+    if (memory != nullptr) {
+        static_cast<ObjectTypeRecord*>(userData)->tracker->freeTracked(memory);
+    }
+}
+
+void VKAPI_PTR HostAllocationTracker::internalAllocation(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+    static_cast<ObjectTypeRecord*>(userData)->tracker->internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VKAPI_PTR HostAllocationTracker::internalFree(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+    static_cast<ObjectTypeRecord*>(userData)->tracker->internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* HostAllocationTracker::allocateTracked(ObjectTypeRecord& record, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    if (size == 0) {
+        return nullptr;
+    }
+
+    // Drivers ask for alignments up to their own needs, which malloc doesn't promise. We over-allocate and align by hand,
+    // leaving room for the header in front of the aligned pointer. Alignments are always powers of two.
+    alignment = std::max(alignment, alignof(AllocationHeader));
+    size_t blockSize = sizeof(AllocationHeader) + alignment + size;
+
+    void* block = std::malloc(blockSize);
+    if (block == nullptr) {
+        return nullptr;
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(block) + sizeof(AllocationHeader);
+    address = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    void* memory = reinterpret_cast<void*>(address);
+
+    AllocationHeader* header = static_cast<AllocationHeader*>(memory) - 1;
+    header->block = block;
+    header->size = size;
+    header->record = &record;
+    header->scope = scope;
+
+    totalCounters.add(size);
+    scopeCounters[scope].add(size);
+    record.counters.add(size);
+
+    return memory;
+}
+
+void HostAllocationTracker::freeTracked(void* memory) {
+    AllocationHeader* header = static_cast<AllocationHeader*>(memory) - 1;
+
+    // The header remembers where the allocation was counted, in case it's freed through the callbacks of another object type.
+    totalCounters.remove(header->size);
+    scopeCounters[header->scope].remove(header->size);
+    header->record->counters.remove(header->size);
+
+    std::free(header->block);
+}
+
+const char* objectTypeName(VkObjectType objectType) {
+    switch (objectType) {
+        case VK_OBJECT_TYPE_INSTANCE: return "Instance";
+        case VK_OBJECT_TYPE_DEVICE: return "Device";
+        case VK_OBJECT_TYPE_SEMAPHORE: return "Semaphore";
+        case VK_OBJECT_TYPE_FENCE: return "Fence";
+        case VK_OBJECT_TYPE_DEVICE_MEMORY: return "Device memory";
+        case VK_OBJECT_TYPE_BUFFER: return "Buffer";
+        case VK_OBJECT_TYPE_IMAGE: return "Image";
+        case VK_OBJECT_TYPE_IMAGE_VIEW: return "Image view";
+        case VK_OBJECT_TYPE_SHADER_MODULE: return "Shader module";
+        case VK_OBJECT_TYPE_PIPELINE_CACHE: return "Pipeline cache";
+        case VK_OBJECT_TYPE_PIPELINE_LAYOUT: return "Pipeline layout";
+        case VK_OBJECT_TYPE_RENDER_PASS: return "Render pass";
+        case VK_OBJECT_TYPE_PIPELINE: return "Pipeline";
+        case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT: return "Descriptor set layout";
+        case VK_OBJECT_TYPE_SAMPLER: return "Sampler";
+        case VK_OBJECT_TYPE_DESCRIPTOR_POOL: return "Descriptor pool";
+        case VK_OBJECT_TYPE_FRAMEBUFFER: return "Framebuffer";
+        case VK_OBJECT_TYPE_COMMAND_POOL: return "Command pool";
+        case VK_OBJECT_TYPE_QUERY_POOL: return "Query pool";
+        case VK_OBJECT_TYPE_SURFACE_KHR: return "Surface";
+        case VK_OBJECT_TYPE_SWAPCHAIN_KHR: return "Swapchain";
+        case VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT: return "Debug messenger";
+        default: return "Other";
+    }
+}
@@ -0,0 +1,205 @@
+#include "ktx2.h"
+#include "blockcompression.h"
+#include "filehelper.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    constexpr std::array<uint8_t, 12> fileIdentifier = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    // The identifier, nine 32 bit header fields, and the offsets and sizes of the data format descriptor,
+    // key/value data and supercompression global data. The level index follows, with 24 bytes per level.
+    constexpr size_t headerSize = 80;
+    constexpr size_t levelIndexEntrySize = 24;
+
+    // Level offsets in the uploaded data are aligned to 16 bytes, which covers every block size, and the 4 byte alignment copies need.
+    constexpr size_t levelAlignment = 16;
+
+    constexpr std::array<VkFormat, 14> compressedFormats = {
+        VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+        VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK,
+        VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK, VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK,
+        VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK,
+    };
+
+    // Written once by queryKtx2FormatSupport, before the I/O threads that decode textures start.
+    std::array<bool, compressedFormats.size()> formatSupported {};
+    // Every device supports 2D images of at least 4096 texels on a side, until it tells us its own limit.
+    uint32_t maxImageDimension = 4096;
+
+    std::atomic<uint64_t> textureCount { 0 };
+    std::atomic<uint64_t> transcodedCount { 0 };
+    std::atomic<uint64_t> uploadedByteCount { 0 };
+    std::atomic<uint64_t> uncompressedByteCount { 0 };
+
+    template<typename T>
+    T readField(const uint8_t* bytes, size_t offset) {
+        T value;
+        std::memcpy(&value, bytes + offset, sizeof(value));
+        return value;
+    }
+
+    bool isSupported(VkFormat format) {
+        auto found = std::find(compressedFormats.begin(), compressedFormats.end(), format);
+        return found != compressedFormats.end() && formatSupported[found - compressedFormats.begin()];
+    }
+
+    bool isSrgb(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+bool isKtx2(std::span<const char> data) {
+    return data.size() >= fileIdentifier.size() && std::memcmp(data.data(), fileIdentifier.data(), fileIdentifier.size()) == 0;
+}
+
+void queryKtx2FormatSupport(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures& enabledFeatures) {
+    VkPhysicalDeviceProperties deviceProperties {};
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    maxImageDimension = deviceProperties.limits.maxImageDimension2D;
+
+    for (size_t i = 0; i < compressedFormats.size(); i++) {
+        VkFormat format = compressedFormats[i];
+        bool isBc = format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+        if ((isBc ? enabledFeatures.textureCompressionBC : enabledFeatures.textureCompressionETC2) != VK_TRUE) {
+            formatSupported[i] = false;
+            continue;
+        }
+
+        VkFormatProperties properties {};
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+        formatSupported[i] = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+    }
+}
+
+Texture decodeKtx2(std::span<const char> data) {
+    if (!isKtx2(data) || data.size() < headerSize) {
+        throw std::runtime_error("KTX2 file is truncated!");
+    }
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    VkFormat format = static_cast<VkFormat>(readField<uint32_t>(bytes, 12));
+    uint32_t width = readField<uint32_t>(bytes, 20);
+    uint32_t height = readField<uint32_t>(bytes, 24);
+    uint32_t depth = readField<uint32_t>(bytes, 28);
+    uint32_t layerCount = readField<uint32_t>(bytes, 32);
+    uint32_t faceCount = readField<uint32_t>(bytes, 36);
+    uint32_t levelCount = readField<uint32_t>(bytes, 40);
+    uint32_t supercompressionScheme = readField<uint32_t>(bytes, 44);
+
+    // A format of 0 means Basis Universal, which is always supercompressed.
+    if (supercompressionScheme != 0 || format == VK_FORMAT_UNDEFINED) {
+        throw std::runtime_error("supercompressed KTX2 files are not supported!");
+    }
+    if (width == 0 || height == 0 || depth > 1 || layerCount > 1 || faceCount != 1) {
+        throw std::runtime_error("only 2D KTX2 textures are supported!");
+    }
+    if (width > maxImageDimension || height > maxImageDimension) {
+        throw std::runtime_error("KTX2 texture is larger than the device supports!");
+    }
+
+    const uint32_t blockSize = compressedBlockSize(format);
+    if (blockSize == 0 && format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB) {
+        throw std::runtime_error("unsupported KTX2 format!");
+    }
+
+    // A level count of 0 asks the loader to generate the mip chain, which we don't, so only the base level is used.
+    // A full mip chain ends at 1x1, which is level floor(log2(max(width, height))), so there can't be more levels than that.
+    levelCount = std::max(levelCount, 1u);
+    if (levelCount > static_cast<uint32_t>(std::bit_width(std::max(width, height)))) {
+        throw std::runtime_error("KTX2 file has more mip levels than its size allows!");
+    }
+    if (data.size() < headerSize + static_cast<size_t>(levelCount) * levelIndexEntrySize) {
+        throw std::runtime_error("KTX2 file is truncated!");
+    }
+
+    const bool transcode = blockSize != 0 && !isSupported(format);
+
+    Texture texture {};
+    texture.width = width;
+    texture.height = height;
+    texture.format = transcode ? (isSrgb(format) ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM) : format;
+    texture.mipLevels = levelCount;
+
+    uint64_t uncompressedBytes = 0;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        uint32_t levelWidth = std::max(width >> level, 1u);
+        uint32_t levelHeight = std::max(height >> level, 1u);
+
+        // In 64 bits, since rounding a width close to 2^32 up to whole blocks would wrap around in 32.
+        uint64_t uncompressedSize = static_cast<uint64_t>(levelWidth) * levelHeight * 4;
+        uint64_t size = blockSize != 0 ? ((levelWidth + 3ull) / 4) * ((levelHeight + 3ull) / 4) * blockSize : uncompressedSize;
+
+        // The file stores the smallest level first, but the index lists them from the largest.
+        uint64_t byteOffset = readField<uint64_t>(bytes, headerSize + level * levelIndexEntrySize);
+        uint64_t byteLength = readField<uint64_t>(bytes, headerSize + level * levelIndexEntrySize + 8);
+        if (byteLength < size || byteOffset > data.size() || data.size() - byteOffset < size) {
+            throw std::runtime_error("KTX2 file is truncated!");
+        }
+        std::span<const uint8_t> source(bytes + byteOffset, size);
+
+        VkBufferImageCopy region {};
+        region.bufferOffset = (texture.pixels.size() + levelAlignment - 1) / levelAlignment * levelAlignment;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        // Blocks may extend past the edges of small levels, but the copy only covers the texels inside them.
+        region.imageExtent = { levelWidth, levelHeight, 1 };
+        texture.levels.push_back(region);
+
+        if (transcode) {
+            texture.pixels.resize(region.bufferOffset + uncompressedSize);
+            if (!decodeCompressedImage(format, source, levelWidth, levelHeight,
+                                       std::span<uint8_t>(texture.pixels.data() + region.bufferOffset, uncompressedSize))) {
+                throw std::runtime_error("failed to decode KTX2 texture!");
+            }
+        } else {
+            texture.pixels.resize(region.bufferOffset);
+            texture.pixels.insert(texture.pixels.end(), source.begin(), source.end());
+        }
+
+        uncompressedBytes += uncompressedSize;
+    }
+
+    textureCount++;
+    if (transcode) {
+        transcodedCount++;
+    }
+    uploadedByteCount += texture.pixels.size();
+    uncompressedByteCount += uncompressedBytes;
+
+    return texture;
+}
+
+Texture loadKtx2(const std::string& filename) {
+    std::vector<char> data = readFile(filename);
+    return decodeKtx2(data);
+}
+
+Ktx2Stats ktx2Stats() {
+    Ktx2Stats stats {};
+    stats.textures = textureCount.load();
+    stats.transcodedTextures = transcodedCount.load();
+    stats.uploadedBytes = uploadedByteCount.load();
+    stats.uncompressedBytes = uncompressedByteCount.load();
+    return stats;
+}
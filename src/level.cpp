@@ -0,0 +1,297 @@
+#include "level.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    constexpr size_t sectionElementSizes[levelSectionCount] = {
+        sizeof(LevelEntity),
+        sizeof(LevelSprite),
+        sizeof(LevelTilemap),
+        sizeof(uint16_t),
+        sizeof(LevelSpatialNode),
+        sizeof(uint32_t),
+        sizeof(char),
+    };
+
+    // Leaves of the spatial index hold up to this many entities. Testing a few boxes is cheaper than descending further.
+    constexpr uint32_t maxLeafItems = 4;
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    Aabb pointBounds(float x, float y) {
+        Aabb box {};
+        box.min[0] = box.max[0] = x;
+        box.min[1] = box.max[1] = y;
+        return box;
+    }
+
+    // The bounds of a "width" by "height" quad centered on the origin of "world".
+    Aabb quadBounds(const Affine2D& world, float width, float height) {
+        float extentX = 0.5f * (std::abs(world.a * width) + std::abs(world.c * height));
+        float extentY = 0.5f * (std::abs(world.b * width) + std::abs(world.d * height));
+
+        Aabb box {};
+        box.min[0] = world.tx - extentX;
+        box.min[1] = world.ty - extentY;
+        box.max[0] = world.tx + extentX;
+        box.max[1] = world.ty + extentY;
+        return box;
+    }
+
+    // Builds the hierarchy over "items[begin, end)" below "nodes[nodeIndex]", reordering the items so that every leaf's are contiguous.
+    void buildSpatialNode(std::vector<LevelSpatialNode>& nodes, std::vector<uint32_t>& items, const std::vector<Aabb>& bounds,
+                          uint32_t nodeIndex, uint32_t begin, uint32_t end) {
+        Aabb nodeBounds = bounds[items[begin]];
+        for (uint32_t i = begin + 1; i < end; i++) {
+            nodeBounds = Aabb::combine(nodeBounds, bounds[items[i]]);
+        }
+        nodes[nodeIndex].bounds = nodeBounds;
+
+        if (end - begin <= maxLeafItems) {
+            nodes[nodeIndex].first = begin;
+            nodes[nodeIndex].itemCount = end - begin;
+            return;
+        }
+
+        // Split at the median of the longer axis, which keeps the hierarchy balanced no matter how the entities are spread.
+        int axis = nodeBounds.max[0] - nodeBounds.min[0] >= nodeBounds.max[1] - nodeBounds.min[1] ? 0 : 1;
+        uint32_t middle = begin + (end - begin) / 2;
+        std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end, [&](uint32_t left, uint32_t right) {
+            return bounds[left].min[axis] + bounds[left].max[axis] < bounds[right].min[axis] + bounds[right].max[axis];
+        });
+
+        uint32_t children = static_cast<uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + 2);
+        nodes[nodeIndex].first = children;
+        nodes[nodeIndex].itemCount = 0;
+
+        buildSpatialNode(nodes, items, bounds, children, begin, middle);
+        buildSpatialNode(nodes, items, bounds, children + 1, middle, end);
+    }
+}
+
+void Level::open(const std::string& filename) {
+    close();
+
+    // Spawning a level reads it mostly from front to back, so reading ahead saves page faults.
+    file.open(filename, MappedFileAccess::Sequential);
+    try {
+        useData(file.data());
+    } catch (...) {
+        file.close();
+        throw;
+    }
+}
+
+void Level::open(std::span<const char> levelData) {
+    close();
+    useData(levelData);
+}
+
+void Level::useData(std::span<const char> levelData) {
+    if (levelData.size() < sizeof(LevelHeader)) {
+        throw std::runtime_error("level is truncated!");
+    }
+
+    const LevelHeader* levelHeader = reinterpret_cast<const LevelHeader*>(levelData.data());
+    if (levelHeader->magic != levelMagic || levelHeader->version != levelVersion) {
+        throw std::runtime_error("level has an unknown format!");
+    }
+    if (levelHeader->size > levelData.size()) {
+        throw std::runtime_error("level is truncated!");
+    }
+
+    // Only the sections as a whole are checked here. References between them are checked when they are followed.
+    for (uint32_t id = 0; id < levelSectionCount; id++) {
+        const LevelSection& section = levelHeader->sections[id];
+        if (section.offset % levelAlignment != 0 || section.offset > levelHeader->size ||
+            section.count > (levelHeader->size - section.offset) / sectionElementSizes[id]) {
+            throw std::runtime_error("level section is out of bounds!");
+        }
+    }
+
+    data = levelData.first(static_cast<size_t>(levelHeader->size));
+    header = levelHeader;
+}
+
+void Level::close() {
+    file.close();
+    data = {};
+    header = nullptr;
+}
+
+std::span<const LevelSprite> Level::sprites(const LevelEntity& entity) const {
+    std::span<const LevelSprite> all = section<LevelSprite>(levelSprites);
+    if (entity.firstSprite > all.size() || entity.spriteCount > all.size() - entity.firstSprite) {
+        throw std::runtime_error("level entity sprites are out of bounds!");
+    }
+    return all.subspan(entity.firstSprite, entity.spriteCount);
+}
+
+std::span<const uint16_t> Level::tiles(const LevelTilemap& tilemap) const {
+    std::span<const uint16_t> all = section<uint16_t>(levelTiles);
+    uint64_t count = static_cast<uint64_t>(tilemap.width) * tilemap.height;
+    if (tilemap.firstTile > all.size() || count > all.size() - tilemap.firstTile) {
+        throw std::runtime_error("level tilemap is out of bounds!");
+    }
+    return all.subspan(static_cast<size_t>(tilemap.firstTile), static_cast<size_t>(count));
+}
+
+std::string_view Level::string(const LevelString& string) const {
+    std::span<const char> strings = section<char>(levelStrings);
+    if (string.offset > strings.size() || string.length > strings.size() - string.offset) {
+        throw std::runtime_error("level string is out of bounds!");
+    }
+    return { strings.data() + string.offset, string.length };
+}
+
+uint32_t LevelBuilder::addEntity(std::string_view name, uint32_t parent, const Transform2D& transform) {
+    if (parent != levelNone && parent >= builtEntities.size()) {
+        throw std::invalid_argument("the parent of a level entity must be added before it!");
+    }
+
+    Entity entity {};
+    entity.entity.transform = transform;
+    entity.entity.parent = parent;
+    entity.name = name;
+    builtEntities.push_back(std::move(entity));
+    return static_cast<uint32_t>(builtEntities.size() - 1);
+}
+
+void LevelBuilder::addSprite(uint32_t entity, std::string_view image, const AtlasUvRect& uv, float width, float height,
+                             const float color[4], float layer) {
+    LevelSprite sprite {};
+    sprite.uv = uv;
+    sprite.size[0] = width;
+    sprite.size[1] = height;
+    std::memcpy(sprite.color, color, sizeof(sprite.color));
+    sprite.layer = layer;
+
+    builtEntities.at(entity).sprites.push_back(sprite);
+    builtEntities.at(entity).images.emplace_back(image);
+}
+
+void LevelBuilder::addTilemap(std::string_view tileset, const AtlasUvRect& tilesetUv, uint32_t tilesetColumns, uint32_t tilesetRows,
+                              float originX, float originY, float tileWidth, float tileHeight, uint32_t width, uint32_t height,
+                              std::span<const uint16_t> tiles, float layer) {
+    if (tiles.size() != static_cast<size_t>(width) * height) {
+        throw std::invalid_argument("a tilemap needs exactly one tile per cell!");
+    }
+
+    Tilemap tilemap {};
+    tilemap.tilemap.origin[0] = originX;
+    tilemap.tilemap.origin[1] = originY;
+    tilemap.tilemap.tileSize[0] = tileWidth;
+    tilemap.tilemap.tileSize[1] = tileHeight;
+    tilemap.tilemap.width = width;
+    tilemap.tilemap.height = height;
+    tilemap.tilemap.tilesetUv = tilesetUv;
+    tilemap.tilemap.tilesetColumns = tilesetColumns;
+    tilemap.tilemap.tilesetRows = tilesetRows;
+    tilemap.tilemap.layer = layer;
+    tilemap.tileset = tileset;
+    tilemap.tiles.assign(tiles.begin(), tiles.end());
+    builtTilemaps.push_back(std::move(tilemap));
+}
+
+std::vector<char> LevelBuilder::build() const {
+    std::vector<LevelEntity> entities;
+    std::vector<LevelSprite> sprites;
+    std::vector<LevelTilemap> tilemaps;
+    std::vector<uint16_t> tiles;
+    std::string strings;
+
+    auto addString = [&](const std::string& string) {
+        LevelString levelString { static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(string.size()) };
+        strings += string;
+        return levelString;
+    };
+
+    // Parents always come before their children, so their world transforms are known by the time a child needs them.
+    std::vector<Affine2D> worlds(builtEntities.size());
+    std::vector<Aabb> entityBounds(builtEntities.size());
+    for (size_t i = 0; i < builtEntities.size(); i++) {
+        const Entity& built = builtEntities[i];
+        Affine2D local = Affine2D::fromTransform(built.entity.transform);
+        worlds[i] = built.entity.parent == levelNone ? local : worlds[built.entity.parent] * local;
+
+        LevelEntity entity = built.entity;
+        entity.firstSprite = static_cast<uint32_t>(sprites.size());
+        entity.spriteCount = static_cast<uint32_t>(built.sprites.size());
+        entity.name = addString(built.name);
+        entities.push_back(entity);
+
+        entityBounds[i] = pointBounds(worlds[i].tx, worlds[i].ty);
+        for (size_t j = 0; j < built.sprites.size(); j++) {
+            LevelSprite sprite = built.sprites[j];
+            sprite.image = addString(built.images[j]);
+            sprites.push_back(sprite);
+
+            Aabb spriteBounds = quadBounds(worlds[i], sprite.size[0], sprite.size[1]);
+            entityBounds[i] = j == 0 ? spriteBounds : Aabb::combine(entityBounds[i], spriteBounds);
+        }
+        entities.back().bounds = entityBounds[i];
+    }
+
+    std::vector<LevelSpatialNode> nodes;
+    std::vector<uint32_t> items(builtEntities.size());
+    for (uint32_t i = 0; i < items.size(); i++) {
+        items[i] = i;
+    }
+    if (!items.empty()) {
+        nodes.resize(1);
+        buildSpatialNode(nodes, items, entityBounds, 0, 0, static_cast<uint32_t>(items.size()));
+    }
+
+    Aabb levelBounds = nodes.empty() ? Aabb {} : nodes[0].bounds;
+    bool haveBounds = !nodes.empty();
+    for (const Tilemap& built : builtTilemaps) {
+        LevelTilemap tilemap = built.tilemap;
+        tilemap.firstTile = tiles.size();
+        tilemap.tileset = addString(built.tileset);
+        tilemaps.push_back(tilemap);
+        tiles.insert(tiles.end(), built.tiles.begin(), built.tiles.end());
+
+        Aabb tilemapBounds {};
+        tilemapBounds.min[0] = tilemap.origin[0];
+        tilemapBounds.min[1] = tilemap.origin[1];
+        tilemapBounds.max[0] = tilemap.origin[0] + tilemap.tileSize[0] * tilemap.width;
+        tilemapBounds.max[1] = tilemap.origin[1] + tilemap.tileSize[1] * tilemap.height;
+        levelBounds = haveBounds ? Aabb::combine(levelBounds, tilemapBounds) : tilemapBounds;
+        haveBounds = true;
+    }
+
+    LevelHeader header {};
+    header.magic = levelMagic;
+    header.version = levelVersion;
+    header.bounds = levelBounds;
+
+    const void* sectionData[levelSectionCount] = {
+        entities.data(), sprites.data(), tilemaps.data(), tiles.data(), nodes.data(), items.data(), strings.data(),
+    };
+    const size_t sectionCounts[levelSectionCount] = {
+        entities.size(), sprites.size(), tilemaps.size(), tiles.size(), nodes.size(), items.size(), strings.size(),
+    };
+
+    uint64_t offset = alignUp(sizeof(LevelHeader), levelAlignment);
+    for (uint32_t id = 0; id < levelSectionCount; id++) {
+        header.sections[id].offset = offset;
+        header.sections[id].count = sectionCounts[id];
+        offset = alignUp(offset + sectionCounts[id] * sectionElementSizes[id], levelAlignment);
+    }
+    header.size = offset;
+
+    std::vector<char> level(static_cast<size_t>(header.size), 0);
+    std::memcpy(level.data(), &header, sizeof(header));
+    for (uint32_t id = 0; id < levelSectionCount; id++) {
+        if (sectionCounts[id] > 0) {
+            std::memcpy(level.data() + header.sections[id].offset, sectionData[id], sectionCounts[id] * sectionElementSizes[id]);
+        }
+    }
+    return level;
+}
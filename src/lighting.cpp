@@ -0,0 +1,483 @@
+#include "lighting.h"
+#include "vulkanhelper.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+void LightingSystem::init(VkPhysicalDevice physicalDevice, VkDevice device, VkExtent2D extent, uint32_t graphicsFamily,
+                          AsyncCompute& asyncCompute, UploadManager& uploadManager, std::span<const char> cullShaderCode,
+                          HostAllocationTracker& hostAllocations) {
+    this->physicalDevice = physicalDevice;
+    logicalDevice = device;
+    this->hostAllocations = &hostAllocations;
+    framebufferExtent = extent;
+    setRenderExtent(extent, 1.0f);
+
+    // Albedo and normals are only written and read within the render pass, so they can be transient.
+    createAttachment(albedoFormat, albedo);
+    createAttachment(normalFormat, normal);
+
+    // Lights are written by the CPU and read by the culling pass, and tile lists are written by the culling pass and read by the lighting subpass.
+    // With a dedicated compute queue, both are shared between the two queue families.
+    std::array<uint32_t, 2> queueFamilies = { asyncCompute.queueFamily(), graphicsFamily };
+    std::span<const uint32_t> sharedQueueFamilies = asyncCompute.usesDedicatedComputeQueue()
+        ? std::span<const uint32_t>(queueFamilies)
+        : std::span<const uint32_t>();
+
+    // Each tile list is a count followed by up to "maxLightsPerTile" light indices. There's room for the tiles of the whole framebuffer.
+    VkDeviceSize tileBufferSize = static_cast<VkDeviceSize>(tileCountX) * tileCountY * (maxLightsPerTile + 1) * sizeof(uint32_t);
+
+    for (auto& slot : slots) {
+        createBuffer(physicalDevice, logicalDevice, maxLights * sizeof(Light), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     slot.lightBuffer, slot.lightMemory, sharedQueueFamilies);
+
+        void* mapped = nullptr;
+        vkMapMemory(logicalDevice, slot.lightMemory, 0, maxLights * sizeof(Light), 0, &mapped);
+        slot.mappedLights = static_cast<Light*>(mapped);
+
+        createBuffer(physicalDevice, logicalDevice, tileBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, slot.tileBuffer, slot.tileMemory, sharedQueueFamilies);
+    }
+
+    // Material textures are sampled with the sprite's texture coordinates, and shouldn't wrap around at the sprite's edges.
+    // They can come with a mip chain, which is blended between levels as sprites are scaled down.
+    VkSamplerCreateInfo samplerInfo {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(logicalDevice, &samplerInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_SAMPLER), &materialSampler) != VK_SUCCESS) {
+        std::cout << "Failed to create material sampler." << std::endl;
+        std::terminate();
+    }
+
+    createDescriptors();
+
+    // A flat normal map points straight at the viewer, so sprites without a normal map are lit like flat surfaces.
+    flatNormalMap.texture.width = 1;
+    flatNormalMap.texture.height = 1;
+    flatNormalMap.texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+    flatNormalMap.texture.pixels = { 128, 128, 255, 255 };
+    uploadTexture(flatNormalMap.texture, { physicalDevice, logicalDevice, &uploadManager });
+
+    // Albedo maps multiply the sprite's color, so a white one leaves it as it is.
+    whiteAlbedoMap.width = 1;
+    whiteAlbedoMap.height = 1;
+    whiteAlbedoMap.pixels = { 255, 255, 255, 255 };
+    uploadTexture(whiteAlbedoMap, { physicalDevice, logicalDevice, &uploadManager });
+
+    defaultMaterial = createMaterialSet(flatNormalMap.texture.imageView);
+
+    // The culling pipeline is a compute pipeline, which only has a single shader stage and no fixed function state.
+    VkShaderModule cullShaderModule = createShaderModule(logicalDevice, cullShaderCode);
+
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &cullPipelineLayout) != VK_SUCCESS) {
+        std::cout << "Failed to create light culling pipeline layout." << std::endl;
+        std::terminate();
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = cullShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = cullPipelineLayout;
+
+    if (vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_PIPELINE), &cullPipeline) != VK_SUCCESS) {
+        std::cout << "Failed to create light culling pipeline." << std::endl;
+        std::terminate();
+    }
+
+    vkDestroyShaderModule(logicalDevice, cullShaderModule, nullptr);
+
+    asyncCompute.addPass("Light culling", [this](VkCommandBuffer commandBuffer, uint32_t slot) {
+        recordCulling(commandBuffer, slot);
+    });
+}
+
+void LightingSystem::createPipeline(VkRenderPass renderPass, uint32_t subpass, std::span<const char> vertexShaderCode, std::span<const char> fragmentShaderCode) {
+    VkShaderModule vertexShaderModule = createShaderModule(logicalDevice, vertexShaderCode);
+    VkShaderModule fragmentShaderModule = createShaderModule(logicalDevice, fragmentShaderCode);
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertexShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragmentShaderModule;
+    shaderStages[1].pName = "main";
+
+    // The lighting subpass draws a single triangle covering the whole framebuffer, generated in the vertex shader.
+    VkPipelineVertexInputStateCreateInfo vertexInputState {};
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState {};
+    inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPipelineViewportStateCreateInfo viewportState {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationState {};
+    rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationState.cullMode = VK_CULL_MODE_NONE;
+    rasterizationState.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizationState.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleState {};
+    multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendState {};
+    colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendState.attachmentCount = 1;
+    colorBlendState.pAttachments = &colorBlendAttachment;
+
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &lightingLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &lightingPipelineLayout) != VK_SUCCESS) {
+        std::cout << "Failed to create lighting pipeline layout." << std::endl;
+        std::terminate();
+    }
+
+    VkGraphicsPipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputState;
+    pipelineInfo.pInputAssemblyState = &inputAssemblyState;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizationState;
+    pipelineInfo.pMultisampleState = &multisampleState;
+    pipelineInfo.pColorBlendState = &colorBlendState;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = lightingPipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = subpass;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE), &lightingPipeline) != VK_SUCCESS) {
+        std::cout << "Failed to create lighting pipeline." << std::endl;
+        std::terminate();
+    }
+
+    vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+    vkDestroyShaderModule(logicalDevice, fragmentShaderModule, nullptr);
+}
+
+void LightingSystem::destroy() {
+    vkDestroyPipeline(logicalDevice, lightingPipeline, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE));
+    vkDestroyPipeline(logicalDevice, cullPipeline, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE));
+    vkDestroyPipelineLayout(logicalDevice, lightingPipelineLayout, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+    vkDestroyPipelineLayout(logicalDevice, cullPipelineLayout, hostAllocations->callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+
+    // Destroying the pool frees all descriptor sets allocated from it.
+    vkDestroyDescriptorPool(logicalDevice, descriptorPool, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+    vkDestroyDescriptorSetLayout(logicalDevice, cullLayout, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+    vkDestroyDescriptorSetLayout(logicalDevice, lightingLayout, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+    vkDestroyDescriptorSetLayout(logicalDevice, materialLayout, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+
+    destroyTexture(logicalDevice, flatNormalMap.texture);
+    destroyTexture(logicalDevice, whiteAlbedoMap);
+    vkDestroySampler(logicalDevice, materialSampler, hostAllocations->callbacks(VK_OBJECT_TYPE_SAMPLER));
+
+    for (auto& slot : slots) {
+        vkUnmapMemory(logicalDevice, slot.lightMemory);
+        vkDestroyBuffer(logicalDevice, slot.lightBuffer, nullptr);
+        vkFreeMemory(logicalDevice, slot.lightMemory, nullptr);
+        vkDestroyBuffer(logicalDevice, slot.tileBuffer, nullptr);
+        vkFreeMemory(logicalDevice, slot.tileMemory, nullptr);
+    }
+
+    for (Attachment* attachment : { &albedo, &normal }) {
+        vkDestroyImageView(logicalDevice, attachment->imageView, nullptr);
+        vkDestroyImage(logicalDevice, attachment->image, nullptr);
+        vkFreeMemory(logicalDevice, attachment->memory, nullptr);
+    }
+}
+
+void LightingSystem::setLights(std::span<const Light> lights) {
+    size_t count = std::min<size_t>(lights.size(), maxLights);
+    this->lights.assign(lights.begin(), lights.begin() + count);
+}
+
+void LightingSystem::setRenderExtent(VkExtent2D extent, float scale) {
+    renderExtent = extent;
+    renderScale = scale;
+    tileCountX = (extent.width + tileSize - 1) / tileSize;
+    tileCountY = (extent.height + tileSize - 1) / tileSize;
+}
+
+VkDescriptorSet LightingSystem::createMaterialSet(VkImageView normalMapView, VkImageView albedoMapView) {
+    VkDescriptorSetAllocateInfo allocInfo {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &materialLayout;
+
+    VkDescriptorSet materialSet;
+    if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &materialSet) != VK_SUCCESS) {
+        std::cout << "Failed to allocate material descriptor set." << std::endl;
+        std::terminate();
+    }
+    countDescriptorAllocations(1);
+
+    updateMaterialSet(materialSet, normalMapView, albedoMapView);
+    return materialSet;
+}
+
+void LightingSystem::updateMaterialSet(VkDescriptorSet materialSet, VkImageView normalMapView, VkImageView albedoMapView) {
+    // Both maps are in consecutive bindings, so a single write with two descriptors updates them.
+    std::array<VkDescriptorImageInfo, 2> imageInfos {};
+    imageInfos[0].sampler = materialSampler;
+    imageInfos[0].imageView = normalMapView != VK_NULL_HANDLE ? normalMapView : flatNormalMap.texture.imageView;
+    imageInfos[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfos[1].sampler = materialSampler;
+    imageInfos[1].imageView = albedoMapView != VK_NULL_HANDLE ? albedoMapView : whiteAlbedoMap.imageView;
+    imageInfos[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = materialSet;
+    write.dstBinding = 0;
+    write.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = imageInfos.data();
+    vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+}
+
+void LightingSystem::recordLighting(VkCommandBuffer commandBuffer, uint32_t slot, CommandCounters& counters) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightingPipelineLayout, 0, 1, &slots[slot].lightingSet, 0, nullptr);
+
+    PushConstants constants = pushConstants(slots[slot].lightCount);
+    vkCmdPushConstants(commandBuffer, lightingPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    counters.bindPipeline();
+    counters.draw(1);
+}
+
+void LightingSystem::createAttachment(VkFormat format, Attachment& attachment) {
+    // VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT tells the implementation that the contents never have to be kept in memory
+    // outside of the render pass, and VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT lets the lighting subpass read them.
+    createImage(physicalDevice, logicalDevice, framebufferExtent.width, framebufferExtent.height, 1, format,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, attachment.image, attachment.memory);
+    attachment.imageView = createImageView(logicalDevice, attachment.image, format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+void LightingSystem::createDescriptors() {
+    // Culling: the lights, and the tile lists it writes.
+    std::array<VkDescriptorSetLayoutBinding, 2> cullBindings {};
+    for (uint32_t i = 0; i < cullBindings.size(); i++) {
+        cullBindings[i].binding = i;
+        cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullBindings[i].descriptorCount = 1;
+        cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    // Lighting: albedo and normal input attachments, then the lights and tile lists.
+    std::array<VkDescriptorSetLayoutBinding, 4> lightingBindings {};
+    for (uint32_t i = 0; i < lightingBindings.size(); i++) {
+        lightingBindings[i].binding = i;
+        lightingBindings[i].descriptorType = i < 2 ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        lightingBindings[i].descriptorCount = 1;
+        lightingBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    // Materials: the normal map and the albedo map of a sprite.
+    std::array<VkDescriptorSetLayoutBinding, 2> materialBindings {};
+    for (uint32_t i = 0; i < materialBindings.size(); i++) {
+        materialBindings[i].binding = i;
+        materialBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        materialBindings[i].descriptorCount = 1;
+        materialBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+
+    layoutInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+    layoutInfo.pBindings = cullBindings.data();
+    VkResult cullResult = vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &cullLayout);
+
+    layoutInfo.bindingCount = static_cast<uint32_t>(lightingBindings.size());
+    layoutInfo.pBindings = lightingBindings.data();
+    VkResult lightingResult = vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &lightingLayout);
+
+    layoutInfo.bindingCount = static_cast<uint32_t>(materialBindings.size());
+    layoutInfo.pBindings = materialBindings.data();
+    VkResult materialResult = vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &materialLayout);
+
+    if (cullResult != VK_SUCCESS || lightingResult != VK_SUCCESS || materialResult != VK_SUCCESS) {
+        std::cout << "Failed to create lighting descriptor set layouts." << std::endl;
+        std::terminate();
+    }
+
+    std::array<VkDescriptorPoolSize, 3> poolSizes {};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[0].descriptorCount = AsyncCompute::slotCount * 4;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    poolSizes[1].descriptorCount = AsyncCompute::slotCount * 2;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = maxMaterialSets * 2;
+
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = AsyncCompute::slotCount * 2 + maxMaterialSets;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+
+    if (vkCreateDescriptorPool(logicalDevice, &poolInfo, hostAllocations->callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &descriptorPool) != VK_SUCCESS) {
+        std::cout << "Failed to create lighting descriptor pool." << std::endl;
+        std::terminate();
+    }
+
+    for (auto& slot : slots) {
+        std::array<VkDescriptorSetLayout, 2> layouts = { cullLayout, lightingLayout };
+        std::array<VkDescriptorSet, 2> sets {};
+
+        VkDescriptorSetAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+        allocInfo.pSetLayouts = layouts.data();
+
+        if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, sets.data()) != VK_SUCCESS) {
+            std::cout << "Failed to allocate lighting descriptor sets." << std::endl;
+            std::terminate();
+        }
+        countDescriptorAllocations(static_cast<uint32_t>(sets.size()));
+
+        slot.cullSet = sets[0];
+        slot.lightingSet = sets[1];
+
+        VkDescriptorBufferInfo lightBufferInfo { slot.lightBuffer, 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo tileBufferInfo { slot.tileBuffer, 0, VK_WHOLE_SIZE };
+        // Input attachments are read in the layout the subpass puts them in.
+        VkDescriptorImageInfo albedoInfo { VK_NULL_HANDLE, albedo.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkDescriptorImageInfo normalInfo { VK_NULL_HANDLE, normal.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+        std::array<VkWriteDescriptorSet, 6> writes {};
+        for (auto& write : writes) {
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.descriptorCount = 1;
+        }
+
+        writes[0].dstSet = slot.cullSet;
+        writes[0].dstBinding = 0;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[0].pBufferInfo = &lightBufferInfo;
+
+        writes[1].dstSet = slot.cullSet;
+        writes[1].dstBinding = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[1].pBufferInfo = &tileBufferInfo;
+
+        writes[2].dstSet = slot.lightingSet;
+        writes[2].dstBinding = 0;
+        writes[2].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        writes[2].pImageInfo = &albedoInfo;
+
+        writes[3].dstSet = slot.lightingSet;
+        writes[3].dstBinding = 1;
+        writes[3].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        writes[3].pImageInfo = &normalInfo;
+
+        writes[4].dstSet = slot.lightingSet;
+        writes[4].dstBinding = 2;
+        writes[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[4].pBufferInfo = &lightBufferInfo;
+
+        writes[5].dstSet = slot.lightingSet;
+        writes[5].dstBinding = 3;
+        writes[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[5].pBufferInfo = &tileBufferInfo;
+
+        vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void LightingSystem::recordCulling(VkCommandBuffer commandBuffer, uint32_t slotIndex) {
+    // The async compute slot is only handed out once the GPU is done with it, so its light buffer can be overwritten.
+    Slot& slot = slots[slotIndex];
+    slot.lightCount = static_cast<uint32_t>(lights.size());
+    if (renderScale == 1.0f && !lights.empty()) {
+        std::memcpy(slot.mappedLights, lights.data(), lights.size() * sizeof(Light));
+    } else {
+        // Lights are placed in output pixels, but the shaders work in the pixels of the (smaller) render extent.
+        for (size_t i = 0; i < lights.size(); i++) {
+            Light light = lights[i];
+            light.position[0] *= renderScale;
+            light.position[1] *= renderScale;
+            light.radius *= renderScale;
+            slot.mappedLights[i] = light;
+        }
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &slot.cullSet, 0, nullptr);
+
+    PushConstants constants = pushConstants(slot.lightCount);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+    // One workgroup per tile.
+    vkCmdDispatch(commandBuffer, tileCountX, tileCountY, 1);
+}
+
+LightingSystem::PushConstants LightingSystem::pushConstants(uint32_t lightCount) const {
+    PushConstants constants {};
+    constants.framebufferSize[0] = static_cast<float>(renderExtent.width);
+    constants.framebufferSize[1] = static_cast<float>(renderExtent.height);
+    constants.tileCountX = tileCountX;
+    constants.lightCount = lightCount;
+    std::copy(ambient.begin(), ambient.end(), constants.ambient);
+    constants.lightHeight = 64.0f * renderScale;
+    return constants;
+}
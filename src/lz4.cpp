@@ -0,0 +1,167 @@
+#include "lz4.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+    constexpr size_t minMatch = 4;
+    // The last 5 bytes of a block are always literals, and the last match has to start at least 12 bytes before the end.
+    constexpr size_t lastLiterals = 5;
+    constexpr size_t matchFindLimit = 12;
+    constexpr size_t maxOffset = 65535;
+    constexpr uint32_t hashBits = 12;
+
+    uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t hashSequence(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - hashBits);
+    }
+
+    void writeLength(std::vector<char>& out, size_t length) {
+        while (length >= 255) {
+            out.push_back(static_cast<char>(255));
+            length -= 255;
+        }
+        out.push_back(static_cast<char>(length));
+    }
+
+    void writeSequence(std::vector<char>& out, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength) {
+        size_t tokenMatch = matchLength >= minMatch ? matchLength - minMatch : 0;
+        uint8_t token = static_cast<uint8_t>((literalLength >= 15 ? 15 : literalLength) << 4);
+        token |= static_cast<uint8_t>(tokenMatch >= 15 ? 15 : tokenMatch);
+        out.push_back(static_cast<char>(token));
+
+        if (literalLength >= 15) {
+            writeLength(out, literalLength - 15);
+        }
+
+        out.insert(out.end(), literals, literals + literalLength);
+
+        // The last sequence of a block consists of literals only.
+        if (matchLength == 0) {
+            return;
+        }
+
+        out.push_back(static_cast<char>(offset & 0xFF));
+        out.push_back(static_cast<char>((offset >> 8) & 0xFF));
+
+        if (tokenMatch >= 15) {
+            writeLength(out, tokenMatch - 15);
+        }
+    }
+}
+
+std::vector<char> lz4CompressBlock(std::span<const char> input) {
+    const uint8_t* source = reinterpret_cast<const uint8_t*>(input.data());
+    const size_t size = input.size();
+
+    std::vector<char> out;
+    out.reserve(size + size / 255 + 16);
+
+    size_t anchor = 0;
+
+    if (size > matchFindLimit) {
+        // Remembers the last position every hashed 4 byte sequence was seen at.
+        std::vector<int64_t> table(size_t(1) << hashBits, -1);
+
+        const size_t matchLimit = size - lastLiterals;
+        const size_t inputLimit = size - matchFindLimit;
+
+        size_t position = 0;
+        while (position <= inputLimit) {
+            uint32_t sequence = read32(source + position);
+            uint32_t hash = hashSequence(sequence);
+            int64_t candidate = table[hash];
+            table[hash] = static_cast<int64_t>(position);
+
+            if (candidate < 0 || position - candidate > maxOffset || read32(source + candidate) != sequence) {
+                position++;
+                continue;
+            }
+
+            size_t matchLength = minMatch;
+            while (position + matchLength < matchLimit && source[candidate + matchLength] == source[position + matchLength]) {
+                matchLength++;
+            }
+
+            writeSequence(out, source + anchor, position - anchor, position - candidate, matchLength);
+
+            position += matchLength;
+            anchor = position;
+        }
+    }
+
+    writeSequence(out, source + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+bool lz4DecompressBlock(std::span<const char> input, std::span<char> output) {
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(input.data());
+    const uint8_t* inEnd = in + input.size();
+    uint8_t* out = reinterpret_cast<uint8_t*>(output.data());
+    uint8_t* const outStart = out;
+    uint8_t* const outEnd = out + output.size();
+
+    auto readLength = [&](size_t length) -> size_t {
+        if (length != 15) {
+            return length;
+        }
+
+        uint8_t extra = 255;
+        while (extra == 255 && in < inEnd) {
+            extra = *in++;
+            length += extra;
+        }
+        return length;
+    };
+
+    while (in < inEnd) {
+        uint8_t token = *in++;
+
+        size_t literalLength = readLength(token >> 4);
+        if (literalLength > static_cast<size_t>(inEnd - in) || literalLength > static_cast<size_t>(outEnd - out)) {
+            return false;
+        }
+
+        // An empty output has no buffer, and memcpy must not be given a null pointer, even for zero bytes.
+        if (literalLength > 0) {
+            std::memcpy(out, in, literalLength);
+        }
+        in += literalLength;
+        out += literalLength;
+
+        // The last sequence has no match part.
+        if (in == inEnd) {
+            break;
+        }
+
+        if (inEnd - in < 2) {
+            return false;
+        }
+
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        if (offset == 0 || offset > static_cast<size_t>(out - outStart)) {
+            return false;
+        }
+
+        size_t matchLength = readLength(token & 0x0F) + minMatch;
+        if (matchLength > static_cast<size_t>(outEnd - out)) {
+            return false;
+        }
+
+        // Matches can overlap the bytes they produce (an offset of 1 repeats a single byte), so this has to be a forward byte copy.
+        const uint8_t* match = out - offset;
+        for (size_t i = 0; i < matchLength; i++) {
+            out[i] = match[i];
+        }
+        out += matchLength;
+    }
+
+    return out == outEnd;
+}
@@ -2,19 +2,51 @@
 #include <string>
 #include <iostream>
 #include <optional>
+#include <span>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
 #include <vector>
 #include <set>
 
-#include "filehelper.h"
+#include "assetarchive.h"
+#include "assetloader.h"
+#include "asynccompute.h"
+#include "broadphase.h"
+#include "deletionqueue.h"
+#include "dynamicresolution.h"
+#include "framearena.h"
+#include "framebufferreadback.h"
+#include "framecapture.h"
+#include "hostallocator.h"
+#include "ktx2.h"
+#include "level.h"
+#include "lighting.h"
+#include "overdraw.h"
+#include "perfcounters.h"
+#include "perfoverlay.h"
+#include "platformwindow.h"
+#include "scenehierarchy.h"
+#include "spriteanimation.h"
+#include "spritebatch.h"
+#include "spritepipelines.h"
+#include "texturecache.h"
+#include "threadpool.h"
+#include "timeline.h"
+#include "uploadmanager.h"
+#include "vulkanhelper.h"
 
 // In order to use the Win32 WSI extensions, we need to define VK_USE_PLATFORM_WIN32_KHR before including vulkan.h
 #define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan/vulkan.h>
 
 // Forward Decl
-LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 bool checkValidationLayerSupport();
 VkDebugUtilsMessengerEXT setupDebugMessenger();
 void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& debugUtilsMessengerCreateInfo);
@@ -26,10 +58,17 @@ void createSwapChain();
 void createImageViews();
 void createGraphicsPipeline();
 void createRenderPass();
-VkShaderModule createShaderModule(const std::vector<char>& code);
+void createPresentRenderPass();
+void createDepthResources();
 void createFramebuffers();
 void createCommandPool();
-void createCommandBuffer();
+void createCommandBuffers();
+void invalidateScene();
+void updateSpriteMaterial();
+Aabb spriteBounds(const SpriteInstance& instance);
+void parseCommandLine(const std::string& commandLine);
+bool applyRenderPacket(const RenderPacket& packet);
+void spawnLevel();
 void drawFrame();
 void createSyncObjects();
 
@@ -37,6 +76,10 @@ struct QueueFamilyIndices {
     // Index to queue supporting graphics operations
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // Index to a queue family that only supports transfer operations, if the device has one.
+    std::optional<uint32_t> transferFamily;
+    // Index to a queue family that supports compute but not graphics operations, if the device has one.
+    std::optional<uint32_t> computeFamily;
 
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -93,6 +136,10 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
     }
 }
 
+// Counts the host memory the driver allocates for the objects we create. Every object created in this file passes
+// hostAllocations.callbacks() for its type to both its vkCreate* and vkDestroy* calls.
+HostAllocationTracker hostAllocations;
+
 VkInstance vkInstance;
 VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 VkDevice logicalDevice = VK_NULL_HANDLE;
@@ -102,12 +149,24 @@ std::vector<VkImage> swapChainImages;
 VkFormat swapChainImageFormat;
 VkExtent2D swapChainExtent;
 std::vector<VkImageView> swapChainImageViews;
-VkPipelineLayout pipelineLayout;
+// Renders the scene into the offscreen scene image, at the resolution picked by dynamicResolution.
 VkRenderPass renderPass;
-VkPipeline graphicsPipeline;
+// Upscales the scene image into the swapchain image, and draws everything that should stay at native resolution.
+VkRenderPass presentRenderPass;
+// Opaque sprites are drawn front to back with depth writes, translucent ones back to front with blending.
+// Without the depth prepass, only translucent variants are used, and every sprite is drawn back to front.
+SpritePipelines spritePipelines;
+// The features every sprite is drawn with. Each mask gets its own specialized variant of the sprite shaders.
+// With "useRuntimeFeatures", the variant that branches on the features at runtime is used instead, to compare against.
+SpriteFeatures spriteFeatures = spriteTinted | spriteLit;
+bool useRuntimeFeatures = false;
+VkFramebuffer sceneFramebuffer;
 std::vector<VkFramebuffer> swapChainFramebuffers;
 VkCommandPool commandPool;
-VkCommandBuffer commandBuffer;
+// One command buffer per swapchain image and async compute slot, so that a recorded frame can be submitted again for the same image.
+// The slot alternates every frame, so with an odd number of images, a buffer per image would never come back to the slot it
+// was recorded with. The buffer of an image and slot is at "imageIndex * AsyncCompute::slotCount + slot".
+std::vector<VkCommandBuffer> commandBuffers;
 VkSemaphore imageAvailableSemaphore;
 VkSemaphore renderFinishedSemaphore;
 VkFence inFlightFence;
@@ -125,6 +184,149 @@ std::array<const char*, 1> deviceExtensions = {
 // TODO: It is possible to have a single queue that simply supports both graphics and presentation. For now it's split up, but maybe combine them later.
 VkQueue graphicsQueue;
 VkQueue presentQueue;
+// If the device has no transfer-only queue family, this is the same queue as graphicsQueue.
+VkQueue transferQueue;
+// If the device has no compute family without graphics support, this is the same queue as graphicsQueue.
+VkQueue computeQueue;
+
+UploadManager uploadManager;
+
+AsyncCompute asyncCompute;
+
+// Lights the scene in a second subpass, using tile light lists built on the async compute queue.
+LightingSystem lightingSystem;
+
+// Scales the resolution the scene is rendered at, to keep the GPU frame time within budget.
+DynamicResolution dynamicResolution;
+
+// All assets are packed into a single archive, which is memory mapped once at startup.
+AssetArchive assetArchive;
+
+AssetLoader assetLoader;
+
+// Textures are streamed in and out through the cache, which keeps them within a memory budget.
+// The budget follows VK_EXT_memory_budget when the device supports it.
+bool useMemoryBudget = false;
+TextureCache textureCache;
+
+// The albedo map given with "--albedo <file>", streamed in through the texture cache. The sprites' material has the white albedo map
+// until the texture is resident, and is pointed at the texture once it is. Without one, sprites use the default material.
+std::string albedoPath;
+std::optional<TextureHandle> albedoTexture;
+VkDescriptorSet spriteMaterialSet = VK_NULL_HANDLE;
+// The view "spriteMaterialSet" was last written with.
+VkImageView spriteMaterialAlbedoView = VK_NULL_HANDLE;
+
+// Objects that are replaced at runtime are retired here instead of being destroyed right away.
+DeletionQueue deletionQueue;
+
+// Transient per-frame data (draw lists, sort keys, culling results) is allocated here instead of on the heap,
+// so that steady-state frames don't allocate at all. It's reset at the start of every rendered frame.
+FrameArena frameArena;
+
+// Workers for data-parallel work of the main loop, like transform propagation. Separate from the asset loader's I/O threads,
+// so a slow file read never holds up a frame.
+std::unique_ptr<ThreadPool> jobPool;
+
+// Layered backgrounds make blending every sprite back to front fill rate bound, since every layer is shaded even where it's hidden.
+// With "useDepthPrepass", the scene render pass gets a depth attachment, and opaque sprites are drawn first, front to back.
+// Fragments behind them then fail the early depth test, and are never shaded.
+// 16 bits of depth are enough to give each sprite of the batch a depth of its own, up to "maxSpriteCount" sprites.
+bool useDepthPrepass = true;
+constexpr VkFormat depthFormat = VK_FORMAT_D16_UNORM;
+VkImage depthImage = VK_NULL_HANDLE;
+VkDeviceMemory depthImageMemory = VK_NULL_HANDLE;
+VkImageView depthImageView = VK_NULL_HANDLE;
+
+// Set if the device can count fragment shader invocations, which "overdrawMeter" uses to measure overdraw.
+bool usePipelineStatistics = false;
+OverdrawMeter overdrawMeter;
+
+// Set if the surface lets swapchain images be copied from, which "framebufferReadback" needs for screenshots and recordings.
+bool swapChainReadable = false;
+FramebufferReadback framebufferReadback;
+// Screenshots and recordings are numbered, so taking another doesn't overwrite the previous one.
+uint32_t screenshotCount = 0;
+uint32_t recordingCount = 0;
+
+// Every sprite is drawn from this instance stream, in at most two draw calls.
+SpriteBatch spriteBatch;
+// Transforms of everything in the scene. Sprites attached to its nodes are moved along with them.
+SceneHierarchy sceneHierarchy;
+// Sprite-sheet animations, evaluated in one pass per frame on the CPU, or in the vertex shader for looping strips.
+SpriteAnimationSystem spriteAnimations;
+
+// Finds overlapping bodies for collision detection. Every sprite has a body, at the same index in "spriteBodies".
+Broadphase broadphase;
+std::vector<BodyId> spriteBodies;
+
+// The game window. Its messages are handled on a platform thread, which turns input into timestamped events.
+PlatformWindow platformWindow;
+// Keyboard and mouse state, as of the current fixed step.
+InputState inputState;
+// Game logic runs at a fixed rate, independent of the frame rate. A frame runs at most "maxStepsPerFrame" steps to catch up.
+constexpr double fixedStepSeconds = 1.0 / 60.0;
+constexpr uint32_t maxStepsPerFrame = 5;
+
+// Every submitted frame gets a value, starting at 1. Objects are retired with the value of the last frame that used them.
+// "completedFrameValue" is the value of the newest frame the GPU is known to have finished.
+uint64_t submittedFrameValue = 0;
+uint64_t completedFrameValue = 0;
+
+// Menus and paused states render the exact same thing frame after frame, so recording their command buffers again is wasted work.
+// When "reuseCommandBuffers" is set, the command buffer of each swapchain image is only re-recorded if "sceneVersion" changed
+// since it was recorded. Anything that changes what is drawn, or the dynamic state it's drawn with, must call invalidateScene().
+// When "skipUnchangedFrames" is also set, nothing is rendered or presented at all while the scene stays unchanged,
+// since the last presented image already shows it.
+bool reuseCommandBuffers = true;
+bool skipUnchangedFrames = true;
+uint64_t sceneVersion = 1;
+uint64_t presentedSceneVersion = 0;
+// The scene version each command buffer was recorded with.
+std::vector<uint64_t> recordedSceneVersions;
+// The commands recorded into each command buffer, which count towards every frame that submits it.
+std::vector<CommandCounters> recordedCommandCounters;
+
+// Always-on counters of what every frame costs. F3 shows them over the frame. From the command line:
+//   --perf-overlay       starts with the overlay shown
+//   --perf-dump <file>   appends the averages of the counters to <file> every second, as a line of JSON
+PerfCounters perfCounters;
+PerfOverlay perfOverlay;
+// The upload manager counts bytes since startup, and the frames count the difference. So does the frame arena, with its heap allocations.
+uint64_t countedUploadBytes = 0;
+uint64_t countedArenaHeapAllocations = 0;
+
+// The Vulkan version of the instance, which caps the version of device functionality we may use.
+uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+
+// Set if the device supports timeline semaphores (Vulkan 1.2). Frames then signal "graphicsTimeline" with their frame value,
+// instead of signaling "inFlightFence", and the upload manager does the same with its tickets on its own timeline.
+bool useTimelineSemaphores = false;
+QueueTimeline graphicsTimeline {};
+
+// Frame capture and replay, enabled from the command line:
+//   --capture <file>          writes the render packet of every rendered frame to <file>
+//   --replay <file>           renders the frames of <file> instead of running the game, as fast as possible
+//   --replay-realtime         replays the frames with the timing they were captured with
+//   --replay-timings <file>   writes the CPU time of every replayed frame to <file>, as CSV
+// A replay renders exactly the frames that were captured, so renderer changes can be measured on the same frames, and rendering bugs
+// reproduced without playing the game up to them.
+FrameCaptureWriter frameCapture;
+FrameCaptureReader frameReplay;
+RenderPacket replayPacket;
+bool replayRealtime = false;
+std::string replayTimingsFile;
+
+// The level given with "--level <file>". It's mapped and used in place, and its entities and tilemaps are spawned into the scene.
+Level level;
+
+// The sprite batch holds at least "minSpriteCount" sprites, or more if the level needs them. Levels with more sprites than 16-bit depth
+// can tell apart are rejected, since sprites sharing a depth would hide each other where they overlap.
+constexpr uint32_t minSpriteCount = 16 * 1024;
+constexpr uint32_t maxSpriteCount = 65534;
+// The body of the demo composite, and an arm and hand sprite for each of its arms.
+constexpr uint32_t demoArmCount = 6;
+constexpr uint32_t demoSpriteCount = 1 + 2 * demoArmCount;
 
 // Windows Desktop Applications have a WinMain function as the entrypoint.
 int WINAPI WinMain(
@@ -135,48 +337,10 @@ int WINAPI WinMain(
 {
     RedirectIOToConsole();
 
-    WNDCLASSEX wcex = {};
-
-    std::string window_class_name = "Main Game Window";
+    parseCommandLine(lpCmdLine);
 
-    // Size in bytes of structure. Must always be set to sizeof(WNDCLASSEX)
-    wcex.cbSize = sizeof(WNDCLASSEX);
-    wcex.style = CS_HREDRAW | CS_VREDRAW;
-    wcex.lpfnWndProc = WindowProc;
-    wcex.hInstance = hInstance;
-    wcex.hCursor = LoadCursor(NULL, IDC_ARROW);
-    wcex.lpszClassName = window_class_name.c_str();
-
-    if (!RegisterClassEx(&wcex))
-    {
-        std::cout << "Failed to register window class." << std::endl;
-        std::terminate();
-    }
-
-    // Create window using the window class
-    std::string window_title = "2D Beagle";
-
-    // If CreateWindowEx fails, it returns NULL.
-    HWND hwnd = CreateWindowEx(
-        0,
-        window_class_name.c_str(),
-        window_title.c_str(),
-        WS_OVERLAPPEDWINDOW,
-        CW_USEDEFAULT, CW_USEDEFAULT,
-        800, 600,
-        NULL,
-        NULL,
-        hInstance,
-        NULL
-    );
-
-    if (!hwnd)
-    {
-        std::cout << "Failed to create window." << std::endl;
-        std::terminate();
-    }
-
-    ShowWindow(hwnd, nCmdShow);
+    // The window and its message loop live on their own thread. Input reaches us through "platformWindow"'s event queue.
+    HWND hwnd = static_cast<HWND>(platformWindow.create(hInstance, nCmdShow, "2D Beagle", 800, 600));
 
     // Create Vulkan Instance
     // The Vulkan Instance is the connection between your application and the Vulkan library.
@@ -188,7 +352,16 @@ int WINAPI WinMain(
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    // vkEnumerateInstanceVersion was added in Vulkan 1.1, so if the loader doesn't have it, we are dealing with a Vulkan 1.0 loader.
+    // A 1.0 implementation rejects instances asking for any other version, so we only ask for 1.2 when it's available.
+    // Timeline semaphores are optional, and everything else works with 1.0.
+    auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+    if (enumerateInstanceVersion != nullptr) {
+        enumerateInstanceVersion(&instanceApiVersion);
+    }
+
+    instanceApiVersion = instanceApiVersion >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2 : VK_API_VERSION_1_0;
+    appInfo.apiVersion = instanceApiVersion;
 
     // Instance extensions are extensions that affect the Vulkan instance itself, rather than a specific device.
     // They extend the capabilities of the Vulkan instance itself, and affect the entire application.
@@ -216,7 +389,7 @@ int WINAPI WinMain(
     populateDebugMessengerCreateInfo(debugUtilsMessengerCreateInfo);
     instanceCreateInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*) &debugUtilsMessengerCreateInfo;
 
-    if (vkCreateInstance(&instanceCreateInfo, nullptr, &vkInstance) != VK_SUCCESS)
+    if (vkCreateInstance(&instanceCreateInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_INSTANCE), &vkInstance) != VK_SUCCESS)
     {
         std::cout << "Failed to create Vulkan instance!" << std::endl;
         std::terminate();
@@ -232,83 +405,480 @@ int WINAPI WinMain(
 
     // vkCreateWin32SurfaceKHR is technically an extension function, but because it is so commonly used
     // the standard Vulkan loader includes it.
-    if (vkCreateWin32SurfaceKHR(vkInstance, &VkWin32SurfaceCreateInfo, nullptr, &surface) != VK_SUCCESS) {
+    if (vkCreateWin32SurfaceKHR(vkInstance, &VkWin32SurfaceCreateInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_SURFACE_KHR), &surface) != VK_SUCCESS) {
         std::cout << "Failed to create Win32 surface!" << std::endl;
         std::terminate();
     }
 
+    // The archive is produced by the "2dbeagle_assets" target, and placed next to the executable.
+    assetArchive.open("assets.bpak");
+
     pickPhysicalDevice();
     createLogicalDevice();
     createSwapChain();
     createImageViews();
-    createGraphicsPipeline();
-    createRenderPass();
-    createFramebuffers();
     createCommandPool();
-    createCommandBuffer();
     createSyncObjects();
 
-    MSG msg = {};
+    deletionQueue.init(logicalDevice);
+    frameArena.init(1024 * 1024);
+    // Every sprite of the level and every tile of its tilemaps may become a sprite. Empty tiles don't, so this can be more than needed.
+    uint64_t spriteCount = demoSpriteCount;
+    if (level.isOpen()) {
+        spriteCount += level.spriteCount() + level.tileCount();
+    }
+    if (spriteCount > maxSpriteCount) {
+        std::cout << "Level has " << spriteCount - demoSpriteCount << " sprites and tiles, but at most "
+                  << maxSpriteCount - demoSpriteCount << " are supported." << std::endl;
+        std::terminate();
+    }
+    spriteBatch.init(physicalDevice, logicalDevice, spriteCount > minSpriteCount ? static_cast<uint32_t>(spriteCount) : minSpriteCount,
+                     useDepthPrepass);
+
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+    uploadManager.init(physicalDevice, logicalDevice,
+        queueFamilyIndices.transferFamily.value_or(queueFamilyIndices.graphicsFamily.value()), transferQueue,
+        queueFamilyIndices.graphicsFamily.value(), graphicsQueue,
+        32 * 1024 * 1024, useTimelineSemaphores);
+
+    asyncCompute.init(physicalDevice, logicalDevice,
+        queueFamilyIndices.computeFamily.value_or(queueFamilyIndices.graphicsFamily.value()), computeQueue,
+        queueFamilyIndices.graphicsFamily.value(), useTimelineSemaphores ? &graphicsTimeline : nullptr, hostAllocations);
+
+    // The scene image uses the swapchain format, so the upscale doesn't change how colors are encoded.
+    // Each command buffer measures its own GPU time, so there's one set of timestamps per swapchain image.
+    DynamicResolutionSettings dynamicResolutionSettings {};
+    dynamicResolution.init(physicalDevice, logicalDevice, queueFamilyIndices.graphicsFamily.value(), swapChainExtent, swapChainImageFormat,
+        static_cast<uint32_t>(swapChainImages.size()), dynamicResolutionSettings, hostAllocations);
+    overdrawMeter.init(logicalDevice, usePipelineStatistics, static_cast<uint32_t>(swapChainImages.size()));
+    framebufferReadback.init(physicalDevice, logicalDevice, queueFamilyIndices.graphicsFamily.value(), swapChainExtent, swapChainImageFormat,
+        swapChainReadable, hostAllocations);
+    perfOverlay.init(physicalDevice, logicalDevice);
+
+    // The lighting system owns the extra attachments of the render pass, and the material layout of the graphics pipeline,
+    // so it's created before both. Pipelines are created for a specific render pass, so the render pass comes before the pipelines.
+    // Its attachments are rendered together with the scene image, so they have the same size.
+    lightingSystem.init(physicalDevice, logicalDevice, dynamicResolution.maxExtent(), queueFamilyIndices.graphicsFamily.value(),
+        asyncCompute, uploadManager, assetArchive.get("shaders/lightcull_comp.spv"), hostAllocations);
+    lightingSystem.setRenderExtent(dynamicResolution.renderExtent(), dynamicResolution.scale());
+    createDepthResources();
+    createRenderPass();
+    createPresentRenderPass();
+    lightingSystem.createPipeline(renderPass, 1, assetArchive.get("shaders/fullscreen_vert.spv"), assetArchive.get("shaders/lighting_frag.spv"));
+    dynamicResolution.createPipeline(presentRenderPass, 0, assetArchive.get("shaders/fullscreen_vert.spv"), assetArchive.get("shaders/upscale_frag.spv"));
+    perfOverlay.createPipeline(presentRenderPass, 0, assetArchive.get("shaders/overlay_vert.spv"), assetArchive.get("shaders/overlay_frag.spv"));
+    createGraphicsPipeline();
+    createFramebuffers();
+    createCommandBuffers();
+
+    // A warm light in the middle of the window, and a cool spot light shining in from the left.
+    std::array<Light, 2> lights {};
+    lights[0].position[0] = swapChainExtent.width * 0.5f;
+    lights[0].position[1] = swapChainExtent.height * 0.5f;
+    lights[0].radius = swapChainExtent.width * 0.5f;
+    lights[0].color[2] = 0.8f;
+    lights[1].position[0] = 0.0f;
+    lights[1].position[1] = swapChainExtent.height * 0.5f;
+    lights[1].radius = static_cast<float>(swapChainExtent.width);
+    lights[1].color[0] = 0.6f;
+    lights[1].type = LightType::Spot;
+    lights[1].cosInnerAngle = 0.95f;
+    lights[1].cosOuterAngle = 0.85f;
+    lightingSystem.setLights(lights);
+
+    // File reads and decoding run on I/O threads, leaving one hardware thread for the main loop.
+    uint32_t ioThreadCount = std::clamp(std::thread::hardware_concurrency(), 2u, 5u) - 1;
+    assetLoader.init(ioThreadCount, &assetArchive, { physicalDevice, logicalDevice, &uploadManager });
+    textureCache.init({ physicalDevice, logicalDevice, &uploadManager }, assetLoader, deletionQueue, useMemoryBudget, TextureCacheSettings {});
+
+    spriteMaterialSet = lightingSystem.defaultMaterialSet();
+    if (!albedoPath.empty()) {
+        albedoTexture = textureCache.add(albedoPath);
+        spriteMaterialSet = lightingSystem.createMaterialSet(VK_NULL_HANDLE);
+    }
+
+    // The main thread takes part in parallel jobs as well, so it doesn't count towards the workers.
+    jobPool = std::make_unique<ThreadPool>(std::clamp(std::thread::hardware_concurrency(), 2u, 17u) - 1);
+
+    // A small composite: a body in the middle of the window, with arms around it that each hold a smaller sprite.
+    // Moving, rotating or scaling a node moves all of its children along with it.
+    NodeId body = sceneHierarchy.createNode(SceneHierarchy::invalidNode,
+        { { swapChainExtent.width * 0.5f, swapChainExtent.height * 0.5f }, 0.0f, { 1.0f, 1.0f } });
+    SpriteInstance bodySprite {};
+    bodySprite.color[1] = 0.6f;
+    bodySprite.color[2] = 0.4f;
+    sceneHierarchy.attachSprite(body, spriteBatch.add(bodySprite), 160.0f, 160.0f);
+
+    for (uint32_t i = 0; i < demoArmCount; i++) {
+        float angle = i * (2.0f * 3.14159265f / demoArmCount);
+        NodeId arm = sceneHierarchy.createNode(body, { { 0.0f, 0.0f }, angle, { 1.0f, 1.0f } });
+        NodeId hand = sceneHierarchy.createNode(arm, { { 150.0f, 0.0f }, -angle, { 1.0f, 1.0f } });
+
+        SpriteInstance armSprite {};
+        armSprite.color[0] = 0.5f;
+        armSprite.color[1] = 0.5f;
+        sceneHierarchy.attachSprite(arm, spriteBatch.add(armSprite), 220.0f, 16.0f);
+
+        SpriteInstance handSprite {};
+        handSprite.color[2] = 0.3f;
+        sceneHierarchy.attachSprite(hand, spriteBatch.add(handSprite), 48.0f, 48.0f);
+    }
+
+    if (level.isOpen()) {
+        spawnLevel();
+    }
+
+    // The bodies get their real bounds once the hierarchy has placed the sprites.
+    for (uint32_t i = 0; i < spriteBatch.count(); i++) {
+        spriteBodies.push_back(broadphase.addBody(Aabb {}, BodyType::Dynamic));
+    }
+
+    // Animations advance with real time, including the time spent waiting while nothing changed.
+    auto startTime = std::chrono::steady_clock::now();
+    auto lastUpdateTime = startTime;
+
+    // Game logic runs in fixed steps, timed with the same clock as input events.
+    const int64_t stepTicks = PlatformWindow::secondsToTicks(fixedStepSeconds);
+    int64_t nextStepTime = PlatformWindow::now();
+
+    // The CPU time of every replayed frame, from reading its packet to submitting it.
+    std::vector<double> replayFrameMilliseconds;
+    auto replayStartTime = startTime;
+    auto replayFrameStart = startTime;
+    double firstPacketTime = 0.0;
+
     auto running = true;
     while (running) {
-        // Process all pending Windows messages
-        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
-        {
-            if (msg.message == WM_QUIT)
-            {
-                running = false;   
+        // Run the steps that are due. Each one starts by consuming the input that arrived before it,
+        // so a step sees exactly the events that happened up to its point in time, no matter when the frame runs.
+        int64_t frameTime = PlatformWindow::now();
+        uint32_t steps = 0;
+        while (nextStepTime <= frameTime) {
+            // Too far behind to catch up, e.g. after a breakpoint. The missed steps are dropped, instead of made up all at once.
+            if (steps == maxStepsPerFrame) {
+                nextStepTime = frameTime + stepTicks;
+                break;
+            }
+
+            inputState.beginStep();
+            platformWindow.drainEvents(nextStepTime, [&](const InputEvent& event) {
+                switch (event.type) {
+                    case InputEventType::WindowClosed:
+                        running = false;
+                        break;
+                    // The window contents have to be drawn again when its size changes.
+                    case InputEventType::WindowResized:
+                        invalidateScene();
+                        break;
+                    // F12 saves a screenshot, F11 starts and stops recording every frame, F3 shows and hides the counters.
+                    case InputEventType::KeyDown:
+                        if (event.code == VK_F3) {
+                            perfOverlay.setEnabled(!perfOverlay.enabled());
+                            invalidateScene();
+                        } else if (event.code == VK_F12) {
+                            framebufferReadback.requestScreenshot("screenshot_" + std::to_string(screenshotCount++) + ".tga");
+                        } else if (event.code == VK_F11 && framebufferReadback.isRecording()) {
+                            framebufferReadback.stopRecording();
+                        } else if (event.code == VK_F11) {
+                            framebufferReadback.startRecording("recording_" + std::to_string(recordingCount++));
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                inputState.apply(event);
+            });
+
+            // Fixed-rate game logic goes here, reading "inputState".
+
+            nextStepTime += stepTicks;
+            steps++;
+        }
+
+        if (!running) {
+            break;
+        }
+
+        // Continue asset loads that finished reading and decoding. This queues their GPU uploads.
+        assetLoader.pump();
+
+        // Make room for the textures that just arrived, by evicting the ones that haven't been used for the longest.
+        textureCache.update(submittedFrameValue + 1);
+
+        // Retire finished uploads, and submit everything recorded since last frame before the frame itself is submitted.
+        uploadManager.collect();
+        uploadManager.flush();
+
+        auto now = std::chrono::steady_clock::now();
+        float deltaSeconds = std::chrono::duration<float>(now - lastUpdateTime).count();
+        lastUpdateTime = now;
+
+        // GPU animated sprites are evaluated at this time.
+        double animationTime = std::chrono::duration<double>(now - startTime).count();
+
+        if (frameReplay.isOpen()) {
+            // The frame comes from the capture instead of the game, and the replay ends with the capture.
+            if (!frameReplay.read(replayPacket)) {
+                break;
+            }
+
+            if (frameReplay.frameCount() == 1) {
+                replayStartTime = std::chrono::steady_clock::now();
+                firstPacketTime = replayPacket.time;
+            } else if (replayRealtime) {
+                std::this_thread::sleep_until(replayStartTime + std::chrono::duration<double>(replayPacket.time - firstPacketTime));
+            }
+
+            replayFrameStart = std::chrono::steady_clock::now();
+            if (!applyRenderPacket(replayPacket)) {
+                break;
+            }
+            animationTime = replayPacket.time;
+        } else {
+            // Advance animations on the CPU. Only sprites whose frame changed are written.
+            if (spriteAnimations.update(deltaSeconds, spriteBatch)) {
+                invalidateScene();
+            }
+
+            // Bring the world transforms of everything that moved up to date. This writes the sprite instances of the moved nodes,
+            // which changes what is drawn.
+            if (sceneHierarchy.propagate(spriteBatch, jobPool.get())) {
+                // Bodies follow their sprites.
+                std::span<SpriteInstance> instances = spriteBatch.instances();
+                for (uint32_t i = 0; i < spriteBodies.size(); i++) {
+                    broadphase.updateBody(spriteBodies[i], spriteBounds(instances[i]));
+                }
+
+                invalidateScene();
+            }
+
+            // Nothing changed since the last presented frame, so there's nothing to render.
+            // Instead of spinning, we sleep until an input event arrives or a short timeout passes, so background work still gets pumped.
+            // Sprites animated on the GPU change the image without changing the scene, so their frames are always rendered.
+            // So are frames that are captured, so that a recording doesn't skip the time the scene stood still,
+            // and frames with the counters shown, which change every frame.
+            // A streamed texture that arrived or was evicted changes the sprites' material, which is only updated in drawFrame.
+            if (albedoTexture.has_value() &&
+                textureCache.isResident(*albedoTexture) != (spriteMaterialAlbedoView != VK_NULL_HANDLE)) {
+                invalidateScene();
+            }
+
+            if (skipUnchangedFrames && presentedSceneVersion == sceneVersion && !spriteAnimations.hasGpuAnimations() &&
+                !framebufferReadback.wantsFrame() && !perfOverlay.enabled()) {
+                platformWindow.waitForEvents(16);
+                continue;
+            }
+
+            // A new scale changes the render area and the light culling, so it's picked before any work of the frame is submitted.
+            if (dynamicResolution.updateScale()) {
+                lightingSystem.setRenderExtent(dynamicResolution.renderExtent(), dynamicResolution.scale());
+                invalidateScene();
             }
+        }
+
+        perfCounters.beginFrame();
+
+        // Everything allocated for the frame before last is released here. The previous frame's data is still valid.
+        frameArena.beginFrame(submittedFrameValue + 1);
+
+        // The compute passes of the next frame are submitted before drawFrame waits for the previous frame,
+        // so that they can run on the compute queue while the graphics queue is still busy.
+        asyncCompute.submit(submittedFrameValue + 1);
 
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+        // Sprite instances have one buffer per compute slot, so the frame before this one may still be reading the other one.
+        // The time only goes into the slot's uniform buffer, so GPU animations don't invalidate recorded command buffers.
+        spriteBatch.setTime(static_cast<float>(animationTime));
+        perfCounters.addUploadedBytes(spriteBatch.upload(asyncCompute.currentSlot(), frameArena));
+
+        // Find the bodies that may collide. This only does work when bodies were added, moved or removed since the last frame.
+        broadphase.findPairs(jobPool.get());
+
+        // The packet is taken right before drawing, once everything that writes instances, lights or the scale is done.
+        if (frameCapture.isOpen()) {
+            frameCapture.write(animationTime, dynamicResolution.scale(), spriteBatch.instances(), lightingSystem.currentLights());
         }
 
         // Update and render game here
         drawFrame();
-        vkDeviceWaitIdle(logicalDevice);
+
+        // Staged uploads are counted towards the frame that submitted them, including those flushed while frames were skipped.
+        perfCounters.addUploadedBytes(uploadManager.stats().bytesUploaded - countedUploadBytes);
+        countedUploadBytes = uploadManager.stats().bytesUploaded;
+        perfCounters.addArenaHeapAllocations(static_cast<uint32_t>(frameArena.heapAllocations() - countedArenaHeapAllocations));
+        countedArenaHeapAllocations = frameArena.heapAllocations();
+        perfCounters.endFrame();
+
+        if (frameReplay.isOpen()) {
+            replayFrameMilliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - replayFrameStart).count());
+        }
     }
 
+    // Everything we destroy below may still be in use by the last frames, so this is the one place where we wait for the device to go idle.
+    vkDeviceWaitIdle(logicalDevice);
+
     // Vulkan Cleanup
 
-    // Destroy semaphores and fences
-    vkDestroySemaphore(logicalDevice, renderFinishedSemaphore, nullptr);
-    vkDestroySemaphore(logicalDevice, imageAvailableSemaphore, nullptr);
-    vkDestroyFence(logicalDevice, inFlightFence, nullptr);
+    deletionQueue.flush();
+
+    const UploadStats& uploadStats = uploadManager.stats();
+    std::cout << "Uploaded " << uploadStats.bytesUploaded / (1024.0 * 1024.0) << " MB in " << uploadStats.batchesSubmitted << " batches at "
+        << uploadStats.megabytesPerSecond << " MB/s, spent " << uploadStats.secondsWaiting * 1000.0 << " ms waiting for staging space." << std::endl;
 
-    // Destroy pipeline
-    vkDestroyPipeline(logicalDevice, graphicsPipeline, nullptr);
+    const AsyncComputeStats& computeStats = asyncCompute.stats();
+    std::cout << "Async compute: " << computeStats.computeMilliseconds << " ms compute, " << computeStats.graphicsMilliseconds << " ms graphics, "
+        << computeStats.overlapRatio * 100.0 << "% of compute overlapped with graphics." << std::endl;
 
-    // Destroy pipeline layouts
-    vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+    std::cout << "Frame arena: high-water mark " << frameArena.highWaterMark() / 1024.0 << " KB, "
+        << frameArena.heapAllocations() << " heap allocations." << std::endl;
+    frameArena.destroy();
+
+    const BroadphaseStats& broadphaseStats = broadphase.stats();
+    std::cout << "Broadphase: " << broadphaseStats.pairCount << " pairs among " << broadphaseStats.bodyCount << " bodies, found in "
+        << broadphaseStats.milliseconds << " ms." << std::endl;
+
+    InputLatencyStats inputStats = platformWindow.latencyStats();
+    std::cout << "Input: " << inputStats.eventCount << " events, " << inputStats.averageMilliseconds << " ms average and "
+        << inputStats.maxMilliseconds << " ms max from arrival to consumption, " << inputStats.droppedEvents << " dropped." << std::endl;
+
+    OverdrawStats overdrawStats = overdrawMeter.stats();
+    std::cout << "Overdraw: drawing back to front would shade " << overdrawStats.paintedFragmentsPerPixel << " fragments per pixel";
+    if (overdrawStats.measured) {
+        std::cout << ", " << overdrawStats.shadedFragmentsPerPixel << " were shaded";
+    }
+    std::cout << ", over " << overdrawStats.measuredFrames << " frames." << std::endl;
+
+    TextureCacheStats textureStats = textureCache.stats();
+    std::cout << "Texture cache: " << textureStats.hits << " hits, " << textureStats.misses << " misses, " << textureStats.loads << " loads, "
+        << textureStats.evictions << " evictions, peak " << textureStats.peakResidentBytes / (1024.0 * 1024.0) << " MB of a "
+        << textureStats.budgetBytes / (1024.0 * 1024.0) << " MB budget." << std::endl;
+
+    Ktx2Stats ktx2 = ktx2Stats();
+    std::cout << "KTX2: " << ktx2.textures << " textures, " << ktx2.transcodedTextures << " transcoded to RGBA8, "
+        << ktx2.uploadedBytes / (1024.0 * 1024.0) << " MB uploaded instead of " << ktx2.uncompressedBytes / (1024.0 * 1024.0)
+        << " MB as RGBA8, saving " << (static_cast<double>(ktx2.uncompressedBytes) - ktx2.uploadedBytes) / (1024.0 * 1024.0)
+        << " MB of video memory." << std::endl;
+
+    std::cout << "Dynamic resolution: rendering at " << dynamicResolution.scale() * 100.0f << "% scale, "
+        << dynamicResolution.gpuMilliseconds() << " ms GPU time per frame." << std::endl;
+
+    FrameCounters averageCounters = perfCounters.average();
+    std::cout << "Frame counters: " << averageCounters.frameMilliseconds << " ms per frame, " << averageCounters.drawCalls << " draw calls, "
+        << averageCounters.instances << " instances, " << averageCounters.pipelineBinds << " pipeline binds, "
+        << averageCounters.bytesUploaded / 1024.0 << " KB uploaded, " << averageCounters.fenceWaitMilliseconds << " ms fence wait and "
+        << averageCounters.acquireWaitMilliseconds << " ms acquire wait on average over the last " << perfCounters.frameCount() << " frames, "
+        << descriptorAllocationCount() << " descriptor sets allocated in total." << std::endl;
+    perfCounters.closeDump();
+
+    framebufferReadback.destroy();
+    ReadbackStats readbackStats = framebufferReadback.stats();
+    std::cout << "Readback: " << readbackStats.capturedFrames << " frames captured, " << readbackStats.droppedFrames << " dropped, "
+        << readbackStats.writtenFrames << " written, " << readbackStats.mainThreadMilliseconds << " ms main thread and "
+        << readbackStats.writeMilliseconds << " ms writer thread time per frame." << std::endl;
+
+    if (frameCapture.isOpen()) {
+        std::cout << "Frame capture: " << frameCapture.frameCount() << " frames in " << frameCapture.bytesWritten() / 1024.0 << " KB." << std::endl;
+        frameCapture.close();
+    }
+
+    if (frameReplay.isOpen()) {
+        if (!replayTimingsFile.empty()) {
+            std::ofstream timings(replayTimingsFile);
+            timings << "frame,milliseconds" << std::endl;
+            for (size_t i = 0; i < replayFrameMilliseconds.size(); i++) {
+                timings << i << "," << replayFrameMilliseconds[i] << std::endl;
+            }
+        }
+
+        std::vector<double> sortedMilliseconds = replayFrameMilliseconds;
+        std::sort(sortedMilliseconds.begin(), sortedMilliseconds.end());
+        if (!sortedMilliseconds.empty()) {
+            double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStartTime).count();
+            std::cout << "Replay: " << sortedMilliseconds.size() << " frames in " << totalSeconds << " s, "
+                << sortedMilliseconds[sortedMilliseconds.size() / 2] << " ms median and "
+                << sortedMilliseconds[sortedMilliseconds.size() * 99 / 100] << " ms 99th percentile CPU time per frame." << std::endl;
+        }
+        frameReplay.close();
+    }
+
+    assetLoader.shutdown();
+    jobPool.reset();
+    textureCache.destroy();
+    spriteBatch.destroy();
+    overdrawMeter.destroy();
+    perfOverlay.destroy();
+    lightingSystem.destroy();
+    dynamicResolution.destroy();
+    asyncCompute.destroy();
+    uploadManager.destroy();
+
+    // Destroy semaphores and fences
+    vkDestroySemaphore(logicalDevice, renderFinishedSemaphore, hostAllocations.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+    vkDestroySemaphore(logicalDevice, imageAvailableSemaphore, hostAllocations.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+    vkDestroyFence(logicalDevice, inFlightFence, hostAllocations.callbacks(VK_OBJECT_TYPE_FENCE));
+    if (useTimelineSemaphores) {
+        destroyQueueTimeline(logicalDevice, graphicsTimeline, hostAllocations.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+    }
+
+    // Destroy pipelines, along with their layout
+    spritePipelines.destroy();
 
     // Framebuffers should be deleted before the image views and render pass
+    vkDestroyFramebuffer(logicalDevice, sceneFramebuffer, hostAllocations.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
     for (auto framebuffer : swapChainFramebuffers) {
-        vkDestroyFramebuffer(logicalDevice, framebuffer, nullptr);
+        vkDestroyFramebuffer(logicalDevice, framebuffer, hostAllocations.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
     }
 
-    // Destroy render pass
-    vkDestroyRenderPass(logicalDevice, renderPass, nullptr);
+    // createImage and createImageView don't use tracked callbacks, so neither do these.
+    if (useDepthPrepass) {
+        vkDestroyImageView(logicalDevice, depthImageView, nullptr);
+        vkDestroyImage(logicalDevice, depthImage, nullptr);
+        vkFreeMemory(logicalDevice, depthImageMemory, nullptr);
+    }
+
+    // Destroy render passes
+    vkDestroyRenderPass(logicalDevice, renderPass, hostAllocations.callbacks(VK_OBJECT_TYPE_RENDER_PASS));
+    vkDestroyRenderPass(logicalDevice, presentRenderPass, hostAllocations.callbacks(VK_OBJECT_TYPE_RENDER_PASS));
 
     // The swapchain should be destroyed before the logical device is destroyed.
-    vkDestroySwapchainKHR(logicalDevice, swapChain, nullptr);
+    vkDestroySwapchainKHR(logicalDevice, swapChain, hostAllocations.callbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR));
 
     for (auto imageView : swapChainImageViews) {
-        vkDestroyImageView(logicalDevice, imageView, nullptr);
+        vkDestroyImageView(logicalDevice, imageView, hostAllocations.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
     }
 
     // Destroy command pool for graphics queue
-    vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
+    vkDestroyCommandPool(logicalDevice, commandPool, hostAllocations.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
 
-    vkDestroyDevice(logicalDevice, nullptr);
+    vkDestroyDevice(logicalDevice, hostAllocations.callbacks(VK_OBJECT_TYPE_DEVICE));
 
-    vkDestroySurfaceKHR(vkInstance, surface, nullptr);
+    vkDestroySurfaceKHR(vkInstance, surface, hostAllocations.callbacks(VK_OBJECT_TYPE_SURFACE_KHR));
 
     // TODO: Investigate this further, I can't find any official explanation for this being true.
     // It is important to destroy the debug messenger AFTER the logical device has been destroyed.
     // This is because the logical device might be using the debug messenger, and destroying the debug messenger before the logical device
     // can cause memory access violations.
-    DestroyDebugUtilsMessengerEXT(vkInstance, debugMessenger, nullptr);    
-    vkDestroyInstance(vkInstance, nullptr);
+    DestroyDebugUtilsMessengerEXT(vkInstance, debugMessenger, hostAllocations.callbacks(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT));
+    vkDestroyInstance(vkInstance, hostAllocations.callbacks(VK_OBJECT_TYPE_INSTANCE));
+
+    // Nothing presents to the window anymore, so it can go.
+    platformWindow.destroy();
+
+    assetArchive.close();
+
+    // Everything created with the tracked callbacks has been destroyed, so anything still live here was leaked by the driver, or by us.
+    HostAllocationStats hostStats = hostAllocations.stats();
+    std::cout << "Driver host memory: peak " << hostStats.total.peakBytes / 1024.0 << " KB in " << hostStats.total.totalAllocations
+        << " allocations, " << hostStats.total.liveBytes << " bytes still live." << std::endl;
+
+    const char* scopeNames[] = { "command", "object", "cache", "device", "instance" };
+    for (size_t i = 0; i < hostStats.byScope.size(); i++) {
+        std::cout << "  Scope " << scopeNames[i] << ": peak " << hostStats.byScope[i].peakBytes / 1024.0 << " KB, "
+            << hostStats.byScope[i].totalAllocations << " allocations." << std::endl;
+    }
+    for (const auto& [objectType, counters] : hostStats.byObjectType) {
+        std::cout << "  " << objectTypeName(objectType) << ": peak " << counters.peakBytes / 1024.0 << " KB, "
+            << counters.totalAllocations << " allocations." << std::endl;
+    }
 
     // Wait for user to press a key before closing the application
     // and thus the console window.
@@ -374,21 +944,33 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice) {
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
 
+    // We go through all queue families instead of stopping once graphics and present are found,
+    // because the optional queue families are often listed after the graphics family.
     int i = 0;
     for (const auto& queueFamily : queueFamilies) {
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) {
             indices.graphicsFamily = i;
         }
 
         // We need to figure out whether the physical device supports presenting to the surface we created.
         VkBool32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &presentSupport);
-        if (presentSupport) {
+        if (presentSupport && !indices.presentFamily.has_value()) {
             indices.presentFamily = i;
         }
 
-        if (indices.isComplete()) {
-            break;
+        // A queue family that supports transfers, but neither graphics nor compute, is usually backed by the GPU's dedicated copy engines.
+        // Copies submitted there can run while the graphics queue is busy rendering.
+        bool transferOnly = (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+            !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+        if (transferOnly && !indices.transferFamily.has_value()) {
+            indices.transferFamily = i;
+        }
+
+        // Likewise, a compute family without graphics support usually maps to hardware queues that run alongside rasterization.
+        bool computeOnly = (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        if (computeOnly && !indices.computeFamily.has_value()) {
+            indices.computeFamily = i;
         }
 
         i++;
@@ -475,6 +1057,12 @@ void createLogicalDevice()
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos {};
     std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    if (indices.transferFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.transferFamily.value());
+    }
+    if (indices.computeFamily.has_value()) {
+        uniqueQueueFamilies.insert(indices.computeFamily.value());
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -483,7 +1071,7 @@ void createLogicalDevice()
         // and how many.
         VkDeviceQueueCreateInfo queueCreateInfo {};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+        queueCreateInfo.queueFamilyIndex = queueFamily;
         queueCreateInfo.queueCount = 1;
         // We also have to specify the priority of the queue, which influences the scheduling of command buffer execution.
         queueCreateInfo.pQueuePriorities = &queuePriority;
@@ -493,16 +1081,42 @@ void createLogicalDevice()
     // We also need to specify the device features we are interested in.
     VkPhysicalDeviceFeatures deviceFeatures {};
 
+    // Counting fragment shader invocations is optional, and only used to measure overdraw.
+    VkPhysicalDeviceFeatures supportedFeatures {};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    usePipelineStatistics = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+
+    // Block-compressed textures are used when the device supports them, and decoded to RGBA8 when it doesn't.
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+
+    // Features added after Vulkan 1.0 are enabled by chaining their feature structs into "pNext" of the device create info.
+    useTimelineSemaphores = instanceApiVersion >= VK_API_VERSION_1_2 && supportsTimelineSemaphores(physicalDevice);
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features {};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = useTimelineSemaphores ? VK_TRUE : VK_FALSE;
+
     // Now we can create the logical device
     VkDeviceCreateInfo deviceCreateInfo {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
     deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+    // The Vulkan 1.2 feature struct may only be chained on a Vulkan 1.2 device.
+    if (useTimelineSemaphores) {
+        deviceCreateInfo.pNext = &vulkan12Features;
+    }
 
-    // Enable device extensions.
-    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    // Enable device extensions. The required ones, plus the optional ones the device supports.
+    std::vector<const char*> enabledExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    useMemoryBudget = supportsMemoryBudget(physicalDevice, instanceApiVersion);
+    if (useMemoryBudget) {
+        enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     // Previous implementations of Vulkan made a distinction between instance and device specific validation layers.
     // This is no longer the case however. And in up-to-date implementations, enabledLayerCount and ppEnabledLayerNames properties of a logical device are ignored.
@@ -510,15 +1124,29 @@ void createLogicalDevice()
     deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
     deviceCreateInfo.ppEnabledLayerNames = validationLayers.data();
 
-    if (vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice) != VK_SUCCESS)
+    if (vkCreateDevice(physicalDevice, &deviceCreateInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_DEVICE), &logicalDevice) != VK_SUCCESS)
     {
         std::cout << "Failed to create logical device!" << std::endl;
         std::terminate();
     }
 
+    queryKtx2FormatSupport(physicalDevice, deviceFeatures);
+
     // Queues are automatically created when the logical device is created.
     vkGetDeviceQueue(logicalDevice, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(logicalDevice, indices.presentFamily.value(), 0, &presentQueue);
+
+    if (indices.transferFamily.has_value()) {
+        vkGetDeviceQueue(logicalDevice, indices.transferFamily.value(), 0, &transferQueue);
+    } else {
+        transferQueue = graphicsQueue;
+    }
+
+    if (indices.computeFamily.has_value()) {
+        vkGetDeviceQueue(logicalDevice, indices.computeFamily.value(), 0, &computeQueue);
+    } else {
+        computeQueue = graphicsQueue;
+    }
 }
 
 VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
@@ -635,8 +1263,10 @@ void createSwapChain()
     swapChainCreateInfo.imageArrayLayers = 1;
     
     // ImageUsage bit specifies what kind of operations we'll use the images in the swap chain for.
-    // For now we render directly to them, which means that they're used as color attachment.
-    swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // We render directly to them, which means that they're used as color attachment.
+    // Screenshots and recordings copy them into buffers, which makes them the source of a transfer, if the surface allows that.
+    swapChainReadable = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    swapChainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (swapChainReadable ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
 
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
     std::array<uint32_t, 2> queueFamilyIndices { indices.graphicsFamily.value(), indices.presentFamily.value() };
@@ -671,7 +1301,7 @@ void createSwapChain()
     // TODO: We ignore oldSwapChain for now.
     swapChainCreateInfo.oldSwapchain = VK_NULL_HANDLE;
 
-    if (vkCreateSwapchainKHR(logicalDevice, &swapChainCreateInfo, nullptr, &swapChain) != VK_SUCCESS)
+    if (vkCreateSwapchainKHR(logicalDevice, &swapChainCreateInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR), &swapChain) != VK_SUCCESS)
     {
         std::cout << "Failed to create swap chain!" << std::endl;
         std::terminate();
@@ -722,7 +1352,7 @@ void createImageViews()
         imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
         imageViewCreateInfo.subresourceRange.layerCount = 1;
 
-        if (vkCreateImageView(logicalDevice, &imageViewCreateInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS)
+        if (vkCreateImageView(logicalDevice, &imageViewCreateInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &swapChainImageViews[i]) != VK_SUCCESS)
         {
             std::cout << "Failed to create image views!" << std::endl;
             std::terminate();
@@ -765,7 +1395,7 @@ VkDebugUtilsMessengerEXT setupDebugMessenger() {
 
     // Create the debug messenger
     VkDebugUtilsMessengerEXT debugMessenger;
-    if (CreateDebugUtilsMessengerEXT(vkInstance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+    if (CreateDebugUtilsMessengerEXT(vkInstance, &createInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT), &debugMessenger) != VK_SUCCESS) {
         std::cout << "Failed to set up debug messenger." << std::endl;
         std::terminate();
     }
@@ -774,198 +1404,42 @@ VkDebugUtilsMessengerEXT setupDebugMessenger() {
 }
 
 void createGraphicsPipeline() {
-    auto vertShaderCode = readFile("shaders/vert.spv");
-    auto fragShaderCode = readFile("shaders/frag.spv");
-
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-    // Create a vertex shader stage
-    // Using the vertex shader module we created.
-    // pName specifies the function to invoke in our shader (entrypoint), in this case "main".
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo {};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
-
-    // Create a fragment shader stage
-    // Using the fragment shader module we created.
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo {};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-    // Describe vertex input
-    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo {};
-    vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-    // Describe input assembly
-    // VkPipelineInputAssemblyStateCreateInfo describes two things:
-    // What kind of geometry will be drawn from the vertices, and if primitive restart should be enabled.
-    // We intend to draw triangles
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo {};
-    inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    // VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST means a triangle from every 3 vertices without reuse.
-    inputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
-
-    // Describe the viewport.
-    // The viewport describes the region of the framebuffer that the output will be rendered to.
-    // This will almost always be (0, 0) to (width, height).
-    VkViewport viewport {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) swapChainExtent.width;
-    viewport.height = (float) swapChainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    // The scissor rectangle defines in which regions pixels will actually be stored.
-    // Anything outside of this rectanble will be discarded by the rasterizer.
-    // For now, I just create it to be the same size as the viewport.
-    VkRect2D scissor {};
-    scissor.offset = { 0, 0 };
-    scissor.extent = swapChainExtent;
-
-    VkPipelineViewportStateCreateInfo viewportStateCreateInfo {};
-    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.pViewports = &viewport;
-    viewportStateCreateInfo.scissorCount = 1;
-    viewportStateCreateInfo.pScissors = &scissor;
-
-    // Describe the Rasterizer stage
-    // The rasterizer takes the geometry that is shaped by the vertices from the vertex shader and turns it into fragments.
-    // The fragments will then be colored, depth tested, and face culled in the fragment shader.
-    VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo {};
-    rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizationStateCreateInfo.depthClampEnable = VK_FALSE;
-    rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-
-    // polygonMode determines how fragments are generated for geometry.
-    // VK_POLYGON_MODE_FILL = Fill the area of the polygon with fragments.
-    rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizationStateCreateInfo.lineWidth = 1.0f;
-
-    // Culling refers to the process of discarding triangles during rendering, based on their orientation to the camera.
-    // VK_CULL_MODE_BACK_BIT = Triangles that are back-facing will be discarded.
-    rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    // frontFace determines that order of vertices that determines the front.
-    rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-
-    // TODO: Read up on what behaviour all these settings alter
-    rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE;
-    rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
-    rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
-    rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f;
-
-    // VkPipelineMultisampleStateCreateInfo configures multisamlping, a type of anti-aliasing.
-    // We disable it for now, as enabling it requires enabling a GPU feature.
-    VkPipelineMultisampleStateCreateInfo multisamplingStateCreateInfo {};
-    multisamplingStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisamplingStateCreateInfo.sampleShadingEnable = VK_FALSE;
-    multisamplingStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisamplingStateCreateInfo.minSampleShading = 1.0f;
-    multisamplingStateCreateInfo.pSampleMask = nullptr;
-    multisamplingStateCreateInfo.alphaToCoverageEnable = VK_FALSE;
-    multisamplingStateCreateInfo.alphaToOneEnable = VK_FALSE;
-
-    // Configure color blending.
-    // Color blending is the process of combining the color of a fragment that is being written with the color that is already in the framebuffer.
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-
-    // VkPiplineColorBlendStateCreateInfo contains the configuration for the entire pipeline's color blending state.
-    // This configuration with the above color blend attachment represents a configuration in where the color from the fragment shader
-    // will be written to the framebuffer in an unmodified way, regardless of the existing color on the framebuffer.
-    VkPipelineColorBlendStateCreateInfo colorBlendingStateCreateInfo {};
-    colorBlendingStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendingStateCreateInfo.logicOpEnable = VK_FALSE;
-    colorBlendingStateCreateInfo.logicOp = VK_LOGIC_OP_COPY;
-    colorBlendingStateCreateInfo.attachmentCount = 1;
-    colorBlendingStateCreateInfo.pAttachments = &colorBlendAttachment;
-    colorBlendingStateCreateInfo.blendConstants[0] = 0.0f;
-    colorBlendingStateCreateInfo.blendConstants[1] = 0.0f;
-    colorBlendingStateCreateInfo.blendConstants[2] = 0.0f;
-    colorBlendingStateCreateInfo.blendConstants[3] = 0.0f;
-
-    std::vector<VkDynamicState> dynamicStates = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR
-    };
-
-    VkPipelineDynamicStateCreateInfo dynamicState{};
-    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-    dynamicState.pDynamicStates = dynamicStates.data();
-
-    // Uniform values in Shaders needs to be specified during pipeline creation through VkPipelineLayout objects.
-    // Currently I don't use uniform values, but it is required to create an empty VkPipelineLayout object at minimum.
-    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo {};
-    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutCreateInfo.setLayoutCount = 0;
-    pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
-
-    if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        std::cout << "Failed to create pipeline layout." << std::endl;
-        std::terminate();
+    // Sprite pipelines are created for a specific render pass, with the sprite's material in set 0 and the frame uniforms of the sprite batch in set 1.
+    SpritePipelineSettings settings {};
+    settings.renderPass = renderPass;
+    settings.subpass = 0;
+    settings.materialLayout = lightingSystem.materialSetLayout();
+    settings.frameLayout = spriteBatch.frameSetLayout();
+    // Without the depth prepass, the render pass has no depth attachment, and there's nothing to test against.
+    settings.depthAttachment = useDepthPrepass;
+    settings.pipelineCallbacks = hostAllocations.callbacks(VK_OBJECT_TYPE_PIPELINE);
+    settings.layoutCallbacks = hostAllocations.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT);
+    settings.cacheCallbacks = hostAllocations.callbacks(VK_OBJECT_TYPE_PIPELINE_CACHE);
+
+    // The shader code is read straight out of the mapped archive, without copying it first.
+    spritePipelines.init(logicalDevice, settings, assetArchive.get("shaders/vert.spv"), assetArchive.get("shaders/frag.spv"));
+
+    // Variants are built on first use. Building the ones every frame draws with now keeps that out of the first frame.
+    SpriteFeatures features = useRuntimeFeatures ? SpritePipelines::runtimeBranching : spriteFeatures;
+    spritePipelines.get(features, SpriteBlend::Translucent);
+    if (useDepthPrepass) {
+        spritePipelines.get(features, SpriteBlend::Opaque);
     }
-
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo {};
-    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStages;
-
-    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisamplingStateCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = nullptr;
-    pipelineCreateInfo.pColorBlendState = &colorBlendingStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = &dynamicState;
-
-    pipelineCreateInfo.layout = pipelineLayout;
-
-    pipelineCreateInfo.renderPass = renderPass;
-    pipelineCreateInfo.subpass = 0;
-
-    // Vulkan allows you to create a new graphics pipeline by deriving from an existing pipeline.
-    // It is less expensive to set up pipelines when they have much functionality in common with an existing pipeline
-    // And switching between pipelines from the same parent can also be done quicker.
-    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineCreateInfo.basePipelineIndex = -1;
-
-    graphicsPipeline = VK_NULL_HANDLE;
-    if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-        std::cout << "Failed to create graphics pipeline." << std::endl;
-        std::terminate();
-    }
-
-    vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
-    vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
 }
 
 void createRenderPass() {
-    // We will have a single color buffer attachment 
+    // The scene image receives the lit scene, which is then upscaled into the swapchain image by the present render pass.
     VkAttachmentDescription colorAttachment {};
     colorAttachment.format = swapChainImageFormat;
     colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 
     // Determine what to do with the color attachment BEFORE rendering
-    // VK_ATTACHMENT_LOAD_OP_CLEAR = Clear the values to a constant at the start.
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    // VK_ATTACHMENT_LOAD_OP_DONT_CARE = The existing contents are undefined. The lighting subpass writes every pixel, so there's no need to clear.
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 
     // Determine what to do with the color attachment AFTER rendering
     // VK_ATTACHMENT_STORE_OP_STORE = Rendered contents will be stored in memory and can be read later.
-    // We do this because we are interested in seeing the rendered triable on the screen.
+    // We do this because the present render pass samples the scene image.
     colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 
     // 'loadOp' and 'storeOp' relates to color and depth data,
@@ -975,24 +1449,148 @@ void createRenderPass() {
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
     // Image layouts specify how the data in an image is organized in memory.
-    // we don't care about the initial layout of the image data, because we're going to clear it anyway.
+    // we don't care about the initial layout of the image data, because we're going to overwrite it anyway.
     colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
     // Final Layout specifies the layout the attachment image subresource will be transitioned to when a render pass instance ends.
-    // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR specifies that the image can be presented to the screen via a swapchain.
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL specifies that the image can be sampled in shaders, which is how the upscale reads it.
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    // The albedo and normal attachments are written by the sprites and read by the lighting subpass.
+    // They are cleared at the start, and their contents are thrown away at the end of the render pass.
+    VkAttachmentDescription albedoAttachment {};
+    albedoAttachment.format = LightingSystem::albedoFormat;
+    albedoAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    albedoAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    albedoAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    albedoAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    albedoAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    albedoAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    albedoAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkAttachmentDescription normalAttachment = albedoAttachment;
+    normalAttachment.format = LightingSystem::normalFormat;
+
+    // The depth attachment is only used while drawing the sprites. It's cleared to the far plane, and thrown away afterwards.
+    VkAttachmentDescription depthAttachment {};
+    depthAttachment.format = depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    std::vector<VkAttachmentDescription> attachments = { colorAttachment, albedoAttachment, normalAttachment };
+    if (useDepthPrepass) {
+        attachments.push_back(depthAttachment);
+    }
 
     // A single render pass can consist of multiple subpasses.
     // Subpasses are subsequent rendering operations that depend on the contents of framebuffers in previous passes, applied one after the other.
-    // For now, we'll stick with a single subpass.
-    // Vulkan requires at least one subpass.
+    // We use two: the sprites are drawn in the first, and lit in the second.
+    // Because the second subpass only reads the pixel it's shading, tiled GPUs can keep the albedo and normal attachments in on-chip memory.
 
     // Every subpass references one or more of the attachments that we've described.
-    // We only have a single attachment, and its in index 0 of the attachment array.
-    VkAttachmentReference colorAttachmentRef {};
-    colorAttachmentRef.attachment = 0;
     // VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL specifies which layout we would like the attachment to have during a subpass that use this reference.
     // We specify VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL because this shows intent to use it as a color buffer.
+    std::array<VkAttachmentReference, 2> geometryAttachmentRefs {};
+    geometryAttachmentRefs[0] = { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    geometryAttachmentRefs[1] = { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+    // The lighting subpass reads albedo and normals as input attachments, and writes to the swapchain image.
+    std::array<VkAttachmentReference, 2> lightingInputRefs {};
+    lightingInputRefs[0] = { 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    lightingInputRefs[1] = { 2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+
+    VkAttachmentReference colorAttachmentRef {};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef {};
+    depthAttachmentRef.attachment = 3;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    std::array<VkSubpassDescription, 2> subpassDescriptions {};
+    subpassDescriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpassDescriptions[0].colorAttachmentCount = static_cast<uint32_t>(geometryAttachmentRefs.size());
+    subpassDescriptions[0].pColorAttachments = geometryAttachmentRefs.data();
+    subpassDescriptions[0].pDepthStencilAttachment = useDepthPrepass ? &depthAttachmentRef : nullptr;
+
+    subpassDescriptions[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpassDescriptions[1].inputAttachmentCount = static_cast<uint32_t>(lightingInputRefs.size());
+    subpassDescriptions[1].pInputAttachments = lightingInputRefs.data();
+    subpassDescriptions[1].colorAttachmentCount = 1;
+    subpassDescriptions[1].pColorAttachments = &colorAttachmentRef;
+
+    std::array<VkSubpassDependency, 4> subpassDependencies {};
+
+    // The scene image is first written in the lighting subpass, which must wait until the previous upscale is done reading it.
+    subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpassDependencies[0].dstSubpass = 1;
+    subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    subpassDependencies[0].srcAccessMask = 0;
+    subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    // The upscale in the present render pass samples what the lighting subpass wrote.
+    subpassDependencies[2].srcSubpass = 1;
+    subpassDependencies[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+    subpassDependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpassDependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    subpassDependencies[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    // The lighting subpass reads what the geometry subpass wrote, at the same pixel, so the dependency can be by region.
+    subpassDependencies[1].srcSubpass = 0;
+    subpassDependencies[1].dstSubpass = 1;
+    subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    subpassDependencies[1].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+    subpassDependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    // The depth attachment is cleared and written by the sprites, which must wait until the previous frame's depth tests are done with it.
+    subpassDependencies[3].srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpassDependencies[3].dstSubpass = 0;
+    subpassDependencies[3].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    subpassDependencies[3].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    subpassDependencies[3].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    subpassDependencies[3].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo renderPassCreateInfo {};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassCreateInfo.pAttachments = attachments.data();
+    renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
+    renderPassCreateInfo.pSubpasses = subpassDescriptions.data();
+    // The last dependency is only needed for the depth attachment.
+    renderPassCreateInfo.dependencyCount = useDepthPrepass ? 4 : 3;
+    renderPassCreateInfo.pDependencies = subpassDependencies.data();
+
+    if (vkCreateRenderPass(logicalDevice, &renderPassCreateInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_RENDER_PASS), &renderPass) != VK_SUCCESS) {
+        std::cout << "Failed to create render pass." << std::endl;
+        std::terminate();
+    }
+}
+
+// The present render pass always runs at the native resolution of the swapchain.
+void createPresentRenderPass() {
+    // The upscale covers every pixel, so the previous contents of the swapchain image don't matter.
+    VkAttachmentDescription colorAttachment {};
+    colorAttachment.format = swapChainImageFormat;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // VK_IMAGE_LAYOUT_PRESENT_SRC_KHR specifies that the image can be presented to the screen via a swapchain.
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    VkAttachmentReference colorAttachmentRef {};
+    colorAttachmentRef.attachment = 0;
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkSubpassDescription subpassDescription {};
@@ -1000,13 +1598,23 @@ void createRenderPass() {
     subpassDescription.colorAttachmentCount = 1;
     subpassDescription.pColorAttachments = &colorAttachmentRef;
 
-    VkSubpassDependency subpassDependency {};
-    subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpassDependency.dstSubpass = 0;
-    subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependency.srcAccessMask = 0;
-    subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    // The swapchain image must not be written before it has been acquired, which the frame's submission waits for at this stage.
+    VkSubpassDependency subpassDependencies[2] {};
+    subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpassDependencies[0].dstSubpass = 0;
+    subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependencies[0].srcAccessMask = 0;
+    subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    // The framebuffer readback copies the image right after the pass, and its barrier only waits for the color attachment output
+    // stage. Without an explicit dependency, the implicit one at the end of the pass doesn't make the writes available to it.
+    subpassDependencies[1].srcSubpass = 0;
+    subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    subpassDependencies[1].dstAccessMask = 0;
 
     VkRenderPassCreateInfo renderPassCreateInfo {};
     renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -1014,16 +1622,55 @@ void createRenderPass() {
     renderPassCreateInfo.pAttachments = &colorAttachment;
     renderPassCreateInfo.subpassCount = 1;
     renderPassCreateInfo.pSubpasses = &subpassDescription;
-    renderPassCreateInfo.dependencyCount = 1;
-    renderPassCreateInfo.pDependencies = &subpassDependency;
+    renderPassCreateInfo.dependencyCount = 2;
+    renderPassCreateInfo.pDependencies = subpassDependencies;
 
-    if (vkCreateRenderPass(logicalDevice, &renderPassCreateInfo, nullptr, &renderPass) != VK_SUCCESS) {
-        std::cout << "Failed to create render pass." << std::endl;
+    if (vkCreateRenderPass(logicalDevice, &renderPassCreateInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_RENDER_PASS), &presentRenderPass) != VK_SUCCESS) {
+        std::cout << "Failed to create present render pass." << std::endl;
         std::terminate();
     }
 }
 
+// The depth attachment of the scene render pass. Like the other attachments, it has the size of the largest render extent.
+void createDepthResources() {
+    if (!useDepthPrepass) {
+        return;
+    }
+
+    // VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT: depth is never stored, so tiled GPUs can keep it in on-chip memory.
+    VkExtent2D extent = dynamicResolution.maxExtent();
+    createImage(physicalDevice, logicalDevice, extent.width, extent.height, 1, depthFormat,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+    depthImageView = createImageView(logicalDevice, depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+}
+
 void createFramebuffers() {
+    // There's a single scene image, so there's a single scene framebuffer.
+    // It has the size of the largest render extent, and smaller ones only render into part of it.
+    std::vector<VkImageView> sceneAttachments = {
+        dynamicResolution.sceneView(),
+        lightingSystem.albedoView(),
+        lightingSystem.normalView()
+    };
+    if (useDepthPrepass) {
+        sceneAttachments.push_back(depthImageView);
+    }
+
+    VkFramebufferCreateInfo sceneFramebufferCreateInfo {};
+    sceneFramebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    sceneFramebufferCreateInfo.renderPass = renderPass;
+    sceneFramebufferCreateInfo.attachmentCount = static_cast<uint32_t>(sceneAttachments.size());
+    sceneFramebufferCreateInfo.pAttachments = sceneAttachments.data();
+    sceneFramebufferCreateInfo.width = dynamicResolution.maxExtent().width;
+    sceneFramebufferCreateInfo.height = dynamicResolution.maxExtent().height;
+    sceneFramebufferCreateInfo.layers = 1;
+
+    if (vkCreateFramebuffer(logicalDevice, &sceneFramebufferCreateInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &sceneFramebuffer) != VK_SUCCESS) {
+        std::cout << "Failed to create scene framebuffer." << std::endl;
+        std::terminate();
+    }
+
     swapChainFramebuffers.resize(swapChainImageViews.size());
 
     for (size_t i = 0; i < swapChainImageViews.size(); i++) {
@@ -1033,14 +1680,14 @@ void createFramebuffers() {
 
         VkFramebufferCreateInfo framebufferCreateInfo {};
         framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferCreateInfo.renderPass = renderPass;
+        framebufferCreateInfo.renderPass = presentRenderPass;
         framebufferCreateInfo.attachmentCount = 1;
         framebufferCreateInfo.pAttachments = attachments;
         framebufferCreateInfo.width = swapChainExtent.width;
         framebufferCreateInfo.height = swapChainExtent.height;
         framebufferCreateInfo.layers = 1;
 
-        if (vkCreateFramebuffer(logicalDevice, &framebufferCreateInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+        if (vkCreateFramebuffer(logicalDevice, &framebufferCreateInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &swapChainFramebuffers[i]) != VK_SUCCESS) {
             std::cout << "Failed to create framebuffer." << std::endl;
             std::terminate();
         }
@@ -1060,7 +1707,7 @@ void createCommandPool() {
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-    if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    if (vkCreateCommandPool(logicalDevice, &poolInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &commandPool) != VK_SUCCESS) {
         std::cout << "Failed to create command pool." << std::endl;
         std::terminate();
     }
@@ -1070,17 +1717,212 @@ void createCommandPool() {
 // These commands include drawing, compute operations, and resource state transitions.
 // There are two types of command buffers: primary and secondary.
 // Primary command buffers can be submitted to a queue, while secondary command buffers are executed by primary command buffers.
-void createCommandBuffer() {
+void createCommandBuffers() {
+    commandBuffers.resize(swapChainImages.size() * AsyncCompute::slotCount);
+
     VkCommandBufferAllocateInfo allocInfo {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = commandPool;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = 1;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
-    if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
-        std::cout << "Failed to allocate command buffer." << std::endl;
+    if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+        std::cout << "Failed to allocate command buffers." << std::endl;
         std::terminate();
     }
+
+    // Scene version 0 is never current, so every command buffer is recorded the first time it's used.
+    recordedSceneVersions.assign(commandBuffers.size(), 0);
+    recordedCommandCounters.assign(commandBuffers.size(), CommandCounters {});
+}
+
+// Marks every recorded command buffer as stale, and makes sure the next frame is rendered.
+void invalidateScene() {
+    sceneVersion++;
+}
+
+// Marks the albedo map as used by the next frame, and points the sprites' material at it when it became resident,
+// or back at the white albedo map when it was evicted. Command buffers that bound the material are invalidated by the update,
+// so the scene is recorded again.
+void updateSpriteMaterial() {
+    if (!albedoTexture.has_value()) {
+        return;
+    }
+
+    VkImageView view = textureCache.acquire(*albedoTexture, submittedFrameValue + 1);
+    VkImageView residentView = textureCache.isResident(*albedoTexture) ? view : VK_NULL_HANDLE;
+    if (residentView == spriteMaterialAlbedoView) {
+        return;
+    }
+
+    lightingSystem.updateMaterialSet(spriteMaterialSet, VK_NULL_HANDLE, residentView);
+    spriteMaterialAlbedoView = residentView;
+    invalidateScene();
+}
+
+// The sprite's corners are at its position plus or minus half of each axis, so the box reaches as far as both half axes combined.
+Aabb spriteBounds(const SpriteInstance& instance) {
+    float extentX = 0.5f * (std::abs(instance.xAxis[0]) + std::abs(instance.yAxis[0]));
+    float extentY = 0.5f * (std::abs(instance.xAxis[1]) + std::abs(instance.yAxis[1]));
+
+    Aabb box {};
+    box.min[0] = instance.position[0] - extentX;
+    box.min[1] = instance.position[1] - extentY;
+    box.max[0] = instance.position[0] + extentX;
+    box.max[1] = instance.position[1] + extentY;
+    return box;
+}
+
+// Reads the capture, replay, level, albedo, counter and sprite feature options out of the command line. Files that can't be opened end the program.
+void parseCommandLine(const std::string& commandLine) {
+    std::istringstream arguments(commandLine);
+    std::string argument;
+    while (arguments >> argument) {
+        try {
+            if (argument == "--capture" && arguments >> argument) {
+                frameCapture.open(argument);
+            } else if (argument == "--replay" && arguments >> argument) {
+                frameReplay.open(argument);
+            } else if (argument == "--replay-realtime") {
+                replayRealtime = true;
+            } else if (argument == "--replay-timings" && arguments >> argument) {
+                replayTimingsFile = argument;
+            } else if (argument == "--albedo" && arguments >> argument) {
+                // The albedo map is only sampled by the textured variants.
+                albedoPath = argument;
+                spriteFeatures |= spriteTextured;
+            } else if (argument == "--level" && arguments >> argument) {
+                level.open(argument);
+            } else if (argument == "--perf-overlay") {
+                perfOverlay.setEnabled(true);
+            } else if (argument == "--perf-dump" && arguments >> argument) {
+                perfCounters.openDump(argument, 1.0);
+            } else if (argument == "--sprite-features" && arguments >> argument) {
+                std::optional<SpriteFeatures> features = parseSpriteFeatures(argument);
+                if (!features.has_value()) {
+                    std::cout << "Unknown sprite features " << argument << ". Use textured, tinted, lit and alphatest, joined with +." << std::endl;
+                    std::terminate();
+                }
+                spriteFeatures = *features;
+            } else if (argument == "--runtime-features") {
+                useRuntimeFeatures = true;
+            } else {
+                std::cout << "Ignoring unknown argument " << argument << std::endl;
+            }
+        } catch (const std::exception& error) {
+            std::cout << "Failed to open " << argument << ": " << error.what() << std::endl;
+            std::terminate();
+        }
+    }
+
+    // Capturing a replay would only produce the same file again.
+    if (frameCapture.isOpen() && frameReplay.isOpen()) {
+        std::cout << "--capture and --replay can't be used together." << std::endl;
+        std::terminate();
+    }
+}
+
+// Makes the next frame render what "packet" was captured from. Replaces what game logic, animations and dynamic resolution do.
+// Returns false if the packet can't be rendered by this build, which ends the replay.
+bool applyRenderPacket(const RenderPacket& packet) {
+    // The capture may come from a build with a larger sprite batch.
+    if (packet.instances.size() > spriteBatch.capacity()) {
+        std::cout << "Frame " << frameReplay.frameCount() - 1 << " of the capture has " << packet.instances.size()
+                  << " sprites, but the sprite batch only holds " << spriteBatch.capacity() << "." << std::endl;
+        return false;
+    }
+
+    // Sprites can't be removed, so when the scene has more sprites than the capture, the rest are hidden.
+    while (spriteBatch.count() < packet.instances.size()) {
+        spriteBatch.add(SpriteInstance {});
+    }
+
+    if (packet.instancesChanged) {
+        std::span<SpriteInstance> instances = spriteBatch.instances();
+        std::copy(packet.instances.begin(), packet.instances.end(), instances.begin());
+        std::fill(instances.begin() + packet.instances.size(), instances.end(), SpriteInstance {});
+        spriteBatch.markChanged();
+        invalidateScene();
+    }
+
+    if (packet.lightsChanged) {
+        lightingSystem.setLights(packet.lights);
+        invalidateScene();
+    }
+
+    if (dynamicResolution.setScale(packet.renderScale)) {
+        lightingSystem.setRenderExtent(dynamicResolution.renderExtent(), dynamicResolution.scale());
+        invalidateScene();
+    }
+
+    return true;
+}
+
+// Creates a node for every entity of "level", and a sprite for every sprite it has.
+// Tilemaps become a node each, with a child node and sprite for every tile that isn't empty.
+void spawnLevel() {
+    auto spawnStart = std::chrono::steady_clock::now();
+    uint32_t firstInstance = spriteBatch.count();
+
+    auto addSprite = [](NodeId node, const AtlasUvRect& uv, const float color[4], float layer, float width, float height) {
+        SpriteInstance instance {};
+        instance.uv = uv;
+        std::copy(color, color + 4, instance.color);
+        instance.layer = layer;
+        sceneHierarchy.attachSprite(node, spriteBatch.add(instance), width, height);
+    };
+
+    // Parents come before their children, so their nodes always exist by the time a child is created.
+    std::span<const LevelEntity> entities = level.entities();
+    std::vector<NodeId> entityNodes(entities.size(), SceneHierarchy::invalidNode);
+    for (size_t i = 0; i < entities.size(); i++) {
+        const LevelEntity& entity = entities[i];
+        NodeId parent = entity.parent < i ? entityNodes[entity.parent] : SceneHierarchy::invalidNode;
+        entityNodes[i] = sceneHierarchy.createNode(parent, entity.transform);
+
+        // A node carries a single sprite, so any further sprites get a child node at the entity's origin.
+        std::span<const LevelSprite> sprites = level.sprites(entity);
+        for (size_t j = 0; j < sprites.size(); j++) {
+            NodeId node = j == 0 ? entityNodes[i] : sceneHierarchy.createNode(entityNodes[i]);
+            addSprite(node, sprites[j].uv, sprites[j].color, sprites[j].layer, sprites[j].size[0], sprites[j].size[1]);
+        }
+    }
+
+    constexpr float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (const LevelTilemap& tilemap : level.tilemaps()) {
+        if (tilemap.tilesetColumns == 0 || tilemap.tilesetRows == 0) {
+            continue;
+        }
+        NodeId tilemapNode = sceneHierarchy.createNode(SceneHierarchy::invalidNode,
+            { { tilemap.origin[0], tilemap.origin[1] }, 0.0f, { 1.0f, 1.0f } });
+
+        float tileU = (tilemap.tilesetUv.u1 - tilemap.tilesetUv.u0) / tilemap.tilesetColumns;
+        float tileV = (tilemap.tilesetUv.v1 - tilemap.tilesetUv.v0) / tilemap.tilesetRows;
+        std::span<const uint16_t> tiles = level.tiles(tilemap);
+        for (size_t i = 0; i < tiles.size(); i++) {
+            if (tiles[i] == levelEmptyTile) {
+                continue;
+            }
+
+            uint32_t column = tiles[i] % tilemap.tilesetColumns;
+            uint32_t row = tiles[i] / tilemap.tilesetColumns;
+            AtlasUvRect uv {};
+            uv.u0 = tilemap.tilesetUv.u0 + column * tileU;
+            uv.v0 = tilemap.tilesetUv.v0 + row * tileV;
+            uv.u1 = uv.u0 + tileU;
+            uv.v1 = uv.v0 + tileV;
+
+            // Sprites are centered on their node, while tiles are placed by their top left corner.
+            float x = ((i % tilemap.width) + 0.5f) * tilemap.tileSize[0];
+            float y = ((i / tilemap.width) + 0.5f) * tilemap.tileSize[1];
+            NodeId tileNode = sceneHierarchy.createNode(tilemapNode, { { x, y }, 0.0f, { 1.0f, 1.0f } });
+            addSprite(tileNode, uv, white, tilemap.layer, tilemap.tileSize[0], tilemap.tileSize[1]);
+        }
+    }
+
+    auto spawnEnd = std::chrono::steady_clock::now();
+    std::cout << "Spawned level: " << entities.size() << " entities, " << spriteBatch.count() - firstInstance << " sprites in "
+              << std::chrono::duration<double, std::milli>(spawnEnd - spawnStart).count() << " ms" << std::endl;
 }
 
 void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
@@ -1097,56 +1939,113 @@ void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
         std::terminate();
     }
 
+    // Counts the draws and pipeline binds recorded below, for every frame that submits this command buffer.
+    CommandCounters commandCounters;
+
+    // The overdraw query belongs to the command buffer, and is reset by it, so it works with reused command buffers as well.
+    overdrawMeter.resetQuery(commandBuffer, imageIndex);
+
+    // The scene is rendered at the current dynamic resolution, into the top left corner of the scene framebuffer.
+    VkExtent2D renderExtent = dynamicResolution.renderExtent();
+
     // Drawing starts by beginning a render pass with vkCmdBeginRenderPass.
     VkRenderPassBeginInfo renderPassBeginInfo {};
     renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassBeginInfo.renderPass = renderPass;
-    renderPassBeginInfo.framebuffer = swapChainFramebuffers[imageIndex];
+    renderPassBeginInfo.framebuffer = sceneFramebuffer;
     // RenderArea defines the area of the framebuffer that will be rendered to.
     // RenderArea must be contained within the framebuffer dimensions.
     // If the RenderArea is smaller than the framebuffer, it may lead to performance cost.
     renderPassBeginInfo.renderArea.offset = { 0, 0 };
-    renderPassBeginInfo.renderArea.extent = swapChainExtent;
+    renderPassBeginInfo.renderArea.extent = renderExtent;
 
     // Define the clear values to use for VK_ATTACHMENT_LOAD_OP_CLEAR, which we used
-    // for the load operation of the color attachment.
-    // This is black with 100% opacity.
-    VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f };
-    renderPassBeginInfo.clearValueCount = 1;
-    renderPassBeginInfo.pClearValues = &clearColor;
+    // for the load operation of the albedo, normal and depth attachments. There is one per attachment, and the swapchain image isn't cleared.
+    // Albedo is cleared to black with 100% opacity, normals to a flat normal facing the viewer, and depth to the far plane.
+    std::array<VkClearValue, 4> clearValues {};
+    clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+    clearValues[2].color = { { 0.5f, 0.5f, 1.0f, 1.0f } };
+    clearValues[3].depthStencil = { 1.0f, 0 };
+    renderPassBeginInfo.clearValueCount = useDepthPrepass ? 4 : 3;
+    renderPassBeginInfo.pClearValues = clearValues.data();
+
+    // The frame time queries are reset and started by the command buffer as well, right where the scene starts, so the measured time
+    // is the scene's and not the submission's waits for its semaphores.
+    dynamicResolution.beginFrameTimestamps(commandBuffer, imageIndex);
 
     // Record the command to begin a render pass.
     // VK_SUBPASS_CONTENTS_INLINE = The render pass command will be embedded in the primary command buffer itself.
     vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-    // Bind the graphics pipeline
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    // The sprite batch binds the sprite pipelines itself, since it knows which sprites are opaque.
 
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = (float) swapChainExtent.width;
-    viewport.height = (float) swapChainExtent.height;
+    viewport.width = (float) renderExtent.width;
+    viewport.height = (float) renderExtent.height;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
     vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
     VkRect2D scissor{};
     scissor.offset = {0, 0};
-    scissor.extent = swapChainExtent;
+    scissor.extent = renderExtent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-    // Issue draw command
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    // The sprites don't have normal maps of their own, so their material has the flat one, and the albedo map if one was given.
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, spritePipelines.layout(), 0, 1, &spriteMaterialSet, 0, nullptr);
+
+    // Sprites are positioned in output pixels. The viewport maps them to the render extent, whatever the resolution scale is.
+    // The features are only read by the runtime branching variant. Specialized variants have them built in.
+    SpritePushConstants pushConstants {};
+    pushConstants.screenSize[0] = (float) swapChainExtent.width;
+    pushConstants.screenSize[1] = (float) swapChainExtent.height;
+    pushConstants.features = spriteFeatures;
+    vkCmdPushConstants(commandBuffer, spritePipelines.layout(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
+                       sizeof(pushConstants), &pushConstants);
+
+    // Draw the opaque sprites front to back, then the translucent ones back to front, with one instanced draw call each.
+    // Only the fragments shaded here count towards the overdraw. The lighting subpass shades every pixel exactly once.
+    overdrawMeter.beginQuery(commandBuffer, imageIndex);
+    SpriteFeatures features = useRuntimeFeatures ? SpritePipelines::runtimeBranching : spriteFeatures;
+    VkPipeline opaquePipeline = useDepthPrepass ? spritePipelines.get(features, SpriteBlend::Opaque) : VK_NULL_HANDLE;
+    VkPipeline translucentPipeline = spritePipelines.get(features, SpriteBlend::Translucent);
+    spriteBatch.record(commandBuffer, spritePipelines.layout(), asyncCompute.currentSlot(), opaquePipeline, translucentPipeline, commandCounters);
+    overdrawMeter.endQuery(commandBuffer, imageIndex);
+
+    // Move on to the lighting subpass. Viewport and scissor are dynamic state of the command buffer, so they carry over.
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+    lightingSystem.recordLighting(commandBuffer, asyncCompute.currentSlot(), commandCounters);
 
     // End the render pass
     vkCmdEndRenderPass(commandBuffer);
 
+    // The present render pass upscales the scene into the swapchain image. It has no clear values, since nothing is cleared.
+    VkRenderPassBeginInfo presentPassBeginInfo {};
+    presentPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    presentPassBeginInfo.renderPass = presentRenderPass;
+    presentPassBeginInfo.framebuffer = swapChainFramebuffers[imageIndex];
+    presentPassBeginInfo.renderArea.offset = { 0, 0 };
+    presentPassBeginInfo.renderArea.extent = swapChainExtent;
+
+    vkCmdBeginRenderPass(commandBuffer, &presentPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    dynamicResolution.recordUpscale(commandBuffer, commandCounters);
+
+    // UI is drawn here, after the upscale, so that it stays sharp at the native resolution.
+    perfOverlay.record(commandBuffer, swapChainExtent, commandCounters);
+
+    vkCmdEndRenderPass(commandBuffer);
+
+    dynamicResolution.endFrameTimestamps(commandBuffer, imageIndex);
+
     // Finish recording the command buffer
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         std::cout << "Failed to record command buffer." << std::endl;
         std::terminate();
     }
+
+    recordedCommandCounters[imageIndex * AsyncCompute::slotCount + asyncCompute.currentSlot()] = commandCounters;
 }
 
 // At a high level, rendering a frame in Vulkan consists of the following steps:
@@ -1156,12 +2055,37 @@ void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
 // 4. Submit the recorded command buffer
 // 5. Present the swap chain image
 void drawFrame() {
-    // Wait for our fence, which in this case signals that the previous frame has finished.
-    // The last parameter of vkWaitForFences is a timeout in milliseconds, and we specify the maximum value. Effectively disabling timeout.
-    vkWaitForFences(logicalDevice, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
+    auto fenceWaitStart = std::chrono::steady_clock::now();
+    if (useTimelineSemaphores) {
+        // Every frame signals the graphics timeline with its frame value, so waiting for the previous frame means waiting for its value.
+        // The counter we read afterwards can only be larger, and there is no fence to reset.
+        waitForTimelineValue(logicalDevice, graphicsTimeline, submittedFrameValue);
+        completedFrameValue = completedTimelineValue(logicalDevice, graphicsTimeline);
+    } else {
+        // Wait for our fence, which in this case signals that the previous frame has finished.
+        // The last parameter of vkWaitForFences is a timeout in milliseconds, and we specify the maximum value. Effectively disabling timeout.
+        vkWaitForFences(logicalDevice, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
+
+        // After waiting, we need to manually reset the fence to unsignaled state.
+        vkResetFences(logicalDevice, 1, &inFlightFence);
+
+        // With a single frame in flight, the fence tells us that every frame submitted so far has completed.
+        completedFrameValue = submittedFrameValue;
+    }
+    perfCounters.addFenceWait(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - fenceWaitStart).count());
+
+    // Anything retired by completed frames can be destroyed now.
+    deletionQueue.collect(completedFrameValue);
+    // No frame uses the sprites' material anymore, so it can be pointed at the albedo map's current view.
+    updateSpriteMaterial();
+    // Captured frames that completed can be written to disk.
+    framebufferReadback.collect(completedFrameValue);
 
-    // After waiting, we need to manually reset the fence to unsignaled state.
-    vkResetFences(logicalDevice, 1, &inFlightFence);
+    // The previous frame has completed, so its GPU time and fragment count can be read.
+    dynamicResolution.collectFrameTime();
+    overdrawMeter.collect();
+    // The overlay's buffer isn't read by any frame anymore, so it can show the counters of the frames so far.
+    perfOverlay.update(perfCounters);
 
     // We aquire an image from the swap chain.
     // First two parameters: the logical device and swap chain from which we wish to aquire an image.
@@ -1171,46 +2095,79 @@ void drawFrame() {
     // The last parameter is an output to the index of the swap chain where an image has become available.
     // The index refers to the VkImage in the swap chain images array. We use that index to pick a VkFrameBuffer.
     uint32_t imageIndex;
+    auto acquireStart = std::chrono::steady_clock::now();
     auto aquireImageKhrResult = vkAcquireNextImageKHR(logicalDevice, swapChain, 300000000000, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+    perfCounters.addAcquireWait(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - acquireStart).count());
+
+    // A command buffer recorded for this image can be submitted again, as long as the scene hasn't changed since.
+    // Compute results are double buffered, so each image has a command buffer for every async compute slot.
+    uint32_t commandBufferIndex = imageIndex * AsyncCompute::slotCount + asyncCompute.currentSlot();
+    VkCommandBuffer commandBuffer = commandBuffers[commandBufferIndex];
+    bool commandBufferCurrent = reuseCommandBuffers && recordedSceneVersions[commandBufferIndex] == sceneVersion;
+
+    if (!commandBufferCurrent) {
+        // Before we start rendering, we reset the command buffer, so that it can be recorded again.
+        vkResetCommandBuffer(commandBuffer, 0);
+        // Record the command buffer with a new drawing operation
+        recordCommandBuffer(commandBuffer, imageIndex);
 
-    // Before we start rendering, we reset the command buffer, so that it can be recorded again.
-    vkResetCommandBuffer(commandBuffer, 0);
-    // Record the command buffer with a new drawing operation
-    recordCommandBuffer(commandBuffer, imageIndex);
+        recordedSceneVersions[commandBufferIndex] = sceneVersion;
+    }
 
     // Submit the command buffer to the graphics queue.
     VkSubmitInfo submitInfo {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
+    // We wait on the imageAvailableSemaphore before writing colors to the image.
+    SubmitSemaphores submitSemaphores;
+    submitSemaphores.waitBinary(imageAvailableSemaphore, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    // Results of this frame's compute passes are consumed by the shaders.
+    asyncCompute.waitInGraphicsSubmit(submitSemaphores, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    // A captured frame is copied out of the swapchain image by a second command buffer, once the frame's own has rendered it.
+    // Keeping the copy separate means the frame's command buffer can still be reused while recording.
+    // The async compute timestamps are kept out of it the same way, and bracket everything else in the submission.
+    AsyncCompute::GraphicsTimestamps graphicsTimestamps = asyncCompute.recordGraphicsTimestamps();
+    std::array<VkCommandBuffer, 4> submittedCommandBuffers {};
+    uint32_t submittedCommandBufferCount = 0;
+    for (VkCommandBuffer submitted : { graphicsTimestamps.begin, commandBuffer,
+            framebufferReadback.recordCopy(swapChainImages[imageIndex], submittedFrameValue + 1), graphicsTimestamps.end }) {
+        if (submitted != VK_NULL_HANDLE) {
+            submittedCommandBuffers[submittedCommandBufferCount++] = submitted;
+        }
+    }
+    submitInfo.commandBufferCount = submittedCommandBufferCount;
+    submitInfo.pCommandBuffers = submittedCommandBuffers.data();
 
     // We specify the semaphores to singal once the comamnd buffers have finished execution.
     // Here, we want to signal the renderFinishedSemaphore, to indicate that rendering has finished.
-    VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    // Presentation only works with binary semaphores, so this one stays binary even when timeline semaphores are in use.
+    submitSemaphores.signalBinary(renderFinishedSemaphore);
+    if (useTimelineSemaphores) {
+        submitSemaphores.signalTimeline(graphicsTimeline, nextTimelineValue(graphicsTimeline));
+    }
+    submitSemaphores.apply(submitInfo);
 
     // Submit the command buffer to the graphics queue.
     // The inFlightFence parameter is the fence that will be signaled when the command buffer has finished execution.
     // This will indicate to us when it is safe to reuse the command buffer for another frame.
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence) != VK_SUCCESS) {
+    // With timeline semaphores, the frame value on the graphics timeline tells us the same thing, so no fence is needed.
+    VkFence submitFence = useTimelineSemaphores ? VK_NULL_HANDLE : inFlightFence;
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, submitFence) != VK_SUCCESS) {
         std::cout << "Failed to submit draw command buffer." << std::endl;
         std::terminate();
     }
 
+    submittedFrameValue++;
+    perfCounters.addCommands(recordedCommandCounters[commandBufferIndex]);
+    dynamicResolution.frameSubmitted(imageIndex);
+    overdrawMeter.frameSubmitted(imageIndex, spriteBatch.instances(), sceneVersion, swapChainExtent, dynamicResolution.renderExtent());
+
     VkPresentInfoKHR presentInfo {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &renderFinishedSemaphore;
 
     VkSwapchainKHR swapChains[] = { swapChain };
 
@@ -1219,6 +2176,8 @@ void drawFrame() {
     presentInfo.pImageIndices = &imageIndex;
 
     vkQueuePresentKHR(presentQueue, &presentInfo);
+
+    presentedSceneVersion = sceneVersion;
 }
 
 void createSyncObjects() {
@@ -1231,30 +2190,16 @@ void createSyncObjects() {
     // We do this so that the first time we wait for the fence in the draw function, it won't block indefinitely.
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphore) != VK_SUCCESS ||
-        vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphore) != VK_SUCCESS ||
-        vkCreateFence(logicalDevice, &fenceInfo, nullptr, &inFlightFence) != VK_SUCCESS) {
+    if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &imageAvailableSemaphore) != VK_SUCCESS ||
+        vkCreateSemaphore(logicalDevice, &semaphoreInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &renderFinishedSemaphore) != VK_SUCCESS ||
+        vkCreateFence(logicalDevice, &fenceInfo, hostAllocations.callbacks(VK_OBJECT_TYPE_FENCE), &inFlightFence) != VK_SUCCESS) {
         std::cout << "Failed to create synchronization objects." << std::endl;
         std::terminate();
     }
-}
 
-VkShaderModule createShaderModule(const std::vector<char>& code) {
-    VkShaderModuleCreateInfo shaderModuleCreateInfo {};
-    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderModuleCreateInfo.codeSize = code.size();
-    // TODO: Read up on reinterpret_cast and the alignment of data. And how std::vector apparently guarantees alignment in worst case alignment requirements.
-    // Notice: pCode is a pointer to an array of 32-bit words, but the data is a char array.
-    shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-    // vkShaderModules are simply thin wrappers around the SPIR-V bytecode, and a VkShaderModule is nothing but a handle to that bytecode.
-    VkShaderModule shaderModule;
-    if (vkCreateShaderModule(logicalDevice, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-        std::cout << "Failed to create shader module." << std::endl;
-        std::terminate();
+    if (useTimelineSemaphores) {
+        graphicsTimeline = createQueueTimeline(logicalDevice, hostAllocations.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
     }
-
-    return shaderModule;
 }
 
 bool checkValidationLayerSupport() {
@@ -1295,15 +2240,4 @@ bool checkValidationLayerSupport() {
     }
 
     return true;
-}
-
-LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
-{
-    switch (uMsg)
-    {
-        case WM_DESTROY:
-            PostQuitMessage(0);
-            return 0;
-    }
-    return DefWindowProc(hwnd, uMsg, wParam, lParam);
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "overdraw.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    // The pixels a sprite covers are its area, which is the area of the parallelogram spanned by its axes.
+    // Only the part on screen is shaded, which is estimated from how much of its bounding box is on screen.
+    double visibleArea(const SpriteInstance& instance, VkExtent2D outputExtent) {
+        double area = std::abs(instance.xAxis[0] * instance.yAxis[1] - instance.xAxis[1] * instance.yAxis[0]);
+        if (area == 0.0) {
+            return 0.0;
+        }
+
+        double extentX = 0.5 * (std::abs(instance.xAxis[0]) + std::abs(instance.yAxis[0]));
+        double extentY = 0.5 * (std::abs(instance.xAxis[1]) + std::abs(instance.yAxis[1]));
+
+        double visibleWidth = std::min<double>(instance.position[0] + extentX, outputExtent.width) - std::max<double>(instance.position[0] - extentX, 0.0);
+        double visibleHeight = std::min<double>(instance.position[1] + extentY, outputExtent.height) - std::max<double>(instance.position[1] - extentY, 0.0);
+        if (visibleWidth <= 0.0 || visibleHeight <= 0.0) {
+            return 0.0;
+        }
+
+        return area * (visibleWidth * visibleHeight) / (4.0 * extentX * extentY);
+    }
+}
+
+void OverdrawMeter::init(VkDevice device, bool pipelineStatistics, uint32_t frameSlotCount) {
+    logicalDevice = device;
+
+    if (!pipelineStatistics) {
+        std::cout << "Pipeline statistics are not supported, overdraw will only be estimated." << std::endl;
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.queryCount = frameSlotCount;
+    // Of all the statistics, only the fragment shader invocations are counted. Each query then has a single result.
+    queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+    if (vkCreateQueryPool(logicalDevice, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+        std::cout << "Failed to create overdraw query pool." << std::endl;
+        std::terminate();
+    }
+}
+
+void OverdrawMeter::destroy() {
+    vkDestroyQueryPool(logicalDevice, queryPool, nullptr);
+}
+
+void OverdrawMeter::resetQuery(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, frameSlot, 1);
+    }
+}
+
+void OverdrawMeter::beginQuery(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdBeginQuery(commandBuffer, queryPool, frameSlot, 0);
+    }
+}
+
+void OverdrawMeter::endQuery(VkCommandBuffer commandBuffer, uint32_t frameSlot) {
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdEndQuery(commandBuffer, queryPool, frameSlot);
+    }
+}
+
+void OverdrawMeter::frameSubmitted(uint32_t frameSlot, std::span<const SpriteInstance> instances, uint64_t sceneVersion,
+                                   VkExtent2D outputExtent, VkExtent2D renderExtent) {
+    if (sceneVersion != estimatedSceneVersion) {
+        double paintedPixels = 0.0;
+        for (const SpriteInstance& instance : instances) {
+            paintedPixels += visibleArea(instance, outputExtent);
+        }
+
+        // Both are in output pixels, so the ratio doesn't depend on the resolution the scene is rendered at.
+        paintedFragmentsPerPixel = paintedPixels / (static_cast<double>(outputExtent.width) * outputExtent.height);
+        estimatedSceneVersion = sceneVersion;
+    }
+
+    pendingFrameSlot = frameSlot;
+    pendingPaintedFragmentsPerPixel = paintedFragmentsPerPixel;
+    pendingRenderPixels = static_cast<double>(renderExtent.width) * renderExtent.height;
+}
+
+void OverdrawMeter::collect() {
+    if (!pendingFrameSlot.has_value()) {
+        return;
+    }
+
+    uint32_t frameSlot = *pendingFrameSlot;
+    pendingFrameSlot.reset();
+
+    // The frame has completed, so its result is available and we don't need to ask the driver to wait for it.
+    uint64_t fragmentInvocations = 0;
+    if (queryPool != VK_NULL_HANDLE) {
+        if (vkGetQueryPoolResults(logicalDevice, queryPool, frameSlot, 1, sizeof(fragmentInvocations), &fragmentInvocations,
+                                  sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return;
+        }
+    }
+
+    // The scene is shaded at the render extent, so that's what the counted fragments are compared with.
+    paintedSum += pendingPaintedFragmentsPerPixel;
+    shadedSum += fragmentInvocations / pendingRenderPixels;
+    measuredFrames++;
+}
+
+OverdrawStats OverdrawMeter::stats() const {
+    OverdrawStats stats {};
+    stats.measuredFrames = measuredFrames;
+    stats.measured = queryPool != VK_NULL_HANDLE;
+    if (measuredFrames > 0) {
+        stats.paintedFragmentsPerPixel = paintedSum / measuredFrames;
+        stats.shadedFragmentsPerPixel = shadedSum / measuredFrames;
+    }
+    return stats;
+}
@@ -0,0 +1,148 @@
+#include "perfcounters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+namespace {
+    std::atomic<uint64_t> descriptorAllocations = 0;
+}
+
+void countDescriptorAllocations(uint32_t count) {
+    descriptorAllocations.fetch_add(count, std::memory_order_relaxed);
+}
+
+uint64_t descriptorAllocationCount() {
+    return descriptorAllocations.load(std::memory_order_relaxed);
+}
+
+void PerfCounters::openDump(const std::string& filename, double intervalSeconds) {
+    dump.open(filename, std::ios::trunc);
+    if (!dump.is_open()) {
+        throw std::runtime_error("failed to create counter dump " + filename + "!");
+    }
+
+    dumpInterval = std::max(intervalSeconds, 0.001);
+    dumpStart = std::chrono::steady_clock::now();
+    dumpSums = {};
+    dumpMaxFrameMilliseconds = 0.0;
+    dumpFrames = 0;
+}
+
+void PerfCounters::closeDump() {
+    if (dump.is_open() && dumpFrames > 0) {
+        writeDumpLine(std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+    }
+    dump.close();
+}
+
+void PerfCounters::beginFrame() {
+    current = {};
+    descriptorAllocationsAtBegin = descriptorAllocationCount();
+}
+
+void PerfCounters::addCommands(const CommandCounters& counters) {
+    current.drawCalls += counters.drawCalls;
+    current.instances += counters.instances;
+    current.pipelineBinds += counters.pipelineBinds;
+}
+
+void PerfCounters::endFrame() {
+    auto now = std::chrono::steady_clock::now();
+    current.descriptorAllocations = static_cast<uint32_t>(descriptorAllocationCount() - descriptorAllocationsAtBegin);
+    current.frameMilliseconds = haveLastFrameEnd ? std::chrono::duration<double, std::milli>(now - lastFrameEnd).count() : 0.0;
+    lastFrameEnd = now;
+    haveLastFrameEnd = true;
+
+    history[historyNext] = current;
+    historyNext = (historyNext + 1) % historySize;
+    historyCount = std::min(historyCount + 1, historySize);
+    frameNumber++;
+
+    if (!dump.is_open()) {
+        return;
+    }
+
+    dumpSums.drawCalls += current.drawCalls;
+    dumpSums.instances += current.instances;
+    dumpSums.pipelineBinds += current.pipelineBinds;
+    dumpSums.bytesUploaded += current.bytesUploaded;
+    dumpSums.descriptorAllocations += current.descriptorAllocations;
+    dumpSums.arenaHeapAllocations += current.arenaHeapAllocations;
+    dumpSums.fenceWaitMilliseconds += current.fenceWaitMilliseconds;
+    dumpSums.acquireWaitMilliseconds += current.acquireWaitMilliseconds;
+    dumpSums.frameMilliseconds += current.frameMilliseconds;
+    dumpMaxFrameMilliseconds = std::max(dumpMaxFrameMilliseconds, current.frameMilliseconds);
+    dumpFrames++;
+
+    if (std::chrono::duration<double>(now - dumpStart).count() >= dumpInterval) {
+        writeDumpLine(std::chrono::duration<double>(now - startTime).count());
+        dumpStart = now;
+    }
+}
+
+const FrameCounters& PerfCounters::lastFrame(uint32_t framesAgo) const {
+    static const FrameCounters none {};
+    if (framesAgo >= historyCount) {
+        return none;
+    }
+    return history[(historyNext + historySize - 1 - framesAgo) % historySize];
+}
+
+FrameCounters PerfCounters::average() const {
+    FrameCounters sums {};
+    double drawCalls = 0.0;
+    double pipelineBinds = 0.0;
+    double descriptorAllocations = 0.0;
+    double arenaHeapAllocations = 0.0;
+    for (uint32_t i = 0; i < historyCount; i++) {
+        const FrameCounters& frame = history[i];
+        drawCalls += frame.drawCalls;
+        sums.instances += frame.instances;
+        pipelineBinds += frame.pipelineBinds;
+        sums.bytesUploaded += frame.bytesUploaded;
+        descriptorAllocations += frame.descriptorAllocations;
+        arenaHeapAllocations += frame.arenaHeapAllocations;
+        sums.fenceWaitMilliseconds += frame.fenceWaitMilliseconds;
+        sums.acquireWaitMilliseconds += frame.acquireWaitMilliseconds;
+        sums.frameMilliseconds += frame.frameMilliseconds;
+    }
+    if (historyCount == 0) {
+        return sums;
+    }
+
+    // The integer counters are rounded to the nearest whole count, which is what they are in any steady scene.
+    FrameCounters average {};
+    average.drawCalls = static_cast<uint32_t>(drawCalls / historyCount + 0.5);
+    average.instances = (sums.instances + historyCount / 2) / historyCount;
+    average.pipelineBinds = static_cast<uint32_t>(pipelineBinds / historyCount + 0.5);
+    average.bytesUploaded = (sums.bytesUploaded + historyCount / 2) / historyCount;
+    average.descriptorAllocations = static_cast<uint32_t>(descriptorAllocations / historyCount + 0.5);
+    average.arenaHeapAllocations = static_cast<uint32_t>(arenaHeapAllocations / historyCount + 0.5);
+    average.fenceWaitMilliseconds = sums.fenceWaitMilliseconds / historyCount;
+    average.acquireWaitMilliseconds = sums.acquireWaitMilliseconds / historyCount;
+    average.frameMilliseconds = sums.frameMilliseconds / historyCount;
+    return average;
+}
+
+void PerfCounters::writeDumpLine(double seconds) {
+    // One JSON object per line, so the file can be read while it's still being written, and tools never see a partial document.
+    double frames = dumpFrames;
+    dump << "{\"time\":" << seconds
+         << ",\"frames\":" << dumpFrames
+         << ",\"frameMs\":" << dumpSums.frameMilliseconds / frames
+         << ",\"maxFrameMs\":" << dumpMaxFrameMilliseconds
+         << ",\"fenceWaitMs\":" << dumpSums.fenceWaitMilliseconds / frames
+         << ",\"acquireWaitMs\":" << dumpSums.acquireWaitMilliseconds / frames
+         << ",\"drawCalls\":" << dumpSums.drawCalls / frames
+         << ",\"instances\":" << dumpSums.instances / frames
+         << ",\"pipelineBinds\":" << dumpSums.pipelineBinds / frames
+         << ",\"bytesUploaded\":" << dumpSums.bytesUploaded / frames
+         << ",\"descriptorAllocations\":" << dumpSums.descriptorAllocations / frames
+         << ",\"arenaHeapAllocations\":" << dumpSums.arenaHeapAllocations / frames
+         << "}" << std::endl;
+
+    dumpSums = {};
+    dumpMaxFrameMilliseconds = 0.0;
+    dumpFrames = 0;
+}
@@ -0,0 +1,355 @@
+#include "perfoverlay.h"
+#include "vulkanhelper.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+    struct Glyph {
+        char character;
+        // Rows from top to bottom, "#" for filled pixels.
+        const char* rows[5];
+    };
+
+    constexpr Glyph font[] = {
+        { '0', { "###", "#.#", "#.#", "#.#", "###" } },
+        { '1', { ".#.", "##.", ".#.", ".#.", "###" } },
+        { '2', { "###", "..#", "###", "#..", "###" } },
+        { '3', { "###", "..#", "###", "..#", "###" } },
+        { '4', { "#.#", "#.#", "###", "..#", "..#" } },
+        { '5', { "###", "#..", "###", "..#", "###" } },
+        { '6', { "###", "#..", "###", "#.#", "###" } },
+        { '7', { "###", "..#", "..#", "..#", "..#" } },
+        { '8', { "###", "#.#", "###", "#.#", "###" } },
+        { '9', { "###", "#.#", "###", "..#", "###" } },
+        { 'A', { "###", "#.#", "###", "#.#", "#.#" } },
+        { 'B', { "##.", "#.#", "##.", "#.#", "##." } },
+        { 'C', { "###", "#..", "#..", "#..", "###" } },
+        { 'D', { "##.", "#.#", "#.#", "#.#", "##." } },
+        { 'E', { "###", "#..", "###", "#..", "###" } },
+        { 'F', { "###", "#..", "###", "#..", "#.." } },
+        { 'G', { "###", "#..", "#.#", "#.#", "###" } },
+        { 'H', { "#.#", "#.#", "###", "#.#", "#.#" } },
+        { 'I', { "###", ".#.", ".#.", ".#.", "###" } },
+        { 'J', { "..#", "..#", "..#", "#.#", "###" } },
+        { 'K', { "#.#", "#.#", "##.", "#.#", "#.#" } },
+        { 'L', { "#..", "#..", "#..", "#..", "###" } },
+        { 'M', { "#.#", "###", "###", "#.#", "#.#" } },
+        { 'N', { "##.", "#.#", "#.#", "#.#", "#.#" } },
+        { 'O', { "###", "#.#", "#.#", "#.#", "###" } },
+        { 'P', { "###", "#.#", "###", "#..", "#.." } },
+        { 'Q', { "###", "#.#", "#.#", "###", "..#" } },
+        { 'R', { "###", "#.#", "##.", "#.#", "#.#" } },
+        { 'S', { "###", "#..", "###", "..#", "###" } },
+        { 'T', { "###", ".#.", ".#.", ".#.", ".#." } },
+        { 'U', { "#.#", "#.#", "#.#", "#.#", "###" } },
+        { 'V', { "#.#", "#.#", "#.#", "#.#", ".#." } },
+        { 'W', { "#.#", "#.#", "###", "###", "#.#" } },
+        { 'X', { "#.#", "#.#", ".#.", "#.#", "#.#" } },
+        { 'Y', { "#.#", "#.#", ".#.", ".#.", ".#." } },
+        { 'Z', { "###", "..#", ".#.", "#..", "###" } },
+        { '.', { "...", "...", "...", "...", ".#." } },
+        { '-', { "...", "...", "###", "...", "..." } },
+        { ':', { "...", ".#.", "...", ".#.", "..." } },
+        { '/', { "..#", "..#", ".#.", "#..", "#.." } },
+        { '%', { "#.#", "..#", ".#.", "#..", "#.#" } },
+    };
+
+    // Masks of the glyphs, indexed by character. Characters without a glyph, like spaces, have an empty mask.
+    struct FontMasks {
+        uint32_t masks[128] {};
+
+        constexpr FontMasks() {
+            for (const Glyph& glyph : font) {
+                uint32_t mask = 0;
+                for (uint32_t row = 0; row < 5; row++) {
+                    for (uint32_t column = 0; column < 3; column++) {
+                        if (glyph.rows[row][column] == '#') {
+                            mask |= 1u << (row * 3 + column);
+                        }
+                    }
+                }
+                masks[static_cast<unsigned char>(glyph.character)] = mask;
+            }
+        }
+    };
+
+    constexpr FontMasks fontMasks;
+
+    // Every pixel of the font is drawn as a square of this many output pixels.
+    constexpr float pixelSize = 2.0f;
+    constexpr float glyphAdvance = 4.0f * pixelSize;
+    constexpr float lineHeight = 7.0f * pixelSize;
+    constexpr float margin = 8.0f;
+
+    // The graph shows one bar per frame of history. Its height covers two frames at 60 Hz, and a line marks one.
+    constexpr float barWidth = 2.0f;
+    constexpr float graphHeight = 64.0f;
+    constexpr double graphMilliseconds = 1000.0 / 30.0;
+
+    constexpr float background[4] = { 0.0f, 0.0f, 0.0f, 0.6f };
+    constexpr float textColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    constexpr float lineColor[4] = { 1.0f, 1.0f, 1.0f, 0.4f };
+    constexpr float fastColor[4] = { 0.3f, 0.9f, 0.3f, 1.0f };
+    constexpr float slowColor[4] = { 0.9f, 0.8f, 0.2f, 1.0f };
+    constexpr float missedColor[4] = { 0.9f, 0.25f, 0.2f, 1.0f };
+}
+
+void PerfOverlay::init(VkPhysicalDevice physicalDevice, VkDevice device) {
+    logicalDevice = device;
+
+    // Rewritten by the CPU every frame and read once by the GPU, so host visible memory saves a staging copy.
+    VkDeviceSize size = rectangleOffset + maxRectangles * sizeof(Rectangle);
+    createBuffer(physicalDevice, logicalDevice, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory);
+
+    void* mapped = nullptr;
+    vkMapMemory(logicalDevice, memory, 0, size, 0, &mapped);
+    drawCommand = static_cast<VkDrawIndirectCommand*>(mapped);
+    rectangles = reinterpret_cast<Rectangle*>(static_cast<char*>(mapped) + rectangleOffset);
+
+    // Nothing is drawn until the first update.
+    *drawCommand = { 4, 0, 0, 0 };
+}
+
+void PerfOverlay::createPipeline(VkRenderPass renderPass, uint32_t subpass, std::span<const char> vertexShaderCode, std::span<const char> fragmentShaderCode) {
+    VkShaderModule vertexShaderModule = createShaderModule(logicalDevice, vertexShaderCode);
+    VkShaderModule fragmentShaderModule = createShaderModule(logicalDevice, fragmentShaderCode);
+
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertexShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragmentShaderModule;
+    shaderStages[1].pName = "main";
+
+    VkVertexInputBindingDescription binding = bindingDescription();
+    std::array<VkVertexInputAttributeDescription, 4> attributes = attributeDescriptions();
+
+    VkPipelineVertexInputStateCreateInfo vertexInputState {};
+    vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputState.vertexBindingDescriptionCount = 1;
+    vertexInputState.pVertexBindingDescriptions = &binding;
+    vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributes.size());
+    vertexInputState.pVertexAttributeDescriptions = attributes.data();
+
+    // Every rectangle is a quad of 4 vertices, like the sprites.
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState {};
+    inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+
+    VkPipelineViewportStateCreateInfo viewportState {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterizationState {};
+    rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationState.cullMode = VK_CULL_MODE_NONE;
+    rasterizationState.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizationState.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampleState {};
+    multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    // The background is translucent, so the frame stays visible behind the numbers.
+    VkPipelineColorBlendAttachmentState colorBlendAttachment {};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlendState {};
+    colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendState.attachmentCount = 1;
+    colorBlendState.pAttachments = &colorBlendAttachment;
+
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    // The size of the output in pixels, which rectangles are positioned in.
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(float) * 2;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        std::cout << "Failed to create overlay pipeline layout." << std::endl;
+        std::terminate();
+    }
+
+    VkGraphicsPipelineCreateInfo pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputState;
+    pipelineInfo.pInputAssemblyState = &inputAssemblyState;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizationState;
+    pipelineInfo.pMultisampleState = &multisampleState;
+    pipelineInfo.pColorBlendState = &colorBlendState;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = subpass;
+    pipelineInfo.basePipelineIndex = -1;
+
+    if (vkCreateGraphicsPipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        std::cout << "Failed to create overlay pipeline." << std::endl;
+        std::terminate();
+    }
+
+    vkDestroyShaderModule(logicalDevice, vertexShaderModule, nullptr);
+    vkDestroyShaderModule(logicalDevice, fragmentShaderModule, nullptr);
+}
+
+void PerfOverlay::destroy() {
+    vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+    vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+
+    vkUnmapMemory(logicalDevice, memory);
+    vkDestroyBuffer(logicalDevice, buffer, nullptr);
+    vkFreeMemory(logicalDevice, memory, nullptr);
+}
+
+void PerfOverlay::update(const PerfCounters& counters) {
+    if (!overlayEnabled) {
+        return;
+    }
+
+    rectangleCount = 0;
+
+    const FrameCounters& last = counters.lastFrame();
+    FrameCounters average = counters.average();
+
+    char lines[9][64];
+    std::snprintf(lines[0], sizeof(lines[0]), "FRAME   %6.2f MS", average.frameMilliseconds);
+    std::snprintf(lines[1], sizeof(lines[1]), "FENCE   %6.2f MS", average.fenceWaitMilliseconds);
+    std::snprintf(lines[2], sizeof(lines[2]), "ACQUIRE %6.2f MS", average.acquireWaitMilliseconds);
+    std::snprintf(lines[3], sizeof(lines[3]), "DRAWS     %u", last.drawCalls);
+    std::snprintf(lines[4], sizeof(lines[4]), "INSTANCES %llu", static_cast<unsigned long long>(last.instances));
+    std::snprintf(lines[5], sizeof(lines[5]), "BINDS     %u", last.pipelineBinds);
+    std::snprintf(lines[6], sizeof(lines[6]), "UPLOAD    %.1f KB", average.bytesUploaded / 1024.0);
+    std::snprintf(lines[7], sizeof(lines[7]), "DESCRIPTORS %u", last.descriptorAllocations);
+    std::snprintf(lines[8], sizeof(lines[8]), "ARENA HEAP  %u", last.arenaHeapAllocations);
+
+    // The panel is as wide as the graph, which is wider than any line of text.
+    float panelWidth = PerfCounters::historySize * barWidth + 2.0f * margin;
+    float textHeight = 9 * lineHeight;
+    float panelHeight = textHeight + graphHeight + 3.0f * margin;
+    addRectangle(margin, margin, panelWidth, panelHeight, background);
+
+    float y = 2.0f * margin;
+    for (const char* line : lines) {
+        addText(2.0f * margin, y, line, textColor);
+        y += lineHeight;
+    }
+
+    // Newest frame on the right. Bars are colored by whether the frame made 60 Hz, 30 Hz, or neither.
+    float graphBottom = 2.0f * margin + textHeight + margin + graphHeight;
+    float graphRight = 2.0f * margin + PerfCounters::historySize * barWidth;
+    for (uint32_t i = 0; i < counters.frameCount(); i++) {
+        double milliseconds = counters.lastFrame(i).frameMilliseconds;
+        float height = static_cast<float>(milliseconds / graphMilliseconds) * graphHeight;
+        height = height < graphHeight ? height : graphHeight;
+        const float* color = milliseconds <= 1000.0 / 60.0 ? fastColor : milliseconds <= 1000.0 / 30.0 ? slowColor : missedColor;
+        addRectangle(graphRight - (i + 1) * barWidth, graphBottom - height, barWidth, height, color);
+    }
+    addRectangle(2.0f * margin, graphBottom - graphHeight * 0.5f, PerfCounters::historySize * barWidth, 1.0f, lineColor);
+
+    drawCommand->instanceCount = rectangleCount;
+}
+
+void PerfOverlay::record(VkCommandBuffer commandBuffer, VkExtent2D outputExtent, CommandCounters& counters) const {
+    if (!overlayEnabled) {
+        return;
+    }
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    counters.bindPipeline();
+
+    VkViewport viewport {};
+    viewport.width = static_cast<float>(outputExtent.width);
+    viewport.height = static_cast<float>(outputExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor {};
+    scissor.extent = outputExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    float screenSize[2] = { static_cast<float>(outputExtent.width), static_cast<float>(outputExtent.height) };
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(screenSize), screenSize);
+
+    VkDeviceSize offset = rectangleOffset;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffer, &offset);
+
+    // The instance count is read from the buffer when the command executes, so it can change without recording again.
+    // It isn't known here, so the overlay's rectangles aren't counted as instances.
+    vkCmdDrawIndirect(commandBuffer, buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+    counters.draw(0);
+}
+
+VkVertexInputBindingDescription PerfOverlay::bindingDescription() {
+    VkVertexInputBindingDescription binding {};
+    binding.binding = 0;
+    binding.stride = sizeof(Rectangle);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    return binding;
+}
+
+std::array<VkVertexInputAttributeDescription, 4> PerfOverlay::attributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 4> attributes {};
+
+    attributes[0] = { 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Rectangle, position) };
+    attributes[1] = { 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Rectangle, size) };
+    attributes[2] = { 2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Rectangle, color) };
+    attributes[3] = { 3, 0, VK_FORMAT_R32_UINT, offsetof(Rectangle, mask) };
+
+    return attributes;
+}
+
+void PerfOverlay::addRectangle(float x, float y, float width, float height, const float color[4], uint32_t mask) {
+    if (rectangleCount >= maxRectangles) {
+        return;
+    }
+
+    Rectangle& rectangle = rectangles[rectangleCount++];
+    rectangle.position[0] = x;
+    rectangle.position[1] = y;
+    rectangle.size[0] = width;
+    rectangle.size[1] = height;
+    for (int i = 0; i < 4; i++) {
+        rectangle.color[i] = color[i];
+    }
+    rectangle.mask = mask;
+}
+
+void PerfOverlay::addText(float x, float y, std::string_view text, const float color[4]) {
+    for (char character : text) {
+        uint32_t mask = static_cast<unsigned char>(character) < 128 ? fontMasks.masks[static_cast<unsigned char>(character)] : 0;
+        if (mask != 0) {
+            addRectangle(x, y, 3.0f * pixelSize, 5.0f * pixelSize, color, mask);
+        }
+        x += glyphAdvance;
+    }
+}
@@ -0,0 +1,305 @@
+#include "platformwindow.h"
+
+#include <Windows.h>
+#include <iostream>
+
+namespace {
+    // Posted by "destroy", since a window can only be destroyed by the thread that created it.
+    constexpr UINT destroyWindowMessage = WM_APP;
+
+    LRESULT CALLBACK windowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+        // The window is created with a pointer to its PlatformWindow, which is kept in the window's user data from then on.
+        if (message == WM_NCCREATE) {
+            auto createStruct = reinterpret_cast<const CREATESTRUCT*>(lParam);
+            SetWindowLongPtr(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(createStruct->lpCreateParams));
+        }
+
+        auto window = reinterpret_cast<PlatformWindow*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
+        if (window != nullptr && window->handleMessage(message, wParam, lParam)) {
+            return 0;
+        }
+        return DefWindowProc(hwnd, message, wParam, lParam);
+    }
+
+    int64_t counterFrequency() {
+        static const int64_t frequency = [] {
+            LARGE_INTEGER value {};
+            QueryPerformanceFrequency(&value);
+            return value.QuadPart;
+        }();
+        return frequency;
+    }
+
+    int32_t lowWord(LPARAM lParam) {
+        return static_cast<int16_t>(LOWORD(lParam));
+    }
+
+    int32_t highWord(LPARAM lParam) {
+        return static_cast<int16_t>(HIWORD(lParam));
+    }
+}
+
+void InputState::beginStep() {
+    mouseDeltaX = 0;
+    mouseDeltaY = 0;
+    wheelDelta = 0;
+}
+
+void InputState::apply(const InputEvent& event) {
+    switch (event.type) {
+        case InputEventType::KeyDown:
+            if (event.code < keysDown.size()) {
+                keysDown.set(event.code);
+            }
+            break;
+        case InputEventType::KeyUp:
+            if (event.code < keysDown.size()) {
+                keysDown.reset(event.code);
+            }
+            break;
+        case InputEventType::MouseMove:
+            mouseX = event.x;
+            mouseY = event.y;
+            break;
+        case InputEventType::MouseDelta:
+            mouseDeltaX += event.x;
+            mouseDeltaY += event.y;
+            break;
+        case InputEventType::MouseButtonDown:
+            mouseButtonsDown |= 1u << event.code;
+            mouseX = event.x;
+            mouseY = event.y;
+            break;
+        case InputEventType::MouseButtonUp:
+            mouseButtonsDown &= ~(1u << event.code);
+            mouseX = event.x;
+            mouseY = event.y;
+            break;
+        case InputEventType::MouseWheel:
+            wheelDelta += event.y;
+            break;
+        default:
+            break;
+    }
+}
+
+PlatformWindow::~PlatformWindow() {
+    destroy();
+}
+
+void* PlatformWindow::create(void* instance, int showCommand, const std::string& title, int width, int height) {
+    // Auto-reset events. A wait on "eventSignal" returns once for any number of events pushed before it.
+    createdSignal = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    eventSignal = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+    platformThread = std::thread(&PlatformWindow::threadMain, this, instance, showCommand, title, width, height);
+
+    // Signaling the event publishes "windowHandle" to this thread.
+    WaitForSingleObject(createdSignal, INFINITE);
+    return windowHandle;
+}
+
+void PlatformWindow::destroy() {
+    if (!platformThread.joinable()) {
+        return;
+    }
+
+    // Destroying the window ends the platform thread's message loop.
+    PostMessage(static_cast<HWND>(windowHandle), destroyWindowMessage, 0, 0);
+    platformThread.join();
+    windowHandle = nullptr;
+
+    CloseHandle(createdSignal);
+    CloseHandle(eventSignal);
+    createdSignal = nullptr;
+    eventSignal = nullptr;
+}
+
+void PlatformWindow::waitForEvents(uint32_t milliseconds) {
+    WaitForSingleObject(eventSignal, milliseconds);
+}
+
+InputLatencyStats PlatformWindow::latencyStats() const {
+    InputLatencyStats stats {};
+    stats.eventCount = consumedEvents;
+    stats.averageMilliseconds = consumedEvents > 0 ? totalLatencyMilliseconds / consumedEvents : 0.0;
+    stats.maxMilliseconds = maxLatencyMilliseconds;
+    stats.droppedEvents = droppedEvents.load(std::memory_order_relaxed);
+    return stats;
+}
+
+int64_t PlatformWindow::now() {
+    LARGE_INTEGER counter {};
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+int64_t PlatformWindow::secondsToTicks(double seconds) {
+    return static_cast<int64_t>(seconds * counterFrequency());
+}
+
+double PlatformWindow::ticksToMilliseconds(int64_t ticks) {
+    return ticks * 1000.0 / counterFrequency();
+}
+
+void PlatformWindow::threadMain(void* instance, int showCommand, std::string title, int width, int height) {
+    HINSTANCE hInstance = static_cast<HINSTANCE>(instance);
+
+    WNDCLASSEX wcex = {};
+
+    std::string window_class_name = "Main Game Window";
+
+    // Size in bytes of structure. Must always be set to sizeof(WNDCLASSEX)
+    wcex.cbSize = sizeof(WNDCLASSEX);
+    wcex.style = CS_HREDRAW | CS_VREDRAW;
+    wcex.lpfnWndProc = windowProc;
+    wcex.hInstance = hInstance;
+    wcex.hCursor = LoadCursor(NULL, IDC_ARROW);
+    wcex.lpszClassName = window_class_name.c_str();
+
+    if (!RegisterClassEx(&wcex))
+    {
+        std::cout << "Failed to register window class." << std::endl;
+        std::terminate();
+    }
+
+    // The window belongs to the thread that creates it, so its messages are delivered to this thread's message loop.
+    // If CreateWindowEx fails, it returns NULL.
+    HWND hwnd = CreateWindowEx(
+        0,
+        window_class_name.c_str(),
+        title.c_str(),
+        WS_OVERLAPPEDWINDOW,
+        CW_USEDEFAULT, CW_USEDEFAULT,
+        width, height,
+        NULL,
+        NULL,
+        hInstance,
+        this
+    );
+
+    if (!hwnd)
+    {
+        std::cout << "Failed to create window." << std::endl;
+        std::terminate();
+    }
+
+    windowHandle = hwnd;
+    ShowWindow(hwnd, showCommand);
+
+    // Raw input reports every motion of the mouse as the device sends it, unaffected by pointer acceleration or the screen edges.
+    RAWINPUTDEVICE mouseDevice = {};
+    mouseDevice.usUsagePage = 0x01; // Generic desktop controls
+    mouseDevice.usUsage = 0x02; // Mouse
+    mouseDevice.hwndTarget = hwnd;
+    if (!RegisterRawInputDevices(&mouseDevice, 1, sizeof(mouseDevice)))
+    {
+        std::cout << "Failed to register for raw mouse input, mouse deltas won't be reported." << std::endl;
+    }
+
+    SetEvent(createdSignal);
+
+    // This thread does nothing but wait for messages, so each one is handled as soon as it arrives.
+    // Moving or resizing the window runs a modal loop inside DefWindowProc, which now only blocks this thread, not the game.
+    MSG msg = {};
+    while (GetMessage(&msg, NULL, 0, 0) > 0)
+    {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+
+    UnregisterClass(window_class_name.c_str(), hInstance);
+}
+
+bool PlatformWindow::handleMessage(uint32_t message, uintptr_t wParam, intptr_t lParam) {
+    switch (message)
+    {
+        // Key messages still go on to DefWindowProc, so that system keys like Alt+F4 keep working.
+        case WM_KEYDOWN:
+        case WM_SYSKEYDOWN:
+            // Bit 30 is set for auto-repeats of a key that is held down.
+            if ((lParam & (1 << 30)) == 0) {
+                pushEvent(InputEventType::KeyDown, static_cast<uint32_t>(wParam), 0, 0);
+            }
+            return false;
+        case WM_KEYUP:
+        case WM_SYSKEYUP:
+            pushEvent(InputEventType::KeyUp, static_cast<uint32_t>(wParam), 0, 0);
+            return false;
+        case WM_MOUSEMOVE:
+            pushEvent(InputEventType::MouseMove, 0, lowWord(lParam), highWord(lParam));
+            return true;
+        case WM_LBUTTONDOWN:
+            pushEvent(InputEventType::MouseButtonDown, 0, lowWord(lParam), highWord(lParam));
+            return true;
+        case WM_RBUTTONDOWN:
+            pushEvent(InputEventType::MouseButtonDown, 1, lowWord(lParam), highWord(lParam));
+            return true;
+        case WM_MBUTTONDOWN:
+            pushEvent(InputEventType::MouseButtonDown, 2, lowWord(lParam), highWord(lParam));
+            return true;
+        case WM_LBUTTONUP:
+            pushEvent(InputEventType::MouseButtonUp, 0, lowWord(lParam), highWord(lParam));
+            return true;
+        case WM_RBUTTONUP:
+            pushEvent(InputEventType::MouseButtonUp, 1, lowWord(lParam), highWord(lParam));
+            return true;
+        case WM_MBUTTONUP:
+            pushEvent(InputEventType::MouseButtonUp, 2, lowWord(lParam), highWord(lParam));
+            return true;
+        case WM_MOUSEWHEEL:
+            pushEvent(InputEventType::MouseWheel, 0, 0, GET_WHEEL_DELTA_WPARAM(wParam));
+            return true;
+        case WM_INPUT:
+        {
+            RAWINPUT rawInput = {};
+            UINT size = sizeof(rawInput);
+            if (GetRawInputData(reinterpret_cast<HRAWINPUT>(lParam), RID_INPUT, &rawInput, &size, sizeof(RAWINPUTHEADER)) != static_cast<UINT>(-1) &&
+                rawInput.header.dwType == RIM_TYPEMOUSE && (rawInput.data.mouse.usFlags & MOUSE_MOVE_ABSOLUTE) == 0 &&
+                (rawInput.data.mouse.lLastX != 0 || rawInput.data.mouse.lLastY != 0)) {
+                pushEvent(InputEventType::MouseDelta, 0, rawInput.data.mouse.lLastX, rawInput.data.mouse.lLastY);
+            }
+            // DefWindowProc has to clean up after WM_INPUT.
+            return false;
+        }
+        case WM_SIZE:
+            pushEvent(InputEventType::WindowResized, 0, lowWord(lParam), highWord(lParam));
+            return false;
+        // Closing is left to the game, which may still be presenting to the window.
+        case WM_CLOSE:
+            pushEvent(InputEventType::WindowClosed, 0, 0, 0);
+            return true;
+        case destroyWindowMessage:
+            DestroyWindow(static_cast<HWND>(windowHandle));
+            return true;
+        case WM_DESTROY:
+            PostQuitMessage(0);
+            return true;
+    }
+    return false;
+}
+
+void PlatformWindow::pushEvent(InputEventType type, uint32_t code, int32_t x, int32_t y) {
+    InputEvent event {};
+    event.timestamp = now();
+    event.type = type;
+    event.code = code;
+    event.x = x;
+    event.y = y;
+
+    // Blocking here would stall the message loop, so when the game is too far behind, the event is dropped instead.
+    if (!events.push(event)) {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    SetEvent(eventSignal);
+}
+
+void PlatformWindow::recordLatency(int64_t latencyTicks) {
+    double milliseconds = ticksToMilliseconds(latencyTicks);
+    consumedEvents++;
+    totalLatencyMilliseconds += milliseconds;
+    if (milliseconds > maxLatencyMilliseconds) {
+        maxLatencyMilliseconds = milliseconds;
+    }
+}
@@ -0,0 +1,188 @@
+#include "scenehierarchy.h"
+#include "spritebatch.h"
+#include "threadpool.h"
+
+#include <algorithm>
+
+NodeId SceneHierarchy::createNode(NodeId parent, const Transform2D& localTransform) {
+    NodeId node = static_cast<NodeId>(parentOf.size());
+    uint32_t index = static_cast<uint32_t>(nodeAt.size());
+
+    parentOf.push_back(parent);
+    indexOf.push_back(index);
+
+    // The node is appended out of order for now. It's moved to its place when the order is rebuilt, before the next propagation.
+    nodeAt.push_back(node);
+    parentIndex.push_back(parent == invalidNode ? invalidNode : indexOf[parent]);
+    locals.push_back(localTransform);
+    worlds.emplace_back();
+    dirty.push_back(1);
+    spriteInstance.push_back(noSprite);
+    spriteSize.push_back(0.0f);
+    spriteSize.push_back(0.0f);
+
+    orderChanged = true;
+    anyDirty = true;
+    return node;
+}
+
+void SceneHierarchy::setLocalTransform(NodeId node, const Transform2D& localTransform) {
+    uint32_t index = indexOf[node];
+    locals[index] = localTransform;
+    dirty[index] = 1;
+    anyDirty = true;
+}
+
+void SceneHierarchy::attachSprite(NodeId node, uint32_t instanceIndex, float width, float height) {
+    uint32_t index = indexOf[node];
+    spriteInstance[index] = instanceIndex;
+    spriteSize[index * 2 + 0] = width;
+    spriteSize[index * 2 + 1] = height;
+
+    // The sprite has to be written even when the transform didn't change.
+    dirty[index] = 1;
+    anyDirty = true;
+}
+
+bool SceneHierarchy::propagate(SpriteBatch& spriteBatch, ThreadPool* pool) {
+    if (orderChanged) {
+        rebuildOrder();
+    }
+    if (!anyDirty) {
+        return false;
+    }
+
+    // Every level only reads the level above it, which is complete once the previous iteration returns.
+    for (size_t level = 0; level + 1 < levelStarts.size(); level++) {
+        uint32_t levelBegin = levelStarts[level];
+        uint32_t levelCount = levelStarts[level + 1] - levelBegin;
+
+        if (pool != nullptr && levelCount >= parallelBatchSize * 2) {
+            pool->parallelFor(levelCount, parallelBatchSize, [&](uint32_t begin, uint32_t end) {
+                propagateRange(levelBegin + begin, levelBegin + end, spriteBatch);
+            });
+        } else {
+            propagateRange(levelBegin, levelBegin + levelCount, spriteBatch);
+        }
+    }
+
+    std::fill(dirty.begin(), dirty.end(), uint8_t(0));
+    anyDirty = false;
+
+    spriteBatch.markChanged();
+    return true;
+}
+
+void SceneHierarchy::propagateRange(uint32_t begin, uint32_t end, SpriteBatch& spriteBatch) {
+    std::span<SpriteInstance> instances = spriteBatch.instances();
+
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t parent = parentIndex[i];
+        bool parentDirty = parent != invalidNode && dirty[parent];
+        if (!dirty[i] && !parentDirty) {
+            continue;
+        }
+
+        Affine2D local = Affine2D::fromTransform(locals[i]);
+        worlds[i] = parent == invalidNode ? local : worlds[parent] * local;
+        // Pass the change down to the children, which are handled with the next level.
+        dirty[i] = 1;
+
+        if (spriteInstance[i] != noSprite) {
+            const Affine2D& world = worlds[i];
+            float width = spriteSize[i * 2 + 0];
+            float height = spriteSize[i * 2 + 1];
+
+            SpriteInstance& instance = instances[spriteInstance[i]];
+            instance.xAxis[0] = world.a * width;
+            instance.xAxis[1] = world.b * width;
+            instance.yAxis[0] = world.c * height;
+            instance.yAxis[1] = world.d * height;
+            instance.position[0] = world.tx;
+            instance.position[1] = world.ty;
+        }
+    }
+}
+
+void SceneHierarchy::rebuildOrder() {
+    uint32_t count = nodeCount();
+
+    // Children of every node as one flat array, with the children of node n at [childStarts[n], childStarts[n + 1]).
+    std::vector<uint32_t> childStarts(count + 1, 0);
+    for (NodeId node = 0; node < count; node++) {
+        if (parentOf[node] != invalidNode) {
+            childStarts[parentOf[node] + 1]++;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        childStarts[i + 1] += childStarts[i];
+    }
+
+    std::vector<NodeId> children(childStarts[count]);
+    std::vector<uint32_t> childFill(childStarts.begin(), childStarts.end() - 1);
+    for (NodeId node = 0; node < count; node++) {
+        if (parentOf[node] != invalidNode) {
+            children[childFill[parentOf[node]]++] = node;
+        }
+    }
+
+    // Breadth-first traversal, starting with all roots. The order array doubles as the queue.
+    std::vector<NodeId> order;
+    order.reserve(count);
+    for (NodeId node = 0; node < count; node++) {
+        if (parentOf[node] == invalidNode) {
+            order.push_back(node);
+        }
+    }
+
+    levelStarts.clear();
+    size_t levelEnd = 0;
+    for (size_t i = 0; i < order.size(); i++) {
+        if (i == levelEnd) {
+            levelStarts.push_back(static_cast<uint32_t>(i));
+            levelEnd = order.size();
+        }
+
+        NodeId node = order[i];
+        for (uint32_t child = childStarts[node]; child < childStarts[node + 1]; child++) {
+            order.push_back(children[child]);
+        }
+    }
+    levelStarts.push_back(static_cast<uint32_t>(order.size()));
+
+    // Move every node's data to its new position.
+    std::vector<uint32_t> newParentIndex(count);
+    std::vector<Transform2D> newLocals(count);
+    std::vector<Affine2D> newWorlds(count);
+    std::vector<uint8_t> newDirty(count);
+    std::vector<uint32_t> newSpriteInstance(count);
+    std::vector<float> newSpriteSize(count * 2);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t oldIndex = indexOf[order[i]];
+        newLocals[i] = locals[oldIndex];
+        newWorlds[i] = worlds[oldIndex];
+        newDirty[i] = dirty[oldIndex];
+        newSpriteInstance[i] = spriteInstance[oldIndex];
+        newSpriteSize[i * 2 + 0] = spriteSize[oldIndex * 2 + 0];
+        newSpriteSize[i * 2 + 1] = spriteSize[oldIndex * 2 + 1];
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        indexOf[order[i]] = i;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        NodeId parent = parentOf[order[i]];
+        newParentIndex[i] = parent == invalidNode ? invalidNode : indexOf[parent];
+    }
+
+    nodeAt = std::move(order);
+    parentIndex = std::move(newParentIndex);
+    locals = std::move(newLocals);
+    worlds = std::move(newWorlds);
+    dirty = std::move(newDirty);
+    spriteInstance = std::move(newSpriteInstance);
+    spriteSize = std::move(newSpriteSize);
+
+    orderChanged = false;
+}
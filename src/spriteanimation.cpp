@@ -0,0 +1,179 @@
+#include "spriteanimation.h"
+#include "spritebatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace {
+    // UVs of neighbouring frames are computed in floating point, so spacing is compared with some tolerance.
+    constexpr float stripTolerance = 1e-5f;
+
+    bool nearlyEqual(float a, float b) {
+        return std::abs(a - b) <= stripTolerance;
+    }
+
+    // Whether the frames are equally sized, in a single row, and equally spaced from left to right.
+    bool isStrip(std::span<const AtlasUvRect> frames, float& stride) {
+        if (frames.size() < 2) {
+            return false;
+        }
+
+        const AtlasUvRect& first = frames[0];
+        stride = frames[1].u0 - first.u0;
+        if (stride <= 0.0f) {
+            return false;
+        }
+
+        for (size_t i = 1; i < frames.size(); i++) {
+            const AtlasUvRect& frame = frames[i];
+            if (!nearlyEqual(frame.v0, first.v0) || !nearlyEqual(frame.v1, first.v1) ||
+                !nearlyEqual(frame.u0, first.u0 + stride * i) || !nearlyEqual(frame.u1 - frame.u0, first.u1 - first.u0)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+ClipId SpriteAnimationSystem::addClip(std::span<const AtlasUvRect> frames, float framesPerSecond, bool loop) {
+    SpriteClip clip {};
+    clip.firstFrame = static_cast<uint32_t>(frameTable.size());
+    clip.frameCount = static_cast<uint32_t>(frames.size());
+    clip.framesPerSecond = framesPerSecond;
+    clip.loop = loop;
+    clip.isStrip = isStrip(frames, clip.stripStride);
+
+    frameTable.insert(frameTable.end(), frames.begin(), frames.end());
+    clips.push_back(clip);
+    return static_cast<ClipId>(clips.size() - 1);
+}
+
+AnimatorId SpriteAnimationSystem::play(uint32_t instanceIndex, ClipId clip, float speed) {
+    AnimatorId id;
+    if (!freeAnimators.empty()) {
+        id = freeAnimators.back();
+        freeAnimators.pop_back();
+    } else {
+        id = static_cast<AnimatorId>(indexOf.size());
+        indexOf.push_back(0);
+    }
+
+    indexOf[id] = static_cast<uint32_t>(times.size());
+    times.push_back(0.0f);
+    speeds.push_back(speed);
+    clipIds.push_back(clip);
+    instanceIndices.push_back(instanceIndex);
+    // No frame has been written yet, so the next update writes the first one.
+    currentFrames.push_back(UINT32_MAX);
+    animatorAt.push_back(id);
+    return id;
+}
+
+void SpriteAnimationSystem::stop(AnimatorId animator) {
+    uint32_t index = indexOf[animator];
+    uint32_t last = static_cast<uint32_t>(times.size() - 1);
+
+    times[index] = times[last];
+    speeds[index] = speeds[last];
+    clipIds[index] = clipIds[last];
+    instanceIndices[index] = instanceIndices[last];
+    currentFrames[index] = currentFrames[last];
+    animatorAt[index] = animatorAt[last];
+    indexOf[animatorAt[index]] = index;
+
+    times.pop_back();
+    speeds.pop_back();
+    clipIds.pop_back();
+    instanceIndices.pop_back();
+    currentFrames.pop_back();
+    animatorAt.pop_back();
+
+    freeAnimators.push_back(animator);
+}
+
+void SpriteAnimationSystem::setClip(AnimatorId animator, ClipId clip) {
+    uint32_t index = indexOf[animator];
+    clipIds[index] = clip;
+    times[index] = 0.0f;
+    currentFrames[index] = UINT32_MAX;
+}
+
+void SpriteAnimationSystem::setSpeed(AnimatorId animator, float speed) {
+    speeds[indexOf[animator]] = speed;
+}
+
+bool SpriteAnimationSystem::update(float deltaSeconds, SpriteBatch& spriteBatch) {
+    std::span<SpriteInstance> instances = spriteBatch.instances();
+    bool changed = false;
+
+    for (size_t i = 0; i < times.size(); i++) {
+        const SpriteClip& clip = clips[clipIds[i]];
+        if (clip.frameCount == 0) {
+            continue;
+        }
+
+        uint32_t frame = 0;
+        if (clip.framesPerSecond > 0.0f) {
+            // Looping clips keep their time within one loop, so it doesn't lose precision as it grows.
+            // Clips that don't loop stop on their last frame, or their first when played backwards.
+            float duration = clip.frameCount / clip.framesPerSecond;
+            float time = times[i] + deltaSeconds * speeds[i];
+            if (clip.loop) {
+                time = std::fmod(time, duration);
+                if (time < 0.0f) {
+                    time += duration;
+                }
+            } else {
+                time = std::clamp(time, 0.0f, duration);
+            }
+            times[i] = time;
+
+            frame = std::min(static_cast<uint32_t>(time * clip.framesPerSecond), clip.frameCount - 1);
+        }
+
+        if (frame != currentFrames[i]) {
+            currentFrames[i] = frame;
+            instances[instanceIndices[i]].uv = frameTable[clip.firstFrame + frame];
+            changed = true;
+        }
+    }
+
+    if (changed) {
+        spriteBatch.markChanged();
+    }
+    return changed;
+}
+
+bool SpriteAnimationSystem::playOnGpu(uint32_t instanceIndex, ClipId clipId, float speed, float startTime, SpriteBatch& spriteBatch) {
+    const SpriteClip& clip = clips[clipId];
+    if (!clip.isStrip || !clip.loop) {
+        return false;
+    }
+
+    SpriteInstance& instance = spriteBatch.instances()[instanceIndex];
+    if (instance.gpuAnimation[0] < 2.0f) {
+        gpuAnimationCount++;
+    }
+
+    instance.uv = frameTable[clip.firstFrame];
+    instance.gpuAnimation[0] = static_cast<float>(clip.frameCount);
+    instance.gpuAnimation[1] = clip.framesPerSecond * speed;
+    instance.gpuAnimation[2] = startTime;
+    instance.gpuAnimation[3] = clip.stripStride;
+
+    spriteBatch.markChanged();
+    return true;
+}
+
+void SpriteAnimationSystem::stopOnGpu(uint32_t instanceIndex, SpriteBatch& spriteBatch) {
+    SpriteInstance& instance = spriteBatch.instances()[instanceIndex];
+    if (instance.gpuAnimation[0] < 2.0f) {
+        return;
+    }
+
+    gpuAnimationCount--;
+    std::fill(std::begin(instance.gpuAnimation), std::end(instance.gpuAnimation), 0.0f);
+    spriteBatch.markChanged();
+}
@@ -0,0 +1,248 @@
+#include "spritebatch.h"
+#include "vulkanhelper.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <numeric>
+
+void SpriteBatch::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t capacity, bool opaqueFirst) {
+    logicalDevice = device;
+    instanceCapacity = capacity;
+    this->opaqueFirst = opaqueFirst;
+    spriteInstances.reserve(capacity);
+    drawOrder.reserve(capacity);
+
+    // The buffers are rewritten by the CPU whenever sprites change, and only read once per frame by the GPU,
+    // so host visible memory is good enough, and saves a staging copy.
+    for (auto& slot : slots) {
+        createBuffer(physicalDevice, logicalDevice, capacity * sizeof(SpriteInstance), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot.buffer, slot.memory);
+
+        void* mapped = nullptr;
+        vkMapMemory(logicalDevice, slot.memory, 0, capacity * sizeof(SpriteInstance), 0, &mapped);
+        slot.mapped = static_cast<SpriteInstance*>(mapped);
+
+        createBuffer(physicalDevice, logicalDevice, sizeof(FrameUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot.uniformBuffer, slot.uniformMemory);
+
+        vkMapMemory(logicalDevice, slot.uniformMemory, 0, sizeof(FrameUniforms), 0, &mapped);
+        slot.uniforms = static_cast<FrameUniforms*>(mapped);
+    }
+
+    createDescriptors();
+}
+
+void SpriteBatch::destroy() {
+    for (auto& slot : slots) {
+        vkUnmapMemory(logicalDevice, slot.memory);
+        vkDestroyBuffer(logicalDevice, slot.buffer, nullptr);
+        vkFreeMemory(logicalDevice, slot.memory, nullptr);
+
+        vkUnmapMemory(logicalDevice, slot.uniformMemory);
+        vkDestroyBuffer(logicalDevice, slot.uniformBuffer, nullptr);
+        vkFreeMemory(logicalDevice, slot.uniformMemory, nullptr);
+    }
+
+    vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(logicalDevice, frameLayout, nullptr);
+}
+
+uint32_t SpriteBatch::add(const SpriteInstance& instance) {
+    if (spriteInstances.size() >= instanceCapacity) {
+        std::cout << "Sprite batch is full." << std::endl;
+        std::terminate();
+    }
+
+    spriteInstances.push_back(instance);
+    markChanged();
+    return static_cast<uint32_t>(spriteInstances.size() - 1);
+}
+
+uint64_t SpriteBatch::upload(uint32_t slotIndex, FrameArena& frameArena) {
+    Slot& slot = slots[slotIndex];
+    slot.uniforms->time = currentTime;
+
+    if (slot.uploadedVersion == version) {
+        return sizeof(FrameUniforms);
+    }
+
+    sortDrawOrder(frameArena);
+
+    // Every sprite gets its own depth from its place in the back to front order, from just below 1 at the back to just above 0 at the front.
+    // The depth test then gives the same result as drawing back to front, whatever order the sprites are actually drawn in.
+    float depthStep = 1.0f / (count() + 1);
+    auto writeInstance = [&](uint32_t& written, uint32_t rank) {
+        SpriteInstance& instance = slot.mapped[written++];
+        instance = spriteInstances[drawOrder[rank]];
+        instance.depth = 1.0f - (rank + 1) * depthStep;
+    };
+
+    // The buffer is written from start to end, in one pass per group, since it's write-combined memory that is slow to read or jump around in.
+    uint32_t written = 0;
+    if (opaqueFirst) {
+        for (uint32_t rank = count(); rank-- > 0;) {
+            if (spriteInstances[drawOrder[rank]].color[3] >= 1.0f) {
+                writeInstance(written, rank);
+            }
+        }
+    }
+    slot.opaqueCount = written;
+
+    for (uint32_t rank = 0; rank < count(); rank++) {
+        if (!opaqueFirst || spriteInstances[drawOrder[rank]].color[3] < 1.0f) {
+            writeInstance(written, rank);
+        }
+    }
+
+    slot.uploadedVersion = version;
+    slot.uploadedCount = count();
+    return sizeof(FrameUniforms) + written * sizeof(SpriteInstance);
+}
+
+void SpriteBatch::sortDrawOrder(FrameArena& frameArena) {
+    drawOrder.resize(spriteInstances.size());
+    std::iota(drawOrder.begin(), drawOrder.end(), 0u);
+
+    // Most scenes put everything on the same layer, and then the order of the instances already is the drawing order.
+    bool singleLayer = std::all_of(spriteInstances.begin(), spriteInstances.end(),
+        [&](const SpriteInstance& instance) { return instance.layer == spriteInstances.front().layer; });
+    if (singleLayer) {
+        return;
+    }
+
+    // A stable sort keeps the order of the instances within each layer. std::stable_sort allocates a buffer of its own every time,
+    // so this is a bottom-up merge sort instead, which merges runs back and forth between the draw order and scratch space from the
+    // frame arena. Merging takes from the left run first on ties, which is what keeps it stable.
+    auto byLayer = [&](uint32_t a, uint32_t b) { return spriteInstances[a].layer < spriteInstances[b].layer; };
+    size_t count = drawOrder.size();
+    FrameVector<uint32_t> scratch(count, FrameAllocator<uint32_t>(frameArena));
+    uint32_t* source = drawOrder.data();
+    uint32_t* target = scratch.data();
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t begin = 0; begin < count; begin += 2 * width) {
+            size_t middle = std::min(begin + width, count);
+            size_t end = std::min(begin + 2 * width, count);
+            std::merge(source + begin, source + middle, source + middle, source + end, target + begin, byLayer);
+        }
+        std::swap(source, target);
+    }
+
+    if (source != drawOrder.data()) {
+        std::copy(source, source + count, drawOrder.data());
+    }
+}
+
+void SpriteBatch::record(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t slotIndex,
+                         VkPipeline opaquePipeline, VkPipeline translucentPipeline, CommandCounters& counters) const {
+    const Slot& slot = slots[slotIndex];
+    if (slot.uploadedCount == 0) {
+        return;
+    }
+
+    // Both pipelines use the same layout, so the descriptor set stays bound when switching between them.
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &slot.frameSet, 0, nullptr);
+
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &slot.buffer, &offset);
+
+    // Every sprite is a quad of 4 vertices drawn as a triangle strip, with the corners generated in the vertex shader.
+    // The opaque sprites are the first instances in the buffer, and the translucent ones follow.
+    if (slot.opaqueCount > 0) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, opaquePipeline);
+        vkCmdDraw(commandBuffer, 4, slot.opaqueCount, 0, 0);
+        counters.bindPipeline();
+        counters.draw(slot.opaqueCount);
+    }
+
+    if (slot.uploadedCount > slot.opaqueCount) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, translucentPipeline);
+        vkCmdDraw(commandBuffer, 4, slot.uploadedCount - slot.opaqueCount, 0, slot.opaqueCount);
+        counters.bindPipeline();
+        counters.draw(slot.uploadedCount - slot.opaqueCount);
+    }
+}
+
+VkVertexInputBindingDescription SpriteBatch::bindingDescription() {
+    // VK_VERTEX_INPUT_RATE_INSTANCE = Move to the next element after each instance, instead of after each vertex.
+    VkVertexInputBindingDescription binding {};
+    binding.binding = 0;
+    binding.stride = sizeof(SpriteInstance);
+    binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    return binding;
+}
+
+std::array<VkVertexInputAttributeDescription, 7> SpriteBatch::attributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 7> attributes {};
+
+    attributes[0] = { 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(SpriteInstance, xAxis) };
+    attributes[1] = { 1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(SpriteInstance, yAxis) };
+    attributes[2] = { 2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(SpriteInstance, position) };
+    attributes[3] = { 3, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SpriteInstance, uv) };
+    attributes[4] = { 4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SpriteInstance, color) };
+    attributes[5] = { 5, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(SpriteInstance, gpuAnimation) };
+    // The layer is only used to sort the sprites, so the shader just reads the depth that came out of it.
+    attributes[6] = { 6, 0, VK_FORMAT_R32_SFLOAT, offsetof(SpriteInstance, depth) };
+
+    return attributes;
+}
+
+void SpriteBatch::createDescriptors() {
+    // The frame uniforms are only read by the vertex shader.
+    VkDescriptorSetLayoutBinding frameBinding {};
+    frameBinding.binding = 0;
+    frameBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    frameBinding.descriptorCount = 1;
+    frameBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &frameBinding;
+
+    if (vkCreateDescriptorSetLayout(logicalDevice, &layoutInfo, nullptr, &frameLayout) != VK_SUCCESS) {
+        std::cout << "Failed to create sprite descriptor set layout." << std::endl;
+        std::terminate();
+    }
+
+    VkDescriptorPoolSize poolSize {};
+    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSize.descriptorCount = slotCount;
+
+    VkDescriptorPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = slotCount;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        std::cout << "Failed to create sprite descriptor pool." << std::endl;
+        std::terminate();
+    }
+
+    for (auto& slot : slots) {
+        VkDescriptorSetAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &frameLayout;
+
+        if (vkAllocateDescriptorSets(logicalDevice, &allocInfo, &slot.frameSet) != VK_SUCCESS) {
+            std::cout << "Failed to allocate sprite descriptor sets." << std::endl;
+            std::terminate();
+        }
+        countDescriptorAllocations(1);
+
+        VkDescriptorBufferInfo uniformInfo { slot.uniformBuffer, 0, VK_WHOLE_SIZE };
+
+        VkWriteDescriptorSet write {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = slot.frameSet;
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        write.descriptorCount = 1;
+        write.pBufferInfo = &uniformInfo;
+
+        vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+    }
+}
@@ -0,0 +1,424 @@
+#include "spritepipelines.h"
+#include "spritebatch.h"
+#include "vulkanhelper.h"
+
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+namespace {
+    struct FeatureName {
+        SpriteFeatures feature;
+        std::string_view name;
+    };
+
+    constexpr std::array<FeatureName, 4> featureNames = { {
+        { spriteTextured, "textured" },
+        { spriteTinted, "tinted" },
+        { spriteLit, "lit" },
+        { spriteAlphaTest, "alphatest" },
+    } };
+
+    // Matches the specialization constants of shader.vert and shader.frag.
+    struct SpecializationData {
+        VkBool32 runtimeBranching = VK_FALSE;
+        uint32_t features = 0;
+        VkBool32 opaquePass = VK_FALSE;
+    };
+
+    bool isInstructionCount(const char* name) {
+        std::string lowered = name;
+        for (char& c : lowered) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return lowered.find("instruction") != std::string::npos;
+    }
+}
+
+std::string spriteFeatureNames(SpriteFeatures features) {
+    std::string names;
+    for (const FeatureName& featureName : featureNames) {
+        if ((features & featureName.feature) != 0) {
+            if (!names.empty()) {
+                names += "+";
+            }
+            names += featureName.name;
+        }
+    }
+    return names.empty() ? "none" : names;
+}
+
+std::optional<SpriteFeatures> parseSpriteFeatures(std::string_view names) {
+    if (names == "none") {
+        return 0;
+    }
+    if (names == "all") {
+        return spriteAllFeatures;
+    }
+
+    SpriteFeatures features = 0;
+    while (!names.empty()) {
+        size_t end = names.find_first_of("+,");
+        std::string_view name = names.substr(0, end);
+        names = end == std::string_view::npos ? std::string_view() : names.substr(end + 1);
+
+        bool known = false;
+        for (const FeatureName& featureName : featureNames) {
+            if (name == featureName.name) {
+                features |= featureName.feature;
+                known = true;
+            }
+        }
+        if (!known) {
+            return std::nullopt;
+        }
+    }
+    return features;
+}
+
+void SpritePipelines::init(VkDevice device, const SpritePipelineSettings& settings, std::span<const char> vertexShaderCode,
+                           std::span<const char> fragmentShaderCode) {
+    logicalDevice = device;
+    pipelineSettings = settings;
+
+    // The modules are kept for the lifetime of the pipelines, since variants are built whenever they're first asked for.
+    vertShaderModule = createShaderModule(logicalDevice, vertexShaderCode);
+    fragShaderModule = createShaderModule(logicalDevice, fragmentShaderCode);
+
+    // Uniform values in Shaders needs to be specified during pipeline creation through VkPipelineLayout objects.
+    // Set 0 is the sprite's material, and set 1 the frame uniforms of the sprite batch.
+    std::array<VkDescriptorSetLayout, 2> setLayouts = { pipelineSettings.materialLayout, pipelineSettings.frameLayout };
+    // The size of the output in pixels, which sprite positions are given in, and the features of runtime branching variants,
+    // which both shaders branch on.
+    VkPushConstantRange pushConstantRange {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(SpritePushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo {};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutCreateInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCreateInfo, pipelineSettings.layoutCallbacks, &pipelineLayout) != VK_SUCCESS) {
+        std::cout << "Failed to create sprite pipeline layout." << std::endl;
+        std::terminate();
+    }
+
+    // All variants share their vertex input and most of their shader code, which the driver can find in the cache
+    // when it builds the next variant.
+    VkPipelineCacheCreateInfo cacheCreateInfo {};
+    cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+    if (vkCreatePipelineCache(logicalDevice, &cacheCreateInfo, pipelineSettings.cacheCallbacks, &pipelineCache) != VK_SUCCESS) {
+        std::cout << "Failed to create sprite pipeline cache." << std::endl;
+        std::terminate();
+    }
+}
+
+void SpritePipelines::destroy() {
+    for (auto& [key, pipeline] : variants) {
+        vkDestroyPipeline(logicalDevice, pipeline, pipelineSettings.pipelineCallbacks);
+    }
+    variants.clear();
+
+    vkDestroyPipelineCache(logicalDevice, pipelineCache, pipelineSettings.cacheCallbacks);
+    vkDestroyPipelineLayout(logicalDevice, pipelineLayout, pipelineSettings.layoutCallbacks);
+
+    // createShaderModule doesn't use tracked callbacks, so neither does the destroy.
+    vkDestroyShaderModule(logicalDevice, vertShaderModule, nullptr);
+    vkDestroyShaderModule(logicalDevice, fragShaderModule, nullptr);
+}
+
+VkPipeline SpritePipelines::get(SpriteFeatures features, SpriteBlend blend) {
+    // Runtime branching variants don't depend on the features, so every mask shares the same one.
+    if ((features & runtimeBranching) != 0) {
+        features = runtimeBranching;
+    }
+    features &= spriteAllFeatures | runtimeBranching;
+
+    auto key = std::make_pair(features, blend);
+    auto variant = variants.find(key);
+    if (variant != variants.end()) {
+        return variant->second;
+    }
+
+    VkPipeline pipeline = build(features, blend);
+    variants.emplace(key, pipeline);
+    return pipeline;
+}
+
+VkPipeline SpritePipelines::build(SpriteFeatures features, SpriteBlend blend) {
+    // The feature mask is baked into both shaders as specialization constants. Constants the shaders declare, but that
+    // aren't given here, keep their default values, which is why the runtime branching flag is always given as well.
+    SpecializationData specializationData {};
+    specializationData.runtimeBranching = (features & runtimeBranching) != 0 ? VK_TRUE : VK_FALSE;
+    specializationData.features = features & spriteAllFeatures;
+    // Opaque variants aren't blended, so the fragment shader cuts out transparent texels instead of blending them.
+    specializationData.opaquePass = blend == SpriteBlend::Opaque ? VK_TRUE : VK_FALSE;
+
+    std::array<VkSpecializationMapEntry, 3> specializationEntries {};
+    specializationEntries[0].constantID = 0;
+    specializationEntries[0].offset = offsetof(SpecializationData, runtimeBranching);
+    specializationEntries[0].size = sizeof(VkBool32);
+    specializationEntries[1].constantID = 1;
+    specializationEntries[1].offset = offsetof(SpecializationData, features);
+    specializationEntries[1].size = sizeof(uint32_t);
+    specializationEntries[2].constantID = 2;
+    specializationEntries[2].offset = offsetof(SpecializationData, opaquePass);
+    specializationEntries[2].size = sizeof(VkBool32);
+
+    VkSpecializationInfo specializationInfo {};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = sizeof(specializationData);
+    specializationInfo.pData = &specializationData;
+
+    // Create a vertex shader stage
+    // Using the vertex shader module we created.
+    // pName specifies the function to invoke in our shader (entrypoint), in this case "main".
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo {};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+    vertShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+    // Create a fragment shader stage
+    // Using the fragment shader module we created.
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo {};
+    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.pName = "main";
+    fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+
+    // Describe vertex input
+    // Sprites have no per-vertex data, since the quad corners come from the vertex index. Everything else is read per instance.
+    VkVertexInputBindingDescription instanceBinding = SpriteBatch::bindingDescription();
+    auto instanceAttributes = SpriteBatch::attributeDescriptions();
+    VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo {};
+    vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+    vertexInputStateCreateInfo.pVertexBindingDescriptions = &instanceBinding;
+    vertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instanceAttributes.size());
+    vertexInputStateCreateInfo.pVertexAttributeDescriptions = instanceAttributes.data();
+
+    // Describe input assembly
+    // VkPipelineInputAssemblyStateCreateInfo describes two things:
+    // What kind of geometry will be drawn from the vertices, and if primitive restart should be enabled.
+    // We intend to draw quads, as strips of two triangles.
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo {};
+    inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    // VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP means every vertex after the first two forms a triangle with the two before it.
+    inputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+    // The viewport and scissor rectangle are dynamic state, set when the command buffer is recorded, since the render extent
+    // changes with the resolution scale. Only their count is part of the pipeline.
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo {};
+    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateCreateInfo.viewportCount = 1;
+    viewportStateCreateInfo.scissorCount = 1;
+
+    // Describe the Rasterizer stage
+    // The rasterizer takes the geometry that is shaped by the vertices from the vertex shader and turns it into fragments.
+    // The fragments will then be colored, depth tested, and face culled in the fragment shader.
+    VkPipelineRasterizationStateCreateInfo rasterizationStateCreateInfo {};
+    rasterizationStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizationStateCreateInfo.depthClampEnable = VK_FALSE;
+    rasterizationStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+
+    // polygonMode determines how fragments are generated for geometry.
+    // VK_POLYGON_MODE_FILL = Fill the area of the polygon with fragments.
+    rasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizationStateCreateInfo.lineWidth = 1.0f;
+
+    // Culling refers to the process of discarding triangles during rendering, based on their orientation to the camera.
+    // VK_CULL_MODE_NONE = No triangles are discarded. Sprites mirrored with a negative scale face away, and must still be drawn.
+    rasterizationStateCreateInfo.cullMode = VK_CULL_MODE_NONE;
+    // frontFace determines that order of vertices that determines the front.
+    rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+    rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE;
+    rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
+    rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
+    rasterizationStateCreateInfo.depthBiasSlopeFactor = 0.0f;
+
+    // VkPipelineMultisampleStateCreateInfo configures multisamlping, a type of anti-aliasing.
+    // We disable it for now, as enabling it requires enabling a GPU feature.
+    VkPipelineMultisampleStateCreateInfo multisamplingStateCreateInfo {};
+    multisamplingStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisamplingStateCreateInfo.sampleShadingEnable = VK_FALSE;
+    multisamplingStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisamplingStateCreateInfo.minSampleShading = 1.0f;
+    multisamplingStateCreateInfo.pSampleMask = nullptr;
+    multisamplingStateCreateInfo.alphaToCoverageEnable = VK_FALSE;
+    multisamplingStateCreateInfo.alphaToOneEnable = VK_FALSE;
+
+    // Configure depth testing.
+    // Opaque sprites are drawn front to back. Each one writes its depth, and fragments behind what's already drawn fail the test.
+    // Unless the variant discards, for the alpha test or the transparent texels of textured sprites, the test can run before the
+    // fragment shader, so hidden fragments are never shaded.
+    // VK_COMPARE_OP_LESS = Smaller depths are in front. Every sprite has a depth of its own, so there are no ties.
+    // Translucent sprites are drawn back to front, after the opaque ones. They are tested against the opaque sprites in front of them,
+    // but don't write depth, since whatever is behind them must still be visible through them.
+    VkPipelineDepthStencilStateCreateInfo depthStencilState {};
+    depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilState.depthTestEnable = VK_TRUE;
+    depthStencilState.depthWriteEnable = blend == SpriteBlend::Opaque ? VK_TRUE : VK_FALSE;
+    depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilState.depthBoundsTestEnable = VK_FALSE;
+    depthStencilState.stencilTestEnable = VK_FALSE;
+
+    // Configure color blending.
+    // Color blending is the process of combining the color of a fragment that is being written with the color that is already in the framebuffer.
+    // Opaque sprites hide what's behind them, so they overwrite it.
+    // Translucent sprites are mixed with what's behind them by their alpha: color = source * alpha + destination * (1 - alpha).
+    // The albedo alpha starts out at 1, and stays there, since the alpha is blended the same way with a source factor of 1.
+    VkPipelineColorBlendAttachmentState blendAttachment {};
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    blendAttachment.blendEnable = VK_FALSE;
+    if (blend == SpriteBlend::Translucent) {
+        blendAttachment.blendEnable = VK_TRUE;
+        blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    }
+
+    // The pipelines draw into the albedo and normal attachments, and each color attachment needs its own blend state.
+    std::array<VkPipelineColorBlendAttachmentState, 2> colorBlendAttachments = { blendAttachment, blendAttachment };
+
+    // VkPiplineColorBlendStateCreateInfo contains the configuration for the entire pipeline's color blending state.
+    VkPipelineColorBlendStateCreateInfo colorBlendingStateCreateInfo {};
+    colorBlendingStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlendingStateCreateInfo.logicOpEnable = VK_FALSE;
+    colorBlendingStateCreateInfo.logicOp = VK_LOGIC_OP_COPY;
+    colorBlendingStateCreateInfo.attachmentCount = static_cast<uint32_t>(colorBlendAttachments.size());
+    colorBlendingStateCreateInfo.pAttachments = colorBlendAttachments.data();
+    colorBlendingStateCreateInfo.blendConstants[0] = 0.0f;
+    colorBlendingStateCreateInfo.blendConstants[1] = 0.0f;
+    colorBlendingStateCreateInfo.blendConstants[2] = 0.0f;
+    colorBlendingStateCreateInfo.blendConstants[3] = 0.0f;
+
+    std::array<VkDynamicState, 2> dynamicStates = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    // The driver only keeps the statistics of its shaders when asked to while building the pipeline.
+    pipelineCreateInfo.flags = pipelineSettings.captureStatistics ? VK_PIPELINE_CREATE_CAPTURE_STATISTICS_BIT_KHR : 0;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = shaderStages;
+
+    pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
+    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizationStateCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &multisamplingStateCreateInfo;
+    // Without a depth attachment, there's nothing to test against.
+    pipelineCreateInfo.pDepthStencilState = pipelineSettings.depthAttachment ? &depthStencilState : nullptr;
+    pipelineCreateInfo.pColorBlendState = &colorBlendingStateCreateInfo;
+    pipelineCreateInfo.pDynamicState = &dynamicState;
+
+    pipelineCreateInfo.layout = pipelineLayout;
+
+    pipelineCreateInfo.renderPass = pipelineSettings.renderPass;
+    pipelineCreateInfo.subpass = pipelineSettings.subpass;
+
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vkCreateGraphicsPipelines(logicalDevice, pipelineCache, 1, &pipelineCreateInfo, pipelineSettings.pipelineCallbacks, &pipeline) != VK_SUCCESS) {
+        std::cout << "Failed to create sprite pipeline for features " << spriteFeatureNames(features & spriteAllFeatures) << "." << std::endl;
+        std::terminate();
+    }
+    return pipeline;
+}
+
+SpriteShaderStatistics SpritePipelines::statistics(SpriteFeatures features, SpriteBlend blend) {
+    SpriteShaderStatistics shaderStatistics {};
+    if (!pipelineSettings.captureStatistics) {
+        return shaderStatistics;
+    }
+
+    // The statistics are part of an extension, so its functions have to be looked up, like the debug messenger's.
+    auto getExecutableProperties = (PFN_vkGetPipelineExecutablePropertiesKHR) vkGetDeviceProcAddr(logicalDevice, "vkGetPipelineExecutablePropertiesKHR");
+    auto getExecutableStatistics = (PFN_vkGetPipelineExecutableStatisticsKHR) vkGetDeviceProcAddr(logicalDevice, "vkGetPipelineExecutableStatisticsKHR");
+    if (getExecutableProperties == nullptr || getExecutableStatistics == nullptr) {
+        return shaderStatistics;
+    }
+
+    VkPipelineInfoKHR pipelineInfo {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INFO_KHR;
+    pipelineInfo.pipeline = get(features, blend);
+
+    // A pipeline is made of one or more executables, which are what the driver actually compiled. Usually there's one per
+    // shader stage, but drivers may merge stages, or split them up.
+    uint32_t executableCount = 0;
+    getExecutableProperties(logicalDevice, &pipelineInfo, &executableCount, nullptr);
+    std::vector<VkPipelineExecutablePropertiesKHR> executables(executableCount);
+    for (VkPipelineExecutablePropertiesKHR& executable : executables) {
+        executable.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_PROPERTIES_KHR;
+    }
+    getExecutableProperties(logicalDevice, &pipelineInfo, &executableCount, executables.data());
+
+    for (uint32_t i = 0; i < executableCount; i++) {
+        VkPipelineExecutableInfoKHR executableInfo {};
+        executableInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_INFO_KHR;
+        executableInfo.pipeline = pipelineInfo.pipeline;
+        executableInfo.executableIndex = i;
+
+        uint32_t statisticCount = 0;
+        getExecutableStatistics(logicalDevice, &executableInfo, &statisticCount, nullptr);
+        std::vector<VkPipelineExecutableStatisticKHR> statistics(statisticCount);
+        for (VkPipelineExecutableStatisticKHR& statistic : statistics) {
+            statistic.sType = VK_STRUCTURE_TYPE_PIPELINE_EXECUTABLE_STATISTIC_KHR;
+        }
+        getExecutableStatistics(logicalDevice, &executableInfo, &statisticCount, statistics.data());
+
+        // Statistic names aren't standardized, but every driver that reports instructions has "instruction" in the name.
+        // Some report more than one kind, so only the first is used, which is the total on the drivers that were checked.
+        for (const VkPipelineExecutableStatisticKHR& statistic : statistics) {
+            if (!isInstructionCount(statistic.name)) {
+                continue;
+            }
+
+            uint64_t instructions = 0;
+            if (statistic.format == VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_UINT64_KHR) {
+                instructions = statistic.value.u64;
+            } else if (statistic.format == VK_PIPELINE_EXECUTABLE_STATISTIC_FORMAT_INT64_KHR) {
+                instructions = static_cast<uint64_t>(statistic.value.i64);
+            } else {
+                continue;
+            }
+
+            if ((executables[i].stages & VK_SHADER_STAGE_VERTEX_BIT) != 0) {
+                shaderStatistics.vertexInstructions += instructions;
+            }
+            if ((executables[i].stages & VK_SHADER_STAGE_FRAGMENT_BIT) != 0) {
+                shaderStatistics.fragmentInstructions += instructions;
+            }
+            shaderStatistics.available = true;
+            break;
+        }
+    }
+    return shaderStatistics;
+}
@@ -0,0 +1,49 @@
+#include "texture.h"
+#include "ktx2.h"
+#include "vulkanhelper.h"
+
+Texture decodeTexture(std::span<const char> data) {
+    return isKtx2(data) ? decodeKtx2(data) : decodeTga(data);
+}
+
+void uploadTexture(Texture& texture, const AssetUploadContext& context) {
+    createImage(context.physicalDevice, context.device, texture.width, texture.height, texture.mipLevels, texture.format,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                texture.image, texture.memory);
+
+    texture.imageView = createImageView(context.device, texture.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels);
+
+    if (texture.levels.empty()) {
+        texture.uploadTicket = context.uploadManager->uploadImage(texture.image, texture.width, texture.height,
+                                                                   texture.pixels.data(), texture.pixels.size());
+    } else {
+        texture.uploadTicket = context.uploadManager->uploadImage(texture.image, texture.mipLevels, texture.levels,
+                                                                   texture.pixels.data(), texture.pixels.size());
+    }
+
+    // The texels now live in the staging arena, so the CPU copy is no longer needed.
+    texture.pixels.clear();
+    texture.pixels.shrink_to_fit();
+    texture.levels.clear();
+}
+
+void destroyTexture(VkDevice device, Texture& texture) {
+    vkDestroyImageView(device, texture.imageView, nullptr);
+    vkDestroyImage(device, texture.image, nullptr);
+    vkFreeMemory(device, texture.memory, nullptr);
+
+    texture.imageView = VK_NULL_HANDLE;
+    texture.image = VK_NULL_HANDLE;
+    texture.memory = VK_NULL_HANDLE;
+}
+
+void retireTexture(DeletionQueue& deletionQueue, Texture& texture, uint64_t lastUsedValue) {
+    // The view must go before the image it views, and the image before the memory bound to it.
+    deletionQueue.retire(texture.imageView, lastUsedValue);
+    deletionQueue.retire(texture.image, lastUsedValue);
+    deletionQueue.retire(texture.memory, lastUsedValue);
+
+    texture.imageView = VK_NULL_HANDLE;
+    texture.image = VK_NULL_HANDLE;
+    texture.memory = VK_NULL_HANDLE;
+}
@@ -0,0 +1,433 @@
+#include "textureatlas.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    // "BATL" in little endian.
+    constexpr uint32_t atlasFileMagic = 0x4C544142;
+    constexpr uint32_t atlasFileVersion = 1;
+    // Larger pages than any device can sample are certainly not from a file we wrote.
+    constexpr uint32_t maxAtlasPageSize = 16384;
+
+    uint32_t alignUp(uint32_t value, uint32_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    bool intersects(const AtlasRect& a, const AtlasRect& b) {
+        return a.x < b.x + b.width && b.x < a.x + a.width &&
+               a.y < b.y + b.height && b.y < a.y + a.height;
+    }
+
+    // Also used to validate rects read from files, so the far edges are computed in 64 bits, where they can't wrap around.
+    bool contains(const AtlasRect& outer, const AtlasRect& inner) {
+        return inner.x >= outer.x && inner.y >= outer.y &&
+               uint64_t { inner.x } + inner.width <= uint64_t { outer.x } + outer.width &&
+               uint64_t { inner.y } + inner.height <= uint64_t { outer.y } + outer.height;
+    }
+
+    template<typename T>
+    void writeValue(std::ofstream& file, const T& value) {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    T readValue(std::ifstream& file) {
+        T value {};
+        file.read(reinterpret_cast<char*>(&value), sizeof(T));
+        if (!file) {
+            throw std::runtime_error("unexpected end of atlas file!");
+        }
+        return value;
+    }
+}
+
+TextureAtlas::TextureAtlas(const TextureAtlasConfig& config) : atlasConfig(config) {
+    if (atlasConfig.alignment == 0) {
+        atlasConfig.alignment = 1;
+    }
+
+    // Pages must be a multiple of the alignment, otherwise the free rects along the right and bottom edge would be misaligned.
+    atlasConfig.pageSize = atlasConfig.pageSize / atlasConfig.alignment * atlasConfig.alignment;
+}
+
+std::optional<AtlasEntry> TextureAtlas::insert(const std::string& name, uint32_t width, uint32_t height, const uint8_t* rgbaPixels) {
+    if (width == 0 || height == 0) {
+        return std::nullopt;
+    }
+
+    // The gutter surrounds the image on all sides, while the padding is only added to the right and bottom.
+    // Two neighbouring allocations are therefore always separated by at least "padding" texels.
+    // Allocations start on a multiple of the alignment, so the image does too once the space before it is rounded up.
+    uint32_t imageOffset = alignUp(atlasConfig.gutter, atlasConfig.alignment);
+    uint32_t allocationWidth = alignUp(imageOffset + width + atlasConfig.gutter + atlasConfig.padding, atlasConfig.alignment);
+    uint32_t allocationHeight = alignUp(imageOffset + height + atlasConfig.gutter + atlasConfig.padding, atlasConfig.alignment);
+
+    if (allocationWidth > atlasConfig.pageSize || allocationHeight > atlasConfig.pageSize) {
+        return std::nullopt;
+    }
+
+    // Try the existing pages first, and only create a new page if none of them have room.
+    std::optional<AtlasRect> position;
+    uint32_t pageIndex = 0;
+    for (; pageIndex < atlasPages.size(); pageIndex++) {
+        position = findPosition(atlasPages[pageIndex], allocationWidth, allocationHeight);
+        if (position.has_value()) {
+            break;
+        }
+    }
+
+    if (!position.has_value()) {
+        if (atlasPages.size() >= atlasConfig.maxPages) {
+            return std::nullopt;
+        }
+
+        pageIndex = static_cast<uint32_t>(atlasPages.size());
+        position = findPosition(addPage(), allocationWidth, allocationHeight);
+    }
+
+    AtlasPage& page = atlasPages[pageIndex];
+    placeRect(page, position.value());
+
+    AtlasEntry entry {};
+    entry.page = pageIndex;
+    entry.allocation = position.value();
+    entry.rect = { entry.allocation.x + imageOffset, entry.allocation.y + imageOffset, width, height };
+
+    float pageSize = static_cast<float>(atlasConfig.pageSize);
+    entry.uv.u0 = entry.rect.x / pageSize;
+    entry.uv.v0 = entry.rect.y / pageSize;
+    entry.uv.u1 = (entry.rect.x + entry.rect.width) / pageSize;
+    entry.uv.v1 = (entry.rect.y + entry.rect.height) / pageSize;
+
+    blitWithGutter(page, entry.rect, rgbaPixels);
+
+    page.entryCount++;
+    usedTexels += static_cast<uint64_t>(entry.allocation.width) * entry.allocation.height;
+
+    // An image being replaced is only removed once its replacement has a place, so a failed insertion leaves it untouched.
+    remove(name);
+    entries[name] = entry;
+
+    return entry;
+}
+
+bool TextureAtlas::remove(const std::string& name) {
+    auto it = entries.find(name);
+    if (it == entries.end()) {
+        return false;
+    }
+
+    const AtlasEntry& entry = it->second;
+    AtlasPage& page = atlasPages[entry.page];
+
+    usedTexels -= static_cast<uint64_t>(entry.allocation.width) * entry.allocation.height;
+    page.entryCount--;
+
+    if (page.entryCount == 0) {
+        // Once a page is empty, we can throw away the fragmented free list and start over with a single free rect.
+        page.freeRects.clear();
+        page.freeRects.push_back({ 0, 0, atlasConfig.pageSize, atlasConfig.pageSize });
+    } else {
+        // The texels of the evicted image are left as they are. Nothing samples them anymore,
+        // and the next insertion into that space overwrites them anyway.
+        page.freeRects.push_back(entry.allocation);
+        mergeFreeRects(page);
+        pruneFreeRects(page);
+    }
+
+    entries.erase(it);
+    return true;
+}
+
+const AtlasEntry* TextureAtlas::find(const std::string& name) const {
+    auto it = entries.find(name);
+    return it != entries.end() ? &it->second : nullptr;
+}
+
+float TextureAtlas::occupancy() const {
+    if (atlasPages.empty()) {
+        return 0.0f;
+    }
+
+    uint64_t totalTexels = static_cast<uint64_t>(atlasConfig.pageSize) * atlasConfig.pageSize * atlasPages.size();
+    return static_cast<float>(usedTexels) / static_cast<float>(totalTexels);
+}
+
+void TextureAtlas::clearDirty(uint32_t page) {
+    atlasPages[page].dirty = false;
+    atlasPages[page].dirtyRect = {};
+}
+
+// Best short side fit: choose the free rect where the shorter leftover side is the smallest.
+// This tends to leave large, square-ish free areas behind, which suits sprites of very different sizes.
+std::optional<AtlasRect> TextureAtlas::findPosition(const AtlasPage& page, uint32_t width, uint32_t height) const {
+    std::optional<AtlasRect> bestRect;
+    uint32_t bestShortSide = std::numeric_limits<uint32_t>::max();
+    uint32_t bestLongSide = std::numeric_limits<uint32_t>::max();
+
+    for (const auto& freeRect : page.freeRects) {
+        if (freeRect.width < width || freeRect.height < height) {
+            continue;
+        }
+
+        uint32_t leftoverX = freeRect.width - width;
+        uint32_t leftoverY = freeRect.height - height;
+        uint32_t shortSide = std::min(leftoverX, leftoverY);
+        uint32_t longSide = std::max(leftoverX, leftoverY);
+
+        if (shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide)) {
+            bestRect = AtlasRect { freeRect.x, freeRect.y, width, height };
+            bestShortSide = shortSide;
+            bestLongSide = longSide;
+        }
+    }
+
+    return bestRect;
+}
+
+// Every free rect overlapping the newly used rect is split into up to four maximal free rects around it.
+void TextureAtlas::placeRect(AtlasPage& page, const AtlasRect& usedRect) {
+    std::vector<AtlasRect> newFreeRects;
+    newFreeRects.reserve(page.freeRects.size() + 4);
+
+    for (const auto& freeRect : page.freeRects) {
+        if (!intersects(freeRect, usedRect)) {
+            newFreeRects.push_back(freeRect);
+            continue;
+        }
+
+        // Left of the used rect
+        if (usedRect.x > freeRect.x) {
+            newFreeRects.push_back({ freeRect.x, freeRect.y, usedRect.x - freeRect.x, freeRect.height });
+        }
+
+        // Right of the used rect
+        if (usedRect.x + usedRect.width < freeRect.x + freeRect.width) {
+            uint32_t x = usedRect.x + usedRect.width;
+            newFreeRects.push_back({ x, freeRect.y, freeRect.x + freeRect.width - x, freeRect.height });
+        }
+
+        // Above the used rect
+        if (usedRect.y > freeRect.y) {
+            newFreeRects.push_back({ freeRect.x, freeRect.y, freeRect.width, usedRect.y - freeRect.y });
+        }
+
+        // Below the used rect
+        if (usedRect.y + usedRect.height < freeRect.y + freeRect.height) {
+            uint32_t y = usedRect.y + usedRect.height;
+            newFreeRects.push_back({ freeRect.x, y, freeRect.width, freeRect.y + freeRect.height - y });
+        }
+    }
+
+    page.freeRects = std::move(newFreeRects);
+    pruneFreeRects(page);
+}
+
+// Removes free rects that are fully contained in another free rect, as they can never be the better choice.
+void TextureAtlas::pruneFreeRects(AtlasPage& page) {
+    auto& rects = page.freeRects;
+
+    for (size_t i = 0; i < rects.size(); i++) {
+        for (size_t j = i + 1; j < rects.size(); j++) {
+            if (contains(rects[j], rects[i])) {
+                rects.erase(rects.begin() + i);
+                i--;
+                break;
+            }
+
+            if (contains(rects[i], rects[j])) {
+                rects.erase(rects.begin() + j);
+                j--;
+            }
+        }
+    }
+}
+
+// Evicted allocations are handed back as free rects of their own.
+// Merging free rects that share a full edge grows them back into larger areas, which keeps fragmentation down
+// for atlases that see a lot of churn.
+void TextureAtlas::mergeFreeRects(AtlasPage& page) {
+    auto& rects = page.freeRects;
+
+    bool merged = true;
+    while (merged) {
+        merged = false;
+
+        for (size_t i = 0; i < rects.size() && !merged; i++) {
+            for (size_t j = i + 1; j < rects.size() && !merged; j++) {
+                AtlasRect& a = rects[i];
+                const AtlasRect& b = rects[j];
+
+                bool sameColumn = a.x == b.x && a.width == b.width;
+                bool sameRow = a.y == b.y && a.height == b.height;
+
+                if (sameColumn && (a.y + a.height == b.y || b.y + b.height == a.y)) {
+                    a.y = std::min(a.y, b.y);
+                    a.height += b.height;
+                    merged = true;
+                } else if (sameRow && (a.x + a.width == b.x || b.x + b.width == a.x)) {
+                    a.x = std::min(a.x, b.x);
+                    a.width += b.width;
+                    merged = true;
+                }
+
+                if (merged) {
+                    rects.erase(rects.begin() + j);
+                }
+            }
+        }
+    }
+}
+
+// Copies the image into the page, and extrudes its border pixels into the gutter around it.
+void TextureAtlas::blitWithGutter(AtlasPage& page, const AtlasRect& imageRect, const uint8_t* rgbaPixels) {
+    const int64_t gutter = atlasConfig.gutter;
+    const int64_t width = imageRect.width;
+    const int64_t height = imageRect.height;
+    const size_t pageStride = static_cast<size_t>(atlasConfig.pageSize) * 4;
+
+    for (int64_t y = -gutter; y < height + gutter; y++) {
+        int64_t sourceY = std::clamp<int64_t>(y, 0, height - 1);
+        uint8_t* destinationRow = page.pixels.data() + (imageRect.y + y) * pageStride;
+        const uint8_t* sourceRow = rgbaPixels + sourceY * width * 4;
+
+        // Left gutter, image row, right gutter
+        for (int64_t x = -gutter; x < 0; x++) {
+            std::copy_n(sourceRow, 4, destinationRow + (imageRect.x + x) * 4);
+        }
+
+        std::copy_n(sourceRow, width * 4, destinationRow + imageRect.x * 4);
+
+        for (int64_t x = width; x < width + gutter; x++) {
+            std::copy_n(sourceRow + (width - 1) * 4, 4, destinationRow + (imageRect.x + x) * 4);
+        }
+    }
+
+    markDirty(page, { imageRect.x - atlasConfig.gutter, imageRect.y - atlasConfig.gutter,
+                      imageRect.width + 2 * atlasConfig.gutter, imageRect.height + 2 * atlasConfig.gutter });
+}
+
+void TextureAtlas::markDirty(AtlasPage& page, const AtlasRect& rect) {
+    if (!page.dirty) {
+        page.dirtyRect = rect;
+        page.dirty = true;
+        return;
+    }
+
+    uint32_t left = std::min(page.dirtyRect.x, rect.x);
+    uint32_t top = std::min(page.dirtyRect.y, rect.y);
+    uint32_t right = std::max(page.dirtyRect.x + page.dirtyRect.width, rect.x + rect.width);
+    uint32_t bottom = std::max(page.dirtyRect.y + page.dirtyRect.height, rect.y + rect.height);
+    page.dirtyRect = { left, top, right - left, bottom - top };
+}
+
+AtlasPage& TextureAtlas::addPage() {
+    AtlasPage& page = atlasPages.emplace_back();
+    page.pixels.resize(static_cast<size_t>(atlasConfig.pageSize) * atlasConfig.pageSize * 4, 0);
+    page.freeRects.push_back({ 0, 0, atlasConfig.pageSize, atlasConfig.pageSize });
+    return page;
+}
+
+// File layout (all values little endian):
+// magic, version, config, page count, entry count
+// per entry: name length, name, page, rect, allocation, uv
+// per page: free rect count, free rects, entry count, pixels
+void TextureAtlas::writeToFile(const std::string& filename) const {
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open atlas file for writing!");
+    }
+
+    writeValue(file, atlasFileMagic);
+    writeValue(file, atlasFileVersion);
+    writeValue(file, atlasConfig);
+    writeValue(file, static_cast<uint32_t>(atlasPages.size()));
+    writeValue(file, static_cast<uint32_t>(entries.size()));
+
+    for (const auto& [name, entry] : entries) {
+        writeValue(file, static_cast<uint32_t>(name.size()));
+        file.write(name.data(), name.size());
+        writeValue(file, entry);
+    }
+
+    for (const auto& page : atlasPages) {
+        writeValue(file, static_cast<uint32_t>(page.freeRects.size()));
+        file.write(reinterpret_cast<const char*>(page.freeRects.data()), page.freeRects.size() * sizeof(AtlasRect));
+        writeValue(file, page.entryCount);
+        file.write(reinterpret_cast<const char*>(page.pixels.data()), page.pixels.size());
+    }
+
+    if (!file) {
+        throw std::runtime_error("failed to write atlas file!");
+    }
+}
+
+TextureAtlas TextureAtlas::readFromFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open atlas file!");
+    }
+
+    if (readValue<uint32_t>(file) != atlasFileMagic || readValue<uint32_t>(file) != atlasFileVersion) {
+        throw std::runtime_error("atlas file has an unknown format!");
+    }
+
+    // Written configs have already been through the constructor, so their page size is a multiple of the alignment.
+    TextureAtlasConfig config = readValue<TextureAtlasConfig>(file);
+    if (config.alignment == 0 || config.pageSize == 0 || config.pageSize > maxAtlasPageSize || config.pageSize % config.alignment != 0) {
+        throw std::runtime_error("atlas file has an invalid page size!");
+    }
+
+    TextureAtlas atlas(config);
+    uint32_t pageCount = readValue<uint32_t>(file);
+    uint32_t entryCount = readValue<uint32_t>(file);
+    if (pageCount > config.maxPages) {
+        throw std::runtime_error("atlas file has more pages than it allows!");
+    }
+
+    const AtlasRect pageRect { 0, 0, config.pageSize, config.pageSize };
+    for (uint32_t i = 0; i < entryCount; i++) {
+        std::string name(readValue<uint32_t>(file), '\0');
+        file.read(name.data(), name.size());
+        AtlasEntry entry = readValue<AtlasEntry>(file);
+
+        if (entry.page >= pageCount || !contains(pageRect, entry.allocation) || !contains(entry.allocation, entry.rect)) {
+            throw std::runtime_error("atlas file has an entry outside of its pages!");
+        }
+
+        atlas.usedTexels += static_cast<uint64_t>(entry.allocation.width) * entry.allocation.height;
+        atlas.entries.emplace(std::move(name), entry);
+    }
+
+    for (uint32_t i = 0; i < pageCount; i++) {
+        AtlasPage& page = atlas.atlasPages.emplace_back();
+
+        page.freeRects.resize(readValue<uint32_t>(file));
+        file.read(reinterpret_cast<char*>(page.freeRects.data()), page.freeRects.size() * sizeof(AtlasRect));
+        page.entryCount = readValue<uint32_t>(file);
+
+        for (const auto& freeRect : page.freeRects) {
+            if (!contains(pageRect, freeRect)) {
+                throw std::runtime_error("atlas file has free space outside of its pages!");
+            }
+        }
+
+        page.pixels.resize(static_cast<size_t>(atlas.atlasConfig.pageSize) * atlas.atlasConfig.pageSize * 4);
+        file.read(reinterpret_cast<char*>(page.pixels.data()), page.pixels.size());
+
+        // Freshly loaded pages have never been uploaded, so the whole page is dirty.
+        page.dirty = true;
+        page.dirtyRect = { 0, 0, atlas.atlasConfig.pageSize, atlas.atlasConfig.pageSize };
+    }
+
+    if (!file) {
+        throw std::runtime_error("unexpected end of atlas file!");
+    }
+
+    return atlas;
+}
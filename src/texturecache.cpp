@@ -0,0 +1,223 @@
+#include "texturecache.h"
+
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+bool supportsMemoryBudget(VkPhysicalDevice physicalDevice, uint32_t instanceApiVersion) {
+    // The budget is read through vkGetPhysicalDeviceMemoryProperties2, which is core in Vulkan 1.1.
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if (instanceApiVersion < VK_API_VERSION_1_1 || properties.apiVersion < VK_API_VERSION_1_1) {
+        return false;
+    }
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+    for (const VkExtensionProperties& extension : extensions) {
+        if (std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TextureCache::init(const AssetUploadContext& uploadContext, AssetLoader& assetLoader, DeletionQueue& deletionQueue,
+                        bool memoryBudget, const TextureCacheSettings& cacheSettings) {
+    context = uploadContext;
+    loader = &assetLoader;
+    retired = &deletionQueue;
+    memoryBudgetSupported = memoryBudget;
+    settings = cacheSettings;
+
+    // A single grey texel, which reads as "not there yet" without standing out the way a missing texture pattern would.
+    placeholder.width = 1;
+    placeholder.height = 1;
+    placeholder.pixels = { 128, 128, 128, 255 };
+    uploadTexture(placeholder, context);
+
+    setBudget(settings.budgetBytes);
+}
+
+void TextureCache::destroy() {
+    for (Entry& entry : entries) {
+        if (entry.residency == Residency::Resident) {
+            destroyTexture(context.device, entry.texture);
+        }
+    }
+    entries.clear();
+    newestResident = invalidIndex;
+    oldestResident = invalidIndex;
+
+    destroyTexture(context.device, placeholder);
+}
+
+TextureHandle TextureCache::add(std::string path) {
+    Entry entry {};
+    entry.path = std::move(path);
+    entries.push_back(std::move(entry));
+    return static_cast<TextureHandle>(entries.size() - 1);
+}
+
+VkImageView TextureCache::acquire(TextureHandle handle, uint64_t frameValue) {
+    Entry& entry = entries[handle];
+    entry.lastUsedFrame = frameValue;
+
+    if (entry.residency == Residency::Resident) {
+        counters.hits++;
+        if (newestResident != handle) {
+            unlink(handle);
+            linkNewest(handle);
+        }
+        return entry.texture.imageView;
+    }
+
+    counters.misses++;
+    if (entry.residency == Residency::Unloaded) {
+        entry.residency = Residency::Loading;
+        spawn(load(handle));
+    }
+    return placeholder.imageView;
+}
+
+bool TextureCache::isResident(TextureHandle handle) const {
+    return entries[handle].residency == Residency::Resident;
+}
+
+void TextureCache::update(uint64_t frameValue) {
+    if (settings.budgetBytes == 0 && frameValue - budgetQueriedFrame >= settings.budgetQueryInterval) {
+        budgetBytes = queryBudget();
+        budgetQueriedFrame = frameValue;
+    }
+
+    // The list is ordered by use, so once the oldest texture is used by this frame, so are all the others.
+    // The cache then stays over budget until fewer textures are used per frame.
+    while (counters.residentBytes > budgetBytes && oldestResident != invalidIndex &&
+           entries[oldestResident].lastUsedFrame < frameValue) {
+        evict(oldestResident);
+    }
+}
+
+void TextureCache::setBudget(VkDeviceSize bytes) {
+    settings.budgetBytes = bytes;
+    budgetBytes = bytes != 0 ? bytes : queryBudget();
+}
+
+TextureCacheStats TextureCache::stats() const {
+    TextureCacheStats stats = counters;
+    stats.budgetBytes = budgetBytes;
+    return stats;
+}
+
+Task<void> TextureCache::load(TextureHandle handle) {
+    // The entry is looked up again after the load, since textures added in the meantime may have moved it.
+    try {
+        Texture texture = co_await loader->load<Texture>(entries[handle].path);
+
+        // The texture is uploaded before the next frame is submitted, so it can be handed out right away.
+        VkMemoryRequirements memoryRequirements {};
+        vkGetImageMemoryRequirements(context.device, texture.image, &memoryRequirements);
+
+        Entry& entry = entries[handle];
+        entry.texture = std::move(texture);
+        entry.bytes = memoryRequirements.size;
+        entry.residency = Residency::Resident;
+        linkNewest(handle);
+
+        counters.loads++;
+        counters.residentCount++;
+        counters.residentBytes += entry.bytes;
+        if (counters.residentBytes > counters.peakResidentBytes) {
+            counters.peakResidentBytes = counters.residentBytes;
+        }
+    } catch (const std::exception& exception) {
+        std::cout << "Failed to load texture " << entries[handle].path << ": " << exception.what() << std::endl;
+        entries[handle].residency = Residency::Failed;
+    }
+}
+
+void TextureCache::linkNewest(TextureHandle handle) {
+    Entry& entry = entries[handle];
+    entry.newer = invalidIndex;
+    entry.older = newestResident;
+
+    if (newestResident != invalidIndex) {
+        entries[newestResident].newer = handle;
+    } else {
+        oldestResident = handle;
+    }
+    newestResident = handle;
+}
+
+void TextureCache::unlink(TextureHandle handle) {
+    Entry& entry = entries[handle];
+
+    if (entry.newer != invalidIndex) {
+        entries[entry.newer].older = entry.older;
+    } else {
+        newestResident = entry.older;
+    }
+
+    if (entry.older != invalidIndex) {
+        entries[entry.older].newer = entry.newer;
+    } else {
+        oldestResident = entry.newer;
+    }
+
+    entry.newer = invalidIndex;
+    entry.older = invalidIndex;
+}
+
+void TextureCache::evict(TextureHandle handle) {
+    Entry& entry = entries[handle];
+    unlink(handle);
+
+    // Frames up to the one that last used the texture may still be sampling it.
+    retireTexture(*retired, entry.texture, entry.lastUsedFrame);
+
+    counters.evictions++;
+    counters.residentCount--;
+    counters.residentBytes -= entry.bytes;
+    entry.bytes = 0;
+    entry.residency = Residency::Unloaded;
+}
+
+VkDeviceSize TextureCache::queryBudget() const {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT heapBudgets {};
+    heapBudgets.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 memoryProperties {};
+    memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    if (memoryBudgetSupported) {
+        memoryProperties.pNext = &heapBudgets;
+        vkGetPhysicalDeviceMemoryProperties2(context.physicalDevice, &memoryProperties);
+    } else {
+        vkGetPhysicalDeviceMemoryProperties(context.physicalDevice, &memoryProperties.memoryProperties);
+    }
+
+    // Textures are created in device-local memory. Integrated GPUs may have several device-local heaps, the largest is the one that matters.
+    const VkPhysicalDeviceMemoryProperties& properties = memoryProperties.memoryProperties;
+    uint32_t heapIndex = invalidIndex;
+    for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+        if ((properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0 &&
+            (heapIndex == invalidIndex || properties.memoryHeaps[i].size > properties.memoryHeaps[heapIndex].size)) {
+            heapIndex = i;
+        }
+    }
+    if (heapIndex == invalidIndex) {
+        return 0;
+    }
+
+    if (!memoryBudgetSupported) {
+        return static_cast<VkDeviceSize>(properties.memoryHeaps[heapIndex].size * settings.heapFraction);
+    }
+
+    // The usage includes the resident textures, which are what the budget is for, so they're not counted against it.
+    VkDeviceSize usage = heapBudgets.heapUsage[heapIndex];
+    VkDeviceSize otherUsage = usage > counters.residentBytes ? usage - counters.residentBytes : 0;
+    VkDeviceSize available = heapBudgets.heapBudget[heapIndex] > otherUsage ? heapBudgets.heapBudget[heapIndex] - otherUsage : 0;
+    return static_cast<VkDeviceSize>(available * settings.heapFraction);
+}
@@ -0,0 +1,55 @@
+#include "texture.h"
+
+#include <stdexcept>
+
+// Kept apart from the rest of the texture code, so that the tools can decode TGA files without linking the renderer.
+Texture decodeTga(std::span<const char> data) {
+    // The TGA header is 18 bytes. We only support image type 2 (uncompressed true-color) without a color map.
+    constexpr size_t headerSize = 18;
+    if (data.size() < headerSize) {
+        throw std::runtime_error("TGA file is truncated!");
+    }
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    uint8_t idLength = bytes[0];
+    uint8_t colorMapType = bytes[1];
+    uint8_t imageType = bytes[2];
+    uint32_t width = bytes[12] | (bytes[13] << 8);
+    uint32_t height = bytes[14] | (bytes[15] << 8);
+    uint8_t bitsPerPixel = bytes[16];
+    uint8_t descriptor = bytes[17];
+
+    if (colorMapType != 0 || imageType != 2 || (bitsPerPixel != 24 && bitsPerPixel != 32)) {
+        throw std::runtime_error("unsupported TGA format!");
+    }
+
+    const size_t bytesPerPixel = bitsPerPixel / 8;
+    const size_t pixelOffset = headerSize + idLength;
+    if (data.size() < pixelOffset + static_cast<size_t>(width) * height * bytesPerPixel) {
+        throw std::runtime_error("TGA file is truncated!");
+    }
+
+    Texture texture {};
+    texture.width = width;
+    texture.height = height;
+    texture.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+    // Bit 5 of the descriptor tells whether rows are stored top to bottom. By default TGA stores them bottom to top.
+    bool topToBottom = (descriptor & 0x20) != 0;
+
+    for (uint32_t y = 0; y < height; y++) {
+        uint32_t sourceRow = topToBottom ? y : height - 1 - y;
+        const uint8_t* source = bytes + pixelOffset + static_cast<size_t>(sourceRow) * width * bytesPerPixel;
+        uint8_t* destination = texture.pixels.data() + static_cast<size_t>(y) * width * 4;
+
+        // TGA stores texels as BGR(A).
+        for (uint32_t x = 0; x < width; x++) {
+            destination[x * 4 + 0] = source[x * bytesPerPixel + 2];
+            destination[x * 4 + 1] = source[x * bytesPerPixel + 1];
+            destination[x * 4 + 2] = source[x * bytesPerPixel + 0];
+            destination[x * 4 + 3] = bytesPerPixel == 4 ? source[x * bytesPerPixel + 3] : 255;
+        }
+    }
+
+    return texture;
+}
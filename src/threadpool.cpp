@@ -0,0 +1,79 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <latch>
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+
+    queueCondition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        jobs.push_back(std::move(job));
+    }
+
+    queueCondition.notify_one();
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t minBatchSize, const std::function<void(uint32_t, uint32_t)>& job) {
+    // One batch per worker plus one for the calling thread, unless there isn't enough work to go around.
+    uint32_t batchCount = std::min(threadCount() + 1, count / std::max(minBatchSize, 1u));
+    if (batchCount <= 1) {
+        job(0, count);
+        return;
+    }
+
+    uint32_t batchSize = (count + batchCount - 1) / batchCount;
+    std::latch remaining(batchCount - 1);
+
+    for (uint32_t batch = 1; batch < batchCount; batch++) {
+        uint32_t begin = std::min(batch * batchSize, count);
+        uint32_t end = std::min(begin + batchSize, count);
+        enqueue([&job, &remaining, begin, end] {
+            job(begin, end);
+            remaining.count_down();
+        });
+    }
+
+    // The calling thread takes the first batch instead of sitting idle.
+    job(0, std::min(batchSize, count));
+    remaining.wait();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+            // Only stop once the queue is drained, so that no job is silently dropped.
+            if (jobs.empty()) {
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        job();
+    }
+}
@@ -0,0 +1,127 @@
+#include "timeline.h"
+
+#include <iostream>
+
+namespace {
+    // The capacity is fixed so that building a submission never allocates. Running out of it is a bug in the caller.
+    void checkSemaphoreCapacity(uint32_t count) {
+        if (count >= SubmitSemaphores::maxSemaphores) {
+            std::cout << "Too many semaphores in a single submission." << std::endl;
+            std::terminate();
+        }
+    }
+}
+
+bool supportsTimelineSemaphores(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    if (properties.apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    // Optional features are queried by chaining feature structs into VkPhysicalDeviceFeatures2.
+    VkPhysicalDeviceVulkan12Features vulkan12Features {};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    return vulkan12Features.timelineSemaphore == VK_TRUE;
+}
+
+QueueTimeline createQueueTimeline(VkDevice device, const VkAllocationCallbacks* allocator) {
+    // A timeline semaphore is a regular semaphore, with a VkSemaphoreTypeCreateInfo chained in to pick the type and initial value.
+    VkSemaphoreTypeCreateInfo semaphoreTypeInfo {};
+    semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    semaphoreTypeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &semaphoreTypeInfo;
+
+    QueueTimeline timeline {};
+    if (vkCreateSemaphore(device, &semaphoreInfo, allocator, &timeline.semaphore) != VK_SUCCESS) {
+        std::cout << "Failed to create timeline semaphore." << std::endl;
+        std::terminate();
+    }
+
+    return timeline;
+}
+
+void destroyQueueTimeline(VkDevice device, QueueTimeline& timeline, const VkAllocationCallbacks* allocator) {
+    vkDestroySemaphore(device, timeline.semaphore, allocator);
+    timeline.semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t completedTimelineValue(VkDevice device, const QueueTimeline& timeline) {
+    uint64_t value = 0;
+    vkGetSemaphoreCounterValue(device, timeline.semaphore, &value);
+    return value;
+}
+
+void waitForTimelineValue(VkDevice device, const QueueTimeline& timeline, uint64_t value, uint64_t timeout) {
+    VkSemaphoreWaitInfo waitInfo {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline.semaphore;
+    waitInfo.pValues = &value;
+
+    vkWaitSemaphores(device, &waitInfo, timeout);
+}
+
+void SubmitSemaphores::waitBinary(VkSemaphore semaphore, VkPipelineStageFlags stage) {
+    checkSemaphoreCapacity(waitCount);
+    waitSemaphores[waitCount] = semaphore;
+    // The value is ignored for binary semaphores, but the arrays must line up with the semaphores.
+    waitValues[waitCount] = 0;
+    waitStages[waitCount] = stage;
+    waitCount++;
+}
+
+void SubmitSemaphores::waitTimeline(const QueueTimeline& timeline, uint64_t value, VkPipelineStageFlags stage) {
+    checkSemaphoreCapacity(waitCount);
+    waitSemaphores[waitCount] = timeline.semaphore;
+    waitValues[waitCount] = value;
+    waitStages[waitCount] = stage;
+    waitCount++;
+    usesTimeline = true;
+}
+
+void SubmitSemaphores::signalBinary(VkSemaphore semaphore) {
+    checkSemaphoreCapacity(signalCount);
+    signalSemaphores[signalCount] = semaphore;
+    signalValues[signalCount] = 0;
+    signalCount++;
+}
+
+void SubmitSemaphores::signalTimeline(const QueueTimeline& timeline, uint64_t value) {
+    checkSemaphoreCapacity(signalCount);
+    signalSemaphores[signalCount] = timeline.semaphore;
+    signalValues[signalCount] = value;
+    signalCount++;
+    usesTimeline = true;
+}
+
+void SubmitSemaphores::apply(VkSubmitInfo& submitInfo) {
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+    // The values of timeline semaphores are passed in a VkTimelineSemaphoreSubmitInfo chained into the submit info.
+    // It's only allowed when the timeline semaphore feature is enabled, so it's left out for submissions using binary semaphores only.
+    if (usesTimeline) {
+        timelineSubmitInfo = {};
+        timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineSubmitInfo.waitSemaphoreValueCount = waitCount;
+        timelineSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineSubmitInfo.signalSemaphoreValueCount = signalCount;
+        timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+        submitInfo.pNext = &timelineSubmitInfo;
+    }
+}
@@ -0,0 +1,512 @@
+#include "uploadmanager.h"
+#include "vulkanhelper.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+void UploadManager::init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t transferFamily, VkQueue transferQueue,
+                         uint32_t graphicsFamily, VkQueue graphicsQueue, VkDeviceSize stagingSize, bool useTimelineSemaphores) {
+    logicalDevice = device;
+    useTimeline = useTimelineSemaphores;
+    transferFamilyIndex = transferFamily;
+    graphicsFamilyIndex = graphicsFamily;
+    this->transferQueue = transferQueue;
+    this->graphicsQueue = graphicsQueue;
+
+    // The staging arena lives in host visible memory, so that we can write to it directly from the CPU.
+    // Host coherent memory means we don't have to flush our writes explicitly before the GPU reads them.
+    stagingCapacity = stagingSize;
+    createBuffer(physicalDevice, logicalDevice, stagingCapacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+
+    // The arena stays mapped for the entire lifetime of the upload manager. Mapping and unmapping per upload is wasted work.
+    void* mapped = nullptr;
+    vkMapMemory(logicalDevice, stagingMemory, 0, stagingCapacity, 0, &mapped);
+    stagingMapped = static_cast<uint8_t*>(mapped);
+
+    // VK_COMMAND_POOL_CREATE_TRANSIENT_BIT = Hint that command buffers are rerecorded often.
+    VkCommandPoolCreateInfo poolInfo {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = transferFamilyIndex;
+
+    if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
+        std::cout << "Failed to create transfer command pool." << std::endl;
+        std::terminate();
+    }
+
+    poolInfo.queueFamilyIndex = graphicsFamilyIndex;
+    if (vkCreateCommandPool(logicalDevice, &poolInfo, nullptr, &acquireCommandPool) != VK_SUCCESS) {
+        std::cout << "Failed to create acquire command pool." << std::endl;
+        std::terminate();
+    }
+
+    // Tickets start at 1 and are handed out in submission order, so they double as the values of the upload timeline.
+    if (useTimeline) {
+        uploadTimeline = createQueueTimeline(logicalDevice, nullptr);
+    }
+
+    VkSemaphoreCreateInfo semaphoreInfo {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (auto& batch : batches) {
+        VkCommandBufferAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        allocInfo.commandPool = transferCommandPool;
+        if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &batch.transferCommandBuffer) != VK_SUCCESS) {
+            std::cout << "Failed to allocate transfer command buffer." << std::endl;
+            std::terminate();
+        }
+
+        allocInfo.commandPool = acquireCommandPool;
+        if (vkAllocateCommandBuffers(logicalDevice, &allocInfo, &batch.acquireCommandBuffer) != VK_SUCCESS) {
+            std::cout << "Failed to allocate acquire command buffer." << std::endl;
+            std::terminate();
+        }
+
+        if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &batch.transferCompleteSemaphore) != VK_SUCCESS ||
+            (!useTimeline && vkCreateFence(logicalDevice, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)) {
+            std::cout << "Failed to create upload synchronization objects." << std::endl;
+            std::terminate();
+        }
+    }
+}
+
+void UploadManager::destroy() {
+    for (auto& batch : batches) {
+        vkDestroySemaphore(logicalDevice, batch.transferCompleteSemaphore, nullptr);
+        vkDestroyFence(logicalDevice, batch.fence, nullptr);
+    }
+
+    if (useTimeline) {
+        destroyQueueTimeline(logicalDevice, uploadTimeline, nullptr);
+    }
+
+    // Destroying a command pool frees all command buffers allocated from it.
+    vkDestroyCommandPool(logicalDevice, transferCommandPool, nullptr);
+    vkDestroyCommandPool(logicalDevice, acquireCommandPool, nullptr);
+
+    vkUnmapMemory(logicalDevice, stagingMemory);
+    vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+    vkFreeMemory(logicalDevice, stagingMemory, nullptr);
+}
+
+UploadTicket UploadManager::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size,
+                                         VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask) {
+    // Large buffers are split into chunks, so that a single upload can never need more than the whole arena.
+    const VkDeviceSize maxChunkSize = stagingCapacity / 2;
+    const uint8_t* source = static_cast<const uint8_t*>(data);
+
+    VkDeviceSize uploaded = 0;
+    while (uploaded < size) {
+        VkDeviceSize chunkSize = std::min(size - uploaded, maxChunkSize);
+        VkDeviceSize stagingOffset = allocateStaging(chunkSize, 4);
+        std::memcpy(stagingMapped + stagingOffset, source + uploaded, chunkSize);
+
+        Batch& batch = batches[currentBatch];
+
+        VkBufferCopy copyRegion {};
+        copyRegion.srcOffset = stagingOffset;
+        copyRegion.dstOffset = dstOffset + uploaded;
+        copyRegion.size = chunkSize;
+        vkCmdCopyBuffer(batch.transferCommandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
+
+        VkBufferMemoryBarrier barrier {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.buffer = dstBuffer;
+        barrier.offset = copyRegion.dstOffset;
+        barrier.size = chunkSize;
+        batch.bufferReleaseBarriers.push_back(barrier);
+        batch.acquireStageMask |= dstStageMask;
+
+        batch.bytes += chunkSize;
+        uploadStats.bytesUploaded += chunkSize;
+        uploaded += chunkSize;
+    }
+
+    return batches[currentBatch].ticket;
+}
+
+UploadTicket UploadManager::uploadImage(VkImage dstImage, uint32_t mipLevels, std::span<const VkBufferImageCopy> regions, const void* data, VkDeviceSize size) {
+    if (size > stagingCapacity) {
+        std::cout << "Image upload does not fit into the staging arena." << std::endl;
+        std::terminate();
+    }
+
+    // Buffer offsets for image copies must be a multiple of the texel block size, and 16 covers every format we use.
+    VkDeviceSize stagingOffset = allocateStaging(size, 16);
+    std::memcpy(stagingMapped + stagingOffset, data, size);
+
+    Batch& batch = batches[currentBatch];
+
+    VkImageSubresourceRange subresourceRange {};
+    subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresourceRange.baseMipLevel = 0;
+    subresourceRange.levelCount = mipLevels;
+    subresourceRange.baseArrayLayer = 0;
+    subresourceRange.layerCount = 1;
+
+    // The image has to be in a layout that allows transfer writes before we copy into it.
+    VkImageMemoryBarrier toTransferDst {};
+    toTransferDst.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toTransferDst.srcAccessMask = 0;
+    toTransferDst.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toTransferDst.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toTransferDst.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toTransferDst.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransferDst.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransferDst.image = dstImage;
+    toTransferDst.subresourceRange = subresourceRange;
+    vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &toTransferDst);
+
+    std::vector<VkBufferImageCopy> stagingRegions(regions.begin(), regions.end());
+    for (auto& region : stagingRegions) {
+        region.bufferOffset += stagingOffset;
+    }
+
+    vkCmdCopyBufferToImage(batch.transferCommandBuffer, stagingBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(stagingRegions.size()), stagingRegions.data());
+
+    // The transition into the layout used for sampling is done as part of the ownership transfer.
+    VkImageMemoryBarrier toShaderRead {};
+    toShaderRead.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toShaderRead.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toShaderRead.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    toShaderRead.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toShaderRead.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    toShaderRead.image = dstImage;
+    toShaderRead.subresourceRange = subresourceRange;
+    batch.imageReleaseBarriers.push_back(toShaderRead);
+    batch.acquireStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+    batch.bytes += size;
+    uploadStats.bytesUploaded += size;
+
+    return batch.ticket;
+}
+
+UploadTicket UploadManager::uploadImage(VkImage dstImage, uint32_t width, uint32_t height, const void* data, VkDeviceSize size) {
+    VkBufferImageCopy region {};
+    region.bufferOffset = 0;
+    // A row length and image height of 0 means that the texels are tightly packed.
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { width, height, 1 };
+
+    return uploadImage(dstImage, 1, std::span<const VkBufferImageCopy>(&region, 1), data, size);
+}
+
+void UploadManager::flush() {
+    Batch& batch = batches[currentBatch];
+    if (!batch.recording) {
+        return;
+    }
+
+    const bool dedicated = usesDedicatedTransferQueue();
+
+    // With a dedicated transfer queue, the release barrier only has to make the writes available.
+    // Making them visible to the graphics stages is the job of the acquire barrier on the graphics queue.
+    // Without one, a single ordinary barrier on the graphics queue does both.
+    std::vector<VkBufferMemoryBarrier> bufferBarriers = batch.bufferReleaseBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers = batch.imageReleaseBarriers;
+
+    for (auto& barrier : bufferBarriers) {
+        barrier.srcQueueFamilyIndex = dedicated ? transferFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = dedicated ? graphicsFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+        if (dedicated) {
+            barrier.dstAccessMask = 0;
+        }
+    }
+
+    for (auto& barrier : imageBarriers) {
+        barrier.srcQueueFamilyIndex = dedicated ? transferFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = dedicated ? graphicsFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+        if (dedicated) {
+            barrier.dstAccessMask = 0;
+        }
+    }
+
+    vkCmdPipelineBarrier(batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         dedicated ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : batch.acquireStageMask, 0,
+                         0, nullptr,
+                         static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                         static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+    if (vkEndCommandBuffer(batch.transferCommandBuffer) != VK_SUCCESS) {
+        std::cout << "Failed to record transfer command buffer." << std::endl;
+        std::terminate();
+    }
+
+    if (!useTimeline) {
+        vkResetFences(logicalDevice, 1, &batch.fence);
+    }
+
+    // The submission that makes the uploads usable by the graphics queue signals the batch's completion,
+    // either through the upload timeline or through the batch fence.
+    VkFence completionFence = useTimeline ? VK_NULL_HANDLE : batch.fence;
+
+    VkSubmitInfo transferSubmitInfo {};
+    transferSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    transferSubmitInfo.commandBufferCount = 1;
+    transferSubmitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+
+    if (!dedicated) {
+        SubmitSemaphores submitSemaphores;
+        if (useTimeline) {
+            submitSemaphores.signalTimeline(uploadTimeline, batch.ticket);
+        }
+        submitSemaphores.apply(transferSubmitInfo);
+
+        if (vkQueueSubmit(transferQueue, 1, &transferSubmitInfo, completionFence) != VK_SUCCESS) {
+            std::cout << "Failed to submit upload command buffer." << std::endl;
+            std::terminate();
+        }
+    } else {
+        transferSubmitInfo.signalSemaphoreCount = 1;
+        transferSubmitInfo.pSignalSemaphores = &batch.transferCompleteSemaphore;
+
+        if (vkQueueSubmit(transferQueue, 1, &transferSubmitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            std::cout << "Failed to submit upload command buffer." << std::endl;
+            std::terminate();
+        }
+
+        // The acquire barriers must match the release barriers exactly, except for the access masks.
+        for (size_t i = 0; i < bufferBarriers.size(); i++) {
+            bufferBarriers[i].srcAccessMask = 0;
+            bufferBarriers[i].dstAccessMask = batch.bufferReleaseBarriers[i].dstAccessMask;
+        }
+        for (size_t i = 0; i < imageBarriers.size(); i++) {
+            imageBarriers[i].srcAccessMask = 0;
+            imageBarriers[i].dstAccessMask = batch.imageReleaseBarriers[i].dstAccessMask;
+        }
+
+        VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkResetCommandBuffer(batch.acquireCommandBuffer, 0);
+        vkBeginCommandBuffer(batch.acquireCommandBuffer, &beginInfo);
+        vkCmdPipelineBarrier(batch.acquireCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, batch.acquireStageMask, 0,
+                             0, nullptr,
+                             static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                             static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+        if (vkEndCommandBuffer(batch.acquireCommandBuffer) != VK_SUCCESS) {
+            std::cout << "Failed to record acquire command buffer." << std::endl;
+            std::terminate();
+        }
+
+        // The acquire has to wait until the transfer queue is done with the copies.
+        SubmitSemaphores submitSemaphores;
+        submitSemaphores.waitBinary(batch.transferCompleteSemaphore, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        if (useTimeline) {
+            submitSemaphores.signalTimeline(uploadTimeline, batch.ticket);
+        }
+
+        VkSubmitInfo acquireSubmitInfo {};
+        acquireSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquireSubmitInfo.commandBufferCount = 1;
+        acquireSubmitInfo.pCommandBuffers = &batch.acquireCommandBuffer;
+        submitSemaphores.apply(acquireSubmitInfo);
+
+        if (vkQueueSubmit(graphicsQueue, 1, &acquireSubmitInfo, completionFence) != VK_SUCCESS) {
+            std::cout << "Failed to submit acquire command buffer." << std::endl;
+            std::terminate();
+        }
+    }
+
+    batch.recording = false;
+    batch.inFlight = true;
+    batch.submitTime = std::chrono::steady_clock::now();
+    batch.stagingEnd = stagingHead;
+    uploadStats.batchesSubmitted++;
+    uploadTimeline.lastSubmittedValue = batch.ticket;
+
+    nextTicket++;
+    currentBatch = (currentBatch + 1) % batchCount;
+}
+
+void UploadManager::collect() {
+    // Batches finish in submission order, so we stop at the first one that is still running.
+    while (true) {
+        Batch* oldest = nullptr;
+        for (auto& batch : batches) {
+            if (batch.inFlight && (oldest == nullptr || batch.ticket < oldest->ticket)) {
+                oldest = &batch;
+            }
+        }
+
+        if (oldest == nullptr || !isBatchComplete(*oldest)) {
+            return;
+        }
+
+        retire(*oldest);
+    }
+}
+
+void UploadManager::waitFor(UploadTicket ticket) {
+    if (isComplete(ticket)) {
+        return;
+    }
+
+    if (batches[currentBatch].recording && batches[currentBatch].ticket <= ticket) {
+        flush();
+    }
+
+    while (!isComplete(ticket)) {
+        waitForOldestBatch();
+    }
+}
+
+UploadManager::Batch& UploadManager::beginRecording() {
+    Batch& batch = batches[currentBatch];
+    if (batch.recording) {
+        return batch;
+    }
+
+    // The batch we are about to reuse might still be executing, if uploads are submitted faster than the GPU completes them.
+    if (batch.inFlight) {
+        auto waitStart = std::chrono::steady_clock::now();
+        waitForBatch(batch);
+        uploadStats.secondsWaiting += secondsSince(waitStart);
+        collect();
+    }
+
+    VkCommandBufferBeginInfo beginInfo {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkResetCommandBuffer(batch.transferCommandBuffer, 0);
+    if (vkBeginCommandBuffer(batch.transferCommandBuffer, &beginInfo) != VK_SUCCESS) {
+        std::cout << "Failed to begin recording transfer command buffer." << std::endl;
+        std::terminate();
+    }
+
+    batch.ticket = nextTicket;
+    batch.bytes = 0;
+    batch.stagingEnd = 0;
+    batch.acquireStageMask = 0;
+    batch.bufferReleaseBarriers.clear();
+    batch.imageReleaseBarriers.clear();
+    batch.recording = true;
+
+    return batch;
+}
+
+// Allocates "size" bytes from the staging ring, and makes sure the current batch is recording.
+// If the ring is full, the current batch is submitted and we wait for the oldest batch to free up its range.
+VkDeviceSize UploadManager::allocateStaging(VkDeviceSize size, VkDeviceSize alignment) {
+    while (true) {
+        if (stagingUsed == 0) {
+            stagingHead = 0;
+            stagingTail = 0;
+        }
+
+        VkDeviceSize offset = alignUp(stagingHead, alignment);
+        bool fits = false;
+
+        if (stagingHead >= stagingTail) {
+            // The free space is [head, capacity) followed by [0, tail).
+            if (offset + size <= stagingCapacity) {
+                fits = true;
+            } else if (size < stagingTail || stagingUsed == 0) {
+                // Wrap around, and waste the remainder at the end of the ring.
+                stagingUsed += stagingCapacity - stagingHead;
+                stagingHead = 0;
+                offset = 0;
+                fits = true;
+            }
+        } else if (offset + size < stagingTail) {
+            fits = true;
+        }
+
+        if (fits) {
+            stagingUsed += offset + size - stagingHead;
+            stagingHead = offset + size;
+            beginRecording();
+            return offset;
+        }
+
+        flush();
+        waitForOldestBatch();
+    }
+}
+
+void UploadManager::waitForOldestBatch() {
+    Batch* oldest = nullptr;
+    for (auto& batch : batches) {
+        if (batch.inFlight && (oldest == nullptr || batch.ticket < oldest->ticket)) {
+            oldest = &batch;
+        }
+    }
+
+    if (oldest == nullptr) {
+        std::cout << "Upload does not fit into the staging arena." << std::endl;
+        std::terminate();
+    }
+
+    auto waitStart = std::chrono::steady_clock::now();
+    waitForBatch(*oldest);
+    uploadStats.secondsWaiting += secondsSince(waitStart);
+
+    retire(*oldest);
+}
+
+bool UploadManager::isBatchComplete(const Batch& batch) const {
+    if (useTimeline) {
+        return completedTimelineValue(logicalDevice, uploadTimeline) >= batch.ticket;
+    }
+
+    return vkGetFenceStatus(logicalDevice, batch.fence) == VK_SUCCESS;
+}
+
+void UploadManager::waitForBatch(const Batch& batch) {
+    if (useTimeline) {
+        waitForTimelineValue(logicalDevice, uploadTimeline, batch.ticket);
+    } else {
+        vkWaitForFences(logicalDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    }
+}
+
+void UploadManager::retire(Batch& batch) {
+    // Everything up to the end of this batch's staging range can be reused.
+    VkDeviceSize released = batch.stagingEnd >= stagingTail
+        ? batch.stagingEnd - stagingTail
+        : stagingCapacity - stagingTail + batch.stagingEnd;
+    stagingUsed -= std::min(released, stagingUsed);
+    stagingTail = batch.stagingEnd;
+
+    secondsInFlight += secondsSince(batch.submitTime);
+    uploadStats.bytesCompleted += batch.bytes;
+    if (secondsInFlight > 0.0) {
+        uploadStats.megabytesPerSecond = (uploadStats.bytesCompleted / (1024.0 * 1024.0)) / secondsInFlight;
+    }
+
+    completedTicket = std::max(completedTicket, batch.ticket);
+    batch.inFlight = false;
+}
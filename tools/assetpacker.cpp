@@ -0,0 +1,174 @@
+// Packs files into an asset archive that the engine memory maps at startup.
+//
+// Usage: 2dbeagle_packer [--compress] [--align <bytes>] <output> <file>...
+//
+// Files are stored under the path they are given with, using forward slashes, so "shaders/vert.spv"
+// is looked up as "shaders/vert.spv" at runtime.
+// With --compress, entries are LZ4 compressed when that makes them smaller.
+#include "assetarchive.h"
+#include "filehelper.h"
+#include "lz4.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    struct PackedFile {
+        std::string name;
+        std::vector<char> data;
+        uint64_t size = 0;
+        uint32_t flags = 0;
+    };
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void printUsage() {
+        std::cout << "Usage: 2dbeagle_packer [--compress] [--align <bytes>] <output> <file>..." << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    bool compress = false;
+    uint32_t alignment = 16;
+    std::string outputFilename;
+    std::vector<std::string> inputFilenames;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+
+            if (argument == "--compress") {
+                compress = true;
+            } else if (argument == "--align" && i + 1 < argc) {
+                unsigned long value = std::stoul(argv[++i]);
+                if (value > UINT32_MAX) {
+                    throw std::out_of_range("alignment");
+                }
+                alignment = static_cast<uint32_t>(value);
+            } else if (outputFilename.empty()) {
+                outputFilename = argument;
+            } else {
+                inputFilenames.push_back(argument);
+            }
+        }
+    } catch (const std::exception&) {
+        printUsage();
+        return 1;
+    }
+
+    // SPIR-V is read as 32-bit words straight out of the mapping, so entries must be at least 4 byte aligned.
+    // That also rules out an alignment of 0. Anything that isn't a power of two would break "alignUp" for the data offsets.
+    if (outputFilename.empty() || alignment < 4 || (alignment & (alignment - 1)) != 0) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<PackedFile> files;
+    uint64_t totalSize = 0;
+    uint64_t totalStoredSize = 0;
+
+    for (const auto& inputFilename : inputFilenames) {
+        PackedFile file;
+        file.name = inputFilename;
+        std::replace(file.name.begin(), file.name.end(), '\\', '/');
+
+        try {
+            file.data = readFile(inputFilename);
+        } catch (const std::exception& exception) {
+            std::cout << "Failed to read " << inputFilename << ": " << exception.what() << std::endl;
+            return 1;
+        }
+
+        file.size = file.data.size();
+
+        if (compress && !file.data.empty()) {
+            std::vector<char> compressed = lz4CompressBlock(file.data);
+            if (compressed.size() < file.data.size()) {
+                file.data = std::move(compressed);
+                file.flags |= archiveEntryCompressed;
+            }
+        }
+
+        totalSize += file.size;
+        totalStoredSize += file.data.size();
+        files.push_back(std::move(file));
+    }
+
+    // The index is sorted the same way the runtime searches it.
+    std::sort(files.begin(), files.end(), [](const PackedFile& a, const PackedFile& b) {
+        uint64_t hashA = hashAssetName(a.name);
+        uint64_t hashB = hashAssetName(b.name);
+        return hashA != hashB ? hashA < hashB : a.name < b.name;
+    });
+
+    for (size_t i = 1; i < files.size(); i++) {
+        if (files[i].name == files[i - 1].name) {
+            std::cout << "Duplicate asset " << files[i].name << std::endl;
+            return 1;
+        }
+    }
+
+    ArchiveHeader header {};
+    header.magic = archiveMagic;
+    header.version = archiveVersion;
+    header.entryCount = static_cast<uint32_t>(files.size());
+    header.alignment = alignment;
+    header.indexOffset = sizeof(ArchiveHeader);
+    header.stringTableOffset = header.indexOffset + files.size() * sizeof(ArchiveEntry);
+
+    std::vector<ArchiveEntry> entries(files.size());
+    std::string stringTable;
+
+    for (size_t i = 0; i < files.size(); i++) {
+        entries[i].nameHash = hashAssetName(files[i].name);
+        entries[i].nameOffset = static_cast<uint32_t>(stringTable.size());
+        entries[i].nameLength = static_cast<uint32_t>(files[i].name.size());
+        entries[i].storedSize = files[i].data.size();
+        entries[i].size = files[i].size;
+        entries[i].flags = files[i].flags;
+        stringTable += files[i].name;
+    }
+
+    uint64_t dataOffset = alignUp(header.stringTableOffset + stringTable.size(), alignment);
+    for (auto& entry : entries) {
+        entry.dataOffset = dataOffset;
+        dataOffset = alignUp(dataOffset + entry.storedSize, alignment);
+    }
+
+    std::ofstream output(outputFilename, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+        std::cout << "Failed to open " << outputFilename << " for writing." << std::endl;
+        return 1;
+    }
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+    output.write(stringTable.data(), stringTable.size());
+
+    const std::vector<char> padding(alignment, 0);
+    uint64_t position = header.stringTableOffset + stringTable.size();
+
+    for (size_t i = 0; i < files.size(); i++) {
+        output.write(padding.data(), entries[i].dataOffset - position);
+        output.write(files[i].data.data(), files[i].data.size());
+        position = entries[i].dataOffset + files[i].data.size();
+    }
+
+    if (!output) {
+        std::cout << "Failed to write " << outputFilename << "." << std::endl;
+        return 1;
+    }
+
+    std::cout << "Packed " << files.size() << " assets into " << outputFilename << " ("
+        << totalSize << " bytes, " << totalStoredSize << " bytes stored)" << std::endl;
+
+    return 0;
+}
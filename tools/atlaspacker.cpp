@@ -0,0 +1,147 @@
+// Packs images into a texture atlas offline, so the engine and the level converter don't have to pack at runtime.
+//
+// Usage: 2dbeagle_atlaspacker [--page-size <texels>] [--padding <texels>] [--gutter <texels>] [--add-to <atlas>] <output> <image>...
+//
+// Images are uncompressed 24 or 32 bit TGA files, and are stored under the path they are given with, using forward slashes.
+// Level sprites and tilesets refer to them by that name.
+// The atlas is written to <output>, and every page to "<output>_<page>.tga" next to it, which can be loaded like any other texture.
+// With --add-to, the images are added to an atlas packed earlier, and the images already in it keep their place. Its settings are
+// kept as well, so the other options are ignored.
+#include "filehelper.h"
+#include "texture.h"
+#include "textureatlas.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    // An uncompressed 32 bit true color TGA, stored top to bottom.
+    void writeTga(const std::string& filename, const AtlasPage& page, uint32_t pageSize) {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open " + filename + " for writing!");
+        }
+
+        uint8_t header[18] {};
+        header[2] = 2;
+        header[12] = static_cast<uint8_t>(pageSize & 0xFF);
+        header[13] = static_cast<uint8_t>(pageSize >> 8);
+        header[14] = static_cast<uint8_t>(pageSize & 0xFF);
+        header[15] = static_cast<uint8_t>(pageSize >> 8);
+        header[16] = 32;
+        header[17] = 0x20 | 8;
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+        std::vector<uint8_t> bgra(page.pixels);
+        for (size_t i = 0; i < bgra.size(); i += 4) {
+            std::swap(bgra[i], bgra[i + 2]);
+        }
+        file.write(reinterpret_cast<const char*>(bgra.data()), static_cast<std::streamsize>(bgra.size()));
+
+        if (!file) {
+            throw std::runtime_error("failed to write " + filename + "!");
+        }
+    }
+
+    void printUsage() {
+        std::cout << "Usage: 2dbeagle_atlaspacker [--page-size <texels>] [--padding <texels>] [--gutter <texels>] [--add-to <atlas>]"
+                     " <output> <image>..." << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    TextureAtlasConfig config {};
+    std::string baseFilename;
+    std::string outputFilename;
+    std::vector<std::string> inputFilenames;
+
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+
+            if (argument == "--page-size" && i + 1 < argc) {
+                config.pageSize = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (argument == "--padding" && i + 1 < argc) {
+                config.padding = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (argument == "--gutter" && i + 1 < argc) {
+                config.gutter = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (argument == "--add-to" && i + 1 < argc) {
+                baseFilename = argv[++i];
+            } else if (outputFilename.empty()) {
+                outputFilename = argument;
+            } else {
+                inputFilenames.push_back(argument);
+            }
+        }
+    } catch (const std::exception&) {
+        printUsage();
+        return 1;
+    }
+
+    // Pages are written as TGA files, whose sizes are 16 bits.
+    if (outputFilename.empty() || config.pageSize == 0 || config.pageSize > UINT16_MAX) {
+        printUsage();
+        return 1;
+    }
+
+    TextureAtlas atlas(config);
+    if (!baseFilename.empty()) {
+        try {
+            atlas = TextureAtlas::readFromFile(baseFilename);
+        } catch (const std::exception& exception) {
+            std::cout << "Failed to read " << baseFilename << ": " << exception.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // Larger images are harder to place, so they go in first, while the pages are still empty.
+    std::vector<std::pair<std::string, Texture>> images;
+    for (const auto& inputFilename : inputFilenames) {
+        std::string name = inputFilename;
+        std::replace(name.begin(), name.end(), '\\', '/');
+
+        try {
+            images.emplace_back(name, decodeTga(readFile(inputFilename)));
+        } catch (const std::exception& exception) {
+            std::cout << "Failed to read " << inputFilename << ": " << exception.what() << std::endl;
+            return 1;
+        }
+    }
+    std::stable_sort(images.begin(), images.end(), [](const auto& a, const auto& b) {
+        return std::max(a.second.width, a.second.height) > std::max(b.second.width, b.second.height);
+    });
+
+    for (const auto& [name, image] : images) {
+        if (!atlas.insert(name, image.width, image.height, image.pixels.data()).has_value()) {
+            std::cout << "Failed to pack " << name << ": it doesn't fit on any of " << atlas.config().maxPages << " pages of "
+                      << atlas.config().pageSize << "x" << atlas.config().pageSize << " texels" << std::endl;
+            return 1;
+        }
+    }
+
+    // The extension of the output is replaced, but a dot in a directory name isn't one.
+    size_t extension = outputFilename.rfind('.');
+    size_t directory = outputFilename.find_last_of("/\\");
+    bool hasExtension = extension != std::string::npos && (directory == std::string::npos || extension > directory);
+    std::string pagePrefix = hasExtension ? outputFilename.substr(0, extension) : outputFilename;
+    try {
+        atlas.writeToFile(outputFilename);
+        for (size_t page = 0; page < atlas.pages().size(); page++) {
+            writeTga(pagePrefix + "_" + std::to_string(page) + ".tga", atlas.pages()[page], atlas.config().pageSize);
+        }
+    } catch (const std::exception& exception) {
+        std::cout << "Failed to write " << outputFilename << ": " << exception.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Packed " << atlas.entryCount() << " images onto " << atlas.pages().size() << " pages of "
+              << atlas.config().pageSize << "x" << atlas.config().pageSize << " texels, "
+              << atlas.occupancy() * 100.0f << "% occupied, into " << outputFilename << std::endl;
+
+    return 0;
+}
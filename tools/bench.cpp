@@ -0,0 +1,1311 @@
+// Measures the sprite renderer in representative scenarios, and compares the results with a baseline.
+//
+// Usage: 2dbeagle_bench [--scenarios <name,...>] [--counts <count,...>] [--frames <count>] [--warmup <count>] [--size <width>x<height>]
+//                       [--gpu] [--assets <file>] [--output <file>] [--features <feature+...>] [--permutations]
+//                       [--baseline <file>] [--threshold <percent>] [--tail-threshold <percent>] [--noise-floor <milliseconds>]
+//
+// The scenarios are:
+//   sprites        moving sprites with a single material
+//   mixedtextures  still sprites spread over 16 materials, a quarter of them translucent, drawn with a batch per material
+//   tilemap        a grid of tiles covering the output, scrolled every frame
+//   particles      translucent particles that fall, fade out and respawn
+//   text           lines of glyphs whose characters change every frame
+// Every scenario is run once for every count, with that many sprites, tiles, particles or glyphs.
+//
+// The renderer runs headless: there's no window or swapchain, and the sprites are drawn into offscreen attachments with the engine's
+// sprite batch and sprite shaders, read from the asset archive. By default a CPU implementation of Vulkan is picked, like lavapipe
+// or SwiftShader, which gives numbers that are comparable between machines without a GPU, like build servers. "--gpu" picks a GPU instead.
+//
+// Time advances by a fixed 1/60 of a second per frame, so every run renders the same frames however fast it is. Two frames are in flight,
+// like in the engine, and the frame time is the time between the submissions of two frames, after "--warmup" frames that aren't measured.
+// The results go to the console, and as one line of JSON per scenario to "--output".
+//
+// With "--baseline", the results are compared with an earlier output. A scenario regressed when its median or 95th percentile frame time
+// grew by more than "--threshold" percent, or its 99th percentile by more than "--tail-threshold" percent, and by more than
+// "--noise-floor" milliseconds, so that tiny frame times don't fail on noise. Regressions make the exit code 2.
+//
+// Sprites are drawn with the shader variant specialized for "--features", tinted and lit by default, like the engine.
+// "--permutations" runs the sprites scenario with every feature mask instead, once with the specialized variant and once with the variant
+// that branches at runtime, and shows how much specialization saves in frame time, and in instructions where the driver reports them.
+#include "assetarchive.h"
+#include "framearena.h"
+#include "perfcounters.h"
+#include "spritebatch.h"
+#include "spritepipelines.h"
+#include "vulkanhelper.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace {
+    enum class ScenarioType {
+        Sprites,
+        MixedTextures,
+        Tilemap,
+        Particles,
+        Text
+    };
+
+    struct ScenarioInfo {
+        const char* name;
+        ScenarioType type;
+    };
+
+    constexpr ScenarioInfo scenarioInfos[] = {
+        { "sprites", ScenarioType::Sprites },
+        { "mixedtextures", ScenarioType::MixedTextures },
+        { "tilemap", ScenarioType::Tilemap },
+        { "particles", ScenarioType::Particles },
+        { "text", ScenarioType::Text },
+    };
+
+    // Every material is a normal map and an albedo map of its own, and gets a sprite batch of its own, like sprites that can't share an atlas.
+    constexpr uint32_t materialCount = 16;
+    constexpr uint32_t materialMapSize = 64;
+    constexpr float frameSeconds = 1.0f / 60.0f;
+
+    // Matches the outputs of shader.frag. The lighting subpass isn't part of the benchmark, since its cost doesn't depend on the sprites.
+    constexpr VkFormat albedoFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    constexpr VkFormat normalFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    constexpr VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+
+    struct Attachment {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+    };
+
+    struct Material {
+        Attachment normalMap {};
+        Attachment albedoMap {};
+        VkDescriptorSet set = VK_NULL_HANDLE;
+    };
+
+    // Everything the scenarios render with. Created once, and shared by every run.
+    struct BenchRenderer {
+        VkInstance instance = VK_NULL_HANDLE;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        VkPhysicalDeviceProperties properties {};
+        // Set if the device reports the statistics of the shaders it compiled, which the permutations compare.
+        bool shaderStatistics = false;
+        VkDevice device = VK_NULL_HANDLE;
+        uint32_t queueFamily = 0;
+        VkQueue queue = VK_NULL_HANDLE;
+        VkExtent2D extent {};
+
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        std::array<VkCommandBuffer, SpriteBatch::slotCount> commandBuffers {};
+        std::array<VkFence, SpriteBatch::slotCount> fences {};
+
+        Attachment albedo {};
+        Attachment normal {};
+        Attachment depth {};
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+        VkSampler sampler = VK_NULL_HANDLE;
+        VkDescriptorSetLayout materialLayout = VK_NULL_HANDLE;
+        VkDescriptorPool materialPool = VK_NULL_HANDLE;
+        std::array<Material, materialCount> materials {};
+
+        // One batch per material. Scenarios with a single material only use the first one.
+        std::array<SpriteBatch, materialCount> batches {};
+        // Scratch memory of the batches' uploads, like the engine's.
+        FrameArena frameArena;
+
+        SpritePipelines pipelines;
+        // The variant the sprites are drawn with. May include SpritePipelines::runtimeBranching.
+        SpriteFeatures features = 0;
+    };
+
+    struct BenchResult {
+        std::string scenario;
+        uint32_t count = 0;
+        double p50Milliseconds = 0.0;
+        double p95Milliseconds = 0.0;
+        double p99Milliseconds = 0.0;
+        double meanMilliseconds = 0.0;
+        double framesPerSecond = 0.0;
+        double instancesPerSecond = 0.0;
+        uint32_t drawCalls = 0;
+        double fenceWaitMilliseconds = 0.0;
+        double uploadedBytes = 0.0;
+        // Only measured by the permutations.
+        SpriteShaderStatistics shaderStatistics {};
+    };
+
+    struct BenchSettings {
+        std::vector<ScenarioType> scenarios;
+        std::vector<uint32_t> counts = { 1000, 10000, 100000 };
+        uint32_t frameCount = 300;
+        uint32_t warmupFrames = 30;
+        VkExtent2D extent = { 1280, 720 };
+        bool preferGpu = false;
+        SpriteFeatures features = spriteTinted | spriteLit;
+        bool permutations = false;
+        std::string assetsFile = "assets.bpak";
+        std::string outputFile;
+        std::string baselineFile;
+        double threshold = 10.0;
+        double tailThreshold = 25.0;
+        double noiseFloor = 0.05;
+    };
+
+    const char* deviceTypeName(VkPhysicalDeviceType type) {
+        switch (type) {
+            case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+            default: return "other";
+        }
+    }
+
+    std::optional<uint32_t> findGraphicsFamily(VkPhysicalDevice physicalDevice) {
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+        for (uint32_t i = 0; i < familyCount; i++) {
+            if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                return i;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Picks a CPU device, or a GPU with "preferGpu", discrete ones before integrated ones.
+    // Falls back to any device with a graphics queue, and says so, since its numbers aren't comparable with the usual ones.
+    void pickDevice(BenchRenderer& renderer, bool preferGpu) {
+        uint32_t deviceCount = 0;
+        vkEnumeratePhysicalDevices(renderer.instance, &deviceCount, nullptr);
+        std::vector<VkPhysicalDevice> devices(deviceCount);
+        vkEnumeratePhysicalDevices(renderer.instance, &deviceCount, devices.data());
+
+        auto rank = [&](VkPhysicalDeviceType type) {
+            if (preferGpu) {
+                return type == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU ? 0 : type == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU ? 1 : 2;
+            }
+            return type == VK_PHYSICAL_DEVICE_TYPE_CPU ? 0 : 2;
+        };
+
+        int bestRank = 3;
+        for (VkPhysicalDevice candidate : devices) {
+            std::optional<uint32_t> family = findGraphicsFamily(candidate);
+            if (!family.has_value()) {
+                continue;
+            }
+
+            VkPhysicalDeviceProperties properties {};
+            vkGetPhysicalDeviceProperties(candidate, &properties);
+            if (rank(properties.deviceType) < bestRank) {
+                bestRank = rank(properties.deviceType);
+                renderer.physicalDevice = candidate;
+                renderer.properties = properties;
+                renderer.queueFamily = family.value();
+            }
+        }
+
+        if (renderer.physicalDevice == VK_NULL_HANDLE) {
+            std::cout << "Failed to find a Vulkan device with a graphics queue." << std::endl;
+            std::terminate();
+        }
+        if (bestRank == 2) {
+            std::cout << "No " << (preferGpu ? "GPU" : "CPU") << " device found, using " << renderer.properties.deviceName << " instead." << std::endl;
+        }
+    }
+
+    void createDevice(BenchRenderer& renderer, bool preferGpu) {
+        // Without a window, the instance needs no surface extensions, and the device no swapchain.
+        VkApplicationInfo appInfo {};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "2D Beagle Bench";
+        appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+        appInfo.pEngineName = "2D Beagle";
+        appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+        // 1.1 makes vkGetPhysicalDeviceFeatures2 core, which the shader statistics feature is queried with.
+        appInfo.apiVersion = VK_API_VERSION_1_1;
+
+        VkInstanceCreateInfo instanceInfo {};
+        instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instanceInfo.pApplicationInfo = &appInfo;
+
+        if (vkCreateInstance(&instanceInfo, nullptr, &renderer.instance) != VK_SUCCESS) {
+            std::cout << "Failed to create Vulkan instance." << std::endl;
+            std::terminate();
+        }
+
+        pickDevice(renderer, preferGpu);
+
+        float queuePriority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo {};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = renderer.queueFamily;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &queuePriority;
+
+        // The shader statistics come from VK_KHR_pipeline_executable_properties. Devices without it are still measured,
+        // just without instruction counts.
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(renderer.physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(renderer.physicalDevice, nullptr, &extensionCount, extensions.data());
+
+        VkPhysicalDevicePipelineExecutablePropertiesFeaturesKHR executableFeatures {};
+        executableFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_EXECUTABLE_PROPERTIES_FEATURES_KHR;
+        for (const VkExtensionProperties& extension : extensions) {
+            if (std::string(extension.extensionName) == VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME &&
+                renderer.properties.apiVersion >= VK_API_VERSION_1_1) {
+                VkPhysicalDeviceFeatures2 supportedFeatures {};
+                supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                supportedFeatures.pNext = &executableFeatures;
+                vkGetPhysicalDeviceFeatures2(renderer.physicalDevice, &supportedFeatures);
+                renderer.shaderStatistics = executableFeatures.pipelineExecutableInfo == VK_TRUE;
+            }
+        }
+        std::vector<const char*> enabledExtensions;
+        if (renderer.shaderStatistics) {
+            enabledExtensions.push_back(VK_KHR_PIPELINE_EXECUTABLE_PROPERTIES_EXTENSION_NAME);
+        }
+
+        VkPhysicalDeviceFeatures features {};
+        VkDeviceCreateInfo deviceInfo {};
+        deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        // Only "pipelineExecutableInfo" is enabled, which is only chained when the device supports it.
+        deviceInfo.pNext = renderer.shaderStatistics ? &executableFeatures : nullptr;
+        deviceInfo.queueCreateInfoCount = 1;
+        deviceInfo.pQueueCreateInfos = &queueInfo;
+        deviceInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        deviceInfo.ppEnabledExtensionNames = enabledExtensions.data();
+        deviceInfo.pEnabledFeatures = &features;
+
+        if (vkCreateDevice(renderer.physicalDevice, &deviceInfo, nullptr, &renderer.device) != VK_SUCCESS) {
+            std::cout << "Failed to create logical device." << std::endl;
+            std::terminate();
+        }
+        vkGetDeviceQueue(renderer.device, renderer.queueFamily, 0, &renderer.queue);
+
+        VkCommandPoolCreateInfo poolInfo {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = renderer.queueFamily;
+
+        if (vkCreateCommandPool(renderer.device, &poolInfo, nullptr, &renderer.commandPool) != VK_SUCCESS) {
+            std::cout << "Failed to create command pool." << std::endl;
+            std::terminate();
+        }
+
+        VkCommandBufferAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = renderer.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(renderer.commandBuffers.size());
+
+        if (vkAllocateCommandBuffers(renderer.device, &allocInfo, renderer.commandBuffers.data()) != VK_SUCCESS) {
+            std::cout << "Failed to allocate command buffers." << std::endl;
+            std::terminate();
+        }
+
+        // The fences start signaled, so the first frame of each slot doesn't wait.
+        VkFenceCreateInfo fenceInfo {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        for (VkFence& fence : renderer.fences) {
+            if (vkCreateFence(renderer.device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+                std::cout << "Failed to create fence." << std::endl;
+                std::terminate();
+            }
+        }
+    }
+
+    void createAttachment(BenchRenderer& renderer, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, Attachment& attachment) {
+        createImage(renderer.physicalDevice, renderer.device, renderer.extent.width, renderer.extent.height, 1, format, usage,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, attachment.image, attachment.memory);
+        attachment.imageView = createImageView(renderer.device, attachment.image, format, aspect, 1);
+    }
+
+    void destroyAttachment(VkDevice device, Attachment& attachment) {
+        vkDestroyImageView(device, attachment.imageView, nullptr);
+        vkDestroyImage(device, attachment.image, nullptr);
+        vkFreeMemory(device, attachment.memory, nullptr);
+    }
+
+    // The first subpass of the engine's scene render pass: albedo and normal, cleared and stored, with a depth attachment for the opaque sprites.
+    void createRenderPass(BenchRenderer& renderer) {
+        createAttachment(renderer, albedoFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, renderer.albedo);
+        createAttachment(renderer, normalFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, renderer.normal);
+        createAttachment(renderer, depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, renderer.depth);
+
+        std::array<VkAttachmentDescription, 3> attachments {};
+        for (auto& attachment : attachments) {
+            attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+            attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+        attachments[0].format = albedoFormat;
+        attachments[1].format = normalFormat;
+        attachments[2].format = depthFormat;
+        attachments[2].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[2].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        std::array<VkAttachmentReference, 2> colorReferences = { {
+            { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+            { 1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL },
+        } };
+        VkAttachmentReference depthReference { 2, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+        VkSubpassDescription subpass {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+        subpass.pColorAttachments = colorReferences.data();
+        subpass.pDepthStencilAttachment = &depthReference;
+
+        // Frames in flight write the same attachments, so a frame's writes must wait for those of the frame before it.
+        VkSubpassDependency dependency {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+        renderPassInfo.pAttachments = attachments.data();
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+
+        if (vkCreateRenderPass(renderer.device, &renderPassInfo, nullptr, &renderer.renderPass) != VK_SUCCESS) {
+            std::cout << "Failed to create render pass." << std::endl;
+            std::terminate();
+        }
+
+        std::array<VkImageView, 3> views = { renderer.albedo.imageView, renderer.normal.imageView, renderer.depth.imageView };
+        VkFramebufferCreateInfo framebufferInfo {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderer.renderPass;
+        framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+        framebufferInfo.pAttachments = views.data();
+        framebufferInfo.width = renderer.extent.width;
+        framebufferInfo.height = renderer.extent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(renderer.device, &framebufferInfo, nullptr, &renderer.framebuffer) != VK_SUCCESS) {
+            std::cout << "Failed to create framebuffer." << std::endl;
+            std::terminate();
+        }
+    }
+
+    // Fills the normal map of every material with bumps of a different size, and its albedo map with a gradient whose alpha is a checkerboard,
+    // so that alpha tested variants discard half of every sprite. Uploads them all with a single submission.
+    void createMaterials(BenchRenderer& renderer) {
+        VkSamplerCreateInfo samplerInfo {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.maxLod = 0.0f;
+
+        if (vkCreateSampler(renderer.device, &samplerInfo, nullptr, &renderer.sampler) != VK_SUCCESS) {
+            std::cout << "Failed to create sampler." << std::endl;
+            std::terminate();
+        }
+
+        // The same layout as the materials of the lighting system: a normal map and an albedo map for the fragment shader.
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings {};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(renderer.device, &layoutInfo, nullptr, &renderer.materialLayout) != VK_SUCCESS) {
+            std::cout << "Failed to create material descriptor set layout." << std::endl;
+            std::terminate();
+        }
+
+        VkDescriptorPoolSize poolSize { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, materialCount * 2 };
+        VkDescriptorPoolCreateInfo poolInfo {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = materialCount;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+
+        if (vkCreateDescriptorPool(renderer.device, &poolInfo, nullptr, &renderer.materialPool) != VK_SUCCESS) {
+            std::cout << "Failed to create material descriptor pool." << std::endl;
+            std::terminate();
+        }
+
+        // The normal maps of all materials come first in the staging buffer, followed by their albedo maps.
+        VkDeviceSize mapBytes = materialMapSize * materialMapSize * 4;
+        VkDeviceSize albedoOffset = mapBytes * materialCount;
+        VkBuffer stagingBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+        createBuffer(renderer.physicalDevice, renderer.device, albedoOffset * 2, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+
+        void* mapped = nullptr;
+        vkMapMemory(renderer.device, stagingMemory, 0, albedoOffset * 2, 0, &mapped);
+        uint8_t* texels = static_cast<uint8_t*>(mapped);
+        for (uint32_t material = 0; material < materialCount; material++) {
+            float frequency = 2.0f * 3.14159265f * (material + 1) / materialMapSize;
+            for (uint32_t y = 0; y < materialMapSize; y++) {
+                for (uint32_t x = 0; x < materialMapSize; x++) {
+                    uint8_t* texel = texels + material * mapBytes + (y * materialMapSize + x) * 4;
+                    texel[0] = static_cast<uint8_t>(127.5f + 60.0f * std::sin(x * frequency));
+                    texel[1] = static_cast<uint8_t>(127.5f + 60.0f * std::sin(y * frequency));
+                    texel[2] = 230;
+                    texel[3] = 255;
+
+                    uint8_t* albedo = texels + albedoOffset + material * mapBytes + (y * materialMapSize + x) * 4;
+                    albedo[0] = static_cast<uint8_t>(x * 255 / materialMapSize);
+                    albedo[1] = static_cast<uint8_t>(y * 255 / materialMapSize);
+                    albedo[2] = static_cast<uint8_t>(material * 255 / materialCount);
+                    albedo[3] = (x / 8 + y / 8) % 2 == 0 ? 255 : 0;
+                }
+            }
+        }
+        vkUnmapMemory(renderer.device, stagingMemory);
+
+        VkCommandBuffer commandBuffer = renderer.commandBuffers[0];
+        VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        for (uint32_t i = 0; i < materialCount; i++) {
+            Material& material = renderer.materials[i];
+
+            // Both maps hold plain values rather than sRGB colors, which doesn't matter for the benchmark.
+            std::array<Attachment*, 2> maps = { &material.normalMap, &material.albedoMap };
+            for (uint32_t map = 0; map < maps.size(); map++) {
+                Attachment& attachment = *maps[map];
+                createImage(renderer.physicalDevice, renderer.device, materialMapSize, materialMapSize, 1, VK_FORMAT_R8G8B8A8_UNORM,
+                            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                            attachment.image, attachment.memory);
+                attachment.imageView = createImageView(renderer.device, attachment.image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+                VkImageMemoryBarrier barrier {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = attachment.image;
+                barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+                VkBufferImageCopy region {};
+                region.bufferOffset = map * albedoOffset + i * mapBytes;
+                region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+                region.imageExtent = { materialMapSize, materialMapSize, 1 };
+                vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, attachment.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            }
+
+            VkDescriptorSetAllocateInfo allocInfo {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorPool = renderer.materialPool;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &renderer.materialLayout;
+
+            if (vkAllocateDescriptorSets(renderer.device, &allocInfo, &material.set) != VK_SUCCESS) {
+                std::cout << "Failed to allocate material descriptor set." << std::endl;
+                std::terminate();
+            }
+            countDescriptorAllocations(1);
+
+            std::array<VkDescriptorImageInfo, 2> imageInfos = { {
+                { renderer.sampler, material.normalMap.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+                { renderer.sampler, material.albedoMap.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+            } };
+            VkWriteDescriptorSet write {};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = material.set;
+            write.dstBinding = 0;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+            write.pImageInfo = imageInfos.data();
+            vkUpdateDescriptorSets(renderer.device, 1, &write, 0, nullptr);
+        }
+
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        vkQueueSubmit(renderer.queue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(renderer.queue);
+
+        vkDestroyBuffer(renderer.device, stagingBuffer, nullptr);
+        vkFreeMemory(renderer.device, stagingMemory, nullptr);
+    }
+
+    void createRenderer(BenchRenderer& renderer, const BenchSettings& settings, AssetArchive& assetArchive) {
+        renderer.extent = settings.extent;
+        createDevice(renderer, settings.preferGpu);
+        createRenderPass(renderer);
+        createMaterials(renderer);
+
+        // The largest count goes into the first batch. The others only hold their share of the mixed textures scenario.
+        uint32_t maxCount = *std::max_element(settings.counts.begin(), settings.counts.end());
+        for (uint32_t i = 0; i < materialCount; i++) {
+            renderer.batches[i].init(renderer.physicalDevice, renderer.device, i == 0 ? maxCount : maxCount / materialCount + 1, true);
+        }
+        renderer.frameArena.init(1024 * 1024);
+
+        // The sprite pipelines of the engine, with the render pass of the benchmark. The frame set layouts of all batches are defined
+        // the same, so the layout of the first one is compatible with all of them.
+        SpritePipelineSettings pipelineSettings {};
+        pipelineSettings.renderPass = renderer.renderPass;
+        pipelineSettings.subpass = 0;
+        pipelineSettings.materialLayout = renderer.materialLayout;
+        pipelineSettings.frameLayout = renderer.batches[0].frameSetLayout();
+        pipelineSettings.depthAttachment = true;
+        pipelineSettings.captureStatistics = renderer.shaderStatistics;
+        renderer.pipelines.init(renderer.device, pipelineSettings, assetArchive.get("shaders/vert.spv"), assetArchive.get("shaders/frag.spv"));
+        renderer.features = settings.features;
+    }
+
+    void destroyRenderer(BenchRenderer& renderer) {
+        VkDevice device = renderer.device;
+        vkDeviceWaitIdle(device);
+
+        renderer.pipelines.destroy();
+        renderer.frameArena.destroy();
+        for (SpriteBatch& batch : renderer.batches) {
+            batch.destroy();
+        }
+
+        for (Material& material : renderer.materials) {
+            destroyAttachment(device, material.normalMap);
+            destroyAttachment(device, material.albedoMap);
+        }
+        vkDestroyDescriptorPool(device, renderer.materialPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, renderer.materialLayout, nullptr);
+        vkDestroySampler(device, renderer.sampler, nullptr);
+
+        vkDestroyFramebuffer(device, renderer.framebuffer, nullptr);
+        vkDestroyRenderPass(device, renderer.renderPass, nullptr);
+        destroyAttachment(device, renderer.albedo);
+        destroyAttachment(device, renderer.normal);
+        destroyAttachment(device, renderer.depth);
+
+        for (VkFence fence : renderer.fences) {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        vkDestroyCommandPool(device, renderer.commandPool, nullptr);
+        vkDestroyDevice(device, nullptr);
+        vkDestroyInstance(renderer.instance, nullptr);
+    }
+
+    // The state a scenario keeps between frames, beyond the sprite instances themselves.
+    struct ScenarioState {
+        ScenarioType type = ScenarioType::Sprites;
+        uint32_t count = 0;
+        std::mt19937 random;
+        // Moving sprites and particles.
+        std::vector<std::array<float, 2>> velocities;
+        std::vector<float> ages;
+        std::vector<float> lifetimes;
+        // The tile grid.
+        uint32_t columns = 0;
+        float tileSize = 0.0f;
+        uint32_t frame = 0;
+    };
+
+    // A cell of a 16 by 16 grid covering the whole texture, like a tileset or a font atlas.
+    AtlasUvRect gridCell(uint32_t index) {
+        float cell = 1.0f / 16.0f;
+        float u = (index % 16) * cell;
+        float v = (index / 16 % 16) * cell;
+        return { u, v, u + cell, v + cell };
+    }
+
+    SpriteInstance makeSprite(float x, float y, float width, float height, float alpha) {
+        SpriteInstance instance {};
+        instance.position[0] = x;
+        instance.position[1] = y;
+        instance.xAxis[0] = width;
+        instance.yAxis[1] = height;
+        instance.color[3] = alpha;
+        return instance;
+    }
+
+    // Glyphs are 8 by 12 pixels, in lines of 100, and wrap around to the top when they run out of space.
+    constexpr float glyphWidth = 8.0f;
+    constexpr float glyphHeight = 12.0f;
+    constexpr uint32_t glyphsPerLine = 100;
+
+    void respawnParticle(ScenarioState& state, SpriteInstance& particle, uint32_t index, VkExtent2D extent) {
+        std::uniform_real_distribution<float> angle(0.0f, 2.0f * 3.14159265f);
+        std::uniform_real_distribution<float> speed(50.0f, 300.0f);
+        std::uniform_real_distribution<float> lifetime(0.5f, 3.0f);
+
+        float direction = angle(state.random);
+        float particleSpeed = speed(state.random);
+        state.velocities[index] = { std::cos(direction) * particleSpeed, std::sin(direction) * particleSpeed };
+        state.ages[index] = 0.0f;
+        state.lifetimes[index] = lifetime(state.random);
+        particle.position[0] = extent.width * 0.5f;
+        particle.position[1] = extent.height * 0.5f;
+        particle.color[3] = 0.99f;
+    }
+
+    void setupScenario(BenchRenderer& renderer, ScenarioState& state) {
+        VkExtent2D extent = renderer.extent;
+        std::uniform_real_distribution<float> x(0.0f, static_cast<float>(extent.width));
+        std::uniform_real_distribution<float> y(0.0f, static_cast<float>(extent.height));
+        std::uniform_real_distribution<float> size(16.0f, 64.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::uniform_int_distribution<uint32_t> cell(0, 255);
+
+        for (SpriteBatch& batch : renderer.batches) {
+            batch.clear();
+        }
+        SpriteBatch& batch = renderer.batches[0];
+
+        switch (state.type) {
+            case ScenarioType::Sprites:
+                state.velocities.resize(state.count);
+                for (uint32_t i = 0; i < state.count; i++) {
+                    SpriteInstance sprite = makeSprite(x(state.random), y(state.random), size(state.random), size(state.random), 1.0f);
+                    sprite.uv = gridCell(cell(state.random));
+                    batch.add(sprite);
+                    state.velocities[i] = { (unit(state.random) - 0.5f) * 200.0f, (unit(state.random) - 0.5f) * 200.0f };
+                }
+                break;
+            case ScenarioType::MixedTextures:
+                for (uint32_t i = 0; i < state.count; i++) {
+                    float alpha = unit(state.random) < 0.25f ? 0.5f : 1.0f;
+                    SpriteInstance sprite = makeSprite(x(state.random), y(state.random), size(state.random), size(state.random), alpha);
+                    sprite.uv = gridCell(cell(state.random));
+                    renderer.batches[i % materialCount].add(sprite);
+                }
+                break;
+            case ScenarioType::Tilemap: {
+                // A grid of about "count" tiles, one column wider than the output, so scrolling never shows a gap.
+                float aspect = static_cast<float>(extent.width) / extent.height;
+                state.columns = std::max(2u, static_cast<uint32_t>(std::ceil(std::sqrt(state.count * aspect))));
+                state.tileSize = static_cast<float>(extent.width) / (state.columns - 1);
+                for (uint32_t i = 0; i < state.count; i++) {
+                    SpriteInstance tile = makeSprite(0.0f, 0.0f, state.tileSize, state.tileSize, 1.0f);
+                    tile.uv = gridCell(cell(state.random));
+                    batch.add(tile);
+                }
+                break;
+            }
+            case ScenarioType::Particles:
+                state.velocities.resize(state.count);
+                state.ages.resize(state.count);
+                state.lifetimes.resize(state.count);
+                for (uint32_t i = 0; i < state.count; i++) {
+                    SpriteInstance particle = makeSprite(0.0f, 0.0f, 6.0f, 6.0f, 0.99f);
+                    particle.uv = gridCell(cell(state.random));
+                    respawnParticle(state, particle, i, extent);
+                    // Spread out the ages, so the particles don't all respawn in the same frame.
+                    state.ages[i] = unit(state.random) * state.lifetimes[i];
+                    batch.add(particle);
+                }
+                break;
+            case ScenarioType::Text: {
+                uint32_t lineCount = std::max(1u, static_cast<uint32_t>(extent.height / glyphHeight));
+                for (uint32_t i = 0; i < state.count; i++) {
+                    uint32_t line = i / glyphsPerLine;
+                    float glyphX = (i % glyphsPerLine + 0.5f) * glyphWidth;
+                    float glyphY = (line % lineCount + 0.5f) * glyphHeight;
+                    // Glyphs are blended, like anti-aliased text.
+                    batch.add(makeSprite(glyphX, glyphY, glyphWidth, glyphHeight, 0.99f));
+                }
+                break;
+            }
+        }
+    }
+
+    // Advances the scenario by one frame.
+    void updateScenario(BenchRenderer& renderer, ScenarioState& state) {
+        VkExtent2D extent = renderer.extent;
+        SpriteBatch& batch = renderer.batches[0];
+        std::span<SpriteInstance> instances = batch.instances();
+
+        switch (state.type) {
+            case ScenarioType::Sprites: {
+                float bounds[2] = { static_cast<float>(extent.width), static_cast<float>(extent.height) };
+                for (uint32_t i = 0; i < state.count; i++) {
+                    for (int axis = 0; axis < 2; axis++) {
+                        instances[i].position[axis] += state.velocities[i][axis] * frameSeconds;
+                        if (instances[i].position[axis] < 0.0f || instances[i].position[axis] > bounds[axis]) {
+                            state.velocities[i][axis] = -state.velocities[i][axis];
+                        }
+                    }
+                }
+                batch.markChanged();
+                break;
+            }
+            case ScenarioType::MixedTextures:
+                // Nothing moves, so after the first frames the batches skip their uploads, and only the draws are measured.
+                break;
+            case ScenarioType::Tilemap: {
+                // Scroll diagonally. Every tile is written every frame, like a tilemap that rebuilds its visible tiles.
+                float scroll = state.frame * frameSeconds * 120.0f;
+                float offset = std::fmod(scroll, state.tileSize);
+                for (uint32_t i = 0; i < state.count; i++) {
+                    instances[i].position[0] = (i % state.columns + 0.5f) * state.tileSize - offset;
+                    instances[i].position[1] = (i / state.columns + 0.5f) * state.tileSize - offset;
+                }
+                batch.markChanged();
+                break;
+            }
+            case ScenarioType::Particles:
+                for (uint32_t i = 0; i < state.count; i++) {
+                    state.ages[i] += frameSeconds;
+                    if (state.ages[i] >= state.lifetimes[i]) {
+                        respawnParticle(state, instances[i], i, extent);
+                        continue;
+                    }
+                    // Gravity pulls the particles down, and they fade out over their lifetime.
+                    state.velocities[i][1] += 200.0f * frameSeconds;
+                    instances[i].position[0] += state.velocities[i][0] * frameSeconds;
+                    instances[i].position[1] += state.velocities[i][1] * frameSeconds;
+                    instances[i].color[3] = 0.99f * (1.0f - state.ages[i] / state.lifetimes[i]);
+                }
+                batch.markChanged();
+                break;
+            case ScenarioType::Text:
+                // Every glyph shows a different character each frame, like a console full of changing numbers.
+                for (uint32_t i = 0; i < state.count; i++) {
+                    instances[i].uv = gridCell(32 + (i * 7 + state.frame) % 96);
+                }
+                batch.markChanged();
+                break;
+        }
+
+        state.frame++;
+    }
+
+    void recordFrame(BenchRenderer& renderer, VkCommandBuffer commandBuffer, uint32_t slot, CommandCounters& counters) {
+        VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            std::cout << "Failed to begin recording command buffer." << std::endl;
+            std::terminate();
+        }
+
+        std::array<VkClearValue, 3> clearValues {};
+        clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+        clearValues[1].color = { { 0.5f, 0.5f, 1.0f, 1.0f } };
+        clearValues[2].depthStencil = { 1.0f, 0 };
+
+        VkRenderPassBeginInfo renderPassInfo {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderer.renderPass;
+        renderPassInfo.framebuffer = renderer.framebuffer;
+        renderPassInfo.renderArea.extent = renderer.extent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport { 0.0f, 0.0f, static_cast<float>(renderer.extent.width), static_cast<float>(renderer.extent.height), 0.0f, 1.0f };
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        VkRect2D scissor { { 0, 0 }, renderer.extent };
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        SpritePushConstants pushConstants {};
+        pushConstants.screenSize[0] = static_cast<float>(renderer.extent.width);
+        pushConstants.screenSize[1] = static_cast<float>(renderer.extent.height);
+        pushConstants.features = renderer.features & spriteAllFeatures;
+        VkPipelineLayout pipelineLayout = renderer.pipelines.layout();
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+
+        VkPipeline opaquePipeline = renderer.pipelines.get(renderer.features, SpriteBlend::Opaque);
+        VkPipeline translucentPipeline = renderer.pipelines.get(renderer.features, SpriteBlend::Translucent);
+        for (uint32_t i = 0; i < materialCount; i++) {
+            if (renderer.batches[i].count() == 0) {
+                continue;
+            }
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &renderer.materials[i].set, 0, nullptr);
+            renderer.batches[i].record(commandBuffer, pipelineLayout, slot, opaquePipeline, translucentPipeline, counters);
+        }
+
+        vkCmdEndRenderPass(commandBuffer);
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            std::cout << "Failed to record command buffer." << std::endl;
+            std::terminate();
+        }
+    }
+
+    // Nearest rank percentile of sorted values.
+    double percentile(const std::vector<double>& sortedValues, double percent) {
+        size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sortedValues.size()));
+        return sortedValues[std::clamp<size_t>(rank, 1, sortedValues.size()) - 1];
+    }
+
+    BenchResult runScenario(BenchRenderer& renderer, const ScenarioInfo& info, uint32_t count, const BenchSettings& settings) {
+        ScenarioState state {};
+        state.type = info.type;
+        state.count = count;
+        state.random.seed(count);
+        setupScenario(renderer, state);
+
+        // Build the variants before the first frame, so that building them is never measured, even without warmup frames.
+        renderer.pipelines.get(renderer.features, SpriteBlend::Opaque);
+        renderer.pipelines.get(renderer.features, SpriteBlend::Translucent);
+
+        std::vector<double> frameMilliseconds;
+        frameMilliseconds.reserve(settings.frameCount);
+        double fenceWaitMilliseconds = 0.0;
+        double uploadedBytes = 0.0;
+        uint64_t instances = 0;
+        CommandCounters lastCounters {};
+
+        auto lastSubmit = std::chrono::steady_clock::now();
+        uint32_t totalFrames = settings.warmupFrames + settings.frameCount;
+        for (uint32_t frame = 0; frame < totalFrames; frame++) {
+            bool measured = frame >= settings.warmupFrames;
+            uint32_t slot = frame % SpriteBatch::slotCount;
+
+            // Wait until the GPU is done with the frame that last used this slot, before its buffers are written.
+            auto waitStart = std::chrono::steady_clock::now();
+            vkWaitForFences(renderer.device, 1, &renderer.fences[slot], VK_TRUE, UINT64_MAX);
+            vkResetFences(renderer.device, 1, &renderer.fences[slot]);
+            double waited = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+
+            updateScenario(renderer, state);
+
+            uint64_t frameBytes = 0;
+            renderer.frameArena.beginFrame(frame + 1);
+            for (SpriteBatch& batch : renderer.batches) {
+                batch.setTime(state.frame * frameSeconds);
+                frameBytes += batch.upload(slot, renderer.frameArena);
+            }
+
+            CommandCounters counters {};
+            VkCommandBuffer commandBuffer = renderer.commandBuffers[slot];
+            recordFrame(renderer, commandBuffer, slot, counters);
+
+            VkSubmitInfo submitInfo {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            if (vkQueueSubmit(renderer.queue, 1, &submitInfo, renderer.fences[slot]) != VK_SUCCESS) {
+                std::cout << "Failed to submit draw command buffer." << std::endl;
+                std::terminate();
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (measured) {
+                frameMilliseconds.push_back(std::chrono::duration<double, std::milli>(now - lastSubmit).count());
+                fenceWaitMilliseconds += waited;
+                uploadedBytes += static_cast<double>(frameBytes);
+                instances += counters.instances;
+                lastCounters = counters;
+            }
+            lastSubmit = now;
+        }
+        vkDeviceWaitIdle(renderer.device);
+
+        std::vector<double> sorted = frameMilliseconds;
+        std::sort(sorted.begin(), sorted.end());
+        double totalMilliseconds = 0.0;
+        for (double milliseconds : frameMilliseconds) {
+            totalMilliseconds += milliseconds;
+        }
+
+        BenchResult result {};
+        result.scenario = info.name;
+        result.count = count;
+        result.p50Milliseconds = percentile(sorted, 50.0);
+        result.p95Milliseconds = percentile(sorted, 95.0);
+        result.p99Milliseconds = percentile(sorted, 99.0);
+        result.meanMilliseconds = totalMilliseconds / settings.frameCount;
+        result.framesPerSecond = 1000.0 * settings.frameCount / totalMilliseconds;
+        result.instancesPerSecond = 1000.0 * instances / totalMilliseconds;
+        result.drawCalls = lastCounters.drawCalls;
+        result.fenceWaitMilliseconds = fenceWaitMilliseconds / settings.frameCount;
+        result.uploadedBytes = uploadedBytes / settings.frameCount;
+        return result;
+    }
+
+    // Runs every scenario at every count, and prints a row for each run.
+    std::vector<BenchResult> runScenarios(BenchRenderer& renderer, const BenchSettings& settings) {
+        std::cout << std::setw(14) << "scenario" << std::setw(8) << "count" << std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms"
+            << std::setw(10) << "p99 ms" << std::setw(10) << "fps" << std::setw(14) << "instances/s" << std::setw(7) << "draws" << std::endl;
+
+        std::vector<BenchResult> results;
+        for (ScenarioType type : settings.scenarios) {
+            const ScenarioInfo& info = *std::find_if(std::begin(scenarioInfos), std::end(scenarioInfos),
+                [&](const ScenarioInfo& candidate) { return candidate.type == type; });
+
+            for (uint32_t count : settings.counts) {
+                BenchResult result = runScenario(renderer, info, count, settings);
+                std::cout << std::fixed << std::setprecision(3)
+                    << std::setw(14) << result.scenario << std::setw(8) << result.count
+                    << std::setw(10) << result.p50Milliseconds << std::setw(10) << result.p95Milliseconds << std::setw(10) << result.p99Milliseconds
+                    << std::setprecision(1) << std::setw(10) << result.framesPerSecond
+                    << std::setprecision(0) << std::setw(14) << result.instancesPerSecond << std::setw(7) << result.drawCalls << std::endl;
+                results.push_back(result);
+            }
+        }
+        std::cout << std::defaultfloat << std::setprecision(6);
+        return results;
+    }
+
+    // Formats the instruction counts of a specialized variant and the runtime branching one as "specialized/runtime".
+    std::string instructionColumn(bool available, uint64_t specialized, uint64_t runtime) {
+        return available ? std::to_string(specialized) + "/" + std::to_string(runtime) : "n/a";
+    }
+
+    // Runs the sprites scenario at every count with every feature mask, drawn once with the specialized variant and once with the
+    // runtime branching one. Both runs get a result of their own, named after the scenario, the features and the variant, so they can be
+    // compared with a baseline like any other. Every sprite of the scenario is opaque, so the opaque variants are the ones measured.
+    std::vector<BenchResult> runPermutations(BenchRenderer& renderer, const BenchSettings& settings) {
+        const ScenarioInfo& info = *std::find_if(std::begin(scenarioInfos), std::end(scenarioInfos),
+            [](const ScenarioInfo& candidate) { return candidate.type == ScenarioType::Sprites; });
+        if (!renderer.shaderStatistics) {
+            std::cout << "The device doesn't report shader statistics, so only frame times are compared." << std::endl;
+        }
+
+        // Instruction counts are "specialized/runtime" for the vertex and fragment shaders. The gain is how much lower the median
+        // frame time of the specialized variant is.
+        std::cout << std::setw(32) << "features" << std::setw(8) << "count" << std::setw(14) << "vs instr" << std::setw(14) << "fs instr"
+            << std::setw(14) << "spec p50 ms" << std::setw(14) << "branch p50 ms" << std::setw(9) << "gain" << std::endl;
+
+        std::vector<BenchResult> results;
+        SpriteShaderStatistics runtimeStatistics = renderer.pipelines.statistics(SpritePipelines::runtimeBranching, SpriteBlend::Opaque);
+        for (uint32_t count : settings.counts) {
+            for (SpriteFeatures features = 0; features <= spriteAllFeatures; features++) {
+                std::string names = spriteFeatureNames(features);
+
+                renderer.features = features;
+                BenchResult specialized = runScenario(renderer, info, count, settings);
+                specialized.scenario = std::string(info.name) + "-" + names + "-specialized";
+                specialized.shaderStatistics = renderer.pipelines.statistics(features, SpriteBlend::Opaque);
+
+                renderer.features = features | SpritePipelines::runtimeBranching;
+                BenchResult runtime = runScenario(renderer, info, count, settings);
+                runtime.scenario = std::string(info.name) + "-" + names + "-runtime";
+                runtime.shaderStatistics = runtimeStatistics;
+
+                bool available = specialized.shaderStatistics.available && runtimeStatistics.available;
+                double gain = runtime.p50Milliseconds > 0.0 ? (runtime.p50Milliseconds - specialized.p50Milliseconds) / runtime.p50Milliseconds * 100.0 : 0.0;
+                std::cout << std::setw(32) << names << std::setw(8) << count
+                    << std::setw(14) << instructionColumn(available, specialized.shaderStatistics.vertexInstructions, runtimeStatistics.vertexInstructions)
+                    << std::setw(14) << instructionColumn(available, specialized.shaderStatistics.fragmentInstructions, runtimeStatistics.fragmentInstructions)
+                    << std::fixed << std::setprecision(3) << std::setw(14) << specialized.p50Milliseconds << std::setw(14) << runtime.p50Milliseconds
+                    << std::setprecision(1) << std::setw(8) << gain << "%" << std::defaultfloat << std::setprecision(6) << std::endl;
+
+                results.push_back(specialized);
+                results.push_back(runtime);
+            }
+        }
+        renderer.features = settings.features;
+        return results;
+    }
+
+    std::string escapeJson(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    void writeResults(const std::string& filename, const BenchRenderer& renderer, const BenchSettings& settings, const std::vector<BenchResult>& results) {
+        std::ofstream output(filename, std::ios::trunc);
+        if (!output.is_open()) {
+            throw std::runtime_error("failed to create " + filename + "!");
+        }
+
+        // One JSON object per line, the first one describing the run, like the counter dump of the engine.
+        output << "{\"device\":\"" << escapeJson(renderer.properties.deviceName) << "\""
+               << ",\"deviceType\":\"" << deviceTypeName(renderer.properties.deviceType) << "\""
+               << ",\"width\":" << settings.extent.width
+               << ",\"height\":" << settings.extent.height
+               << ",\"frames\":" << settings.frameCount
+               << ",\"warmupFrames\":" << settings.warmupFrames
+               << ",\"features\":\"" << (settings.permutations ? "permutations" : spriteFeatureNames(settings.features)) << "\""
+               << "}" << std::endl;
+
+        for (const BenchResult& result : results) {
+            output << "{\"scenario\":\"" << result.scenario << "\""
+                   << ",\"count\":" << result.count
+                   << ",\"p50Ms\":" << result.p50Milliseconds
+                   << ",\"p95Ms\":" << result.p95Milliseconds
+                   << ",\"p99Ms\":" << result.p99Milliseconds
+                   << ",\"meanMs\":" << result.meanMilliseconds
+                   << ",\"framesPerSecond\":" << result.framesPerSecond
+                   << ",\"instancesPerSecond\":" << result.instancesPerSecond
+                   << ",\"drawCalls\":" << result.drawCalls
+                   << ",\"fenceWaitMs\":" << result.fenceWaitMilliseconds
+                   << ",\"bytesUploaded\":" << result.uploadedBytes;
+            if (result.shaderStatistics.available) {
+                output << ",\"vertexInstructions\":" << result.shaderStatistics.vertexInstructions
+                       << ",\"fragmentInstructions\":" << result.shaderStatistics.fragmentInstructions;
+            }
+            output << "}" << std::endl;
+        }
+    }
+
+    // Finds the value of "key" in a line written by "writeResults". Only handles the flat objects it writes, not JSON in general.
+    std::optional<std::string> findJsonValue(const std::string& line, const std::string& key) {
+        std::string pattern = "\"" + key + "\":";
+        size_t start = line.find(pattern);
+        if (start == std::string::npos) {
+            return std::nullopt;
+        }
+        start += pattern.size();
+
+        if (start < line.size() && line[start] == '"') {
+            size_t end = line.find('"', start + 1);
+            if (end == std::string::npos) {
+                return std::nullopt;
+            }
+            return line.substr(start + 1, end - start - 1);
+        }
+
+        size_t end = line.find_first_of(",}", start);
+        if (end == std::string::npos) {
+            return std::nullopt;
+        }
+        return line.substr(start, end - start);
+    }
+
+    // Reads the results of an earlier run, keyed by scenario and count. Lines that aren't results are skipped.
+    std::map<std::pair<std::string, uint32_t>, BenchResult> readBaseline(const std::string& filename) {
+        std::ifstream input(filename);
+        if (!input.is_open()) {
+            throw std::runtime_error("failed to open baseline " + filename + "!");
+        }
+
+        std::map<std::pair<std::string, uint32_t>, BenchResult> baseline;
+        std::string line;
+        while (std::getline(input, line)) {
+            std::optional<std::string> scenario = findJsonValue(line, "scenario");
+            std::optional<std::string> count = findJsonValue(line, "count");
+            std::optional<std::string> p50 = findJsonValue(line, "p50Ms");
+            std::optional<std::string> p95 = findJsonValue(line, "p95Ms");
+            std::optional<std::string> p99 = findJsonValue(line, "p99Ms");
+            if (!scenario || !count || !p50 || !p95 || !p99) {
+                continue;
+            }
+
+            BenchResult result {};
+            result.scenario = *scenario;
+            result.count = static_cast<uint32_t>(std::stoul(*count));
+            result.p50Milliseconds = std::stod(*p50);
+            result.p95Milliseconds = std::stod(*p95);
+            result.p99Milliseconds = std::stod(*p99);
+            baseline[{ result.scenario, result.count }] = result;
+        }
+        return baseline;
+    }
+
+    // Compares the results with the baseline, prints every change beyond the thresholds, and returns the number of regressions.
+    uint32_t compareWithBaseline(const std::vector<BenchResult>& results, const BenchSettings& settings) {
+        auto baseline = readBaseline(settings.baselineFile);
+
+        uint32_t regressions = 0;
+        std::cout << "Compared with " << settings.baselineFile << ":" << std::endl;
+        for (const BenchResult& result : results) {
+            auto found = baseline.find({ result.scenario, result.count });
+            if (found == baseline.end()) {
+                std::cout << "  " << result.scenario << " " << result.count << ": not in the baseline" << std::endl;
+                continue;
+            }
+
+            const BenchResult& before = found->second;
+            struct Metric {
+                const char* name;
+                double before;
+                double after;
+                double threshold;
+            };
+            const Metric metrics[] = {
+                { "p50", before.p50Milliseconds, result.p50Milliseconds, settings.threshold },
+                { "p95", before.p95Milliseconds, result.p95Milliseconds, settings.threshold },
+                { "p99", before.p99Milliseconds, result.p99Milliseconds, settings.tailThreshold },
+            };
+
+            for (const Metric& metric : metrics) {
+                double change = metric.before > 0.0 ? (metric.after - metric.before) / metric.before * 100.0 : 0.0;
+                bool regressed = change > metric.threshold && metric.after - metric.before > settings.noiseFloor;
+                bool improved = -change > metric.threshold && metric.before - metric.after > settings.noiseFloor;
+                if (regressed || improved) {
+                    std::cout << "  " << result.scenario << " " << result.count << " " << metric.name << ": "
+                        << metric.before << " ms -> " << metric.after << " ms (" << std::showpos << change << std::noshowpos << "%)"
+                        << (regressed ? " REGRESSED" : " improved") << std::endl;
+                }
+                if (regressed) {
+                    regressions++;
+                }
+            }
+        }
+
+        std::cout << "  " << regressions << " regressions" << std::endl;
+        return regressions;
+    }
+
+    std::vector<std::string> splitList(const std::string& list) {
+        std::vector<std::string> items;
+        std::istringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    bool parseArguments(int argc, char** argv, BenchSettings& settings) {
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            bool hasValue = i + 1 < argc;
+
+            if (argument == "--scenarios" && hasValue) {
+                for (const std::string& name : splitList(argv[++i])) {
+                    auto found = std::find_if(std::begin(scenarioInfos), std::end(scenarioInfos),
+                        [&](const ScenarioInfo& info) { return name == info.name; });
+                    if (found == std::end(scenarioInfos)) {
+                        std::cout << "Unknown scenario " << name << "." << std::endl;
+                        return false;
+                    }
+                    settings.scenarios.push_back(found->type);
+                }
+            } else if (argument == "--counts" && hasValue) {
+                settings.counts.clear();
+                for (const std::string& count : splitList(argv[++i])) {
+                    settings.counts.push_back(std::max(1u, static_cast<uint32_t>(std::stoul(count))));
+                }
+            } else if (argument == "--frames" && hasValue) {
+                settings.frameCount = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+            } else if (argument == "--warmup" && hasValue) {
+                settings.warmupFrames = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (argument == "--size" && hasValue) {
+                std::string size = argv[++i];
+                size_t separator = size.find('x');
+                if (separator == std::string::npos) {
+                    return false;
+                }
+                settings.extent.width = std::max(1u, static_cast<uint32_t>(std::stoul(size.substr(0, separator))));
+                settings.extent.height = std::max(1u, static_cast<uint32_t>(std::stoul(size.substr(separator + 1))));
+            } else if (argument == "--gpu") {
+                settings.preferGpu = true;
+            } else if (argument == "--features" && hasValue) {
+                std::optional<SpriteFeatures> features = parseSpriteFeatures(argv[++i]);
+                if (!features.has_value()) {
+                    std::cout << "Unknown sprite features " << argv[i] << "." << std::endl;
+                    return false;
+                }
+                settings.features = *features;
+            } else if (argument == "--permutations") {
+                settings.permutations = true;
+            } else if (argument == "--assets" && hasValue) {
+                settings.assetsFile = argv[++i];
+            } else if (argument == "--output" && hasValue) {
+                settings.outputFile = argv[++i];
+            } else if (argument == "--baseline" && hasValue) {
+                settings.baselineFile = argv[++i];
+            } else if (argument == "--threshold" && hasValue) {
+                settings.threshold = std::stod(argv[++i]);
+            } else if (argument == "--tail-threshold" && hasValue) {
+                settings.tailThreshold = std::stod(argv[++i]);
+            } else if (argument == "--noise-floor" && hasValue) {
+                settings.noiseFloor = std::stod(argv[++i]);
+            } else {
+                return false;
+            }
+        }
+
+        if (settings.scenarios.empty()) {
+            for (const ScenarioInfo& info : scenarioInfos) {
+                settings.scenarios.push_back(info.type);
+            }
+        }
+        return !settings.counts.empty();
+    }
+}
+
+int main(int argc, char** argv) {
+    BenchSettings settings {};
+    if (!parseArguments(argc, argv, settings)) {
+        std::cout << "Usage: 2dbeagle_bench [--scenarios <name,...>] [--counts <count,...>] [--frames <count>] [--warmup <count>]" << std::endl
+                  << "                      [--size <width>x<height>] [--gpu] [--assets <file>] [--output <file>]" << std::endl
+                  << "                      [--features <feature+...>] [--permutations]" << std::endl
+                  << "                      [--baseline <file>] [--threshold <percent>] [--tail-threshold <percent>] [--noise-floor <milliseconds>]" << std::endl;
+        return 1;
+    }
+
+    try {
+        AssetArchive assetArchive;
+        assetArchive.open(settings.assetsFile);
+
+        BenchRenderer renderer {};
+        createRenderer(renderer, settings, assetArchive);
+
+        std::cout << renderer.properties.deviceName << " (" << deviceTypeName(renderer.properties.deviceType) << "), "
+            << settings.extent.width << "x" << settings.extent.height << ", " << settings.frameCount << " frames after "
+            << settings.warmupFrames << " warmup frames" << std::endl;
+
+        std::vector<BenchResult> results = settings.permutations ? runPermutations(renderer, settings) : runScenarios(renderer, settings);
+
+        if (!settings.outputFile.empty()) {
+            writeResults(settings.outputFile, renderer, settings, results);
+        }
+
+        destroyRenderer(renderer);
+
+        if (!settings.baselineFile.empty() && compareWithBaseline(results, settings) > 0) {
+            return 2;
+        }
+    } catch (const std::exception& exception) {
+        std::cout << exception.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
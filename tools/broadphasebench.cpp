@@ -0,0 +1,144 @@
+// Measures how the broadphase scales with the number of bodies.
+//
+// Usage: 2dbeagle_broadphase_bench [--frames <count>] [--static <fraction>]
+//
+// For every body count, bodies are scattered over a world that grows with the count, so the density and the number of pairs per
+// body stay the same. Dynamic bodies move a little every frame, and the time of updating them and finding pairs is averaged.
+// Every mode is run on the same bodies, and the pair counts are compared, so a mismatch points at a bug in one of them.
+#include "broadphase.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct BenchBody {
+        float position[2];
+        float velocity[2];
+        float halfSize;
+        BodyType type;
+        BodyId id;
+    };
+
+    Aabb boundsOf(const BenchBody& body) {
+        Aabb box {};
+        box.min[0] = body.position[0] - body.halfSize;
+        box.min[1] = body.position[1] - body.halfSize;
+        box.max[0] = body.position[0] + body.halfSize;
+        box.max[1] = body.position[1] + body.halfSize;
+        return box;
+    }
+
+    struct BenchResult {
+        double milliseconds = 0.0;
+        uint32_t pairCount = 0;
+    };
+
+    BenchResult run(std::vector<BenchBody> benchBodies, float worldSize, BroadphaseMode mode, ThreadPool* pool, uint32_t frameCount) {
+        Broadphase broadphase(mode);
+        for (auto& body : benchBodies) {
+            body.id = broadphase.addBody(boundsOf(body), body.type);
+        }
+
+        // The first update sorts from scratch, or builds the tree, which isn't what a frame costs.
+        broadphase.findPairs(pool);
+
+        double totalMilliseconds = 0.0;
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            auto startTime = std::chrono::high_resolution_clock::now();
+
+            for (auto& body : benchBodies) {
+                if (body.type == BodyType::Static) {
+                    continue;
+                }
+
+                // Bounce off the edges of the world.
+                for (int axis = 0; axis < 2; axis++) {
+                    body.position[axis] += body.velocity[axis];
+                    if (body.position[axis] < 0.0f || body.position[axis] > worldSize) {
+                        body.velocity[axis] = -body.velocity[axis];
+                    }
+                }
+                broadphase.updateBody(body.id, boundsOf(body));
+            }
+
+            broadphase.findPairs(pool);
+
+            auto endTime = std::chrono::high_resolution_clock::now();
+            totalMilliseconds += std::chrono::duration<double, std::milli>(endTime - startTime).count();
+        }
+
+        return { totalMilliseconds / frameCount, broadphase.stats().pairCount };
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t frameCount = 60;
+    float staticFraction = 0.5f;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+
+        if (argument == "--frames" && i + 1 < argc) {
+            frameCount = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (argument == "--static" && i + 1 < argc) {
+            staticFraction = std::clamp(std::stof(argv[++i]), 0.0f, 1.0f);
+        } else {
+            std::cout << "Usage: 2dbeagle_broadphase_bench [--frames <count>] [--static <fraction>]" << std::endl;
+            return 1;
+        }
+    }
+
+    ThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+
+    std::cout << frameCount << " frames, " << staticFraction * 100.0f << "% static bodies, " << pool.threadCount() + 1 << " threads" << std::endl;
+    std::cout << "Milliseconds per frame:" << std::endl;
+    std::cout << std::setw(8) << "bodies" << std::setw(10) << "pairs" << std::setw(12) << "sap" << std::setw(12) << "sap mt"
+        << std::setw(12) << "tree" << std::setw(12) << "tree mt" << std::endl;
+
+    const uint32_t bodyCounts[] = { 1000, 2000, 5000, 10000, 20000, 50000, 100000 };
+    for (uint32_t bodyCount : bodyCounts) {
+        // About 100x100 units of space per body, with bodies of 4 to 16 units on a side.
+        float worldSize = std::sqrt(static_cast<float>(bodyCount)) * 100.0f;
+
+        std::mt19937 random(bodyCount);
+        std::uniform_real_distribution<float> position(0.0f, worldSize);
+        std::uniform_real_distribution<float> velocity(-2.0f, 2.0f);
+        std::uniform_real_distribution<float> halfSize(2.0f, 8.0f);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        std::vector<BenchBody> benchBodies(bodyCount);
+        for (auto& body : benchBodies) {
+            body.position[0] = position(random);
+            body.position[1] = position(random);
+            body.velocity[0] = velocity(random);
+            body.velocity[1] = velocity(random);
+            body.halfSize = halfSize(random);
+            body.type = unit(random) < staticFraction ? BodyType::Static : BodyType::Dynamic;
+        }
+
+        BenchResult sap = run(benchBodies, worldSize, BroadphaseMode::SweepAndPrune, nullptr, frameCount);
+        BenchResult sapThreaded = run(benchBodies, worldSize, BroadphaseMode::SweepAndPrune, &pool, frameCount);
+        BenchResult tree = run(benchBodies, worldSize, BroadphaseMode::DynamicTree, nullptr, frameCount);
+        BenchResult treeThreaded = run(benchBodies, worldSize, BroadphaseMode::DynamicTree, &pool, frameCount);
+
+        std::cout << std::fixed << std::setprecision(3)
+            << std::setw(8) << bodyCount << std::setw(10) << sap.pairCount
+            << std::setw(12) << sap.milliseconds << std::setw(12) << sapThreaded.milliseconds
+            << std::setw(12) << tree.milliseconds << std::setw(12) << treeThreaded.milliseconds << std::endl;
+
+        if (sap.pairCount != sapThreaded.pairCount || sap.pairCount != tree.pairCount || sap.pairCount != treeThreaded.pairCount) {
+            std::cout << "Pair counts differ between modes." << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+// Converts a level from its text description into the binary level format the engine memory maps.
+//
+// Usage: 2dbeagle_levelconverter [--atlas <atlas>] <input> <output>
+//
+// The input has one statement per line, and "#" starts a comment:
+//
+//   entity <name> <parent|-> <x> <y> <rotation> <scaleX> <scaleY>
+//   sprite <image> <width> <height> <layer> <r> <g> <b> <a> [<u0> <v0> <u1> <v1>]
+//   tilemap <tileset> <columns> <rows> <x> <y> <tileWidth> <tileHeight> <width> <height> <layer>
+//
+// Parents are referred to by name, and must come before their children. Rotations are in radians.
+// A sprite belongs to the entity above it, and covers the whole image unless a uv rectangle is given.
+// With --atlas, images are looked up in an atlas packed by 2dbeagle_atlaspacker, and sprites without a uv rectangle, and tilesets,
+// get the image's rectangle on the atlas. The engine draws every sprite with a single albedo map, so images must be on the first page.
+// A tilemap is followed by "height" lines of "width" tile indices each, where "." is an empty tile.
+#include "level.h"
+#include "textureatlas.h"
+
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    void printUsage() {
+        std::cout << "Usage: 2dbeagle_levelconverter [--atlas <atlas>] <input> <output>" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string atlasFilename;
+    std::vector<std::string> filenames;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--atlas" && i + 1 < argc) {
+            atlasFilename = argv[++i];
+        } else {
+            filenames.push_back(argument);
+        }
+    }
+
+    if (filenames.size() != 2) {
+        printUsage();
+        return 1;
+    }
+
+    std::string inputFilename = filenames[0];
+    std::string outputFilename = filenames[1];
+
+    std::optional<TextureAtlas> atlas;
+    if (!atlasFilename.empty()) {
+        try {
+            atlas = TextureAtlas::readFromFile(atlasFilename);
+        } catch (const std::exception& e) {
+            std::cout << "Failed to read " << atlasFilename << ": " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    std::ifstream input(inputFilename);
+    if (!input) {
+        std::cout << "Failed to open " << inputFilename << std::endl;
+        return 1;
+    }
+
+    LevelBuilder builder;
+    std::unordered_map<std::string, uint32_t> entityIndices;
+    uint32_t currentEntity = levelNone;
+
+    std::string line;
+    uint32_t lineNumber = 0;
+    auto fail = [&](const std::string& message) {
+        std::cout << inputFilename << ":" << lineNumber << ": " << message << std::endl;
+        return 1;
+    };
+
+    // Without an atlas, every image is a texture of its own, and covers all of it.
+    std::string atlasError;
+    auto imageUv = [&](const std::string& image) -> std::optional<AtlasUvRect> {
+        if (!atlas.has_value()) {
+            return AtlasUvRect{ 0.0f, 0.0f, 1.0f, 1.0f };
+        }
+        const AtlasEntry* entry = atlas->find(image);
+        if (entry == nullptr) {
+            atlasError = "image \"" + image + "\" is not in " + atlasFilename;
+            return std::nullopt;
+        }
+        if (entry->page != 0) {
+            atlasError = "image \"" + image + "\" is on page " + std::to_string(entry->page) + " of " + atlasFilename +
+                         ", but levels can only use the first page";
+            return std::nullopt;
+        }
+        return entry->uv;
+    };
+
+    while (std::getline(input, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream statement(line);
+        std::string keyword;
+        if (!(statement >> keyword)) {
+            continue;
+        }
+
+        if (keyword == "entity") {
+            std::string name;
+            std::string parentName;
+            Transform2D transform;
+            if (!(statement >> name >> parentName >> transform.position[0] >> transform.position[1] >> transform.rotation
+                            >> transform.scale[0] >> transform.scale[1])) {
+                return fail("expected entity <name> <parent|-> <x> <y> <rotation> <scaleX> <scaleY>");
+            }
+
+            uint32_t parent = levelNone;
+            if (parentName != "-") {
+                auto found = entityIndices.find(parentName);
+                if (found == entityIndices.end()) {
+                    return fail("unknown parent \"" + parentName + "\"");
+                }
+                parent = found->second;
+            }
+
+            if (entityIndices.contains(name)) {
+                return fail("duplicate entity \"" + name + "\"");
+            }
+            currentEntity = builder.addEntity(name, parent, transform);
+            entityIndices[name] = currentEntity;
+        } else if (keyword == "sprite") {
+            std::string image;
+            float width, height, layer;
+            float color[4];
+            if (!(statement >> image >> width >> height >> layer >> color[0] >> color[1] >> color[2] >> color[3])) {
+                return fail("expected sprite <image> <width> <height> <layer> <r> <g> <b> <a> [<u0> <v0> <u1> <v1>]");
+            }
+            if (currentEntity == levelNone) {
+                return fail("sprite before any entity");
+            }
+
+            AtlasUvRect uv;
+            AtlasUvRect givenUv;
+            if (statement >> givenUv.u0 >> givenUv.v0 >> givenUv.u1 >> givenUv.v1) {
+                uv = givenUv;
+            } else if (std::optional<AtlasUvRect> atlasUv = imageUv(image)) {
+                uv = *atlasUv;
+            } else {
+                return fail(atlasError);
+            }
+
+            builder.addSprite(currentEntity, image, uv, width, height, color, layer);
+        } else if (keyword == "tilemap") {
+            std::string tileset;
+            uint32_t columns, rows, width, height;
+            float x, y, tileWidth, tileHeight, layer;
+            if (!(statement >> tileset >> columns >> rows >> x >> y >> tileWidth >> tileHeight >> width >> height >> layer)
+                || columns == 0 || rows == 0) {
+                return fail("expected tilemap <tileset> <columns> <rows> <x> <y> <tileWidth> <tileHeight> <width> <height> <layer>");
+            }
+            std::optional<AtlasUvRect> tilesetUv = imageUv(tileset);
+            if (!tilesetUv.has_value()) {
+                return fail(atlasError);
+            }
+
+            std::vector<uint16_t> tiles;
+            tiles.reserve(static_cast<size_t>(width) * height);
+            for (uint32_t row = 0; row < height; row++) {
+                if (!std::getline(input, line)) {
+                    return fail("expected " + std::to_string(height) + " rows of tiles");
+                }
+                lineNumber++;
+
+                std::istringstream rowTiles(line.substr(0, line.find('#')));
+                std::string tile;
+                uint32_t count = 0;
+                while (rowTiles >> tile) {
+                    if (tile == ".") {
+                        tiles.push_back(levelEmptyTile);
+                    } else {
+                        unsigned long index = 0;
+                        try {
+                            index = std::stoul(tile);
+                        } catch (const std::exception&) {
+                            return fail("invalid tile \"" + tile + "\"");
+                        }
+                        if (index >= static_cast<unsigned long>(columns) * rows || index >= levelEmptyTile) {
+                            return fail("tile " + tile + " is outside the tileset");
+                        }
+                        tiles.push_back(static_cast<uint16_t>(index));
+                    }
+                    count++;
+                }
+                if (count != width) {
+                    return fail("expected " + std::to_string(width) + " tiles, got " + std::to_string(count));
+                }
+            }
+
+            builder.addTilemap(tileset, *tilesetUv, columns, rows, x, y, tileWidth, tileHeight,
+                               width, height, tiles, layer);
+        } else {
+            return fail("unknown statement \"" + keyword + "\"");
+        }
+    }
+
+    std::vector<char> levelData = builder.build();
+
+    // Open the level the way the engine will, so a level that wouldn't load is never written.
+    Level level;
+    try {
+        level.open(std::span<const char>(levelData));
+    } catch (const std::exception& e) {
+        std::cout << "Failed to build " << outputFilename << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::ofstream output(outputFilename, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        std::cout << "Failed to create " << outputFilename << std::endl;
+        return 1;
+    }
+    output.write(levelData.data(), static_cast<std::streamsize>(levelData.size()));
+    if (!output) {
+        std::cout << "Failed to write " << outputFilename << std::endl;
+        return 1;
+    }
+
+    std::cout << "Converted " << level.entities().size() << " entities, " << level.spriteCount() << " sprites and "
+              << level.tilemaps().size() << " tilemaps (" << level.tileCount() << " tiles) into " << outputFilename
+              << " (" << levelData.size() << " bytes)" << std::endl;
+
+    return 0;
+}